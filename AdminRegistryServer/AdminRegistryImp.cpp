@@ -937,7 +937,11 @@ int AdminRegistryImp::batchPatch(const tars::PatchRequest & req, string & result
 int AdminRegistryImp::batchPatch_inner(const tars::PatchRequest & req, string &result)
 {
     tars::PatchRequest reqPro = req;
-    reqPro.patchobj = (*g_pconf)["/tars/objname<patchServerObj>"];
+    //patchobj为空时从patch下载, 否则原样下发, 格式为"节点1;...;patch", 由调用者(分发树)把patch放在最后兜底
+    if (reqPro.patchobj.empty())
+    {
+        reqPro.patchobj = (*g_pconf)["/tars/objname<patchServerObj>"];
+    }
 	reqPro.servertype = getServerType(req.appname, req.servername, req.nodename);
 
     int iRet = 0;
@@ -836,6 +836,33 @@ int DbProxy::getGroupId(const string& ip)
     return -1;
 }
 
+string DbProxy::getNodeObj(const string& nodeName)
+{
+    try
+    {
+		TC_Mysql::MysqlData res;
+		{
+			MYSQL_LOCK;
+			string sSql = "select node_obj "
+                      "from t_node_info "
+				"where node_name='" + MYSQL_INDEX->escapeString(nodeName) + "' and present_state='active'";
+
+			res = MYSQL_INDEX->queryRecord(sSql);
+		}
+
+        if (res.size() > 0)
+        {
+            return res[0]["node_obj"];
+        }
+    }
+    catch (TC_Mysql_Exception& ex)
+    {
+        TLOG_ERROR(" " << nodeName << " exception: " << ex.what() << endl);
+    }
+
+    return "";
+}
+
 NodePrx DbProxy::getNodePrx(const string& nodeName)
 {
     try
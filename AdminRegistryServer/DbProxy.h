@@ -68,6 +68,13 @@ public:
      */
     NodePrx getNodePrx(const string & nodeName);
 
+    /**
+     * 获取node注册的node_obj, 和getNodePrx使用同一个地址
+     * @param nodeName : node id
+     * @return : node_obj, node没有注册或者不是active时返回空
+     */
+    string getNodeObj(const string & nodeName);
+
     /**
      * 增加异步任务
      * 
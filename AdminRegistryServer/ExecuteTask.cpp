@@ -19,6 +19,7 @@
 #include "servant/RemoteLogger.h"
 #include "util/tc_timeprovider.h"
 #include <thread>
+#include <set>
 extern TC_Config * g_pconf;
 
 TaskList::TaskList(const TaskReq &taskReq, unsigned int t)
@@ -362,6 +363,95 @@ string TaskList::get(const string &name, const map<string, string> &parameters)
     return it->second;
 }
 
+string TaskList::getNodeHost(const string &nodeName)
+{
+    //node_obj形如tars.tarsnode.NodeObj@tcp -h 127.0.0.1 -p 19385 -t 60000, 取第一个地址
+    string nodeObj = DBPROXY->getNodeObj(nodeName);
+    string::size_type at = nodeObj.find('@');
+    if (at == string::npos)
+    {
+        TLOG_ERROR("TaskList::getNodeHost node:" << nodeName << "|invalid node_obj:" << nodeObj << endl);
+        return "";
+    }
+
+    try
+    {
+        vector<string> vEndpoint = TC_Common::sepstr<string>(nodeObj.substr(at + 1), ":");
+        if (!vEndpoint.empty())
+        {
+            TC_Endpoint ep;
+            ep.parse(vEndpoint[0]);
+            return ep.getHost();
+        }
+    }
+    catch (exception &ex)
+    {
+        TLOG_ERROR("TaskList::getNodeHost node:" << nodeName << "|node_obj:" << nodeObj << "|exception:" << ex.what() << endl);
+    }
+
+    return "";
+}
+
+string TaskList::getPeerPatchObj(size_t index, const TaskItemReq &req)
+{
+    if (g_pconf->get("/tars/patch<peer_patch>", "N") != "Y")
+    {
+        return "";
+    }
+
+    size_t fanout = TC_Common::strto<size_t>(g_pconf->get("/tars/patch<peer_patch_fanout>", "4"));
+    fanout = fanout < 1 ? 1 : fanout;
+
+    string port  = g_pconf->get("/tars/patch<peer_patch_port>", "19388");
+    string patch = get("patch_id", req.parameters);
+
+    //同一个包的发布在任务中的顺序
+    vector<size_t> vIndex;
+    size_t pos = 0;
+    for (size_t i = 0; i < _taskReq.taskItemReq.size(); i++)
+    {
+        const TaskItemReq &item = _taskReq.taskItemReq[i];
+        if ((item.command == "patch_tars" || item.command == "grace_patch_tars") && get("patch_id", item.parameters) == patch)
+        {
+            if (i == index)
+            {
+                pos = vIndex.size();
+            }
+            vIndex.push_back(i);
+        }
+    }
+
+    //从父节点开始往上, 最多三层, 都不可用时由patch兜底
+    string peers;
+    set<string> setNode;
+    setNode.insert(req.nodeName);
+    for (int level = 0; level < 3 && pos > 0; level++)
+    {
+        pos = (pos - 1) / fanout;
+
+        const string &nodeName = _taskReq.taskItemReq[vIndex[pos]].nodeName;
+        if (!setNode.insert(nodeName).second)
+        {
+            continue;
+        }
+
+        //和节点代理一样使用节点注册的node_obj中的地址, node名不一定是能连上的地址
+        string host = getNodeHost(nodeName);
+        if (!host.empty())
+        {
+            peers += (peers.empty() ? "" : ";") + string("tars.tarsnode.PatchObj@tcp -h ") + host + " -p " + port + " -t 60000";
+        }
+    }
+
+    //分发树的根节点没有祖先, 直接从patch下载
+    if (peers.empty())
+    {
+        return "";
+    }
+
+    return peers + ";" + g_pconf->get("/tars/objname<patchServerObj>", "tars.tarspatch.PatchObj");
+}
+
 EMTaskItemStatus TaskList::patch(size_t index, const TaskItemReq &req, string &log)
 {
     try
@@ -383,6 +473,7 @@ EMTaskItemStatus TaskList::patch(size_t index, const TaskItemReq &req, string &l
         patchReq.user       = req.userName;
 	    patchReq.groupname  = groupName;
 		patchReq.md5		= get("md5",req.parameters);
+		patchReq.patchobj	= getPeerPatchObj(index, req);
 
 		//外部是串行处理的
         try
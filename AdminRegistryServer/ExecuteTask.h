@@ -97,6 +97,17 @@ protected:
 //    EMTaskItemStatus gridPatchServer(const TaskItemReq &req, string &log);
     string get(const string &name, const map<string, string> &parameters);
 
+    /**
+     * 节点间分发发布包时, 本任务中同一个包的发布按顺序组成分发树,
+     * 返回树中祖先节点的PatchObj和最后兜底的patch, 用";"分隔, 未开启或者没有祖先时返回空
+     */
+    string getPeerPatchObj(size_t index, const TaskItemReq &req);
+
+    /**
+     * 节点注册的node_obj中的地址, 取不到时返回空
+     */
+    string getNodeHost(const string &nodeName);
+
     void finish() { _finished = true; }
 
 protected:
@@ -20,11 +20,247 @@
 
 #if TARGET_PLATFORM_LINUX
 #include <sys/wait.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <sched.h>
 #endif
 
 #if TARGET_PLATFORM_LINUX || TARGET_PLATFORM_IOS
+#include <fcntl.h>
+#include <signal.h>
+#include <pthread.h>
+
+extern char **environ;
+
 static pid_t *childpid = NULL; /* ptr to array allocated at run-time */
 #define SHELL   "/bin/sh"
+
+#if TARGET_PLATFORM_LINUX && !defined(__NR_close_range)
+#define __NR_close_range 436
+#endif
+
+/**
+ * 子进程的启动参数
+ * 都在父进程中准备好, 子进程和父进程共享地址空间, 只能调用异步信号安全的函数, 不能分配内存
+ */
+struct SpawnArgs
+{
+    const char      *exe;           //可执行文件, 已经按PATH查找过
+    char *const     *argv;
+    char *const     *envp;
+    char *const     *shArgv;        //exe不是可执行格式(没有#!的脚本)时用sh执行, 为NULL时不处理
+    const char      *pwd;           //工作目录, 为空时不切换
+    int             fds[3];         //子进程的标准输入/输出/错误, -1表示继承
+    sigset_t        mask;           //子进程的信号掩码
+    volatile int    err;            //子进程exec失败时的errno
+};
+
+static void writeStderr(const char *s1, const char *s2)
+{
+    if (::write(STDERR_FILENO, s1, strlen(s1)) < 0 || ::write(STDERR_FILENO, s2, strlen(s2)) < 0 || ::write(STDERR_FILENO, "\n", 1) < 0)
+    {
+        return;
+    }
+}
+
+/**
+ * 关闭lowFd及以上的所有fd
+ * 优先用close_range, 内核不支持时只关闭/proc/self/fd中打开的fd, 不再遍历到最大fd
+ */
+static void closeFrom(int lowFd)
+{
+#if TARGET_PLATFORM_LINUX
+    if (syscall(__NR_close_range, (unsigned int)lowFd, ~0U, 0) == 0)
+    {
+        return;
+    }
+
+    struct LinuxDirent64
+    {
+        uint64_t        d_ino;
+        int64_t         d_off;
+        unsigned short  d_reclen;
+        unsigned char   d_type;
+        char            d_name[1];
+    };
+
+    int dirFd = ::open("/proc/self/fd", O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (dirFd >= 0)
+    {
+        char buf[4096];
+        bool closed = true;
+
+        //边读边关闭时目录内容会变化, 重新读到没有需要关闭的为止
+        while (closed)
+        {
+            closed = false;
+            lseek(dirFd, 0, SEEK_SET);
+
+            long n;
+            while ((n = syscall(SYS_getdents64, dirFd, buf, sizeof(buf))) > 0)
+            {
+                for (long pos = 0; pos < n; )
+                {
+                    LinuxDirent64 *d = (LinuxDirent64 *)(buf + pos);
+                    pos += d->d_reclen;
+
+                    int fd = 0;
+                    const char *p = d->d_name;
+                    for (; *p >= '0' && *p <= '9'; ++p)
+                    {
+                        fd = fd * 10 + (*p - '0');
+                    }
+
+                    if (*p == '\0' && p != d->d_name && fd >= lowFd && fd != dirFd)
+                    {
+                        ::close(fd);
+                        closed = true;
+                    }
+                }
+            }
+        }
+
+        ::close(dirFd);
+        return;
+    }
+#endif
+
+    int maxFd = static_cast<int>(sysconf(_SC_OPEN_MAX));
+    for (int fd = lowFd; fd < maxFd; ++fd)
+    {
+        ::close(fd);
+    }
+}
+
+static int spawnChild(void *arg)
+{
+    SpawnArgs *args = (SpawnArgs *)arg;
+
+    //node的信号处理函数不能在子进程中执行
+    for (int sig = 1; sig < NSIG; ++sig)
+    {
+        struct sigaction sa;
+        if (sigaction(sig, NULL, &sa) == 0 && sa.sa_handler != SIG_IGN && sa.sa_handler != SIG_DFL)
+        {
+            sa.sa_handler = SIG_DFL;
+            sigaction(sig, &sa, NULL);
+        }
+    }
+
+    for (int i = 0; i < 3; ++i)
+    {
+        if (args->fds[i] == i)
+        {
+            fcntl(i, F_SETFD, 0);
+        }
+        else if (args->fds[i] >= 0)
+        {
+            dup2(args->fds[i], i);
+        }
+    }
+
+    closeFrom(3);
+
+    if (args->pwd != NULL && args->pwd[0] != '\0' && chdir(args->pwd) == -1)
+    {
+        writeStderr("cannot change working directory to ", args->pwd);
+    }
+
+    sigprocmask(SIG_SETMASK, &args->mask, NULL);
+
+    execve(args->exe, args->argv, args->envp);
+
+    if (errno == ENOEXEC && args->shArgv != NULL)
+    {
+        execve(SHELL, args->shArgv, args->envp);
+    }
+
+    args->err = errno;
+    writeStderr("cannot execute ", args->exe);
+
+    _exit(127);
+    return 0;
+}
+
+/**
+ * 启动子进程
+ * linux下用clone(CLONE_VM|CLONE_VFORK), 不复制node的地址空间, 调用线程挂起到子进程exec或者退出,
+ * exec失败时args.err中是错误码
+ * @return 子进程id, -1失败
+ */
+static pid_t spawnProcess(SpawnArgs &args)
+{
+    args.err = 0;
+
+    //子进程恢复信号处理函数前不能收到信号
+    sigset_t all;
+    sigfillset(&all);
+    pthread_sigmask(SIG_SETMASK, &all, &args.mask);
+
+    pid_t pid = -1;
+
+#if TARGET_PLATFORM_LINUX
+    const size_t stackSize = 128 * 1024;
+
+    void *stack = mmap(NULL, stackSize, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_STACK, -1, 0);
+    if (stack != MAP_FAILED)
+    {
+        //栈向下增长
+        pid = clone(spawnChild, (char *)stack + stackSize, CLONE_VM | CLONE_VFORK | SIGCHLD, &args);
+
+        int err = errno;
+        munmap(stack, stackSize);
+        errno = err;
+    }
+#else
+    pid = fork();
+    if (pid == 0)
+    {
+        spawnChild(&args);
+    }
+#endif
+
+    int err = errno;
+    pthread_sigmask(SIG_SETMASK, &args.mask, NULL);
+    errno = err;
+
+    return pid;
+}
+
+/**
+ * 和execvp一样按PATH查找可执行文件
+ */
+static string searchPath(const string &exe, const map<string, string> &env)
+{
+    if (exe.find('/') != string::npos)
+    {
+        return exe;
+    }
+
+    map<string, string>::const_iterator it = env.find("PATH");
+    vector<string> vPath = TC_Common::sepstr<string>(it != env.end() ? it->second : "/bin:/usr/bin", ":", true);
+
+    for (size_t i = 0; i < vPath.size(); i++)
+    {
+        string file = (vPath[i].empty() ? "." : vPath[i]) + "/" + exe;
+        if (access(file.c_str(), X_OK) == 0)
+        {
+            return file;
+        }
+    }
+
+    return exe;
+}
+
+static void toArgv(const vector<string> &v, vector<char *> &argv)
+{
+    argv.resize(v.size() + 1);
+    for (size_t i = 0; i < v.size(); i++)
+    {
+        argv[i] = const_cast<char *>(v[i].c_str());
+    }
+    argv[v.size()] = NULL;
+}
 #endif
 
 int64_t Activator::activate(const string& strExePath, const string& strPwdPath, const string& strRollLogPath, const vector<string>& vOptions, vector<string>& vEnvs)
@@ -106,83 +342,99 @@ int64_t Activator::activate(const string& strExePath, const string& strPwdPath,
 
 	NODE_LOG(_server->getServerId())->debug() << "Activator::activate server [exepath: " << strExePath << ", args: " << TC_Common::tostr(vArgs) << "]" << endl;
 
-    int argc = static_cast<int>(vArgs.size());
-    char **argv = static_cast<char **>(malloc((argc + 1) * sizeof(char *)));
-    int i = 0;
-    for (vector<string>::const_iterator p = vArgs.begin(); p != vArgs.end(); ++p, ++i)
+    //参数/环境变量/日志文件都在父进程中准备好, 子进程中只做重定向/chdir/exec
+    map<string, string> mEnv;
+    for (char **env = environ; *env != NULL; ++env)
     {
-        assert(i < argc);
-        argv[i] = strdup(p->c_str());
+        const char *p = strchr(*env, '=');
+        if (p != NULL)
+        {
+            mEnv[string(*env, p - *env)] = p + 1;
+        }
     }
-    assert(i == argc);
-    argv[argc] = 0;
 
-    pid_t pid = fork();
-    if (pid == -1)
+    for_each(vEnvs.begin(), vEnvs.end(), EnvVal(mEnv));
+
+    vector<string> vEnvp;
+    for (map<string, string>::const_iterator it = mEnv.begin(); it != mEnv.end(); ++it)
     {
-	    NODE_LOG(_server->getServerId())->debug() << "Activator::activate " << strPwdPath << "|fork child process  catch exception|errno=" << errno << endl;
-        throw runtime_error("fork child process  catch exception");
+        vEnvp.push_back(it->first + "=" + it->second);
     }
 
-    if (pid == 0)
-    {
-        int maxFd = static_cast<int>(sysconf(_SC_OPEN_MAX));
-        for (int fd = 3; fd < maxFd; ++fd)
-        {
-            close(fd);
-        }
+    //exe不是可执行格式时和execvp一样用sh执行
+    string sExe = searchPath(strExePath, mEnv);
 
-		string stdOutLog = !_redirectPath.empty()?  _redirectPath : strRollLogPath;
+    vector<string> vShArgs;
+    vShArgs.push_back(SHELL);
+    vShArgs.push_back(sExe);
+    vShArgs.insert(vShArgs.end(), vOptions.begin(), vOptions.end());
 
-        //server stdcout 日志在滚动日志显示
-        if (!stdOutLog.empty())
-        {
-            TC_File::makeDirRecursive(TC_File::extractFilePath(stdOutLog));
-#if TARGET_PLATFORM_IOS
-            if ((freopen(stdOutLog.c_str(), "ab", stdout)) != NULL && (freopen(stdOutLog.c_str(), "ab", stderr)) != NULL)
-#else
-            if ((freopen64(stdOutLog.c_str(), "ab", stdout)) != NULL && (freopen64(stdOutLog.c_str(), "ab", stderr)) != NULL)
-#endif
-            {
-                cout << argv[0] << " redirect stdout and stderr  to " << stdOutLog << endl;
-            }
-            else
-            {
-                //重定向失败 直接退出
-//                exit(0);
-				g_app.terminate();
-            }
-        }
-        else
-        {
-            cout << argv[0] << " cannot redirect stdout and stderr to log file sRollLogPath is empty" << endl;
-        }
+    vector<char *> argv;
+    vector<char *> envp;
+    vector<char *> shArgv;
+    toArgv(vArgs, argv);
+    toArgv(vEnvp, envp);
+    toArgv(vShArgs, shArgv);
 
-        for_each(vEnvs.begin(), vEnvs.end(), EnvVal());
+    string stdOutLog = !_redirectPath.empty()?  _redirectPath : strRollLogPath;
+
+    //server stdcout 日志在滚动日志显示
+    int logFd = -1;
+    if (!stdOutLog.empty())
+    {
+        TC_File::makeDirRecursive(TC_File::extractFilePath(stdOutLog));
 
-        if (strlen(pwdCStr) != 0)
+        logFd = ::open(stdOutLog.c_str(), O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0666);
+        if (logFd < 0)
         {
-            if (chdir(pwdCStr) == -1)
-            {
-                cerr << argv[0] << " cannot change working directory to " << pwdCStr << ", errno: " << errno << endl;
-            }
+            NODE_LOG(_server->getServerId())->error() << "Activator::activate open " << stdOutLog << " error:" << strerror(errno) << endl;
+            throw runtime_error("cannot redirect stdout and stderr to " + stdOutLog);
         }
 
-        if (execvp(argv[0], argv) == -1)
+        string sMsg = strExePath + " redirect stdout and stderr  to " + stdOutLog + "\n";
+        if (::write(logFd, sMsg.c_str(), sMsg.length()) < 0)
         {
-            cerr << "cannot execute " << argv[0] << ", errno:" << strerror(errno) << endl;
+            NODE_LOG(_server->getServerId())->error() << "Activator::activate write " << stdOutLog << " error:" << strerror(errno) << endl;
         }
-//        exit(0);
-		g_app.terminate();
     }
     else
     {
-        for (i = 0; argv[i]; i++)
-        {
-            free(argv[i]);
-        }
-        free(argv);
+        cout << strExePath << " cannot redirect stdout and stderr to log file sRollLogPath is empty" << endl;
+    }
+
+    SpawnArgs args;
+    args.exe    = sExe.c_str();
+    args.argv   = &argv[0];
+    args.envp   = &envp[0];
+    args.shArgv = &shArgv[0];
+    args.pwd    = pwdCStr;
+    args.fds[0] = -1;
+    args.fds[1] = logFd;
+    args.fds[2] = logFd;
+
+    pid_t pid = spawnProcess(args);
+    int err = errno;
+
+    if (logFd >= 0)
+    {
+        ::close(logFd);
+    }
+
+    if (pid == -1)
+    {
+	    NODE_LOG(_server->getServerId())->debug() << "Activator::activate " << strPwdPath << "|fork child process  catch exception|errno=" << err << endl;
+        throw runtime_error("fork child process  catch exception");
     }
+
+    //exec失败, 子进程已经退出
+    if (args.err != 0)
+    {
+        waitpid(pid, NULL, 0);
+
+        NODE_LOG(_server->getServerId())->error() << "Activator::activate cannot execute " << sExe << ", errno:" << strerror(args.err) << endl;
+        throw runtime_error("cannot execute " + sExe + ", errno:" + strerror(args.err));
+    }
+
     return pid;
 #endif
 }
@@ -505,7 +757,7 @@ map<string, string> Activator::parseScriptResult(const string& strResult)
 #if TARGET_PLATFORM_LINUX || TARGET_PLATFORM_IOS
 FILE* Activator::popen2(const char *cmdstring, const char *type)
 {
-    int     i, pfd[2];
+    int     pfd[2];
     pid_t   pid;
     FILE    *fp;
     /*only allow "r" or "w" */
@@ -532,35 +784,24 @@ FILE* Activator::popen2(const char *cmdstring, const char *type)
         return (NULL);   /* errno set by pipe() */
     }
 
-    if ((pid = fork()) < 0)
+    const char *argv[] = { "sh", "-c", cmdstring, NULL };
+
+    /* child: pipe to stdin or stdout/stderr, all other descriptors closed */
+    SpawnArgs args;
+    args.exe    = SHELL;
+    args.argv   = (char *const *)argv;
+    args.envp   = environ;
+    args.shArgv = NULL;
+    args.pwd    = NULL;
+    args.fds[0] = (*type == 'r') ? -1 : pfd[0];
+    args.fds[1] = (*type == 'r') ? pfd[1] : -1;
+    args.fds[2] = args.fds[1];
+
+    if ((pid = spawnProcess(args)) < 0)
     {
-        return (NULL);   /* errno set by fork() */
-    }
-    else if (pid == 0)
-    {                            /* child */
-        if (*type == 'r')
-        {
-            close(pfd[0]);
-            dup2(pfd[1], STDOUT_FILENO);
-            dup2(pfd[1], STDERR_FILENO);
-            close(pfd[1]);
-        }
-        else
-        {
-            close(pfd[1]);
-            dup2(pfd[0], STDIN_FILENO);
-            close(pfd[0]);
-        }
-        /* close all descriptors opened in parent process*/
-        for (i = 3; i < maxfd; i++)
-        {
-            if (i != pfd[0] && i !=  pfd[1])
-            {
-                close(i);
-            }
-        }
-        execl(SHELL, "sh", "-c", cmdstring, (char *)0);
-        _exit(127);
+        close(pfd[0]);
+        close(pfd[1]);
+        return (NULL);   /* errno set by clone()/fork() */
     }
     /* parent */
     if (*type == 'r')
@@ -21,6 +21,7 @@
 #include "util/tc_file.h"
 #include "util/tc_monitor.h"
 #include <iostream>
+#include <map>
 
 using namespace tars;
 using namespace std;
@@ -32,9 +33,11 @@ typedef TC_AutoPtr<ServerObject> ServerObjectPtr;
 
 //用来标志脚本结束
 /////////////////////////////////////////////////////////
-// 环境变量
+// 环境变量, 在env上做宏替换并设置, 不修改node自身的环境变量
 struct EnvVal : std::unary_function<string, string>
 {
+    EnvVal(map<string, string> &env) : _env(env) {}
+
     string operator()(const std::string& value)
     {
         string::size_type pos = value.find("=");
@@ -73,21 +76,20 @@ struct EnvVal : std::unary_function<string, string>
                 --finish;
             }
 
-            char* p = getenv(var.c_str());
-            string str = p ? string(p) : "";
+            map<string, string>::const_iterator it = _env.find(var);
+            string str = it != _env.end() ? it->second : "";
 
             v.replace(start, finish - start + 1, str);
 
             start += str.size();
         }
-#if TARGET_PLATFORM_WINDOWS
-		SetEnvironmentVariable((value.substr(0, pos)).c_str(), v.c_str());
-#else
-		//此处需要马上设置，否则以上宏替换中获取的环境变量为空
-		setenv((value.substr(0, pos)).c_str(),v.c_str(),true);
-#endif
+		//此处需要马上设置，否则后面的宏替换中获取的环境变量为空
+		_env[value.substr(0, pos)] = v;
+
         return value.substr(0, pos) + "=" + v;
     }
+
+    map<string, string> &_env;
 };
 
 class Activator : public TC_ThreadLock, public TC_HandleBase
@@ -0,0 +1,268 @@
+/**
+ * Tencent is pleased to support the open source community by making Tars available.
+ *
+ * Copyright (C) 2016THL A29 Limited, a Tencent company. All rights reserved.
+ *
+ * Licensed under the BSD 3-Clause License (the "License"); you may not use this file except 
+ * in compliance with the License. You may obtain a copy of the License at
+ *
+ * https://opensource.org/licenses/BSD-3-Clause
+ *
+ * Unless required by applicable law or agreed to in writing, software distributed 
+ * under the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR 
+ * CONDITIONS OF ANY KIND, either express or implied. See the License for the 
+ * specific language governing permissions and limitations under the License.
+ */
+
+
+#include <climits>
+#include "AutoStartThread.h"
+#include "CommandStart.h"
+#include "util.h"
+
+AutoStart::AutoStart()
+: _holding(false)
+, _roundBeginMs(0)
+, _roundCount(0)
+, _slowestMs(0)
+{
+}
+
+AutoStart::~AutoStart()
+{
+    terminate();
+}
+
+void AutoStart::start(int iThreadNum, const string &sStartOrder)
+{
+    vector<string> vGroup = TC_Common::sepstr<string>(sStartOrder, ";");
+    for (size_t i = 0; i < vGroup.size(); i++)
+    {
+        vector<string> vServer = TC_Common::sepstr<string>(vGroup[i], ", \t");
+        if (!vServer.empty())
+        {
+            _order.push_back(vServer);
+        }
+    }
+
+    for (int i = 0; i < iThreadNum; i++)
+    {
+        AutoStartThread *t = new AutoStartThread(this);
+        t->start();
+
+        _runners.push_back(t);
+    }
+}
+
+void AutoStart::terminate()
+{
+    for (size_t i = 0; i < _runners.size(); ++i)
+    {
+        if (_runners[i]->isAlive())
+        {
+            _runners[i]->terminate();
+        }
+    }
+
+    {
+        TC_ThreadLock::Lock lock(_mutex);
+        _mutex.notifyAll();
+    }
+
+    for (size_t i = 0; i < _runners.size(); ++i)
+    {
+        if (_runners[i]->getThreadControl().id() != TC_Thread::CURRENT_THREADID() && _runners[i]->isAlive())
+        {
+            _runners[i]->getThreadControl().join();
+        }
+        delete _runners[i];
+    }
+
+    _runners.clear();
+}
+
+int AutoStart::getGroup(const string &serverId) const
+{
+    for (size_t i = 0; i < _order.size(); i++)
+    {
+        for (size_t j = 0; j < _order[i].size(); j++)
+        {
+            const string &s = _order[i][j];
+            if (s == serverId || (!s.empty() && s[s.length() - 1] == '*' && serverId.compare(0, s.length() - 1, s, 0, s.length() - 1) == 0))
+            {
+                return (int)i;
+            }
+        }
+    }
+
+    return (int)_order.size();
+}
+
+bool AutoStart::push_back(const ServerObjectPtr &server)
+{
+    TC_ThreadLock::Lock lock(_mutex);
+
+    const string &serverId = server->getServerId();
+
+    if (_running.find(serverId) != _running.end())
+    {
+        return false;
+    }
+
+    for (list<AutoStartTask>::const_iterator it = _pending.begin(); it != _pending.end(); ++it)
+    {
+        if (it->serverId == serverId)
+        {
+            return false;
+        }
+    }
+
+    AutoStartTask task;
+    task.server   = server;
+    task.serverId = serverId;
+    task.group    = getGroup(serverId);
+    task.pushMs   = TNOWMS;
+
+    if (_pending.empty() && _running.empty())
+    {
+        _roundBeginMs = task.pushMs;
+        _roundCount   = 0;
+        _slowestId    = "";
+        _slowestMs    = 0;
+    }
+
+    _pending.push_back(task);
+
+    _mutex.notify();
+
+    return true;
+}
+
+void AutoStart::hold()
+{
+    TC_ThreadLock::Lock lock(_mutex);
+    _holding = true;
+}
+
+void AutoStart::release()
+{
+    TC_ThreadLock::Lock lock(_mutex);
+    _holding = false;
+    _mutex.notifyAll();
+}
+
+bool AutoStart::pop_front(AutoStartTask &task, int millsecond)
+{
+    TC_ThreadLock::Lock lock(_mutex);
+
+    //一轮检查还没结束, 后面可能还有更靠前分组的服务要入队
+    if (_holding)
+    {
+        _mutex.timedWait(millsecond);
+        return false;
+    }
+
+    //正在启动以及等待启动的服务中最靠前的分组, 只有这个分组的服务可以启动
+    int minGroup = INT_MAX;
+    for (map<string, int>::const_iterator it = _running.begin(); it != _running.end(); ++it)
+    {
+        minGroup = min(minGroup, it->second);
+    }
+
+    for (list<AutoStartTask>::const_iterator it = _pending.begin(); it != _pending.end(); ++it)
+    {
+        minGroup = min(minGroup, it->group);
+    }
+
+    for (list<AutoStartTask>::iterator it = _pending.begin(); it != _pending.end(); ++it)
+    {
+        if (it->group == minGroup)
+        {
+            task = *it;
+            _pending.erase(it);
+            _running[task.serverId] = task.group;
+            return true;
+        }
+    }
+
+    _mutex.timedWait(millsecond);
+
+    return false;
+}
+
+void AutoStart::finish(const AutoStartTask &task, int64_t costMs)
+{
+    int64_t waitMs = TNOWMS - task.pushMs - costMs;
+
+    NODE_LOG(task.serverId)->debug() << FILE_FUN << task.serverId << "|group:" << task.group << "|wait:" << waitMs << "ms|start:" << costMs << "ms" << endl;
+    NODE_LOG("startServer")->debug() << FILE_FUN << task.serverId << "|group:" << task.group << "|wait:" << waitMs << "ms|start:" << costMs << "ms" << endl;
+
+    REPORT_MAX(task.serverId, task.serverId + ".startTime", costMs);
+
+    TC_ThreadLock::Lock lock(_mutex);
+
+    _running.erase(task.serverId);
+
+    ++_roundCount;
+    if (costMs >= _slowestMs)
+    {
+        _slowestMs = costMs;
+        _slowestId = task.serverId;
+    }
+
+    if (_pending.empty() && _running.empty())
+    {
+        NODE_LOG("startServer")->debug() << FILE_FUN << "all started, servers:" << _roundCount << "|cost:" << (TNOWMS - _roundBeginMs)
+                                         << "ms|slowest:" << _slowestId << "|" << _slowestMs << "ms" << endl;
+    }
+
+    //后面分组的服务可能可以启动了
+    _mutex.notifyAll();
+}
+
+AutoStartThread::AutoStartThread(AutoStart *autoStart)
+: _autoStart(autoStart)
+, _shutDown(false)
+{
+}
+
+AutoStartThread::~AutoStartThread()
+{
+    terminate();
+}
+
+void AutoStartThread::terminate()
+{
+    _shutDown = true;
+}
+
+void AutoStartThread::run()
+{
+    while (!_shutDown)
+    {
+        AutoStartTask task;
+
+        if (!_autoStart->pop_front(task, 1000))
+        {
+            continue;
+        }
+
+        int64_t beginMs = TNOWMS;
+
+        try
+        {
+            CommandStart command(task.server);
+            command.doProcess();
+        }
+        catch (exception &e)
+        {
+            NODE_LOG(task.serverId)->error() << FILE_FUN << task.serverId << " catch exception|" << e.what() << endl;
+        }
+        catch (...)
+        {
+            NODE_LOG(task.serverId)->error() << FILE_FUN << task.serverId << " catch unkown exception" << endl;
+        }
+
+        _autoStart->finish(task, TNOWMS - beginMs);
+    }
+}
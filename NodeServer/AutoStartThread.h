@@ -0,0 +1,144 @@
+/**
+ * Tencent is pleased to support the open source community by making Tars available.
+ *
+ * Copyright (C) 2016THL A29 Limited, a Tencent company. All rights reserved.
+ *
+ * Licensed under the BSD 3-Clause License (the "License"); you may not use this file except 
+ * in compliance with the License. You may obtain a copy of the License at
+ *
+ * https://opensource.org/licenses/BSD-3-Clause
+ *
+ * Unless required by applicable law or agreed to in writing, software distributed 
+ * under the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR 
+ * CONDITIONS OF ANY KIND, either express or implied. See the License for the 
+ * specific language governing permissions and limitations under the License.
+ */
+
+
+#ifndef __AUTO_START_THREAD_H_
+#define __AUTO_START_THREAD_H_
+
+#include <list>
+#include <map>
+#include "util/tc_thread.h"
+#include "util/tc_monitor.h"
+#include "ServerObject.h"
+
+using namespace tars;
+using namespace std;
+
+class AutoStartThread;
+
+/**
+ * 一个待启动的服务
+ */
+struct AutoStartTask
+{
+    ServerObjectPtr     server;
+    string              serverId;
+    int                 group;          //启动分组, 越小越先启动
+    int64_t             pushMs;         //进入队列的时间
+};
+
+/**
+ * 服务自动启动调度
+ * node重启后所有服务都需要拉起, 由多个线程并发启动, 总耗时取决于最慢的服务而不是所有服务之和
+ * 配置了startOrder时按分组顺序启动: 前面分组的服务都启动完成后, 后面分组的服务才开始启动
+ * startOrder格式: 分组之间用;分隔, 组内用,分隔, 服务id以*结尾时按前缀匹配, 例如 tars.tarsregistry,tars.tarsconfig;tars.*
+ * 没有匹配任何分组的服务最后启动
+ * 保活线程检查服务期间调用hold暂停启动, 一轮检查完release后再开始, 保证分组比较时所有需要启动的服务都已经入队
+ */
+class AutoStart
+{
+public:
+    AutoStart();
+
+    ~AutoStart();
+
+    /**
+     * 启动线程
+     */
+    void start(int iThreadNum, const string &sStartOrder);
+
+    /**
+     * 结束线程
+     */
+    void terminate();
+
+    /**
+     * 加入启动队列
+     * @return 服务已经在队列中或者正在启动时返回false
+     */
+    bool push_back(const ServerObjectPtr &server);
+
+    /**
+     * 暂停启动, 入队的服务先不取出
+     */
+    void hold();
+
+    /**
+     * 恢复启动
+     */
+    void release();
+
+    /**
+     * 取出可以启动的服务, 暂停期间或者前面分组还有服务没有启动完成时等待
+     */
+    bool pop_front(AutoStartTask &task, int millsecond);
+
+    /**
+     * 服务启动完成
+     * @param costMs, 启动耗时
+     */
+    void finish(const AutoStartTask &task, int64_t costMs);
+
+protected:
+    /**
+     * 服务所在的启动分组
+     */
+    int getGroup(const string &serverId) const;
+
+protected:
+    TC_ThreadLock                   _mutex;
+
+    //每个分组的匹配规则
+    vector<vector<string> >         _order;
+
+    list<AutoStartTask>             _pending;
+
+    //正在启动的服务及其分组
+    map<string, int>                _running;
+
+    //保活线程正在检查服务, 暂停启动
+    bool                            _holding;
+
+    vector<AutoStartThread *>       _runners;
+
+    //一轮启动(从空闲到所有服务启动完)的统计
+    int64_t                         _roundBeginMs;
+
+    size_t                          _roundCount;
+
+    string                          _slowestId;
+
+    int64_t                         _slowestMs;
+};
+
+class AutoStartThread : public TC_Thread
+{
+public:
+    AutoStartThread(AutoStart *autoStart);
+
+    ~AutoStartThread();
+
+    virtual void run();
+
+    void terminate();
+
+protected:
+    AutoStart       *_autoStart;
+
+    bool            _shutDown;
+};
+
+#endif
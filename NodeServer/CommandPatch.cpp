@@ -15,6 +15,13 @@
  */
 
 #include "CommandPatch.h"
+#include "tars_delta.h"
+#include "util/tc_port.h"
+#include <memory>
+
+#ifndef S_ISREG
+#define S_ISREG(m) (((m) & S_IFMT) == S_IFREG)
+#endif
 
 //////////////////////////////////////////////////////////////
 //
@@ -23,6 +30,7 @@ CommandPatch::CommandPatch(const ServerObjectPtr & server, const std::string & s
 {
     _localTgzBasePath      = sDownloadPath + FILE_SEP + "BatchPatchingLoad";
     _localExtractBasePath  = sDownloadPath + FILE_SEP + "BatchPatching";
+    _localTgzStorePath     = sDownloadPath + FILE_SEP + "BatchPatchingStore";
 }
 
 string CommandPatch::getOsType()
@@ -83,6 +91,8 @@ ServerCommand::ExeStatus CommandPatch::canExecute(string & sResult)
 
     _statExChange  = new StatExChange(_serverObjectPtr, ServerObject::BatchPatching, eState);
 
+    _lastPatchVersion = _serverObjectPtr->getPatchVersion();
+
     _serverObjectPtr->setPatchVersion(_patchRequest.version);
     _serverObjectPtr->setPatchPercent(0);
     _serverObjectPtr->setPatchResult("", true);
@@ -138,29 +148,200 @@ int CommandPatch::updatePatchResult(string & sResult)
     return 0;
 }
 
-int CommandPatch::download(const std::string & sRemoteTgzPath, const std::string & sLocalTgzPath, const std::string & sShortFileName, const std::string& reqMd5, std::string & sResult)
+bool CommandPatch::isSameFile(const string &file1, const string &file2)
+{
+#if TARGET_PLATFORM_WINDOWS
+    return false;
+#else
+    struct stat st1, st2;
+    if (::stat(file1.c_str(), &st1) != 0 || ::stat(file2.c_str(), &st2) != 0)
+    {
+        return false;
+    }
+
+    return st1.st_dev == st2.st_dev && st1.st_ino == st2.st_ino;
+#endif
+}
+
+int CommandPatch::linkFile(const string &srcFile, const string &destFile)
+{
+    TC_File::removeFile(destFile, false);
+
+#if !TARGET_PLATFORM_WINDOWS
+    //同一个文件系统下直接硬链接, 不占用额外空间
+    if (::link(srcFile.c_str(), destFile.c_str()) == 0)
+    {
+        return 0;
+    }
+#endif
+
+    try
+    {
+        TC_File::copyFile(srcFile, destFile, true);
+    }
+    catch (exception &ex)
+    {
+        NODE_LOG(_serverObjectPtr->getServerId())->error() <<FILE_FUN<< srcFile << " -> " << destFile << "|copy error:" << ex.what() << endl;
+        return -1;
+    }
+
+    return 0;
+}
+
+void CommandPatch::pruneStore()
+{
+    int keepTime = TC_Common::strto<int>(g_pconf->get("/tars/node<downloadStoreKeepTime>", "3600"));
+
+    vector<string> vFiles;
+    TC_File::listDirectory(_localTgzStorePath, vFiles, false);
+
+    time_t now = TNOW;
+    for (size_t i = 0; i < vFiles.size(); i++)
+    {
+        //只剩仓库中的一份, 说明已经没有服务在使用了
+        TC_Port::stat_t st;
+        if (TC_Port::lstat(vFiles[i].c_str(), &st) == 0 && S_ISREG(st.st_mode) && st.st_nlink <= 1 && now - st.st_mtime > keepTime)
+        {
+            NODE_LOG("patchPro")->debug() <<FILE_FUN<< "remove " << vFiles[i] << endl;
+            TC_File::removeFile(vFiles[i], false);
+        }
+    }
+}
+
+int CommandPatch::downloadDelta(const string &sRemoteTgzPath, const string &sBaseTgzFile, const string &md5, string &sStoreFile)
+{
+#if TARGET_PLATFORM_WINDOWS
+    return -1;
+#else
+    if(sBaseTgzFile.empty() || g_pconf->get("/tars/node<deltaPatch>", "Y") != "Y" || !TC_File::isFileExist(sBaseTgzFile))
+    {
+        return -1;
+    }
+
+    //仓库中的文件以md5命名, 上一个版本的包不在仓库中(升级前下载的)才计算md5
+    string baseMd5;
+    vector<string> vFiles;
+    TC_File::listDirectory(_localTgzStorePath, vFiles, false);
+    for (size_t i = 0; i < vFiles.size() && baseMd5.empty(); i++)
+    {
+        if (isSameFile(vFiles[i], sBaseTgzFile))
+        {
+            baseMd5 = TC_File::extractFileName(vFiles[i]).substr(0, 32);
+        }
+    }
+
+    if (baseMd5.empty())
+    {
+        baseMd5 = TC_Common::lower(TC_MD5::md5file(sBaseTgzFile));
+    }
+
+    vector<string> vObj = TC_Common::sepstr<string>(_patchRequest.patchobj, ";");
+    if (baseMd5 == md5 || vObj.empty())
+    {
+        return -1;
+    }
+
+    string sDeltaFile       = _localTgzStorePath + FILE_SEP + md5 + ".delta";
+    string sRemoteDeltaFile = FILE_SEP + string("TARSBatchPatchingDelta") + FILE_SEP + _patchRequest.appname + FILE_SEP + TC_File::extractFileName(sRemoteTgzPath)
+                              + FILE_SEP + baseMd5 + "_" + md5 + ".delta";
+
+    string sResult;
+    int64_t tBegin = TNOWMS;
+
+    try
+    {
+        //差量只有patch上有, 由patch生成
+        vector<DownloadSource> vSource(1);
+        vSource[0].patchPrx   = Application::getCommunicator()->stringToProxy<PatchPrx>(vObj.back());
+        vSource[0].remoteFile = sRemoteDeltaFile;
+        vSource[0].patchPrx->tars_timeout(60000);
+
+        DownloadEventPtr eventPtr = new PatchDownloadEvent(_serverObjectPtr);
+
+        string fileMd5;
+        if(SingleFileDownloader::download(vSource, sDeltaFile, eventPtr, _patchRequest.appname, _patchRequest.servername, _patchRequest.nodename, sResult, fileMd5) != 0)
+        {
+            NODE_LOG(_serverObjectPtr->getServerId())->debug() <<FILE_FUN<< sRemoteDeltaFile << "|no delta:" << sResult << endl;
+            TC_File::removeFile(sDeltaFile, false);
+            return -1;
+        }
+    }
+    catch (exception &ex)
+    {
+        NODE_LOG(_serverObjectPtr->getServerId())->error() <<FILE_FUN<< sRemoteDeltaFile << "|Exception:" << ex.what() << endl;
+        TC_File::removeFile(sDeltaFile, false);
+        return -1;
+    }
+
+    size_t deltaSize = TC_File::getFileSize(sDeltaFile);
+
+    //还原出来的是新版本解压后的内容, 差量头中的内容md5校验通过后才放入仓库
+    string sTmpFile = _localTgzStorePath + FILE_SEP + md5 + ".tmp";
+    string contentMd5;
+
+    int iRet = TarsDelta::applyDelta(sBaseTgzFile, sDeltaFile, sTmpFile, md5, contentMd5, sResult);
+
+    TC_File::removeFile(sDeltaFile, false);
+
+    if (iRet != 0)
+    {
+        NODE_LOG(_serverObjectPtr->getServerId())->error() <<FILE_FUN<< sRemoteDeltaFile << "|" << sBaseTgzFile << "|apply delta error:" << sResult << endl;
+        return -1;
+    }
+
+    //gzip的包还原出来的是tar, 放在<md5>.tar, 不是gzip格式的包还原出来的就是发布包本身
+    sStoreFile = _localTgzStorePath + FILE_SEP + md5 + (contentMd5 == md5 ? "" : ".tar");
+
+    if (::rename(sTmpFile.c_str(), sStoreFile.c_str()) != 0)
+    {
+        NODE_LOG(_serverObjectPtr->getServerId())->error() <<FILE_FUN<< sStoreFile << "|rename error:" << TC_Exception::parseError(TC_Exception::getSystemCode()) << endl;
+        TC_File::removeFile(sTmpFile, false);
+        return -1;
+    }
+
+    NODE_LOG(_serverObjectPtr->getServerId())->debug() <<FILE_FUN<< sRemoteDeltaFile << "|" << sBaseTgzFile << " -> " << sStoreFile
+            << "|delta size:" << deltaSize << "|size:" << TC_File::getFileSize(sStoreFile) << "|cost:" << (TNOWMS - tBegin) << "ms" << endl;
+
+    return 0;
+#endif
+}
+
+int CommandPatch::download(const std::string & sRemoteTgzPath, const std::string & sLocalTgzPath, const std::string & sShortFileName, const std::string& reqMd5, std::string & sResult, const std::string & sBaseTgzFile)
 {
     int iRet = 0;
 
-    DownloadTask dtask;
-    dtask.sLocalTgzFile   = sLocalTgzPath + FILE_SEP + sShortFileName;
+    string sLocalTgzFile  = sLocalTgzPath + FILE_SEP + sShortFileName;
     string sRemoteTgzFile = sRemoteTgzPath + FILE_SEP + sShortFileName;
+    string md5            = TC_Common::lower(reqMd5);
 
     NODE_LOG(_serverObjectPtr->getServerId())->debug() <<FILE_FUN<< _patchRequest.appname + "." + _patchRequest.servername
             << ". md5: " << reqMd5
-            << ", local: " << dtask.sLocalTgzFile
+            << ", local: " << sLocalTgzFile
             << ", remote: " << sRemoteTgzFile
             << ", begin downloading" << endl;
 
-    if(TC_File::isFileExist(dtask.sLocalTgzFile))
+    //md5同时作为仓库中的文件名
+    if(md5.length() != 32 || md5.find_first_not_of("0123456789abcdef") != string::npos)
     {
-        string fileMd5 = TC_MD5::md5file(dtask.sLocalTgzFile);
-        if(fileMd5 == reqMd5)
-        {
-            NODE_LOG(_serverObjectPtr->getServerId())->debug() <<FILE_FUN<< dtask.sLocalTgzFile << " cached succ" << endl;
-            _serverObjectPtr->setPatchPercent(100);
-            return iRet;
-        }
+        sResult = string("request md5:") + reqMd5 + " is invalid";
+        NODE_LOG(_serverObjectPtr->getServerId())->error() <<FILE_FUN<< _patchRequest.appname + "." + _patchRequest.servername << "|" << sResult << endl;
+        return -6;
+    }
+
+    //节点上按md5存放的发布包, 各服务的本地文件都是它的硬链接, 同一个包在节点上只下载和校验一次
+    DownloadTask dtask;
+    dtask.sLocalTgzFile = _localTgzStorePath + FILE_SEP + md5;
+
+    //差量还原出来的tgz是解压后的tar
+    string sStoreTarFile = dtask.sLocalTgzFile + ".tar";
+    string sStoreFile    = dtask.sLocalTgzFile;
+
+    //本地文件就是仓库中的文件, 仓库中的文件都是校验过的, 不需要再计算md5
+    if(isSameFile(sLocalTgzFile, dtask.sLocalTgzFile) || isSameFile(sLocalTgzFile, sStoreTarFile))
+    {
+        NODE_LOG(_serverObjectPtr->getServerId())->debug() <<FILE_FUN<< sLocalTgzFile << " cached succ" << endl;
+        _serverObjectPtr->setPatchPercent(100);
+        return iRet;
     }
 
     NODE_LOG(_serverObjectPtr->getServerId())->debug() <<FILE_FUN<< _patchRequest.appname + "." + _patchRequest.servername
@@ -171,29 +352,24 @@ int CommandPatch::download(const std::string & sRemoteTgzPath, const std::string
 
     TC_ThreadRecLock* taskLock = DownloadTaskFactory::getInstance().getRecLock(dtask);
     bool returned = false;
+    bool downloaded = false;
 
     {
         TC_ThreadRecLock::Lock lock(*taskLock);
 
-        if(TC_File::isFileExist(dtask.sLocalTgzFile)) //锁内的检查，防止重复下载
-        {
-            string fileMd5 = TC_MD5::md5file(dtask.sLocalTgzFile);
-            if(fileMd5 == reqMd5)
-            {
-                NODE_LOG(_serverObjectPtr->getServerId())->debug() <<FILE_FUN<< dtask.sLocalTgzFile << " cached succ" << endl;
-                returned = true;
-            }
-        }
+        vector<string> vPath;
+        vPath.push_back(_localTgzStorePath);
+        vPath.push_back(sLocalTgzPath);
 
-        if(!returned)
+        for(size_t i = 0; i < vPath.size() && !returned; i++)
         {
-            if(!TC_File::isFileExistEx(sLocalTgzPath, S_IFDIR))
+            if(!TC_File::isFileExistEx(vPath[i], S_IFDIR))
             {
-                bool mkResult = TC_File::makeDirRecursive(sLocalTgzPath);
+                bool mkResult = TC_File::makeDirRecursive(vPath[i]);
                 if(!mkResult)
                 {
                     string err = TC_Exception::parseError(TC_Exception::getSystemCode());
-                    sResult = " mkdir \""+sLocalTgzPath+"\" failure,errno," + err;
+                    sResult = " mkdir \""+vPath[i]+"\" failure,errno," + err;
                     NODE_LOG(_serverObjectPtr->getServerId())->error() <<FILE_FUN<< _patchRequest.appname + "." + _patchRequest.servername << "|"<<sResult<< endl;
                     iRet = -1;
                     returned = true;
@@ -201,23 +377,77 @@ int CommandPatch::download(const std::string & sRemoteTgzPath, const std::string
             }
         }
 
+        //锁内的检查，其它服务已经下载过同一个包
+        if(!returned && TC_File::isFileExist(dtask.sLocalTgzFile))
+        {
+            NODE_LOG(_serverObjectPtr->getServerId())->debug() <<FILE_FUN<< dtask.sLocalTgzFile << " cached succ" << endl;
+            returned = true;
+        }
+        else if(!returned && TC_File::isFileExist(sStoreTarFile))
+        {
+            NODE_LOG(_serverObjectPtr->getServerId())->debug() <<FILE_FUN<< sStoreTarFile << " cached succ" << endl;
+            sStoreFile = sStoreTarFile;
+            returned = true;
+        }
+
+        //升级前下载的本地文件, 校验一次后放入仓库
+        if(!returned && TC_File::isFileExist(sLocalTgzFile) && TC_MD5::md5file(sLocalTgzFile) == md5)
+        {
+            if(linkFile(sLocalTgzFile, dtask.sLocalTgzFile) == 0)
+            {
+                NODE_LOG(_serverObjectPtr->getServerId())->debug() <<FILE_FUN<< sLocalTgzFile << " cached succ, move to store" << endl;
+                _serverObjectPtr->setPatchPercent(100);
+                return iRet;
+            }
+        }
+
+        //增量发布只下载差量, 失败时下载完整的包
+        if(!returned && downloadDelta(sRemoteTgzPath, sBaseTgzFile, md5, sStoreFile) == 0)
+        {
+            downloaded = true;
+            returned = true;
+        }
+
         if(!returned)
         {
             try
             {
-                DownloadEventPtr eventPtr = new PatchDownloadEvent(_serverObjectPtr);
+                DownloadEventPtr eventPtr = new PatchDownloadEvent(_serverObjectPtr, _extractor.get());
+
+                //patchobj为"节点1;节点2;...;patch", 前面是分发树中已经有(或正在下载)这个包的节点, 最后是patch
+                vector<string> vObj = TC_Common::sepstr<string>(_patchRequest.patchobj, ";");
+                vector<DownloadSource> vSource(vObj.size());
+                for (size_t i = 0; i < vObj.size(); i++)
+                {
+                    bool peer = (i + 1 < vObj.size());
 
-                //到PATCH下载文件
-                PatchPrx proxy = Application::getCommunicator()->stringToProxy<PatchPrx>(_patchRequest.patchobj);
-                proxy->tars_timeout(60000);
+                    vSource[i].patchPrx   = Application::getCommunicator()->stringToProxy<PatchPrx>(vObj[i]);
+                    vSource[i].remoteFile = peer ? md5 : sRemoteTgzFile;
+
+                    //节点出问题时尽快换下一个源
+                    vSource[i].patchPrx->tars_timeout(peer ? 10000 : 60000);
+                }
 
-                int downloadRet = SingleFileDownloader::download(proxy, sRemoteTgzFile, dtask.sLocalTgzFile, eventPtr, _patchRequest.appname, _patchRequest.servername, _patchRequest.nodename, sResult);
+                //到PATCH下载文件, md5校验通过后才会出现在仓库中
+                string fileMd5;
+                int downloadRet = SingleFileDownloader::download(vSource, dtask.sLocalTgzFile, eventPtr, _patchRequest.appname, _patchRequest.servername, _patchRequest.nodename, sResult, fileMd5, md5);
                 if(downloadRet != 0)
                 {
                     //返回码错开一下
                     iRet = downloadRet - 100;
                     returned = true;
                 }
+                //检查新下载的文件是否存在
+                else if(!TC_File::isFileExist(dtask.sLocalTgzFile))
+                {
+                    iRet = -5;
+                    sResult = "local download file not exist";
+                    returned = true;
+                }
+                else
+                {
+                    downloaded = true;
+                }
             }
             catch (std::exception & ex)
             {
@@ -233,32 +463,34 @@ int CommandPatch::download(const std::string & sRemoteTgzPath, const std::string
                 NODE_LOG(_serverObjectPtr->getServerId())->error() <<FILE_FUN<< _patchRequest.appname + "." + _patchRequest.servername << "|" << reqMd5 << "|Unknown Exception" << endl;
                 returned = true;
             }
-        }
 
-        if(!returned)
-        {
-            //检查新下载的文件是否存在
-            if(!TC_File::isFileExist(dtask.sLocalTgzFile))
+            //边下载边解压出来的内容没有通过md5校验(或者不完整), 整个解压目录丢掉
+            if(iRet != 0 && _extractor)
             {
-                iRet = -5;
-                sResult = "local download file not exist";
-                returned = true;
+                string sExtractPath = _extractor->getDestPath();
+                _extractor.reset();
+                TC_File::removeFile(sExtractPath, true);
             }
         }
 
-        //检查md5
-        if(!returned)
+        //仓库中的文件链接到服务的下载目录
+        if(iRet == 0 && linkFile(sStoreFile, sLocalTgzFile) != 0)
         {
-            string fileMd5 = TC_MD5::md5file(dtask.sLocalTgzFile);
-            if(fileMd5 != reqMd5)
-            {
-                iRet = -6;
-                sResult = string("request md5:") + reqMd5 + ", local file md5:" + fileMd5 + ", md5 is not equal";
-                returned = true;
-            }
+            iRet = -5;
+            sResult = "link " + sStoreFile + " to " + sLocalTgzFile + " error";
         }
     } //解锁
 
+    if(iRet == 0)
+    {
+        _serverObjectPtr->setPatchPercent(100);
+    }
+
+    if(downloaded)
+    {
+        pruneStore();
+    }
+
     return iRet;
 }
 
@@ -273,6 +505,24 @@ int CommandPatch::execute(string &sResult)
         {
             string sServerName      = _patchRequest.groupname.empty()?_patchRequest.servername:_patchRequest.groupname;
             string sLocalTgzPath    = _localTgzBasePath + FILE_SEP + _patchRequest.appname + "." + sServerName;
+            string sLocalExtractPach   = _localExtractBasePath + FILE_SEP + _patchRequest.appname + "." + _patchRequest.servername;
+
+            //解压目录在下载前准备好, 下载过程中可以直接解压
+            if (prepareExtractPath(sLocalExtractPach, sResult) != 0)
+            {
+                iRet = -4;
+                break;
+            }
+
+            TC_Config conf;
+            conf.parseFile(_serverObjectPtr->getConfigFile());
+            string packageFormat= _serverObjectPtr->getPackageFormat(); //conf.get("/tars/application/server<packageFormat>","war");
+            bool bJava = (_serverObjectPtr->getServerType() == "tars_java");
+
+#if !TARGET_PLATFORM_WINDOWS
+            //tgz包边下载边解压, java的war/jar包不是tgz
+            _extractor.reset(bJava ? NULL : new TarExtractor(sLocalExtractPach));
+#endif
 
             string sShortFile;
             string sRemoteTgzPath;
@@ -283,8 +533,15 @@ int CommandPatch::execute(string &sResult)
                 sShortFile =  _patchRequest.appname + "." + sServerName + "."+ _patchRequest.version + "." + _patchRequest.ostype + ".tgz";
                 sRemoteTgzPath = FILE_SEP + string("TARSBatchPatchingV2") + FILE_SEP + _patchRequest.appname + FILE_SEP + sServerName;
 
+                //上一个版本的包
+                string sBaseTgzFile;
+                if(!_lastPatchVersion.empty() && _lastPatchVersion != _patchRequest.version)
+                {
+                    sBaseTgzFile = sLocalTgzPath + FILE_SEP + _patchRequest.appname + "." + sServerName + "." + _lastPatchVersion + "." + _patchRequest.ostype + ".tgz";
+                }
+
                 //使用新路径下载
-                iRet = download(sRemoteTgzPath, sLocalTgzPath, sShortFile, _patchRequest.md5, sResult);
+                iRet = download(sRemoteTgzPath, sLocalTgzPath, sShortFile, _patchRequest.md5, sResult, sBaseTgzFile);
                 if(iRet != 0)
                 {
                     NODE_LOG("patchPro")->error() <<FILE_FUN<< sRemoteTgzPath << "|" <<  sLocalTgzPath << "|old download error:" << sShortFile
@@ -296,7 +553,9 @@ int CommandPatch::execute(string &sResult)
             {
                 sShortFile = _patchRequest.appname + "." + sServerName + ".tgz";
                 sRemoteTgzPath = FILE_SEP + string("TARSBatchPatching") + FILE_SEP + _patchRequest.appname + FILE_SEP + sServerName;
-                iRet = download(sRemoteTgzPath, sLocalTgzPath, sShortFile, _patchRequest.md5, sResult);
+
+                //旧路径每个版本的文件名相同, 本地的文件就是上一个版本
+                iRet = download(sRemoteTgzPath, sLocalTgzPath, sShortFile, _patchRequest.md5, sResult, sLocalTgzPath + FILE_SEP + sShortFile);
                 if(iRet != 0)
                 {
                     NODE_LOG(_serverObjectPtr->getServerId())->error() <<FILE_FUN<< sRemoteTgzPath << "|" <<  sLocalTgzPath << "|old download error:" << sShortFile
@@ -317,154 +576,168 @@ int CommandPatch::execute(string &sResult)
                 break;
             }
 
-            string sLocalExtractPach   = _localExtractBasePath + FILE_SEP + _patchRequest.appname + "." + _patchRequest.servername;
-            //如果存在， 则删除之前的已经存在的文件
-            if(TC_File::isFileExistEx(sLocalExtractPach, S_IFDIR) && TC_File::removeFile(sLocalExtractPach, true) != 0)
-            {
-                sResult = " removeFile \""+sLocalExtractPach+"\" failure, error:" + TC_Exception::parseError(TC_Exception::getSystemCode());
-                NODE_LOG(_serverObjectPtr->getServerId())->error() <<FILE_FUN<<sResult<< endl;
-                iRet = -4;
-                break;
-            }
-
-            //创建解压目录
-            if (!TC_File::makeDirRecursive(sLocalExtractPach))
-            {
-                sResult = " makeDirRecursive \""+sLocalExtractPach+"\" failure, errnr:" + TC_Exception::parseError(TC_Exception::getSystemCode());
-                NODE_LOG(_serverObjectPtr->getServerId())->error() <<FILE_FUN<<sResult<< endl;
-                iRet = -5;
-                break;
-            }
-
             string busybox;
-    #if TARGET_PLATFORM_WINDOWS
+#if TARGET_PLATFORM_WINDOWS
             busybox = ServerConfig::TarsPath + string(FILE_SEP) + "tarsnode\\util\\busybox.exe";
-            string cmdDelimiter="&";//多命令分隔符";" 对应Windows是"&"                  
-#else
-            string cmdDelimiter=";";
 #endif
             //解压
-            TC_Config conf;
-            conf.parseFile(_serverObjectPtr->getConfigFile());
-            string packageFormat= _serverObjectPtr->getPackageFormat(); //conf.get("/tars/application/server<packageFormat>","war");
+            string cmd,sLocalTgzFile_bak;
+            if (bJava) //如果是tars_java，使用war 方法
+            {
+                sLocalTgzFile_bak = TC_Common::replace(sLocalTgzFile, ".tgz", packageFormat == "jar" ? ".jar" : ".war");
+                TC_File::removeFile(sLocalTgzFile_bak, false);
+                if (::rename(sLocalTgzFile.c_str(), sLocalTgzFile_bak.c_str()) != 0)
+                {
+                    sResult = "rename " + sLocalTgzFile + " to " + sLocalTgzFile_bak + " error:" + TC_Exception::parseError(TC_Exception::getSystemCode());
+                    NODE_LOG(_serverObjectPtr->getServerId())->error() <<FILE_FUN<<sResult<< endl;
+                    iRet = -6;
+                    break;
+                }
 
-            	string cmd,sLocalTgzFile_bak;
-            	if (_serverObjectPtr->getServerType() == "tars_java") //如果是tars_java，使用war 方法
-            	{
-            		if(packageFormat=="jar")
-            		{
-            			sLocalTgzFile_bak=TC_Common::replace(sLocalTgzFile,".tgz",".jar");
-            			cmd += busybox + " mv " + sLocalTgzFile + " " + sLocalTgzFile_bak + cmdDelimiter;
-            		}
-            		else
-            		{
-            			sLocalTgzFile_bak=TC_Common::replace(sLocalTgzFile,".tgz",".war");
-            			cmd += busybox + " mv " + sLocalTgzFile + " " + sLocalTgzFile_bak + cmdDelimiter;
+                if(packageFormat != "jar")
+                {
+                    //unzip -oq -d 在Windows 下不像Liunx会自动创建目录
+                    TC_File::makeDirRecursive(sLocalExtractPach + FILE_SEP + sServerName);
+                    cmd = busybox + " unzip -oq  " + sLocalTgzFile_bak+ " -d "+ sLocalExtractPach + FILE_SEP +sServerName;
+                    system(cmd.c_str());
+                }
+            }
+            else
+            {
 #if TARGET_PLATFORM_WINDOWS
-            			//unzip -oq -d 在Windows 下不像Liunx会自动创建目录
-            			cmd += busybox + " mkdir -p "  + sLocalExtractPach + FILE_SEP +sServerName + cmdDelimiter;
+                cmd = busybox + " tar xzf " + sLocalTgzFile + " -C " + sLocalExtractPach;
+                system(cmd.c_str());
+#else
+                cmd = "extract " + sLocalTgzFile;
+
+                //download返回成功时包的md5已经校验过, 边下载边解压的内容就是校验过的数据
+                //已经缓存在本地/通过差量还原/边下载边解压出错时, 清空解压目录后从文件解压
+                bool extracted = (_extractor && _extractor->finish());
+                string sExtractError = _extractor ? _extractor->getError() : "";
+                _extractor.reset();
+
+                if (!extracted)
+                {
+                    NODE_LOG(_serverObjectPtr->getServerId())->debug() << FILE_FUN << "extract from file:" << sLocalTgzFile << ", " << sExtractError << endl;
+
+                    string sError;
+                    if (prepareExtractPath(sLocalExtractPach, sResult) != 0 || TarExtractor::extractFile(sLocalTgzFile, sLocalExtractPach, sError) != 0)
+                    {
+                        sResult += sError;
+                        NODE_LOG(_serverObjectPtr->getServerId())->error() <<FILE_FUN<<sResult<< endl;
+                        iRet = -6;
+                        break;
+                    }
+                }
 #endif
-            			cmd += busybox + " unzip -oq  " + sLocalTgzFile_bak+ " -d "+ sLocalExtractPach + FILE_SEP +sServerName;
-            		}
-            	}
-            	else
-            	{
-            		cmd = busybox + " tar xzf " + sLocalTgzFile + " -C " + sLocalExtractPach;
-            	}
-
-            	//解压
-            	system(cmd.c_str());
-
-            	NODE_LOG(_serverObjectPtr->getServerId())->debug() << FILE_FUN << "unzip:" << cmd << ", error: " << TC_Exception::getSystemError() <<endl;
-
-            	/**
-				 * 有可能system这里解压失败了，
-				 * 这里通过遍历解压目录下有没有文件来判断是否解压成功,因为解压之前这个目录是空的
-				 */
-            	if(packageFormat != "jar")
-            	{
-            		vector<string> files;
-            		tars::TC_File::listDirectory(sLocalExtractPach, files, false);
-            		if(files.empty())
-            		{
-            			sResult = cmd + ", error!";
-            			NODE_LOG(_serverObjectPtr->getServerId())->error() <<FILE_FUN<<sResult<< endl;
-            			iRet = -6;
-            			break;
-            		}
-
-            		NODE_LOG(_serverObjectPtr->getServerId())->debug() <<FILE_FUN<< "directory:" << files[0] << endl;
-
-            		//dcache用到, 同一个发布程序, 发布成不同的服务名
-            		if(sServerName != _patchRequest.servername)
-            		{
-            			string sSrcFile     = sLocalExtractPach + FILE_SEP + sServerName + FILE_SEP + sServerName;
-            			string sDstFile     = sLocalExtractPach + FILE_SEP + sServerName + FILE_SEP + _patchRequest.servername;
-
-            			rename(sSrcFile.c_str(), sDstFile.c_str());
-            			NODE_LOG(_serverObjectPtr->getServerId())->debug() <<FILE_FUN<< "rename:" << sSrcFile << " " << sDstFile << endl;
-            		}
-            	}
-
-            	//检查是否需要备份bin目录下的文件夹
-            	if(backupfiles(sResult) != 0)
-            	{
-            		NODE_LOG(_serverObjectPtr->getServerId())->error() << FILE_FUN << sResult << endl;
-            		iRet = -7;
-            		break;
-            	}
-
-//            	//copy file失败， 会抛异常
-//            	if (_serverObjectPtr->getServerType() == "tars_nodejs")
-//            	{
-//            		NODE_LOG(_serverObjectPtr->getServerId())->debug() <<FILE_FUN<<"|copy :" << sLocalExtractPach + FILE_SEP + sServerName + FILE_SEP + sServerName << " -> " <<_serverObjectPtr->getExePath() << endl;
-//
-//            		TC_File::copyFile(sLocalExtractPach + FILE_SEP + sServerName + FILE_SEP + sServerName, _serverObjectPtr->getExePath(), true);
-//            	}
-//            	else
-//
-            	if (_serverObjectPtr->getServerType() == "tars_java" && packageFormat=="jar")
-            	{
-            		string  cpCmd = busybox + " cp -f "+sLocalTgzFile_bak + " " + _serverObjectPtr->getExePath();
-            		system(cpCmd.c_str());
-
-					NODE_LOG(_serverObjectPtr->getServerId())->debug() <<FILE_FUN<<"|copy :" << cpCmd << ", " << TC_Exception::getSystemError() << endl;
-            	}
-            	else
-            	{
-            		//(为了兼容所有语言)
-            		//遍历到目录, 如果该目录下只有一个目录, 则继续遍历, 直到该目录下: 有多个文件或者没有子目录了!
-            		//此时, 该目录这就是执行程序所在的目录
-            		//把这个目录下所有文件copy到可执行程序目录
-            		string srcPath = sLocalExtractPach;// + FILE_SEP + sServerName;
-
-					do
-					{
-						vector<string> files;
-						tars::TC_File::listDirectory(srcPath, files, false);
-						if(files.empty())
-						{
-							sResult = cmd + ", error!";
-							NODE_LOG(_serverObjectPtr->getServerId())->error() <<FILE_FUN<<sResult<< endl;
-							iRet = -6;
-							break;
-						}
+            }
 
-						//只要一个目录, 继续遍历
-						if(files.size() == 1 && TC_File::isFileExist(files[0], S_IFDIR))
-						{
-							srcPath = files[0];
-						}
-						else
-						{
-							break;
-						}
-					}while(true);
+            NODE_LOG(_serverObjectPtr->getServerId())->debug() << FILE_FUN << "unzip:" << cmd << ", error: " << TC_Exception::getSystemError() <<endl;
+
+            /**
+             * 有可能system这里解压失败了，
+             * 这里通过遍历解压目录下有没有文件来判断是否解压成功,因为解压之前这个目录是空的
+             */
+            if(packageFormat != "jar")
+            {
+                vector<string> files;
+                tars::TC_File::listDirectory(sLocalExtractPach, files, false);
+                if(files.empty())
+                {
+                    sResult = cmd + ", error!";
+                    NODE_LOG(_serverObjectPtr->getServerId())->error() <<FILE_FUN<<sResult<< endl;
+                    iRet = -6;
+                    break;
+                }
+
+                NODE_LOG(_serverObjectPtr->getServerId())->debug() <<FILE_FUN<< "directory:" << files[0] << endl;
+
+                //dcache用到, 同一个发布程序, 发布成不同的服务名
+                if(sServerName != _patchRequest.servername)
+                {
+                    string sSrcFile     = sLocalExtractPach + FILE_SEP + sServerName + FILE_SEP + sServerName;
+                    string sDstFile     = sLocalExtractPach + FILE_SEP + sServerName + FILE_SEP + _patchRequest.servername;
 
-            		NODE_LOG(_serverObjectPtr->getServerId())->debug() <<FILE_FUN<<"|copy :" << srcPath << " -> " <<_serverObjectPtr->getExePath() << endl;
+                    rename(sSrcFile.c_str(), sDstFile.c_str());
+                    NODE_LOG(_serverObjectPtr->getServerId())->debug() <<FILE_FUN<< "rename:" << sSrcFile << " " << sDstFile << endl;
+                }
+            }
+
+            if (bJava && packageFormat=="jar")
+            {
+                //检查是否需要备份bin目录下的文件夹
+                if(backupfiles(sResult) != 0)
+                {
+                    NODE_LOG(_serverObjectPtr->getServerId())->error() << FILE_FUN << sResult << endl;
+                    iRet = -7;
+                    break;
+                }
+
+                string sDstFile = _serverObjectPtr->getExePath() + FILE_SEP + TC_File::extractFileName(sLocalTgzFile_bak);
 
-            		TC_File::copyFile(srcPath, _serverObjectPtr->getExePath(), true);
-            	}
+                NODE_LOG(_serverObjectPtr->getServerId())->debug() <<FILE_FUN<<"|copy :" << sLocalTgzFile_bak << " -> " << sDstFile << endl;
+
+                TC_File::copyFile(sLocalTgzFile_bak, sDstFile, true);
+            }
+            else
+            {
+                //(为了兼容所有语言)
+                //遍历到目录, 如果该目录下只有一个目录, 则继续遍历, 直到该目录下: 有多个文件或者没有子目录了!
+                //此时, 该目录这就是执行程序所在的目录
+                //把这个目录下所有文件copy到可执行程序目录
+                string srcPath = sLocalExtractPach;// + FILE_SEP + sServerName;
+
+                do
+                {
+                    vector<string> files;
+                    tars::TC_File::listDirectory(srcPath, files, false);
+                    if(files.empty())
+                    {
+                        sResult = cmd + ", error!";
+                        NODE_LOG(_serverObjectPtr->getServerId())->error() <<FILE_FUN<<sResult<< endl;
+                        iRet = -6;
+                        break;
+                    }
+
+                    //只要一个目录, 继续遍历
+                    if(files.size() == 1 && TC_File::isFileExist(files[0], S_IFDIR))
+                    {
+                        srcPath = files[0];
+                    }
+                    else
+                    {
+                        break;
+                    }
+                }while(true);
+
+                if(iRet != 0)
+                {
+                    break;
+                }
+
+                //执行程序在服务的bin目录下时, 在临时目录准备好后整体替换bin目录
+                int installRet = installFiles(srcPath, sResult);
+                if(installRet < 0)
+                {
+                    NODE_LOG(_serverObjectPtr->getServerId())->error() << FILE_FUN << sResult << endl;
+                    iRet = -7;
+                    break;
+                }
+                else if(installRet > 0)
+                {
+                    //检查是否需要备份bin目录下的文件夹
+                    if(backupfiles(sResult) != 0)
+                    {
+                        NODE_LOG(_serverObjectPtr->getServerId())->error() << FILE_FUN << sResult << endl;
+                        iRet = -7;
+                        break;
+                    }
+
+                    NODE_LOG(_serverObjectPtr->getServerId())->debug() <<FILE_FUN<<"|copy :" << srcPath << " -> " <<_serverObjectPtr->getExePath() << endl;
+
+                    TC_File::copyFile(srcPath, _serverObjectPtr->getExePath(), true);
+                }
+            }
 
         } while ( false );
 
@@ -513,6 +786,124 @@ int CommandPatch::execute(string &sResult)
     return iRet;
 }
 
+int CommandPatch::prepareExtractPath(const string &sLocalExtractPach, std::string &sResult)
+{
+    //如果存在， 则删除之前的已经存在的文件
+    if(TC_File::isFileExistEx(sLocalExtractPach, S_IFDIR) && TC_File::removeFile(sLocalExtractPach, true) != 0)
+    {
+        sResult = " removeFile \""+sLocalExtractPach+"\" failure, error:" + TC_Exception::parseError(TC_Exception::getSystemCode());
+        NODE_LOG(_serverObjectPtr->getServerId())->error() <<FILE_FUN<<sResult<< endl;
+        return -1;
+    }
+
+    //创建解压目录
+    if (!TC_File::makeDirRecursive(sLocalExtractPach))
+    {
+        sResult = " makeDirRecursive \""+sLocalExtractPach+"\" failure, errnr:" + TC_Exception::parseError(TC_Exception::getSystemCode());
+        NODE_LOG(_serverObjectPtr->getServerId())->error() <<FILE_FUN<<sResult<< endl;
+        return -1;
+    }
+
+    return 0;
+}
+
+void CommandPatch::copyMissing(const string &srcFile, const string &destFile)
+{
+    if (TC_File::isFileExistEx(srcFile, S_IFDIR))
+    {
+        if (!TC_File::isFileExistEx(destFile, S_IFDIR))
+        {
+            TC_File::makeDirRecursive(destFile);
+        }
+
+        vector<string> vFiles;
+        TC_File::listDirectory(srcFile, vFiles, false);
+        for (size_t i = 0; i < vFiles.size(); i++)
+        {
+            copyMissing(vFiles[i], destFile + FILE_SEP + TC_File::extractFileName(vFiles[i]));
+        }
+    }
+    else if (!TC_File::isFileExist(destFile))
+    {
+        TC_File::copyFile(srcFile, destFile, true);
+    }
+}
+
+int CommandPatch::installFiles(const string &srcPath, std::string &sResult)
+{
+    string serverPath = ServerConfig::TarsPath + "tarsnode" + FILE_SEP + "data" + FILE_SEP + _patchRequest.appname + "." + _patchRequest.servername + FILE_SEP;
+    string destPath   = ServerConfig::TarsPath + "tarsnode" + FILE_SEP + "data" + FILE_SEP + "tmp" + FILE_SEP + _patchRequest.appname + "." + _patchRequest.servername + FILE_SEP;
+    string binPath    = serverPath + "bin" + FILE_SEP;
+    string stagePath  = serverPath + "bin.patching" + FILE_SEP;
+
+    //执行程序不在服务的bin目录下, 由调用者按原来的方式拷贝
+    if (TC_File::simplifyDirectory(_serverObjectPtr->getExePath()) != TC_File::simplifyDirectory(binPath))
+    {
+        return 1;
+    }
+
+    try
+    {
+        if (TC_File::isFileExistEx(stagePath, S_IFDIR) && TC_File::removeFile(stagePath, true) != 0)
+        {
+            sResult = "removeFile " + stagePath + " error:" + TC_Exception::parseError(TC_Exception::getSystemCode());
+            return -1;
+        }
+
+        //解压目录和服务目录在同一个文件系统时直接改名, 否则拷贝
+        if (::rename(TC_File::simplifyDirectory(srcPath).c_str(), TC_File::simplifyDirectory(stagePath).c_str()) != 0)
+        {
+            if (!TC_File::makeDirRecursive(stagePath))
+            {
+                sResult = "makeDirRecursive " + stagePath + " error:" + TC_Exception::parseError(TC_Exception::getSystemCode());
+                return -1;
+            }
+
+            TC_File::copyFile(srcPath, stagePath, true);
+        }
+
+        //需要保留的文件从当前bin目录带到新版本中, 发布包中有同名文件时以发布包为准
+        string serverType = _serverObjectPtr->getServerType();
+        if (serverType == "tars_java" || serverType == "tars_node")
+        {
+            vector<string> vFileNames = TC_Common::sepstr<string>(_serverObjectPtr->getBackupFileNames(), ";|");
+            for (size_t i = 0; i < vFileNames.size(); i++)
+            {
+                if (TC_File::isFileExistEx(binPath + vFileNames[i], S_IFDIR))
+                {
+                    copyMissing(binPath + vFileNames[i], stagePath + vFileNames[i]);
+                }
+            }
+        }
+
+        if (serverType == "tars_node")
+        {
+            // 对于 tarsnode 服务， 还需要保留一些默认文件 bin/*.conf, bin/*.sh, bin/*.bak
+            vector<string> oldBinFils;
+            TC_File::listDirectory(binPath, oldBinFils, false);
+            for (size_t i = 0; i < oldBinFils.size(); i++)
+            {
+                string fName  = TC_File::extractFileName(oldBinFils[i]);
+                string exName = TC_File::extractFileExt(fName);
+                if (exName == "conf" || exName == "sh" || exName == "bak")
+                {
+                    copyMissing(oldBinFils[i], stagePath + fName);
+                }
+            }
+        }
+    }
+    catch(exception& e)
+    {
+        sResult = string(__FUNCTION__) + "|" + _patchRequest.appname + "." + _patchRequest.servername + "|Exception:" + e.what();
+        return -1;
+    }
+
+    NODE_LOG(_serverObjectPtr->getServerId())->debug() <<FILE_FUN<< "install " << srcPath << " -> " << stagePath << " -> " << binPath << endl;
+
+    //备份当前bin目录后换上准备好的新版本, bin目录只在两次rename之间不存在
+    return backupBinFiles(serverPath, destPath, sResult, stagePath);
+}
+
 int CommandPatch::backupfiles(std::string &sResult)
 {
     try
@@ -621,7 +1012,7 @@ int CommandPatch::restoreFiles(const string &existFile, const string &destPathBa
     return 0;
 }
 
-int CommandPatch::backupBinFiles(const string &srcPath, const string &destPath, std::string &sResult)
+int CommandPatch::backupBinFiles(const string &srcPath, const string &destPath, std::string &sResult, const string &stagePath)
 {
     NODE_LOG(_serverObjectPtr->getServerId())->debug() <<FILE_FUN << "backup: "<< srcPath << " to " << destPath<< endl;
 
@@ -690,6 +1081,32 @@ int CommandPatch::backupBinFiles(const string &srcPath, const string &destPath,
 
     NODE_LOG(_serverObjectPtr->getServerId())->debug()   <<FILE_FUN<< "rename :"<< existFile << " to "<< destPathBak << " finished, ret:" << ret << ", " << TC_Exception::parseError(TC_Exception::getSystemCode())<<endl;
 
+    if(!stagePath.empty())
+    {
+        //bin目录没有备份成功时不能换上新版本, 保持原来的bin目录不动
+        if(ret != 0)
+        {
+            sResult = "rename " + existFile + " to " + destPathBak + " error:" + TC_Exception::parseError(TC_Exception::getSystemCode());
+            return -1;
+        }
+
+        if(::rename(TC_File::simplifyDirectory(stagePath).c_str(), TC_File::simplifyDirectory(existFile).c_str()) != 0)
+        {
+            sResult = "rename " + stagePath + " to " + existFile + " error:" + TC_Exception::parseError(TC_Exception::getSystemCode());
+
+            //换回原来的bin目录, 服务还能用旧版本启动
+            if(::rename(TC_File::simplifyDirectory(destPathBak).c_str(), TC_File::simplifyDirectory(existFile).c_str()) != 0)
+            {
+                sResult += ", restore " + destPathBak + " error:" + TC_Exception::parseError(TC_Exception::getSystemCode());
+            }
+
+            NODE_LOG(_serverObjectPtr->getServerId())->error() <<FILE_FUN<< sResult << endl;
+            return -1;
+        }
+
+        return 0;
+    }
+
     TC_File::makeDir(existFile);
 
     return 0;
@@ -26,6 +26,8 @@
 #include "ServerCommand.h"
 #include "CommandStop.h"
 #include "util.h"
+#include "TarExtractor.h"
+#include <memory>
 
 class CommandPatch : public ServerCommand
 {
@@ -38,7 +40,11 @@ public:
 
     int updatePatchResult(std::string &sResult);
 
-    int download(const std::string & sRemoteTgzPath, const std::string & sLocalTgzPath, const std::string & sShortFileName, const std::string& reqMd5, std::string & sResult);
+    /**
+     * 下载发布包
+     * @param sBaseTgzFile, 服务上一个版本的包, 存在时先尝试只下载两个版本之间的差量
+     */
+    int download(const std::string & sRemoteTgzPath, const std::string & sLocalTgzPath, const std::string & sShortFileName, const std::string& reqMd5, std::string & sResult, const std::string & sBaseTgzFile = "");
 
     static string getOsType();
 
@@ -50,33 +56,83 @@ private:
 
     /**
      * 备份5次bin目录bin
+     * stagePath不为空时, 备份后把stagePath改名为bin目录, 否则创建空的bin目录
      */ 
-    int backupBinFiles(const string &srcPath, const string &destPath, std::string &sResult);
+    int backupBinFiles(const string &srcPath, const string &destPath, std::string &sResult, const string &stagePath = "");
+
+    /**
+     * 清空并创建解压目录
+     */
+    int prepareExtractPath(const string &sLocalExtractPach, std::string &sResult);
+
+    /**
+     * 在bin.patching中准备好新版本(包括需要保留的文件), 备份后替换bin目录
+     * @return 0成功, <0失败, >0执行程序不在服务的bin目录下, 不能整体替换
+     */
+    int installFiles(const string &srcPath, std::string &sResult);
+
+    /**
+     * 递归拷贝, 目标已存在的文件不覆盖
+     */
+    static void copyMissing(const string &srcFile, const string &destFile);
 
     /**
      * 恢复指定的备份文件
      */ 
     int restoreFiles(const string &existFile, const string &destPathBak);
 
+    /**
+     * 两个路径是否是同一个文件(硬链接)
+     */
+    static bool isSameFile(const string &file1, const string &file2);
+
+    /**
+     * 把srcFile硬链接到destFile, 不支持硬链接时拷贝
+     */
+    int linkFile(const string &srcFile, const string &destFile);
+
+    /**
+     * 清理仓库中已经没有服务链接的发布包
+     */
+    void pruneStore();
+
+    /**
+     * 从patch下载上一个版本到新版本的差量, 在上一个版本的包上还原出新版本并校验md5后放入仓库
+     * gzip的包还原出来的是解压后的tar, 放在仓库中的<md5>.tar, 其它格式的包就是<md5>
+     * @param sStoreFile, 还原后仓库中的文件
+     * @return 0成功, 失败时下载完整的包
+     */
+    int downloadDelta(const string &sRemoteTgzPath, const string &sBaseTgzFile, const string &md5, string &sStoreFile);
+
 private:
     ServerObjectPtr     _serverObjectPtr;
 
     PatchRequest   _patchRequest;
 
+    //发布前服务的版本
+    std::string         _lastPatchVersion;
+
     //本地存放tgz的目录
     std::string         _localTgzBasePath;
 
+    //节点上按md5存放发布包的目录, 所有服务共用
+    std::string         _localTgzStorePath;
+
     //本地解压的文件目录
     std::string         _localExtractBasePath;
 
     StatExChangePtr     _statExChange;
+
+    //边下载边解压到解压目录, 只在execute下载期间有效
+    std::unique_ptr<TarExtractor> _extractor;
 };
 
 class PatchDownloadEvent : public DownloadEvent
 {
 public:
-    PatchDownloadEvent(ServerObjectPtr pServerObjectPtr)
+    PatchDownloadEvent(ServerObjectPtr pServerObjectPtr, TarExtractor *extractor = NULL)
     : _serverObjectPtr(pServerObjectPtr)
+    , _extractor(extractor)
     {}
 
     virtual void onDownloading(const FileInfo &fi, int pos)
@@ -87,8 +143,18 @@ public:
         }
     }
 
+    //收到的数据就是计算md5的数据, md5校验通过时解压出来的内容也是校验过的
+    virtual void onData(const char *data, size_t len)
+    {
+        if (_extractor)
+        {
+            _extractor->input(data, len);
+        }
+    }
+
 private:
     ServerObjectPtr     _serverObjectPtr;
+    TarExtractor        *_extractor;
 };
 
 #endif
@@ -303,6 +303,27 @@ void CommandStart::prepareScript()
 		vEnvs.push_back(vecEnvs[i]);
 	}
 
+	//共享内存心跳表的槽位, 每个adapter一个, 不支持的服务忽略这两个环境变量继续走rpc心跳
+	HeartbeatShm *pShm = g_app.getHeartbeatShm();
+	if (pShm && _serverObjectPtr->getRunType() != ServerObject::Container)
+	{
+		vector<string> vAdapters;
+		for (map<string, AdapterDescriptor>::const_iterator it = _desc.adapters.begin(); it != _desc.adapters.end(); ++it)
+		{
+			vAdapters.push_back(it->first);
+		}
+		vAdapters.push_back("AdminAdapter");
+
+		int iSlot = pShm->allocate(_serverObjectPtr->getServerId(), vAdapters);
+		_serverObjectPtr->setHeartbeatSlot(iSlot, vAdapters);
+
+		if (iSlot >= 0)
+		{
+			vEnvs.push_back("TARS_HEARTBEAT_SHM=" + pShm->getFile());
+			vEnvs.push_back("TARS_HEARTBEAT_SLOT=" + TC_Common::tostr(iSlot) + ":" + TC_Common::tostr(vAdapters.size()));
+		}
+	}
+
 	//生成启动脚本
 	std::ostringstream osStartStcript;
 #if TARGET_PLATFORM_WINDOWS
@@ -0,0 +1,279 @@
+/**
+ * Tencent is pleased to support the open source community by making Tars available.
+ *
+ * Copyright (C) 2016THL A29 Limited, a Tencent company. All rights reserved.
+ *
+ * Licensed under the BSD 3-Clause License (the "License"); you may not use this file except 
+ * in compliance with the License. You may obtain a copy of the License at
+ *
+ * https://opensource.org/licenses/BSD-3-Clause
+ *
+ * Unless required by applicable law or agreed to in writing, software distributed 
+ * under the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR 
+ * CONDITIONS OF ANY KIND, either express or implied. See the License for the 
+ * specific language governing permissions and limitations under the License.
+ */
+
+
+#include "HeartbeatShm.h"
+#include "util.h"
+
+#if !TARGET_PLATFORM_WINDOWS
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <string.h>
+#include <unistd.h>
+#endif
+
+static_assert(sizeof(HeartbeatShm::Head) == 64, "heartbeat head size must be 64");
+static_assert(sizeof(HeartbeatShm::Slot) == 128, "heartbeat slot size must be 128");
+
+HeartbeatShm::HeartbeatShm()
+: _addr(NULL)
+, _size(0)
+, _slotNum(0)
+{
+}
+
+HeartbeatShm::~HeartbeatShm()
+{
+#if !TARGET_PLATFORM_WINDOWS
+    if (_addr)
+    {
+        munmap(_addr, _size);
+        _addr = NULL;
+    }
+#endif
+}
+
+HeartbeatShm::Slot *HeartbeatShm::getSlot(int index) const
+{
+    return (Slot *)(_addr + sizeof(Head) + (size_t)index * sizeof(Slot));
+}
+
+void HeartbeatShm::clearSlot(Slot *slot)
+{
+    slot->heartbeat.store(0, std::memory_order_relaxed);
+    slot->pid.store(0, std::memory_order_relaxed);
+    memset(slot->serverId, 0, sizeof(slot->serverId));
+    memset(slot->adapter, 0, sizeof(slot->adapter));
+}
+
+bool HeartbeatShm::init(const string &sFile, uint32_t iSlotNum)
+{
+#if TARGET_PLATFORM_WINDOWS
+    return false;
+#else
+    TC_ThreadLock::Lock lock(_mutex);
+
+    size_t size = sizeof(Head) + (size_t)iSlotNum * sizeof(Slot);
+
+    int fd = open(sFile.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+    if (fd < 0)
+    {
+        TLOG_ERROR("HeartbeatShm::init open " << sFile << " error:" << strerror(errno) << endl);
+        return false;
+    }
+
+    struct stat st;
+    bool bReuse = (fstat(fd, &st) == 0 && (size_t)st.st_size == size);
+
+    if (!bReuse)
+    {
+        //大小不一致时重建, ftruncate扩展出来的部分都是0
+        if (ftruncate(fd, 0) != 0 || ftruncate(fd, size) != 0)
+        {
+            TLOG_ERROR("HeartbeatShm::init truncate " << sFile << " error:" << strerror(errno) << endl);
+            close(fd);
+            return false;
+        }
+    }
+
+    void *addr = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+
+    if (addr == MAP_FAILED)
+    {
+        TLOG_ERROR("HeartbeatShm::init mmap " << sFile << " error:" << strerror(errno) << endl);
+        return false;
+    }
+
+    _file    = sFile;
+    _addr    = (char *)addr;
+    _size    = size;
+    _slotNum = iSlotNum;
+
+    Head *head = (Head *)_addr;
+    if (bReuse && (head->magic != MAGIC || head->slotSize != sizeof(Slot) || head->slotNum != iSlotNum))
+    {
+        memset(_addr, 0, _size);
+        bReuse = false;
+    }
+
+    head->slotSize = sizeof(Slot);
+    head->slotNum  = iSlotNum;
+    head->magic    = MAGIC;
+
+    //node重启, 从槽位中恢复每个服务的分配
+    _servers.clear();
+    for (uint32_t i = 0; bReuse && i < _slotNum; )
+    {
+        Slot *slot = getSlot(i);
+        slot->serverId[NAME_LEN - 1] = '\0';
+        slot->adapter[NAME_LEN - 1]  = '\0';
+
+        if (slot->serverId[0] == '\0')
+        {
+            ++i;
+            continue;
+        }
+
+        string serverId = slot->serverId;
+        uint32_t j = i + 1;
+        while (j < _slotNum && strncmp(getSlot(j)->serverId, slot->serverId, NAME_LEN) == 0)
+        {
+            ++j;
+        }
+
+        if (_servers.find(serverId) == _servers.end())
+        {
+            _servers[serverId] = make_pair((int)i, (int)(j - i));
+        }
+        else
+        {
+            //不连续的重复分配, 只保留第一段
+            for (uint32_t k = i; k < j; k++)
+            {
+                clearSlot(getSlot(k));
+            }
+        }
+
+        i = j;
+    }
+
+    TLOG_DEBUG("HeartbeatShm::init " << sFile << ", slots:" << _slotNum << ", reuse:" << bReuse << ", servers:" << _servers.size() << endl);
+
+    return true;
+#endif
+}
+
+int HeartbeatShm::allocate(const string &serverId, const vector<string> &adapters)
+{
+    TC_ThreadLock::Lock lock(_mutex);
+
+    if (!_addr || adapters.empty() || serverId.length() >= NAME_LEN)
+    {
+        return -1;
+    }
+
+    int num   = (int)adapters.size();
+    int index = -1;
+
+    map<string, pair<int, int> >::iterator it = _servers.find(serverId);
+    if (it != _servers.end())
+    {
+        if (it->second.second == num)
+        {
+            index = it->second.first;
+        }
+        else
+        {
+            for (int i = 0; i < it->second.second; i++)
+            {
+                clearSlot(getSlot(it->second.first + i));
+            }
+            _servers.erase(it);
+        }
+    }
+
+    if (index < 0)
+    {
+        //找第一段足够长的连续空闲槽位
+        int begin = 0;
+        for (int i = 0; i < (int)_slotNum; i++)
+        {
+            if (getSlot(i)->serverId[0] != '\0')
+            {
+                begin = i + 1;
+            }
+            else if (i - begin + 1 == num)
+            {
+                index = begin;
+                break;
+            }
+        }
+
+        if (index < 0)
+        {
+            NODE_LOG(serverId)->error() << FILE_FUN << "no free heartbeat slot, adapters:" << num << endl;
+            return -1;
+        }
+
+        _servers[serverId] = make_pair(index, num);
+    }
+
+    for (int i = 0; i < num; i++)
+    {
+        Slot *slot = getSlot(index + i);
+        clearSlot(slot);
+        strncpy(slot->serverId, serverId.c_str(), NAME_LEN - 1);
+        strncpy(slot->adapter, adapters[i].c_str(), NAME_LEN - 1);
+    }
+
+    return index;
+}
+
+int HeartbeatShm::find(const string &serverId, vector<string> &adapters)
+{
+    TC_ThreadLock::Lock lock(_mutex);
+
+    adapters.clear();
+
+    map<string, pair<int, int> >::const_iterator it = _servers.find(serverId);
+    if (!_addr || it == _servers.end())
+    {
+        return -1;
+    }
+
+    for (int i = 0; i < it->second.second; i++)
+    {
+        adapters.push_back(getSlot(it->second.first + i)->adapter);
+    }
+
+    return it->second.first;
+}
+
+void HeartbeatShm::release(const string &serverId)
+{
+    TC_ThreadLock::Lock lock(_mutex);
+
+    map<string, pair<int, int> >::iterator it = _servers.find(serverId);
+    if (it == _servers.end())
+    {
+        return;
+    }
+
+    for (int i = 0; i < it->second.second; i++)
+    {
+        clearSlot(getSlot(it->second.first + i));
+    }
+
+    _servers.erase(it);
+}
+
+int64_t HeartbeatShm::getHeartbeat(int index, int64_t &pid) const
+{
+    if (!_addr || index < 0 || index >= (int)_slotNum)
+    {
+        pid = 0;
+        return 0;
+    }
+
+    Slot *slot = getSlot(index);
+
+    int64_t heartbeat = slot->heartbeat.load(std::memory_order_acquire);
+    pid = slot->pid.load(std::memory_order_relaxed);
+
+    return heartbeat;
+}
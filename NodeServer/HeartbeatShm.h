@@ -0,0 +1,141 @@
+/**
+ * Tencent is pleased to support the open source community by making Tars available.
+ *
+ * Copyright (C) 2016THL A29 Limited, a Tencent company. All rights reserved.
+ *
+ * Licensed under the BSD 3-Clause License (the "License"); you may not use this file except 
+ * in compliance with the License. You may obtain a copy of the License at
+ *
+ * https://opensource.org/licenses/BSD-3-Clause
+ *
+ * Unless required by applicable law or agreed to in writing, software distributed 
+ * under the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR 
+ * CONDITIONS OF ANY KIND, either express or implied. See the License for the 
+ * specific language governing permissions and limitations under the License.
+ */
+
+
+#ifndef __HEARTBEAT_SHM_H_
+#define __HEARTBEAT_SHM_H_
+
+#include <atomic>
+#include <map>
+#include <vector>
+#include "util/tc_platform.h"
+#include "util/tc_monitor.h"
+
+using namespace tars;
+using namespace std;
+
+/**
+ * 共享内存心跳表
+ * node创建一个mmap文件, 每个服务的每个adapter(包括AdminAdapter)占一个槽位,
+ * 服务进程直接把当前时间写入自己的槽位, node读槽位判断心跳是否超时, 不需要每个adapter每次都调用keepAlive.
+ * 老版本的服务仍然走keepAlive rpc, 两者取最新的时间.
+ *
+ * 服务启动时通过环境变量获得槽位:
+ * TARS_HEARTBEAT_SHM=文件路径
+ * TARS_HEARTBEAT_SLOT=起始槽位:槽位个数
+ * 服务mmap文件后在[起始槽位, 起始槽位+个数)中按adapter名字找到自己的槽位,
+ * 先写pid, 再写heartbeat(秒), 都是8字节对齐的原子写.
+ * node重启时文件保留, 已经在运行的服务继续写同一个文件, node从槽位中的serverId恢复分配关系.
+ */
+class HeartbeatShm
+{
+public:
+    enum
+    {
+        MAGIC       = 0x54484231,       //"THB1"
+        NAME_LEN    = 56,
+    };
+
+    /**
+     * 文件头, 64字节
+     */
+    struct Head
+    {
+        uint32_t    magic;
+        uint32_t    slotSize;
+        uint32_t    slotNum;
+        char        reserve[52];
+    };
+
+    /**
+     * 槽位, 128字节
+     */
+    struct Slot
+    {
+        std::atomic<int64_t>    heartbeat;              //最近心跳时间(秒), 0表示还没有上报
+        std::atomic<int64_t>    pid;                    //上报心跳的进程
+        char                    serverId[NAME_LEN];     //空表示槽位空闲
+        char                    adapter[NAME_LEN];
+    };
+
+    HeartbeatShm();
+
+    ~HeartbeatShm();
+
+    /**
+     * 打开或创建心跳文件
+     * @param sFile 文件路径
+     * @param iSlotNum 槽位个数
+     * @return 失败返回false, 此时只能使用rpc心跳
+     */
+    bool init(const string &sFile, uint32_t iSlotNum);
+
+    /**
+     * 文件路径
+     */
+    const string &getFile() const { return _file; }
+
+    /**
+     * 服务启动前分配槽位, 槽位个数与adapter个数一致时复用原来的槽位
+     * 分配出来的槽位心跳清零
+     * @param serverId
+     * @param adapters 服务的adapter
+     * @return 起始槽位, 没有足够的连续槽位时返回-1
+     */
+    int allocate(const string &serverId, const vector<string> &adapters);
+
+    /**
+     * 服务已经分配的槽位, node重启后加载服务时用来恢复槽位和adapter的对应关系
+     * @param serverId
+     * @param adapters 输出每个槽位对应的adapter
+     * @return 起始槽位, 没有分配时返回-1
+     */
+    int find(const string &serverId, vector<string> &adapters);
+
+    /**
+     * 服务删除时释放槽位
+     */
+    void release(const string &serverId);
+
+    /**
+     * 读取槽位的心跳, 不加锁
+     * @param index 槽位
+     * @param pid 上报心跳的进程
+     * @return 心跳时间(秒), 0表示还没有上报
+     */
+    int64_t getHeartbeat(int index, int64_t &pid) const;
+
+protected:
+    Slot *getSlot(int index) const;
+
+    void clearSlot(Slot *slot);
+
+protected:
+    TC_ThreadLock               _mutex;
+
+    string                      _file;
+
+    char                        *_addr;
+
+    size_t                      _size;
+
+    uint32_t                    _slotNum;
+
+    //服务的起始槽位和槽位个数
+    map<string, pair<int, int> > _servers;
+};
+
+#endif
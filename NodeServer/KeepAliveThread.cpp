@@ -22,6 +22,7 @@
 KeepAliveThread::KeepAliveThread()
 : _terminate(false)
 , _registryPrx(NULL)
+, _exitNotified(false)
 {
     _runTime                = time(0);
     _nodeInfo               = _platformInfo.getNodeInfo();
@@ -61,12 +62,26 @@ bool KeepAliveThread::timedWait(int millsecond)
 {
     TC_ThreadLock::Lock lock(_lock);
 
-    if (_terminate)
+    if (_terminate || _exitNotified)
     {
+        _exitNotified = false;
         return true;
     }
 
-    return _lock.timedWait(millsecond);
+    bool bNotified = _lock.timedWait(millsecond);
+
+    _exitNotified = false;
+
+    return bNotified;
+}
+
+void KeepAliveThread::notifyExit()
+{
+    TC_ThreadLock::Lock lock(_lock);
+
+    _exitNotified = true;
+
+    _lock.notifyAll();
 }
 
 FrameworkKey KeepAliveThread::getFrameworkKey()
@@ -158,9 +173,19 @@ void KeepAliveThread::run()
                 ServerFactory::getInstance()->setAllServerResourceLimit();
             }
 
-            //检查服务
+            //检查服务, 整轮检查完后才开始启动, 启动分组能看到这一轮所有需要启动的服务
+            if (g_app.getAutoStart())
+            {
+                g_app.getAutoStart()->hold();
+            }
+
             checkAlive();
 
+            if (g_app.getAutoStart())
+            {
+                g_app.getAutoStart()->release();
+            }
+
             // 上报node状态
             if (reportAlive() != 0)
             {
@@ -176,9 +201,28 @@ void KeepAliveThread::run()
             NODE_LOG("KeepAliveThread")->error() << FILE_FUN << "catch unkown exception|" << endl;
         }
 
+        //检查中抛出异常时也要恢复启动
+        if (g_app.getAutoStart())
+        {
+            g_app.getAutoStart()->release();
+        }
+
         _latestKeepAliveTime = TNOW;
 
-        timedWait(_monitorInterval * 1000);
+        //等待下一个检查周期, 期间有服务进程退出时立即检查退出的服务
+        int64_t nextCheckMs = TC_TimeProvider::getInstance()->getNowMs() + _monitorInterval * 1000;
+        while (!_terminate)
+        {
+            checkExited();
+
+            int64_t waitMs = nextCheckMs - TC_TimeProvider::getInstance()->getNowMs();
+            if (waitMs <= 0)
+            {
+                break;
+            }
+
+            timedWait(waitMs);
+        }
     }
 }
 
@@ -308,6 +352,52 @@ int KeepAliveThread::synStat()
     return -1;
 }
 
+void KeepAliveThread::checkExited()
+{
+#if TARGET_PLATFORM_LINUX
+    ProcessWatchThread *pWatch = g_app.getProcessWatchThread();
+    if (!pWatch)
+    {
+        return;
+    }
+
+    vector<string> vServerId;
+    pWatch->popExited(vServerId);
+
+    if ((TNOW - _runTime) < (ServantHandle::HEART_BEAT_INTERVAL + 1))
+    {
+        //等待心跳包, 由周期检查处理
+        return;
+    }
+
+    for (size_t i = 0; i < vServerId.size(); i++)
+    {
+        try
+        {
+            string::size_type pos = vServerId[i].find('.');
+            if (pos == string::npos)
+            {
+                continue;
+            }
+
+            ServerObjectPtr pServerObjectPtr = ServerFactory::getInstance()->getServer(vServerId[i].substr(0, pos), vServerId[i].substr(pos + 1));
+            if (!pServerObjectPtr)
+            {
+                continue;
+            }
+
+            NODE_LOG("KeepAliveThread")->debug() << FILE_FUN << vServerId[i] << "|process exited, check now" << endl;
+
+            pServerObjectPtr->checkServer(_heartTimeout);
+        }
+        catch (exception& e)
+        {
+            NODE_LOG("KeepAliveThread")->error() << FILE_FUN << vServerId[i] << " catch exception|" << e.what() << endl;
+        }
+    }
+#endif
+}
+
 void KeepAliveThread::checkAlive()
 {
 //    int64_t startMs = TC_TimeProvider::getInstance()->getNowMs();
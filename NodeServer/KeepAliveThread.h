@@ -50,6 +50,11 @@ public:
 	 */
     time_t getLatestKeepAliveTime() const { return _latestKeepAliveTime; }
 
+    /**
+     * 有服务进程退出, 唤醒线程立即检查
+     */
+    void notifyExit();
+
 	/**
 	 *
 	 * @return
@@ -80,6 +85,11 @@ protected:
      */
     void checkAlive();
 
+    /**
+     * 检查收到退出事件的服务
+     */
+    void checkExited();
+
     /**
      * 与registry 同步node上所属服务状态
      */
@@ -116,6 +126,8 @@ protected:
 	time_t 				_dockerLastUpdateTime = 0;
 
 	FrameworkKey		_fKey;
+
+    bool                _exitNotified;         //有服务进程退出, 需要立即检查
 private:
 
     vector<ServerStateInfo>     _stat;         //服务状态列表
@@ -0,0 +1,431 @@
+/**
+ * Tencent is pleased to support the open source community by making Tars available.
+ *
+ * Copyright (C) 2016THL A29 Limited, a Tencent company. All rights reserved.
+ *
+ * Licensed under the BSD 3-Clause License (the "License"); you may not use this file except 
+ * in compliance with the License. You may obtain a copy of the License at
+ *
+ * https://opensource.org/licenses/BSD-3-Clause
+ *
+ * Unless required by applicable law or agreed to in writing, software distributed 
+ * under the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR 
+ * CONDITIONS OF ANY KIND, either express or implied. See the License for the 
+ * specific language governing permissions and limitations under the License.
+ */
+
+
+#include "LogCleaner.h"
+#include <algorithm>
+#include <thread>
+#include "util/tc_file.h"
+#include "util/tc_common.h"
+#include "util/tc_timeprovider.h"
+#include "util.h"
+
+#if TARGET_PLATFORM_LINUX
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <dirent.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <string.h>
+#include <unistd.h>
+
+struct linux_dirent64
+{
+    ino64_t         d_ino;
+    off64_t         d_off;
+    unsigned short  d_reclen;
+    unsigned char   d_type;
+    char            d_name[];
+};
+
+#define IOPRIO_CLASS_IDLE       3
+#define IOPRIO_CLASS_SHIFT      13
+#define IOPRIO_WHO_PROCESS      1
+#endif
+
+LogCleaner::LogCleaner(int iFilesPerSecond, int64_t iBytesPerSecond, const bool *pStop)
+: _filesPerSecond(iFilesPerSecond)
+, _bytesPerSecond(iBytesPerSecond)
+, _stop(pStop)
+, _windowBegin(TNOWMS)
+, _windowFiles(0)
+, _windowBytes(0)
+, _removedFiles(0)
+, _removedBytes(0)
+{
+}
+
+void LogCleaner::setIdleIoPriority()
+{
+#if TARGET_PLATFORM_LINUX
+    //who为0时设置的是当前线程
+    if (syscall(SYS_ioprio_set, IOPRIO_WHO_PROCESS, 0, IOPRIO_CLASS_IDLE << IOPRIO_CLASS_SHIFT) != 0)
+    {
+        NODE_LOG("RemoveLogThread")->error() << FILE_FUN << "ioprio_set error:" << strerror(errno) << endl;
+    }
+#endif
+}
+
+void LogCleaner::throttle(int64_t iBytes)
+{
+    ++_removedFiles;
+    _removedBytes += iBytes;
+
+    ++_windowFiles;
+    _windowBytes += iBytes;
+
+    int64_t now = TNOWMS;
+    if (now - _windowBegin >= 1000)
+    {
+        _windowBegin = now;
+        _windowFiles = 0;
+        _windowBytes = 0;
+        return;
+    }
+
+    if ((_filesPerSecond > 0 && _windowFiles >= _filesPerSecond) || (_bytesPerSecond > 0 && _windowBytes >= _bytesPerSecond))
+    {
+        //本秒的配额用完, 等到下一秒, 期间检查是否需要退出
+        while (!stopped() && TNOWMS - _windowBegin < 1000)
+        {
+            std::this_thread::sleep_for(std::chrono::milliseconds(min<int64_t>(100, 1000 - (TNOWMS - _windowBegin))));
+        }
+
+        _windowBegin = TNOWMS;
+        _windowFiles = 0;
+        _windowBytes = 0;
+    }
+}
+
+#if TARGET_PLATFORM_LINUX
+int LogCleaner::removeAt(int parentFd, const char *name, bool bDir)
+{
+    if (!bDir)
+    {
+        struct stat st;
+        int64_t bytes = fstatat(parentFd, name, &st, AT_SYMLINK_NOFOLLOW) == 0 ? (int64_t)st.st_blocks * 512 : 0;
+
+        if (unlinkat(parentFd, name, 0) != 0 && errno != ENOENT)
+        {
+            return -1;
+        }
+
+        throttle(bytes);
+        return 0;
+    }
+
+    int fd = openat(parentFd, name, O_RDONLY | O_DIRECTORY | O_NOFOLLOW | O_CLOEXEC);
+    if (fd < 0)
+    {
+        return errno == ENOENT ? 0 : -1;
+    }
+
+    int ret = 0;
+    vector<char> buf(32 * 1024);
+
+    //边读边删, 一轮读完后从头再读一次, 直到某一轮没有删除任何文件
+    bool bRemoved = true;
+    while (bRemoved && !stopped())
+    {
+        bRemoved = false;
+        lseek(fd, 0, SEEK_SET);
+
+        long n;
+        while (!stopped() && (n = syscall(SYS_getdents64, fd, &buf[0], buf.size())) > 0)
+        {
+            for (long off = 0; off < n && !stopped(); )
+            {
+                linux_dirent64 *d = (linux_dirent64 *)(&buf[off]);
+                off += d->d_reclen;
+
+                if (strcmp(d->d_name, ".") == 0 || strcmp(d->d_name, "..") == 0)
+                {
+                    continue;
+                }
+
+                bool bSubDir = (d->d_type == DT_DIR);
+                if (d->d_type == DT_UNKNOWN)
+                {
+                    struct stat st;
+                    bSubDir = (fstatat(fd, d->d_name, &st, AT_SYMLINK_NOFOLLOW) == 0 && S_ISDIR(st.st_mode));
+                }
+
+                if (removeAt(fd, d->d_name, bSubDir) == 0)
+                {
+                    bRemoved = true;
+                }
+                else
+                {
+                    ret = -1;
+                }
+            }
+        }
+    }
+
+    close(fd);
+
+    if (stopped())
+    {
+        return -1;
+    }
+
+    if (unlinkat(parentFd, name, AT_REMOVEDIR) != 0 && errno != ENOENT)
+    {
+        return -1;
+    }
+
+    return ret;
+}
+
+size_t LogCleaner::scanAt(int dirFd, size_t iDir, time_t iMaxAge, time_t iActiveTime, time_t now, vector<LogDir> &vDir, vector<LogFile> &vLog)
+{
+    size_t removed = 0;
+    vector<char> buf(32 * 1024);
+
+    long n;
+    while (!stopped() && (n = syscall(SYS_getdents64, dirFd, &buf[0], buf.size())) > 0)
+    {
+        for (long off = 0; off < n && !stopped(); )
+        {
+            linux_dirent64 *d = (linux_dirent64 *)(&buf[off]);
+            off += d->d_reclen;
+
+            if (strcmp(d->d_name, ".") == 0 || strcmp(d->d_name, "..") == 0)
+            {
+                continue;
+            }
+
+            if (d->d_type == DT_DIR || d->d_type == DT_UNKNOWN)
+            {
+                int fd = openat(dirFd, d->d_name, O_RDONLY | O_DIRECTORY | O_NOFOLLOW | O_CLOEXEC);
+                if (fd >= 0)
+                {
+                    struct stat st;
+                    if (fstat(fd, &st) == 0)
+                    {
+                        LogDir ld;
+                        ld.path = vDir[iDir].path + d->d_name + "/";
+                        ld.dev  = st.st_dev;
+                        ld.ino  = st.st_ino;
+
+                        vDir.push_back(ld);
+                        removed += scanAt(fd, vDir.size() - 1, iMaxAge, iActiveTime, now, vDir, vLog);
+                    }
+                    close(fd);
+                    continue;
+                }
+            }
+
+            if (d->d_type != DT_REG && d->d_type != DT_UNKNOWN)
+            {
+                continue;
+            }
+
+            struct stat st;
+            if (fstatat(dirFd, d->d_name, &st, AT_SYMLINK_NOFOLLOW) != 0 || !S_ISREG(st.st_mode))
+            {
+                continue;
+            }
+
+            int64_t bytes = (int64_t)st.st_blocks * 512;
+
+            //最近修改过的文件可能还被服务打开着, 按时间删除时同样跳过
+            if (iMaxAge > 0 && now - st.st_mtime > iMaxAge && now - st.st_mtime >= iActiveTime)
+            {
+                if (unlinkat(dirFd, d->d_name, 0) == 0)
+                {
+                    ++removed;
+                    throttle(bytes);
+                }
+                continue;
+            }
+
+            LogFile lf;
+            lf.dir   = iDir;
+            lf.name  = d->d_name;
+            lf.mtime = st.st_mtime;
+            lf.bytes = bytes;
+
+            vLog.push_back(lf);
+        }
+    }
+
+    return removed;
+}
+
+int LogCleaner::openLogDir(int dirFd, const LogDir &dir)
+{
+    int fd = dup(dirFd);
+
+    vector<string> vItem = TC_Common::sepstr<string>(dir.path, "/");
+    for (size_t i = 0; i < vItem.size() && fd >= 0; i++)
+    {
+        //遍历之后被换成软链接的目录打开失败, 不会跟随到其它目录
+        int next = openat(fd, vItem[i].c_str(), O_RDONLY | O_DIRECTORY | O_NOFOLLOW | O_CLOEXEC);
+        close(fd);
+        fd = next;
+    }
+
+    struct stat st;
+    if (fd >= 0 && (fstat(fd, &st) != 0 || st.st_dev != dir.dev || st.st_ino != dir.ino))
+    {
+        close(fd);
+        fd = -1;
+    }
+
+    return fd;
+}
+#endif
+
+bool LogCleaner::isLink(const string &sPath)
+{
+#if TARGET_PLATFORM_LINUX
+    string sDir = TC_File::simplifyDirectory(sPath);
+    if (sDir.length() > 1 && sDir[sDir.length() - 1] == '/')
+    {
+        sDir.resize(sDir.length() - 1);
+    }
+
+    struct stat st;
+    return lstat(sDir.c_str(), &st) == 0 && S_ISLNK(st.st_mode);
+#else
+    return false;
+#endif
+}
+
+int LogCleaner::removeTree(const string &sPath)
+{
+#if TARGET_PLATFORM_LINUX
+    string sDir = TC_File::simplifyDirectory(sPath);
+    if (sDir.length() > 1 && sDir[sDir.length() - 1] == '/')
+    {
+        sDir.resize(sDir.length() - 1);
+    }
+
+    string sParent = TC_File::extractFilePath(sDir);
+    string sName   = TC_File::extractFileName(sDir);
+    if (sName.empty())
+    {
+        return -1;
+    }
+
+    int parentFd = open(sParent.empty() ? "." : sParent.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (parentFd < 0)
+    {
+        NODE_LOG("RemoveLogThread")->error() << FILE_FUN << "open " << sParent << " error:" << strerror(errno) << endl;
+        return -1;
+    }
+
+    //要删除的目录本身是软链接时(比如链接到其它磁盘), 只删除链接, 不跟随过去删除目标下的文件,
+    //链接可能指向共用的目录, 目标下的文件留给管理员处理
+    struct stat st;
+    if (fstatat(parentFd, sName.c_str(), &st, AT_SYMLINK_NOFOLLOW) == 0 && S_ISLNK(st.st_mode))
+    {
+        char target[PATH_MAX] = {0};
+        readlinkat(parentFd, sName.c_str(), target, sizeof(target) - 1);
+
+        int ret = unlinkat(parentFd, sName.c_str(), 0);
+        NODE_LOG("RemoveLogThread")->error() << FILE_FUN << sDir << " is a symlink to " << target << ", remove the link only"
+                                             << (ret == 0 ? "" : string(", error:") + strerror(errno)) << endl;
+        close(parentFd);
+        return ret == 0 ? 0 : -1;
+    }
+
+    int ret = removeAt(parentFd, sName.c_str(), true);
+
+    close(parentFd);
+
+    return ret;
+#else
+    return TC_File::removeFile(sPath, true);
+#endif
+}
+
+size_t LogCleaner::pruneDir(const string &sDir, time_t iMaxAge, int64_t iQuota, time_t iActiveTime)
+{
+    size_t removed = 0;
+
+#if TARGET_PLATFORM_LINUX
+    if (iMaxAge <= 0 && iQuota <= 0)
+    {
+        return 0;
+    }
+
+    int dirFd = open(sDir.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (dirFd < 0)
+    {
+        return 0;
+    }
+
+    //与removeTree一样按fd遍历, 不先生成整棵树的路径列表再逐个lstat
+    vector<LogDir> vDir(1);
+    vector<LogFile> vLog;
+    time_t now = TNOW;
+
+    struct stat st;
+    if (fstat(dirFd, &st) != 0)
+    {
+        close(dirFd);
+        return 0;
+    }
+
+    vDir[0].dev = st.st_dev;
+    vDir[0].ino = st.st_ino;
+
+    removed = scanAt(dirFd, 0, iMaxAge, iActiveTime, now, vDir, vLog);
+
+    int64_t total = 0;
+    for (size_t i = 0; i < vLog.size(); i++)
+    {
+        total += vLog[i].bytes;
+    }
+
+    if (iQuota > 0 && total > iQuota)
+    {
+        std::sort(vLog.begin(), vLog.end());
+
+        //按文件名在所在目录的fd上删除, 不用多级的相对路径, 中间的目录换成软链接也不会删到日志目录之外
+        //按时间排序后同一个目录的文件通常是连续的, 上一个打开的目录留着复用
+        size_t openDir = 0;
+        int openFd     = dirFd;
+
+        for (size_t i = 0; i < vLog.size() && total > iQuota && !stopped(); i++)
+        {
+            if (now - vLog[i].mtime < iActiveTime)
+            {
+                break;
+            }
+
+            if (vLog[i].dir != openDir)
+            {
+                if (openFd >= 0 && openFd != dirFd)
+                {
+                    close(openFd);
+                }
+
+                openDir = vLog[i].dir;
+                openFd  = openLogDir(dirFd, vDir[openDir]);
+            }
+
+            if (openFd >= 0 && unlinkat(openFd, vLog[i].name.c_str(), 0) == 0)
+            {
+                ++removed;
+                total -= vLog[i].bytes;
+                throttle(vLog[i].bytes);
+            }
+        }
+
+        if (openFd >= 0 && openFd != dirFd)
+        {
+            close(openFd);
+        }
+    }
+
+    close(dirFd);
+#endif
+
+    return removed;
+}
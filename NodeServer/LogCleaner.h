@@ -0,0 +1,146 @@
+/**
+ * Tencent is pleased to support the open source community by making Tars available.
+ *
+ * Copyright (C) 2016THL A29 Limited, a Tencent company. All rights reserved.
+ *
+ * Licensed under the BSD 3-Clause License (the "License"); you may not use this file except 
+ * in compliance with the License. You may obtain a copy of the License at
+ *
+ * https://opensource.org/licenses/BSD-3-Clause
+ *
+ * Unless required by applicable law or agreed to in writing, software distributed 
+ * under the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR 
+ * CONDITIONS OF ANY KIND, either express or implied. See the License for the 
+ * specific language governing permissions and limitations under the License.
+ */
+
+
+#ifndef __LOG_CLEANER_H_
+#define __LOG_CLEANER_H_
+
+#include <string>
+#include <vector>
+#include "util/tc_platform.h"
+
+#if TARGET_PLATFORM_LINUX
+#include <sys/types.h>
+#endif
+
+using namespace std;
+
+/**
+ * 限速删除文件
+ * 目录用getdents64分批读取, 文件用unlinkat删除, 每秒删除的文件数和字节数(按实际占用的块计算)超过配额时等待到下一秒,
+ * 避免一次删除大量小文件时占满磁盘io, 影响同一台机器上的服务.
+ * 非linux平台直接调用TC_File删除, 不限速.
+ */
+class LogCleaner
+{
+public:
+    /**
+     * @param iFilesPerSecond 每秒最多删除的文件数, <=0不限制
+     * @param iBytesPerSecond 每秒最多删除的字节数, <=0不限制
+     * @param pStop 不为NULL且为true时尽快退出
+     */
+    LogCleaner(int iFilesPerSecond, int64_t iBytesPerSecond, const bool *pStop);
+
+    /**
+     * 把当前线程的io优先级设置为idle, 只在磁盘空闲时才做io
+     */
+    static void setIdleIoPriority();
+
+    /**
+     * 删除目录及其下的所有文件
+     * 目录本身是软链接时只删除链接, 不删除链接目标下的文件
+     * @return 0: 成功, -1: 有文件删除失败或者中途退出
+     */
+    int removeTree(const string &sPath);
+
+    /**
+     * 路径本身是否是软链接
+     */
+    static bool isLink(const string &sPath);
+
+    /**
+     * 清理一个服务的日志目录
+     * 先删除修改时间超过iMaxAge秒的文件, 剩余文件总大小超过iQuota时从最旧的开始删除,
+     * 最近iActiveTime秒内修改过的文件认为还在写, 两种方式都不删除
+     * @param iMaxAge <=0不按时间删除
+     * @param iQuota <=0不按大小删除
+     * @return 删除的文件数
+     */
+    size_t pruneDir(const string &sDir, time_t iMaxAge, int64_t iQuota, time_t iActiveTime);
+
+    /**
+     * 累计删除的文件数和字节数
+     */
+    size_t getRemovedFiles() const { return _removedFiles; }
+
+    int64_t getRemovedBytes() const { return _removedBytes; }
+
+protected:
+    bool stopped() const { return _stop && *_stop; }
+
+    /**
+     * 删除一个文件后调用, 超过配额时等待
+     */
+    void throttle(int64_t iBytes);
+
+#if TARGET_PLATFORM_LINUX
+    /**
+     * 删除parentFd下的name, bDir时先删除其下的所有文件
+     */
+    int removeAt(int parentFd, const char *name, bool bDir);
+
+    //遍历时经过的目录, 按大小删除时重新逐级打开, 用dev和ino确认还是同一个目录
+    struct LogDir
+    {
+        string  path;       //相对日志目录的路径, 以/结尾, 日志目录本身为空
+        dev_t   dev;
+        ino_t   ino;
+    };
+
+    struct LogFile
+    {
+        size_t  dir;        //所在目录在vDir中的下标
+        string  name;
+        time_t  mtime;
+        int64_t bytes;
+
+        bool operator<(const LogFile &r) const { return mtime < r.mtime; }
+    };
+
+    /**
+     * 遍历dirFd下的所有文件, 超时的直接删除, 其余的记录到vLog
+     * @param iDir dirFd在vDir中的下标
+     * @return 删除的文件数
+     */
+    size_t scanAt(int dirFd, size_t iDir, time_t iMaxAge, time_t iActiveTime, time_t now, vector<LogDir> &vDir, vector<LogFile> &vLog);
+
+    /**
+     * 从日志目录开始逐级打开(不跟随软链接)遍历时记录的目录
+     * @return 目录的fd, 目录不存在或者已经不是遍历时的那个目录时返回-1
+     */
+    int openLogDir(int dirFd, const LogDir &dir);
+#endif
+
+protected:
+    int             _filesPerSecond;
+
+    int64_t         _bytesPerSecond;
+
+    const bool      *_stop;
+
+    //当前一秒的开始时间和已经删除的量
+    int64_t         _windowBegin;
+
+    int             _windowFiles;
+
+    int64_t         _windowBytes;
+
+    size_t          _removedFiles;
+
+    int64_t         _removedBytes;
+};
+
+#endif
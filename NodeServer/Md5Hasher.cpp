@@ -0,0 +1,199 @@
+/**
+ * Tencent is pleased to support the open source community by making Tars available.
+ *
+ * Copyright (C) 2016THL A29 Limited, a Tencent company. All rights reserved.
+ *
+ * Licensed under the BSD 3-Clause License (the "License"); you may not use this file except 
+ * in compliance with the License. You may obtain a copy of the License at
+ *
+ * https://opensource.org/licenses/BSD-3-Clause
+ *
+ * Unless required by applicable law or agreed to in writing, software distributed 
+ * under the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR 
+ * CONDITIONS OF ANY KIND, either express or implied. See the License for the 
+ * specific language governing permissions and limitations under the License.
+ */
+
+#include "Md5Hasher.h"
+#include <string.h>
+
+#define MD5_F(x, y, z) (((x) & (y)) | (~(x) & (z)))
+#define MD5_G(x, y, z) (((x) & (z)) | ((y) & ~(z)))
+#define MD5_H(x, y, z) ((x) ^ (y) ^ (z))
+#define MD5_I(x, y, z) ((y) ^ ((x) | ~(z)))
+
+#define MD5_ROTATE_LEFT(x, n) (((x) << (n)) | ((x) >> (32 - (n))))
+
+#define MD5_STEP(f, a, b, c, d, x, s, ac) \
+    (a) += f((b), (c), (d)) + (x) + (uint32_t)(ac); \
+    (a) = MD5_ROTATE_LEFT((a), (s)); \
+    (a) += (b);
+
+Md5Hasher::Md5Hasher()
+{
+    reset();
+}
+
+void Md5Hasher::reset()
+{
+    _state[0] = 0x67452301;
+    _state[1] = 0xefcdab89;
+    _state[2] = 0x98badcfe;
+    _state[3] = 0x10325476;
+    _bytes    = 0;
+}
+
+void Md5Hasher::update(const void *data, size_t len)
+{
+    const unsigned char *input = static_cast<const unsigned char *>(data);
+
+    size_t index = static_cast<size_t>(_bytes & 63);
+    _bytes += len;
+
+    //先补齐上次剩余的不完整块
+    if (index > 0)
+    {
+        size_t fill = 64 - index;
+        if (len < fill)
+        {
+            memcpy(_buffer + index, input, len);
+            return;
+        }
+
+        memcpy(_buffer + index, input, fill);
+        transform(_buffer);
+        input += fill;
+        len   -= fill;
+    }
+
+    while (len >= 64)
+    {
+        transform(input);
+        input += 64;
+        len   -= 64;
+    }
+
+    if (len > 0)
+    {
+        memcpy(_buffer, input, len);
+    }
+}
+
+string Md5Hasher::final()
+{
+    uint64_t bits = _bytes << 3;
+
+    unsigned char padding[72] = { 0x80 };
+    size_t index  = static_cast<size_t>(_bytes & 63);
+    size_t padLen = (index < 56) ? (56 - index) : (120 - index);
+
+    unsigned char length[8];
+    for (int i = 0; i < 8; i++)
+    {
+        length[i] = static_cast<unsigned char>(bits >> (8 * i));
+    }
+
+    update(padding, padLen);
+    update(length, 8);
+
+    static const char *hex = "0123456789abcdef";
+
+    string result(32, '0');
+    for (int i = 0; i < 16; i++)
+    {
+        unsigned char v = static_cast<unsigned char>(_state[i / 4] >> (8 * (i % 4)));
+        result[i * 2]     = hex[v >> 4];
+        result[i * 2 + 1] = hex[v & 0x0f];
+    }
+
+    reset();
+
+    return result;
+}
+
+void Md5Hasher::transform(const unsigned char block[64])
+{
+    uint32_t a = _state[0];
+    uint32_t b = _state[1];
+    uint32_t c = _state[2];
+    uint32_t d = _state[3];
+
+    uint32_t x[16];
+    for (int i = 0; i < 16; i++)
+    {
+        x[i] = (uint32_t)block[i * 4] | ((uint32_t)block[i * 4 + 1] << 8) | ((uint32_t)block[i * 4 + 2] << 16) | ((uint32_t)block[i * 4 + 3] << 24);
+    }
+
+    MD5_STEP(MD5_F, a, b, c, d, x[ 0],  7, 0xd76aa478)
+    MD5_STEP(MD5_F, d, a, b, c, x[ 1], 12, 0xe8c7b756)
+    MD5_STEP(MD5_F, c, d, a, b, x[ 2], 17, 0x242070db)
+    MD5_STEP(MD5_F, b, c, d, a, x[ 3], 22, 0xc1bdceee)
+    MD5_STEP(MD5_F, a, b, c, d, x[ 4],  7, 0xf57c0faf)
+    MD5_STEP(MD5_F, d, a, b, c, x[ 5], 12, 0x4787c62a)
+    MD5_STEP(MD5_F, c, d, a, b, x[ 6], 17, 0xa8304613)
+    MD5_STEP(MD5_F, b, c, d, a, x[ 7], 22, 0xfd469501)
+    MD5_STEP(MD5_F, a, b, c, d, x[ 8],  7, 0x698098d8)
+    MD5_STEP(MD5_F, d, a, b, c, x[ 9], 12, 0x8b44f7af)
+    MD5_STEP(MD5_F, c, d, a, b, x[10], 17, 0xffff5bb1)
+    MD5_STEP(MD5_F, b, c, d, a, x[11], 22, 0x895cd7be)
+    MD5_STEP(MD5_F, a, b, c, d, x[12],  7, 0x6b901122)
+    MD5_STEP(MD5_F, d, a, b, c, x[13], 12, 0xfd987193)
+    MD5_STEP(MD5_F, c, d, a, b, x[14], 17, 0xa679438e)
+    MD5_STEP(MD5_F, b, c, d, a, x[15], 22, 0x49b40821)
+
+    MD5_STEP(MD5_G, a, b, c, d, x[ 1],  5, 0xf61e2562)
+    MD5_STEP(MD5_G, d, a, b, c, x[ 6],  9, 0xc040b340)
+    MD5_STEP(MD5_G, c, d, a, b, x[11], 14, 0x265e5a51)
+    MD5_STEP(MD5_G, b, c, d, a, x[ 0], 20, 0xe9b6c7aa)
+    MD5_STEP(MD5_G, a, b, c, d, x[ 5],  5, 0xd62f105d)
+    MD5_STEP(MD5_G, d, a, b, c, x[10],  9, 0x02441453)
+    MD5_STEP(MD5_G, c, d, a, b, x[15], 14, 0xd8a1e681)
+    MD5_STEP(MD5_G, b, c, d, a, x[ 4], 20, 0xe7d3fbc8)
+    MD5_STEP(MD5_G, a, b, c, d, x[ 9],  5, 0x21e1cde6)
+    MD5_STEP(MD5_G, d, a, b, c, x[14],  9, 0xc33707d6)
+    MD5_STEP(MD5_G, c, d, a, b, x[ 3], 14, 0xf4d50d87)
+    MD5_STEP(MD5_G, b, c, d, a, x[ 8], 20, 0x455a14ed)
+    MD5_STEP(MD5_G, a, b, c, d, x[13],  5, 0xa9e3e905)
+    MD5_STEP(MD5_G, d, a, b, c, x[ 2],  9, 0xfcefa3f8)
+    MD5_STEP(MD5_G, c, d, a, b, x[ 7], 14, 0x676f02d9)
+    MD5_STEP(MD5_G, b, c, d, a, x[12], 20, 0x8d2a4c8a)
+
+    MD5_STEP(MD5_H, a, b, c, d, x[ 5],  4, 0xfffa3942)
+    MD5_STEP(MD5_H, d, a, b, c, x[ 8], 11, 0x8771f681)
+    MD5_STEP(MD5_H, c, d, a, b, x[11], 16, 0x6d9d6122)
+    MD5_STEP(MD5_H, b, c, d, a, x[14], 23, 0xfde5380c)
+    MD5_STEP(MD5_H, a, b, c, d, x[ 1],  4, 0xa4beea44)
+    MD5_STEP(MD5_H, d, a, b, c, x[ 4], 11, 0x4bdecfa9)
+    MD5_STEP(MD5_H, c, d, a, b, x[ 7], 16, 0xf6bb4b60)
+    MD5_STEP(MD5_H, b, c, d, a, x[10], 23, 0xbebfbc70)
+    MD5_STEP(MD5_H, a, b, c, d, x[13],  4, 0x289b7ec6)
+    MD5_STEP(MD5_H, d, a, b, c, x[ 0], 11, 0xeaa127fa)
+    MD5_STEP(MD5_H, c, d, a, b, x[ 3], 16, 0xd4ef3085)
+    MD5_STEP(MD5_H, b, c, d, a, x[ 6], 23, 0x04881d05)
+    MD5_STEP(MD5_H, a, b, c, d, x[ 9],  4, 0xd9d4d039)
+    MD5_STEP(MD5_H, d, a, b, c, x[12], 11, 0xe6db99e5)
+    MD5_STEP(MD5_H, c, d, a, b, x[15], 16, 0x1fa27cf8)
+    MD5_STEP(MD5_H, b, c, d, a, x[ 2], 23, 0xc4ac5665)
+
+    MD5_STEP(MD5_I, a, b, c, d, x[ 0],  6, 0xf4292244)
+    MD5_STEP(MD5_I, d, a, b, c, x[ 7], 10, 0x432aff97)
+    MD5_STEP(MD5_I, c, d, a, b, x[14], 15, 0xab9423a7)
+    MD5_STEP(MD5_I, b, c, d, a, x[ 5], 21, 0xfc93a039)
+    MD5_STEP(MD5_I, a, b, c, d, x[12],  6, 0x655b59c3)
+    MD5_STEP(MD5_I, d, a, b, c, x[ 3], 10, 0x8f0ccc92)
+    MD5_STEP(MD5_I, c, d, a, b, x[10], 15, 0xffeff47d)
+    MD5_STEP(MD5_I, b, c, d, a, x[ 1], 21, 0x85845dd1)
+    MD5_STEP(MD5_I, a, b, c, d, x[ 8],  6, 0x6fa87e4f)
+    MD5_STEP(MD5_I, d, a, b, c, x[15], 10, 0xfe2ce6e0)
+    MD5_STEP(MD5_I, c, d, a, b, x[ 6], 15, 0xa3014314)
+    MD5_STEP(MD5_I, b, c, d, a, x[13], 21, 0x4e0811a1)
+    MD5_STEP(MD5_I, a, b, c, d, x[ 4],  6, 0xf7537e82)
+    MD5_STEP(MD5_I, d, a, b, c, x[11], 10, 0xbd3af235)
+    MD5_STEP(MD5_I, c, d, a, b, x[ 2], 15, 0x2ad7d2bb)
+    MD5_STEP(MD5_I, b, c, d, a, x[ 9], 21, 0xeb86d391)
+
+    _state[0] += a;
+    _state[1] += b;
+    _state[2] += c;
+    _state[3] += d;
+}
@@ -0,0 +1,59 @@
+/**
+ * Tencent is pleased to support the open source community by making Tars available.
+ *
+ * Copyright (C) 2016THL A29 Limited, a Tencent company. All rights reserved.
+ *
+ * Licensed under the BSD 3-Clause License (the "License"); you may not use this file except 
+ * in compliance with the License. You may obtain a copy of the License at
+ *
+ * https://opensource.org/licenses/BSD-3-Clause
+ *
+ * Unless required by applicable law or agreed to in writing, software distributed 
+ * under the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR 
+ * CONDITIONS OF ANY KIND, either express or implied. See the License for the 
+ * specific language governing permissions and limitations under the License.
+ */
+
+#ifndef __MD5_HASHER_H_
+#define __MD5_HASHER_H_
+
+#include <string>
+#include <stdint.h>
+#include <stddef.h>
+
+using namespace std;
+
+/**
+ * 增量计算md5, 下载过程中边收数据边计算, 不需要下载完后再读一遍文件
+ * 结果与TC_MD5::md5file一致(小写16进制)
+ */
+class Md5Hasher
+{
+public:
+    Md5Hasher();
+
+    /**
+     * 重新开始计算
+     */
+    void reset();
+
+    /**
+     * 追加数据
+     */
+    void update(const void *data, size_t len);
+
+    /**
+     * 结束计算, 返回32位小写16进制字符串
+     */
+    string final();
+
+protected:
+    void transform(const unsigned char block[64]);
+
+protected:
+    uint32_t        _state[4];
+    uint64_t        _bytes;
+    unsigned char   _buffer[64];
+};
+
+#endif
@@ -17,6 +17,9 @@
 #include "NodeServer.h"
 //#include "NodeImp.h"
 #include "ServerImp.h"
+#include "PeerPatchImp.h"
+#include "StatAggregateImp.h"
+#include "PropertyAggregateImp.h"
 #include "RegistryProxy.h"
 #include "servant/CommunicatorFactory.h"
 #include "util/tc_md5.h"
@@ -49,6 +52,37 @@ void NodeServer::initialize()
     addServant<ServerImp>(sServerObj);
 
     TLOG_DEBUG("NodeServer::initialize ServerAdapter " << (getAdapterEndpoint("ServerAdapter")).toString() << endl);
+
+    //配置了PatchAdapter时, 向其它节点提供本节点已有的发布包
+    if (!g_pconf->get("/tars/application/server/PatchAdapter<servant>", "").empty())
+    {
+        addServant<PeerPatchImp>(ServerConfig::Application + "." + ServerConfig::ServerName + ".PatchObj");
+
+        TLOG_DEBUG("NodeServer::initialize PatchAdapter " << (getAdapterEndpoint("PatchAdapter")).toString() << endl);
+    }
+
+    //配置了StatAdapter/PropertyAdapter时, 合并本机服务的调用统计和属性上报, 每个周期批量上报一次
+    bool bStat      = !g_pconf->get("/tars/application/server/StatAdapter<servant>", "").empty();
+    bool bProperty  = !g_pconf->get("/tars/application/server/PropertyAdapter<servant>", "").empty();
+    if (bStat || bProperty)
+    {
+        _reportAggregateThread = new ReportAggregateThread();
+        _reportAggregateThread->start();
+    }
+
+    if (bStat)
+    {
+        addServant<StatAggregateImp>(ServerConfig::Application + "." + ServerConfig::ServerName + ".StatObj");
+
+        TLOG_DEBUG("NodeServer::initialize StatAdapter " << (getAdapterEndpoint("StatAdapter")).toString() << endl);
+    }
+
+    if (bProperty)
+    {
+        addServant<PropertyAggregateImp>(ServerConfig::Application + "." + ServerConfig::ServerName + ".PropertyObj");
+
+        TLOG_DEBUG("NodeServer::initialize PropertyAdapter " << (getAdapterEndpoint("PropertyAdapter")).toString() << endl);
+    }
 //    TLOG_DEBUG("NodeServer::initialize NodeAdapter "   << (getAdapterEndpoint("NodeAdapter")).toString() << endl);
 
 //    g_sNodeIp = getAdapterEndpoint("NodeAdapter").getHost();
@@ -70,6 +104,41 @@ void NodeServer::initialize()
 	_dockerSocket = g_pconf->get("/tars/node/container<socket>", "/var/run/docker.sock");
 	_dockerPullTimeout = TC_Common::strto<int>(g_pconf->get("/tars/node/container<timeout>", "300"));
 
+#if TARGET_PLATFORM_LINUX
+    //先于KeepAliveThread启动, 第一次检查服务时就可以开始监听
+    _processWatchThread = new ProcessWatchThread();
+    _processWatchThread->start();
+
+    TLOG_DEBUG("NodeServer::initialize |ProcessWatchThread start" << endl);
+#endif
+
+#if !TARGET_PLATFORM_WINDOWS
+    //共享内存心跳表, 服务直接写心跳时间, 不再需要每个adapter调用keepAlive
+    if (g_pconf->get("/tars/node/keepalive<heartbeatShm>", "N") == "Y")
+    {
+        uint32_t iSlots = TC_Common::strto<uint32_t>(g_pconf->get("/tars/node/keepalive<heartbeatSlots>", "4096"));
+
+        _heartbeatShm = new HeartbeatShm();
+        if (!_heartbeatShm->init(ServerConfig::DataPath + FILE_SEP + "heartbeat.shm", iSlots))
+        {
+            delete _heartbeatShm;
+            _heartbeatShm = NULL;
+        }
+    }
+#endif
+
+    //先于KeepAliveThread启动, 需要自动拉起的服务由多个线程并发启动
+    int iStartThreads   = TC_Common::strto<int>(g_pconf->get("/tars/node/keepalive<startThreads>", "8"));
+    if (iStartThreads < 1)
+    {
+        iStartThreads = 1;
+    }
+
+    _autoStart = new AutoStart();
+    _autoStart->start(iStartThreads, g_pconf->get("/tars/node/keepalive<startOrder>", "tars.*"));
+
+    TLOG_DEBUG("NodeServer::initialize |AutoStartThread start(" << iStartThreads << ")" << endl);
+
     //启动KeepAliveThread
     _keepAliveThread   = new KeepAliveThread();
     _keepAliveThread->start();
@@ -234,6 +303,32 @@ void NodeServer::destroyApp()
         _keepAliveThread = NULL;
     }
 
+    if (_autoStart)
+    {
+        delete _autoStart;
+        _autoStart = NULL;
+    }
+
+    if (_reportAggregateThread)
+    {
+        delete _reportAggregateThread;
+        _reportAggregateThread = NULL;
+    }
+
+    if (_heartbeatShm)
+    {
+        delete _heartbeatShm;
+        _heartbeatShm = NULL;
+    }
+
+#if TARGET_PLATFORM_LINUX
+    if (_processWatchThread)
+    {
+        delete _processWatchThread;
+        _processWatchThread = NULL;
+    }
+#endif
+
     if (_reportMemThread)
     {
         delete _reportMemThread;
@@ -19,11 +19,15 @@
 
 #include "servant/Application.h"
 #include "KeepAliveThread.h"
+#include "ProcessWatchThread.h"
 #include "ReportMemThread.h"
 #include "DockerPullThread.h"
 #include "QueryF.h"
 #include "BatchPatchThread.h"
 #include "RemoveLogThread.h"
+#include "AutoStartThread.h"
+#include "HeartbeatShm.h"
+#include "ReportAggregateThread.h"
 #include "util.h"
 
 using namespace tars;
@@ -84,6 +88,30 @@ public:
 	 */
     KeepAliveThread* getKeepAliveThread() { return _keepAliveThread; }
 
+	/**
+	 * 进程退出事件监听线程, 只在linux下启动, 其它平台返回NULL
+	 * @return
+	 */
+	ProcessWatchThread *getProcessWatchThread() { return _processWatchThread; }
+
+	/**
+	 * 服务自动启动调度, 保活线程发现需要自动拉起的服务时放入
+	 * @return
+	 */
+	AutoStart *getAutoStart() { return _autoStart; }
+
+	/**
+	 * 共享内存心跳表, 没有开启时返回NULL
+	 * @return
+	 */
+	HeartbeatShm *getHeartbeatShm() { return _heartbeatShm; }
+
+	/**
+	 * 本机服务调用统计和属性上报的汇聚线程, 没有配置StatAdapter/PropertyAdapter时返回NULL
+	 * @return
+	 */
+	ReportAggregateThread *getReportAggregateThread() { return _reportAggregateThread; }
+
 	/**
 	 * 获取docker拉取线程
 	 * @return
@@ -137,7 +165,11 @@ private:
 
 private:
     KeepAliveThread *   _keepAliveThread;
+    ProcessWatchThread * _processWatchThread = NULL;
     ReportMemThread *    _reportMemThread;
+    AutoStart *          _autoStart = NULL;
+    HeartbeatShm *       _heartbeatShm = NULL;
+    ReportAggregateThread * _reportAggregateThread = NULL;
 
     BatchPatch *        _batchPatchThread;
     RemoveLogManager *  _removeLogThread;
@@ -0,0 +1,180 @@
+/**
+ * Tencent is pleased to support the open source community by making Tars available.
+ *
+ * Copyright (C) 2016THL A29 Limited, a Tencent company. All rights reserved.
+ *
+ * Licensed under the BSD 3-Clause License (the "License"); you may not use this file except 
+ * in compliance with the License. You may obtain a copy of the License at
+ *
+ * https://opensource.org/licenses/BSD-3-Clause
+ *
+ * Unless required by applicable law or agreed to in writing, software distributed 
+ * under the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR 
+ * CONDITIONS OF ANY KIND, either express or implied. See the License for the 
+ * specific language governing permissions and limitations under the License.
+ */
+
+#include "PeerPatchImp.h"
+#include "SingleFileDownloader.h"
+#include "PlatformInfo.h"
+#include "NodeServer.h"
+#include "util.h"
+#include "tars_range.h"
+
+//范围下载每次最多返回的大小
+#define PEER_RANGE_MAX (16 * 1024 * 1024)
+
+void PeerPatchImp::initialize()
+{
+    PlatformInfo plat;
+    _storePath = plat.getDownLoadDir() + FILE_SEP + "BatchPatchingStore";
+    _size      = TC_Common::toSize(g_pconf->get("/tars/node<downloadChunkSize>", DOWNLOAD_CHUNK_SIZE), 1024*1024);
+
+    //没有限制来源时任何人都可以来拉包, 不对外提供
+    _enabled   = !TC_Common::trim(g_pconf->get("/tars/application/server/PatchAdapter<allow>", "")).empty();
+    if (!_enabled)
+    {
+        TLOG_ERROR("PeerPatchImp::initialize PatchAdapter has no allow list, peer patch disabled" << endl);
+    }
+
+    TLOG_DEBUG("PeerPatchImp::initialize store:" << _storePath << "|size:" << _size << "|enabled:" << _enabled << endl);
+}
+
+string PeerPatchImp::getStoreFile(const string &md5)
+{
+    if (md5.length() != 32 || md5.find_first_not_of("0123456789abcdef") != string::npos)
+    {
+        return "";
+    }
+
+    return _storePath + FILE_SEP + md5;
+}
+
+int PeerPatchImp::listFileInfo(const string &path, vector<FileInfo> &vf, CurrentPtr current)
+{
+    if (!_enabled)
+    {
+        return PEER_PATCH_DISABLED;
+    }
+
+    string file = getStoreFile(path);
+    if (file.empty())
+    {
+        NODE_LOG("patchPro")->error() << "PeerPatchImp::listFileInfo ip:" << current->getHostName() << "|invalid path:" << path << endl;
+        return -1;
+    }
+
+    if (!TC_File::isFileExist(file))
+    {
+        //差量还原出来的是tar, md5和发布包对不上, 让对方直接换下一个源
+        if (TC_File::isFileExist(file + ".tar"))
+        {
+            return PEER_PATCH_NO_PACKAGE;
+        }
+
+        //正在下载时.part最近有写入, 让对方等待
+        //.part是预先分配好大小的, 用.part.ranges的大小表示进度(每完成一个块追加一行), 对方据此判断下载是否还在进行
+        string partFile = file + ".part";
+        struct stat st;
+        if (::stat(partFile.c_str(), &st) == 0 && TNOW - st.st_mtime < 30)
+        {
+            FileInfo fi;
+            fi.path     = path;
+            fi.size     = TC_File::isFileExist(partFile + ".ranges") ? TC_File::getFileSize(partFile + ".ranges") : 0;
+            fi.canExec  = false;
+
+            vf.push_back(fi);
+
+            return PEER_PATCH_DOWNLOADING;
+        }
+
+        //自己也在等上游的节点, 返回上游的进度
+        string waitFile = file + ".wait";
+        if (::stat(waitFile.c_str(), &st) == 0 && TNOW - st.st_mtime < 30)
+        {
+            FileInfo fi;
+            fi.path     = path;
+            fi.size     = TC_Common::strto<int64_t>(TC_File::load2str(waitFile));
+            fi.canExec  = false;
+
+            vf.push_back(fi);
+
+            return PEER_PATCH_DOWNLOADING;
+        }
+
+        return PEER_PATCH_NOT_FOUND;
+    }
+
+    FileInfo fi;
+    fi.path     = path;
+    fi.size     = TC_File::getFileSize(file);
+    fi.canExec  = false;
+    fi.md5      = path;
+
+    vf.push_back(fi);
+
+    NODE_LOG("patchPro")->debug() << "PeerPatchImp::listFileInfo ip:" << current->getHostName() << "|file:" << file << "|size:" << fi.size << endl;
+
+    return 1;
+}
+
+int PeerPatchImp::download(const string &file, int pos, vector<char> &vb, CurrentPtr current)
+{
+    string path = getStoreFile(file);
+    if (!_enabled || path.empty())
+    {
+        return -1;
+    }
+
+    size_t offset   = pos;
+    size_t size     = _size;
+    bool withInfo   = false;
+    size_t rangePos = 0;
+    size_t rangeLen = 0;
+    if (TarsRange::getRequest(current->getContext(), rangePos, rangeLen, withInfo))
+    {
+        offset  = rangePos;
+        size    = rangeLen == 0 ? _size : std::min(rangeLen, std::max(_size, (size_t)PEER_RANGE_MAX));
+    }
+    else if (pos < 0)
+    {
+        return -1;
+    }
+
+    FILE *fp = fopen(path.c_str(), "rb");
+    if (fp == NULL)
+    {
+        NODE_LOG("patchPro")->error() << "PeerPatchImp::download file:" << path << "|pos:" << offset << "|open file error:" << strerror(errno) << endl;
+        return -1;
+    }
+
+    if (fseek(fp, offset, SEEK_SET) == -1)
+    {
+        fclose(fp);
+        return -2;
+    }
+
+    //仓库中的文件名就是md5
+    if (withInfo)
+    {
+        map<string, string> rspContext;
+        TarsRange::setFileInfo(rspContext, TC_File::getFileSize(path), file);
+        current->setResponseContext(rspContext);
+    }
+
+    vb.resize(size);
+    size_t r = fread(&vb[0], 1, size, fp);
+    bool eof = feof(fp);
+    fclose(fp);
+
+    if (r > 0)
+    {
+        vb.resize(r);
+        return 0;
+    }
+
+    vb.clear();
+
+    //到文件末尾了
+    return eof ? 1 : -3;
+}
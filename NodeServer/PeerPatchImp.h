@@ -0,0 +1,91 @@
+/**
+ * Tencent is pleased to support the open source community by making Tars available.
+ *
+ * Copyright (C) 2016THL A29 Limited, a Tencent company. All rights reserved.
+ *
+ * Licensed under the BSD 3-Clause License (the "License"); you may not use this file except 
+ * in compliance with the License. You may obtain a copy of the License at
+ *
+ * https://opensource.org/licenses/BSD-3-Clause
+ *
+ * Unless required by applicable law or agreed to in writing, software distributed 
+ * under the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR 
+ * CONDITIONS OF ANY KIND, either express or implied. See the License for the 
+ * specific language governing permissions and limitations under the License.
+ */
+
+#ifndef __PEER_PATCH_IMP_H_
+#define __PEER_PATCH_IMP_H_
+
+#include "Patch.h"
+
+using namespace tars;
+
+/**
+ * 节点间分发发布包
+ * 实现patch的下载接口, 只对外提供本节点发布包仓库(BatchPatchingStore)中已校验过的包,
+ * 文件名就是包的md5, 其它节点发布同一个包时可以从这里下载, 不用都去patch下载
+ * PatchAdapter必须配置allow(各节点的ip), 没有配置时不提供任何包;
+ * 下载方收到的数据在整个文件md5校验通过前都不使用
+ */
+class PeerPatchImp : public Patch
+{
+public:
+    /**
+     * 初始化
+     */
+    virtual void initialize();
+
+    /**
+     * 退出
+     */
+    virtual void destroy() {};
+
+    /**
+     * 获取发布包的文件信息
+     * @param path, 发布包的md5
+     * @return int, 1: 成功, PEER_PATCH_DOWNLOADING: 本节点正在下载, PEER_PATCH_DISABLED: 没有配置allow, PEER_PATCH_NOT_FOUND: 还没有这个包, 其它<0: 参数错误
+     */
+    int listFileInfo(const string &path, vector<FileInfo> &vf, CurrentPtr current);
+
+    /**
+     * 下载发布包
+     * @param file, 发布包的md5
+     * @param pos, 从什么位置开始下载, context中带了范围参数(见TarsRange)时以范围参数为准
+     * @return int, 0: 成功, 1: 已到文件末尾, <0: 失败
+     */
+    int download(const string &file, int pos, vector<char> &vb, CurrentPtr current);
+
+    /**
+     * 节点上不支持
+     */
+    int preparePatchFile(const string &app, const string &serverName, const string &patchFile, string &result, CurrentPtr current) { return -1; }
+
+    int deletePatchFile(const string &app, const string &serverName, const string &patchFile, CurrentPtr current) { return -1; }
+
+    int upload(const std::string &app, const std::string &serverName, const tars::FileContent &content, CurrentPtr current) { return -1; }
+
+protected:
+    /**
+     * 仓库中的文件, md5不合法时返回空
+     */
+    string getStoreFile(const string &md5);
+
+protected:
+    /**
+     * 发布包仓库目录
+     */
+    string _storePath;
+
+    /**
+     * 每次下载的大小
+     */
+    size_t _size;
+
+    /**
+     * PatchAdapter是否配置了allow
+     */
+    bool   _enabled;
+};
+
+#endif
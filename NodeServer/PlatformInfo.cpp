@@ -18,6 +18,7 @@
 #include "util/tc_clientsocket.h"
 #include "util/tc_common.h"
 #include "NodeServer.h"
+#include "ResourceSampler.h"
 #include <numeric>
 
 NodeInfo PlatformInfo::getNodeInfo() 
@@ -42,8 +43,14 @@ LoadInfo PlatformInfo::getLoadInfo()
     info.avg15  = -1.0f;
 #if TARGET_PLATFORM_LINUX || TARGET_PLATFORM_IOS
 
+    //优先使用ReportMemThread的采样结果
+    NodeResource node = ResourceSampler::getInstance()->getNode();
     double loadAvg[3];
-    if ( getloadavg( loadAvg, 3 ) != -1 )
+    if ( node.sampleTime > 0 )
+    {
+        info.avg1   = node.load1;
+    }
+    else if ( getloadavg( loadAvg, 3 ) != -1 )
     {
         info.avg1   = static_cast<float>( loadAvg[0] );
     // info.avg5   = static_cast<float>( loadAvg[1] );
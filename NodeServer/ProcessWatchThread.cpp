@@ -0,0 +1,459 @@
+/**
+ * Tencent is pleased to support the open source community by making Tars available.
+ *
+ * Copyright (C) 2016THL A29 Limited, a Tencent company. All rights reserved.
+ *
+ * Licensed under the BSD 3-Clause License (the "License"); you may not use this file except 
+ * in compliance with the License. You may obtain a copy of the License at
+ *
+ * https://opensource.org/licenses/BSD-3-Clause
+ *
+ * Unless required by applicable law or agreed to in writing, software distributed 
+ * under the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR 
+ * CONDITIONS OF ANY KIND, either express or implied. See the License for the 
+ * specific language governing permissions and limitations under the License.
+ */
+
+#include "ProcessWatchThread.h"
+#include <algorithm>
+#include "NodeServer.h"
+#include "util/tc_json.h"
+#include "util/tc_timeprovider.h"
+#include "util.h"
+
+#if TARGET_PLATFORM_LINUX
+
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <sys/syscall.h>
+#include <sys/un.h>
+#include <fcntl.h>
+#include <string.h>
+#include <unistd.h>
+
+#ifndef __NR_pidfd_open
+#define __NR_pidfd_open 434
+#endif
+
+//只订阅容器的die事件, 即 filters={"type":["container"],"event":["die"]}
+//使用HTTP/1.0, docker不会使用chunked编码, 事件按行返回直到连接关闭
+#define DOCKER_EVENTS_REQUEST "GET /events?filters=%7B%22type%22%3A%5B%22container%22%5D%2C%22event%22%3A%5B%22die%22%5D%7D HTTP/1.0\r\nHost: docker\r\n\r\n"
+
+ProcessWatchThread::ProcessWatchThread()
+: _terminate(false)
+, _dockerfd(-1)
+, _dockerHeaderDone(false)
+, _dockerReadyTimeMs(0)
+, _dockerRetryTime(0)
+, _containerNum(0)
+{
+    _probeInterval = TC_Common::strto<int>(g_pconf->get("/tars/node/keepalive<processProbeInterval>", "60"));
+    _probeInterval = _probeInterval < 1 ? 1 : _probeInterval;
+
+    _epollfd  = epoll_create1(EPOLL_CLOEXEC);
+    _wakeupfd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+
+    epoll_event ev;
+    ev.events  = EPOLLIN;
+    ev.data.fd = _wakeupfd;
+    epoll_ctl(_epollfd, EPOLL_CTL_ADD, _wakeupfd, &ev);
+}
+
+ProcessWatchThread::~ProcessWatchThread()
+{
+    terminate();
+
+    for (map<string, WatchEntry>::iterator it = _watch.begin(); it != _watch.end(); ++it)
+    {
+        closePidfd(it->second);
+    }
+
+    closeDocker();
+
+    ::close(_wakeupfd);
+    ::close(_epollfd);
+}
+
+void ProcessWatchThread::terminate()
+{
+    NODE_LOG("ProcessWatchThread")->debug() << FILE_FUN << endl;
+
+    _terminate = true;
+
+    uint64_t one = 1;
+    if (::write(_wakeupfd, &one, sizeof(one)) < 0)
+    {
+        NODE_LOG("ProcessWatchThread")->error() << FILE_FUN << "wakeup error:" << errno << endl;
+    }
+
+    if (isAlive())
+    {
+        getThreadControl().join();
+    }
+}
+
+void ProcessWatchThread::watch(const string &serverId, int64_t pid, bool container)
+{
+    TC_ThreadLock::Lock lock(_lock);
+
+    WatchEntry &entry = _watch[serverId];
+    if (entry.pid != pid)
+    {
+        closePidfd(entry);
+        entry.exited = false;
+    }
+
+    if (entry.container != container)
+    {
+        container ? ++_containerNum : --_containerNum;
+    }
+
+    entry.pid         = pid;
+    entry.container   = container;
+    entry.probeTimeMs = TC_TimeProvider::getInstance()->getNowMs();
+
+    if (container || entry.exited || entry.pidfd >= 0)
+    {
+        return;
+    }
+
+    int fd = static_cast<int>(::syscall(__NR_pidfd_open, static_cast<pid_t>(pid), 0));
+    if (fd < 0)
+    {
+        //内核不支持pidfd(低于5.3)时, 普通进程仍然逐个检查
+        NODE_LOG("ProcessWatchThread")->debug() << FILE_FUN << serverId << "|" << pid << "|pidfd_open error:" << errno << endl;
+        return;
+    }
+
+    fcntl(fd, F_SETFD, FD_CLOEXEC);
+
+    epoll_event ev;
+    ev.events  = EPOLLIN;
+    ev.data.fd = fd;
+    if (epoll_ctl(_epollfd, EPOLL_CTL_ADD, fd, &ev) != 0)
+    {
+        ::close(fd);
+        return;
+    }
+
+    entry.pidfd        = fd;
+    _pidfd2Server[fd]  = serverId;
+}
+
+void ProcessWatchThread::unwatch(const string &serverId)
+{
+    TC_ThreadLock::Lock lock(_lock);
+
+    map<string, WatchEntry>::iterator it = _watch.find(serverId);
+    if (it == _watch.end())
+    {
+        return;
+    }
+
+    closePidfd(it->second);
+
+    if (it->second.container)
+    {
+        --_containerNum;
+    }
+
+    _watch.erase(it);
+}
+
+bool ProcessWatchThread::isWatchedAlive(const string &serverId, int64_t pid)
+{
+    TC_ThreadLock::Lock lock(_lock);
+
+    map<string, WatchEntry>::const_iterator it = _watch.find(serverId);
+    if (it == _watch.end() || it->second.pid != pid)
+    {
+        return false;
+    }
+
+    const WatchEntry &entry = it->second;
+    if (entry.exited || TC_TimeProvider::getInstance()->getNowMs() - entry.probeTimeMs >= _probeInterval * 1000LL)
+    {
+        return false;
+    }
+
+    if (entry.container)
+    {
+        //事件流建立之后检查过的容器, 之后的退出事件一定能收到
+        return _dockerReadyTimeMs > 0 && entry.probeTimeMs >= _dockerReadyTimeMs;
+    }
+
+    return entry.pidfd >= 0;
+}
+
+void ProcessWatchThread::popExited(vector<string> &vServerId)
+{
+    TC_ThreadLock::Lock lock(_lock);
+
+    vServerId.swap(_exited);
+    _exited.clear();
+}
+
+void ProcessWatchThread::onExit(const string &serverId)
+{
+    map<string, WatchEntry>::iterator it = _watch.find(serverId);
+    if (it == _watch.end())
+    {
+        return;
+    }
+
+    closePidfd(it->second);
+
+    //不再信任上次的检查结果, 下次checkPid做真实检查
+    it->second.exited = true;
+
+    if (std::find(_exited.begin(), _exited.end(), serverId) == _exited.end())
+    {
+        _exited.push_back(serverId);
+    }
+
+    NODE_LOG("ProcessWatchThread")->debug() << FILE_FUN << serverId << "|" << it->second.pid << "|exited" << endl;
+}
+
+void ProcessWatchThread::closePidfd(WatchEntry &entry)
+{
+    if (entry.pidfd < 0)
+    {
+        return;
+    }
+
+    epoll_ctl(_epollfd, EPOLL_CTL_DEL, entry.pidfd, NULL);
+    ::close(entry.pidfd);
+
+    _pidfd2Server.erase(entry.pidfd);
+    entry.pidfd = -1;
+}
+
+void ProcessWatchThread::connectDocker()
+{
+    _dockerRetryTime = TNOW + 5;
+
+    int fd = ::socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd < 0)
+    {
+        return;
+    }
+
+    struct sockaddr_un addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    strncpy(addr.sun_path, g_app.getDocketSocket().c_str(), sizeof(addr.sun_path) - 1);
+
+    const string request = DOCKER_EVENTS_REQUEST;
+    if (::connect(fd, (struct sockaddr *)&addr, sizeof(addr)) != 0
+        || ::send(fd, request.c_str(), request.size(), MSG_NOSIGNAL) != (ssize_t)request.size())
+    {
+        NODE_LOG("ProcessWatchThread")->debug() << FILE_FUN << "connect docker events error:" << errno << endl;
+        ::close(fd);
+        return;
+    }
+
+    fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+
+    epoll_event ev;
+    ev.events  = EPOLLIN;
+    ev.data.fd = fd;
+    epoll_ctl(_epollfd, EPOLL_CTL_ADD, fd, &ev);
+
+    _dockerfd         = fd;
+    _dockerHeaderDone = false;
+    _dockerBuffer.clear();
+}
+
+void ProcessWatchThread::closeDocker()
+{
+    if (_dockerfd >= 0)
+    {
+        epoll_ctl(_epollfd, EPOLL_CTL_DEL, _dockerfd, NULL);
+        ::close(_dockerfd);
+        _dockerfd = -1;
+    }
+
+    _dockerHeaderDone = false;
+    _dockerBuffer.clear();
+
+    TC_ThreadLock::Lock lock(_lock);
+    _dockerReadyTimeMs = 0;
+}
+
+void ProcessWatchThread::readDocker()
+{
+    char buff[4096];
+    while (true)
+    {
+        ssize_t n = ::recv(_dockerfd, buff, sizeof(buff), 0);
+        if (n > 0)
+        {
+            _dockerBuffer.append(buff, n);
+            continue;
+        }
+
+        if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR))
+        {
+            break;
+        }
+
+        //docker重启或者连接异常, 稍后重连
+        NODE_LOG("ProcessWatchThread")->error() << FILE_FUN << "docker events closed, errno:" << errno << endl;
+        closeDocker();
+        return;
+    }
+
+    if (!_dockerHeaderDone)
+    {
+        string::size_type pos = _dockerBuffer.find("\r\n\r\n");
+        if (pos == string::npos)
+        {
+            return;
+        }
+
+        if (_dockerBuffer.find(" 200 ") > _dockerBuffer.find("\r\n"))
+        {
+            NODE_LOG("ProcessWatchThread")->error() << FILE_FUN << "docker events error:" << _dockerBuffer.substr(0, pos) << endl;
+            closeDocker();
+            return;
+        }
+
+        _dockerBuffer.erase(0, pos + 4);
+        _dockerHeaderDone = true;
+
+        TC_ThreadLock::Lock lock(_lock);
+        _dockerReadyTimeMs = TC_TimeProvider::getInstance()->getNowMs();
+
+        NODE_LOG("ProcessWatchThread")->debug() << FILE_FUN << "docker events ready" << endl;
+    }
+
+    string::size_type begin = 0;
+    string::size_type end   = 0;
+    while ((end = _dockerBuffer.find('\n', begin)) != string::npos)
+    {
+        if (end > begin)
+        {
+            parseDockerEvent(_dockerBuffer.substr(begin, end - begin));
+        }
+        begin = end + 1;
+    }
+
+    _dockerBuffer.erase(0, begin);
+}
+
+void ProcessWatchThread::parseDockerEvent(const string &line)
+{
+    try
+    {
+        JsonValueObjPtr oPtr = JsonValueObjPtr::dynamicCast(TC_Json::getValue(line));
+        if (!oPtr)
+        {
+            return;
+        }
+
+        JsonValueObjPtr actor = JsonValueObjPtr::dynamicCast(oPtr->value["Actor"]);
+        if (!actor)
+        {
+            return;
+        }
+
+        JsonValueObjPtr attr = JsonValueObjPtr::dynamicCast(actor->value["Attributes"]);
+        if (!attr)
+        {
+            return;
+        }
+
+        JsonValueStringPtr name = JsonValueStringPtr::dynamicCast(attr->value["name"]);
+        if (!name)
+        {
+            return;
+        }
+
+        TC_ThreadLock::Lock lock(_lock);
+
+        map<string, WatchEntry>::const_iterator it = _watch.find(name->value);
+        if (it != _watch.end() && it->second.container)
+        {
+            onExit(name->value);
+        }
+    }
+    catch (exception &ex)
+    {
+        NODE_LOG("ProcessWatchThread")->error() << FILE_FUN << "parse docker event error:" << ex.what() << ", " << line << endl;
+    }
+}
+
+void ProcessWatchThread::run()
+{
+    epoll_event events[64];
+
+    while (!_terminate)
+    {
+        try
+        {
+            bool needDocker = false;
+            {
+                TC_ThreadLock::Lock lock(_lock);
+                needDocker = _containerNum > 0;
+            }
+
+            if (needDocker && _dockerfd < 0 && TNOW >= _dockerRetryTime)
+            {
+                connectDocker();
+            }
+            else if (!needDocker && _dockerfd >= 0)
+            {
+                closeDocker();
+            }
+
+            int num = epoll_wait(_epollfd, events, sizeof(events) / sizeof(events[0]), 1000);
+
+            for (int i = 0; i < num; i++)
+            {
+                int fd = events[i].data.fd;
+                if (fd == _wakeupfd)
+                {
+                    uint64_t value;
+                    while (::read(_wakeupfd, &value, sizeof(value)) > 0);
+                }
+                else if (fd == _dockerfd)
+                {
+                    readDocker();
+                }
+                else
+                {
+                    //pidfd可读表示进程已退出
+                    TC_ThreadLock::Lock lock(_lock);
+
+                    map<int, string>::const_iterator it = _pidfd2Server.find(fd);
+                    if (it != _pidfd2Server.end())
+                    {
+                        onExit(string(it->second));
+                    }
+                }
+            }
+
+            bool hasExited = false;
+            {
+                TC_ThreadLock::Lock lock(_lock);
+                hasExited = !_exited.empty();
+            }
+
+            if (hasExited && g_app.getKeepAliveThread())
+            {
+                g_app.getKeepAliveThread()->notifyExit();
+            }
+        }
+        catch (exception &e)
+        {
+            NODE_LOG("ProcessWatchThread")->error() << FILE_FUN << "catch exception|" << e.what() << endl;
+        }
+        catch (...)
+        {
+            NODE_LOG("ProcessWatchThread")->error() << FILE_FUN << "catch unkown exception|" << endl;
+        }
+    }
+}
+
+#endif
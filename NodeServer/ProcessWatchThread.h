@@ -0,0 +1,151 @@
+/**
+ * Tencent is pleased to support the open source community by making Tars available.
+ *
+ * Copyright (C) 2016THL A29 Limited, a Tencent company. All rights reserved.
+ *
+ * Licensed under the BSD 3-Clause License (the "License"); you may not use this file except 
+ * in compliance with the License. You may obtain a copy of the License at
+ *
+ * https://opensource.org/licenses/BSD-3-Clause
+ *
+ * Unless required by applicable law or agreed to in writing, software distributed 
+ * under the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR 
+ * CONDITIONS OF ANY KIND, either express or implied. See the License for the 
+ * specific language governing permissions and limitations under the License.
+ */
+
+#ifndef __PROCESS_WATCH_THREAD_H_
+#define __PROCESS_WATCH_THREAD_H_
+
+#include <map>
+#include <vector>
+#include "util/tc_platform.h"
+#include "util/tc_monitor.h"
+#include "util/tc_thread.h"
+
+using namespace tars;
+using namespace std;
+
+/**
+ * 进程退出事件监听线程
+ * 普通进程通过pidfd监听退出, 容器通过docker的events接口监听die事件,
+ * 有服务退出时通知KeepAliveThread立即检查该服务.
+ * 被监听且未退出的服务, checkPid可以不用kill(pid, 0)或者inspect容器,
+ * 每个服务仍然每隔_probeInterval秒做一次真实检查作为兜底
+ */
+class ProcessWatchThread : public TC_Thread
+{
+public:
+    /**
+     * 构造函数
+     */
+    ProcessWatchThread();
+
+    /**
+     * 析构函数
+     */
+    ~ProcessWatchThread();
+
+    /**
+     * 结束线程
+     */
+    void terminate();
+
+    /**
+     * 真实检查服务存活后调用, 开始(或继续)监听该服务的退出事件
+     * @param serverId 服务id, 容器名与服务id相同
+     * @param pid 进程id
+     * @param container 是否是容器
+     */
+    void watch(const string &serverId, int64_t pid, bool container);
+
+    /**
+     * 不再监听该服务
+     */
+    void unwatch(const string &serverId);
+
+    /**
+     * 服务是否在监听中且未退出, 返回true时可以不做真实检查
+     */
+    bool isWatchedAlive(const string &serverId, int64_t pid);
+
+    /**
+     * 取出已经退出的服务
+     */
+    void popExited(vector<string> &vServerId);
+
+protected:
+
+    virtual void run();
+
+    struct WatchEntry
+    {
+        int64_t     pid         = 0;
+        bool        container   = false;
+        int         pidfd       = -1;       //普通进程的pidfd, -1表示没有监听
+        int64_t     probeTimeMs = 0;        //最近一次真实检查存活的时间
+        bool        exited      = false;    //收到过退出事件, 同一个pid不再监听(例如未回收的僵尸进程)
+    };
+
+    /**
+     * 服务退出, 记录并通知KeepAliveThread, 需要加锁调用
+     */
+    void onExit(const string &serverId);
+
+    /**
+     * 关闭pidfd, 需要加锁调用
+     */
+    void closePidfd(WatchEntry &entry);
+
+    /**
+     * 连接docker的events接口
+     */
+    void connectDocker();
+
+    /**
+     * 断开docker的events接口, 断开期间容器回到逐个检查
+     */
+    void closeDocker();
+
+    /**
+     * 读取并处理docker事件
+     */
+    void readDocker();
+
+    /**
+     * 处理一条docker事件
+     */
+    void parseDockerEvent(const string &line);
+
+protected:
+
+    bool                        _terminate;
+
+    int                         _probeInterval;     //兜底检查间隔(s)
+
+    int                         _epollfd;
+
+    int                         _wakeupfd;          //结束线程时唤醒epoll
+
+    int                         _dockerfd;
+
+    bool                        _dockerHeaderDone;  //是否已跳过http头
+
+    string                      _dockerBuffer;
+
+    int64_t                     _dockerReadyTimeMs;     //事件流建立的时间, 0表示未建立, 之前检查的容器不能信任
+
+    time_t                      _dockerRetryTime;
+
+    map<string, WatchEntry>     _watch;
+
+    map<int, string>            _pidfd2Server;
+
+    vector<string>              _exited;
+
+    size_t                      _containerNum;
+
+    TC_ThreadLock               _lock;
+};
+
+#endif
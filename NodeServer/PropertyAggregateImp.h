@@ -0,0 +1,50 @@
+/**
+ * Tencent is pleased to support the open source community by making Tars available.
+ *
+ * Copyright (C) 2016THL A29 Limited, a Tencent company. All rights reserved.
+ *
+ * Licensed under the BSD 3-Clause License (the "License"); you may not use this file except 
+ * in compliance with the License. You may obtain a copy of the License at
+ *
+ * https://opensource.org/licenses/BSD-3-Clause
+ *
+ * Unless required by applicable law or agreed to in writing, software distributed 
+ * under the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR 
+ * CONDITIONS OF ANY KIND, either express or implied. See the License for the 
+ * specific language governing permissions and limitations under the License.
+ */
+
+
+#ifndef __PROPERTY_AGGREGATE_IMP_H_
+#define __PROPERTY_AGGREGATE_IMP_H_
+
+#include "servant/PropertyF.h"
+
+using namespace tars;
+
+/**
+ * 节点本地的属性上报接口
+ * 接口与tarsproperty相同, 本机服务把client<property>配置成node的PropertyObj即可, 数据由ReportAggregateThread合并后上报
+ */
+class PropertyAggregateImp : public PropertyF
+{
+public:
+    /**
+     * 初始化
+     */
+    virtual void initialize() {};
+
+    /**
+     * 退出
+     */
+    virtual void destroy() {};
+
+    /**
+     * 上报属性信息
+     * @param propMsg, 上报信息
+     * @return int, 返回0表示成功
+     */
+    virtual int reportPropMsg(const map<StatPropMsgHead, StatPropMsgBody> &propMsg, CurrentPtr current);
+};
+
+#endif
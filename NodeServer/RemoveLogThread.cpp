@@ -23,7 +23,13 @@
 using namespace tars;
 
 RemoveLogManager::RemoveLogManager()
+: _lastPrune(TNOW)
 {
+    _filesPerSecond = TC_Common::strto<int>(g_pconf->get("/tars/node/removelog<filesPerSecond>", "2000"));
+    _bytesPerSecond = TC_Common::toSize(g_pconf->get("/tars/node/removelog<bytesPerSecond>", "100M"), 100 * 1024 * 1024);
+    _maxAge         = TC_Common::strto<time_t>(g_pconf->get("/tars/node/removelog<maxAge>", "0"));
+    _quota          = TC_Common::toSize(g_pconf->get("/tars/node/removelog<quota>", "0"), 0);
+    _pruneInterval  = TC_Common::strto<time_t>(g_pconf->get("/tars/node/removelog<pruneInterval>", "3600"));
 }
 
 RemoveLogManager::~RemoveLogManager()
@@ -96,6 +102,25 @@ bool RemoveLogManager::pop_front(string& logPath)
     return bRet;
 }
 
+bool RemoveLogManager::needPrune()
+{
+    if (_maxAge <= 0 && _quota <= 0)
+    {
+        return false;
+    }
+
+    TC_ThreadLock::Lock lock(_queueMutex);
+
+    if (TNOW - _lastPrune < _pruneInterval)
+    {
+        return false;
+    }
+
+    _lastPrune = TNOW;
+
+    return true;
+}
+
 void RemoveLogManager::timedWait(int millsecond)
 {
     TC_ThreadLock::Lock lock(_queueMutex);
@@ -120,8 +145,38 @@ void RemoveLogThread::terminate()
     _shutDown = true;
 }
 
+void RemoveLogThread::pruneServers(LogCleaner &cleaner)
+{
+    int64_t startMs = TC_TimeProvider::getInstance()->getNowMs();
+    size_t removed  = 0;
+
+    map<string, ServerGroup> mServers = ServerFactory::getInstance()->getAllServers();
+    for (map<string, ServerGroup>::const_iterator it = mServers.begin(); it != mServers.end() && !_shutDown; ++it)
+    {
+        for (ServerGroup::const_iterator itServer = it->second.begin(); itServer != it->second.end() && !_shutDown; ++itServer)
+        {
+            if (!itServer->second || itServer->second->getLogPath().empty())
+            {
+                continue;
+            }
+
+            string sLogDir = TC_File::simplifyDirectory(itServer->second->getLogPath() + FILE_SEP + it->first + FILE_SEP + itServer->first);
+
+            //最近10分钟修改过的文件认为还在写
+            removed += cleaner.pruneDir(sLogDir, _manager->getMaxAge(), _manager->getQuota(), 600);
+        }
+    }
+
+    NODE_LOG("RemoveLogThread")->debug() << FILE_FUN << "prune log files:" << removed << ", use:" << (TC_TimeProvider::getInstance()->getNowMs() - startMs) << endl;
+}
+
 void RemoveLogThread::run()
 {
+    //删除和清理日志只在磁盘空闲时进行
+    LogCleaner::setIdleIoPriority();
+
+    LogCleaner cleaner(_manager->getFilesPerSecond(), _manager->getBytesPerSecond(), &_shutDown);
+
     while (!_shutDown)
     {
         try
@@ -130,12 +185,17 @@ void RemoveLogThread::run()
             if (_manager->pop_front(sLogPath))
             {
                 int64_t startMs = TC_TimeProvider::getInstance()->getNowMs();
-                if (TC_File::isFileExistEx(sLogPath, S_IFDIR))
+                //isFileExistEx不跟随软链接, 软链接的目录也交给removeTree, 由它只删除链接并记录日志
+                if (TC_File::isFileExistEx(sLogPath, S_IFDIR) || LogCleaner::isLink(sLogPath))
                 {
-                    int ret = TC_File::removeFile(sLogPath,true);
+                    size_t files  = cleaner.getRemovedFiles();
+                    int64_t bytes = cleaner.getRemovedBytes();
+
+                    int ret = cleaner.removeTree(sLogPath);
                     if (ret == 0)
                     {
-                        NODE_LOG("RemoveLogThread")->debug() <<FILE_FUN<< "remove log path success:" << sLogPath << ", use:" << (TC_TimeProvider::getInstance()->getNowMs() - startMs) << endl;
+                        NODE_LOG("RemoveLogThread")->debug() <<FILE_FUN<< "remove log path success:" << sLogPath << ", files:" << (cleaner.getRemovedFiles() - files)
+                                                            << ", bytes:" << (cleaner.getRemovedBytes() - bytes) << ", use:" << (TC_TimeProvider::getInstance()->getNowMs() - startMs) << endl;
                     }
                     else
                     {
@@ -147,6 +207,10 @@ void RemoveLogThread::run()
                     NODE_LOG("RemoveLogThread")->debug()<<FILE_FUN << "log path does not exist:" << sLogPath << ", use:" << (TC_TimeProvider::getInstance()->getNowMs() - startMs) << endl;
                 }
             }
+            else if (_manager->needPrune())
+            {
+                pruneServers(cleaner);
+            }
             else
             {
                 _manager->timedWait(2000);
@@ -21,6 +21,7 @@
 #include "Node.h"
 #include "ServerObject.h"
 #include "util/tc_thread_queue.h"
+#include "LogCleaner.h"
 
 class RemoveLogThread;
 
@@ -62,6 +63,25 @@ public:
      */
     bool pop_front(string& logPath);
 
+    /**
+     * 是否到了按时间/大小清理各服务日志的时间, 返回true时开始新的一轮
+     */
+    bool needPrune();
+
+    /**
+     * 每秒最多删除的文件数和字节数
+     */
+    int getFilesPerSecond() const { return _filesPerSecond; }
+
+    int64_t getBytesPerSecond() const { return _bytesPerSecond; }
+
+    /**
+     * 日志文件保留的时间(s), 每个服务日志目录的大小上限
+     */
+    time_t getMaxAge() const { return _maxAge; }
+
+    int64_t getQuota() const { return _quota; }
+
 private:
     TC_ThreadLock                  _queueMutex;
 
@@ -70,6 +90,19 @@ private:
     std::set<string>                   _reqSet; //用于去重
 
     std::vector<RemoveLogThread *>     _runners;
+
+    int                                _filesPerSecond;
+
+    int64_t                            _bytesPerSecond;
+
+    time_t                             _maxAge;
+
+    int64_t                            _quota;
+
+    //按时间/大小清理的间隔(s)
+    time_t                             _pruneInterval;
+
+    time_t                             _lastPrune;
 };
 
 class RemoveLogThread : public TC_Thread
@@ -83,6 +116,12 @@ public:
 
     void terminate();
 
+protected:
+    /**
+     * 按时间/大小清理所有服务的日志目录
+     */
+    void pruneServers(LogCleaner &cleaner);
+
 protected:
     RemoveLogManager *    _manager;
 
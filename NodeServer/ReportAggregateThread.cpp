@@ -0,0 +1,338 @@
+/**
+ * Tencent is pleased to support the open source community by making Tars available.
+ *
+ * Copyright (C) 2016THL A29 Limited, a Tencent company. All rights reserved.
+ *
+ * Licensed under the BSD 3-Clause License (the "License"); you may not use this file except 
+ * in compliance with the License. You may obtain a copy of the License at
+ *
+ * https://opensource.org/licenses/BSD-3-Clause
+ *
+ * Unless required by applicable law or agreed to in writing, software distributed 
+ * under the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR 
+ * CONDITIONS OF ANY KIND, either express or implied. See the License for the 
+ * specific language governing permissions and limitations under the License.
+ */
+
+
+#include "ReportAggregateThread.h"
+#include "servant/Application.h"
+#include "util/tc_timeprovider.h"
+#include "util.h"
+
+ReportAggregateThread::ReportAggregateThread()
+: _shutDown(false)
+, _micReportNum(0)
+, _propReportNum(0)
+{
+    _interval   = TC_Common::strto<int>(g_pconf->get("/tars/node/aggregate<interval>", "60"));
+    _interval   = _interval < 1 ? 1 : _interval;
+
+    int maxBatch = TC_Common::strto<int>(g_pconf->get("/tars/node/aggregate<maxBatch>", "1000"));
+    _maxBatch   = maxBatch < 1 ? 1 : (size_t)maxBatch;
+
+    //与服务自己上报时用的对象一致
+    Application::getCommunicator()->stringToProxy(g_pconf->get("/tars/application/client<stat>", "tars.tarsstat.StatObj"), _statPrx);
+    Application::getCommunicator()->stringToProxy(g_pconf->get("/tars/application/client<property>", "tars.tarsproperty.PropertyObj"), _propertyPrx);
+}
+
+ReportAggregateThread::~ReportAggregateThread()
+{
+    terminate();
+}
+
+void ReportAggregateThread::terminate()
+{
+    NODE_LOG("ReportAggregateThread")->debug()<<FILE_FUN<< endl;
+
+    _shutDown = true;
+
+    if(isAlive())
+    {
+        TC_ThreadLock::Lock lock(_lock);
+        _lock.notifyAll();
+    }
+    getThreadControl().join();
+}
+
+bool ReportAggregateThread::timedWait(int millsecond)
+{
+    TC_ThreadLock::Lock lock(_lock);
+    if(_shutDown)
+    {
+        return true;
+    }
+    return _lock.timedWait(millsecond);
+}
+
+void ReportAggregateThread::addMicMsg(const map<StatMicMsgHead, StatMicMsgBody> &statmsg, bool bFromClient)
+{
+    TC_ThreadLock::Lock lock(_lock);
+
+    map<StatMicMsgHead, StatMicMsgBody> &mMsg = _micMsg[bFromClient ? 1 : 0];
+
+    for (map<StatMicMsgHead, StatMicMsgBody>::const_iterator it = statmsg.begin(); it != statmsg.end(); ++it)
+    {
+        const StatMicMsgBody &body = it->second;
+
+        //三个数据都为0时tarsstat也不入库
+        if(body.count == 0 && body.execCount == 0 && body.timeoutCount == 0)
+        {
+            continue;
+        }
+
+        //tarsstat会用连接的ip覆盖这个字段
+        StatMicMsgHead head = it->first;
+        if (bFromClient)
+        {
+            head.masterIp = "";
+        }
+        else
+        {
+            head.slaveIp = "";
+        }
+
+        map<StatMicMsgHead, StatMicMsgBody>::iterator itMsg = mMsg.find(head);
+        if (itMsg == mMsg.end())
+        {
+            mMsg.insert(make_pair(head, body));
+            continue;
+        }
+
+        //与StatHashMap::add的合并方式一致
+        StatMicMsgBody &stBody = itMsg->second;
+
+        stBody.count            += body.count;
+        stBody.execCount        += body.execCount;
+        stBody.timeoutCount     += body.timeoutCount;
+
+        for(map<int,int>::const_iterator itInterval = body.intervalCount.begin(); itInterval != body.intervalCount.end(); ++itInterval)
+        {
+            stBody.intervalCount[itInterval->first] += itInterval->second;
+        }
+
+        stBody.totalRspTime += body.totalRspTime;
+        if(stBody.maxRspTime < body.maxRspTime)
+        {
+            stBody.maxRspTime = body.maxRspTime;
+        }
+        //非0最小值
+        if( stBody.minRspTime == 0 || (stBody.minRspTime > body.minRspTime && body.minRspTime != 0))
+        {
+            stBody.minRspTime = body.minRspTime;
+        }
+    }
+
+    ++_micReportNum;
+}
+
+void ReportAggregateThread::addPropMsg(const map<StatPropMsgHead, StatPropMsgBody> &propMsg)
+{
+    TC_ThreadLock::Lock lock(_lock);
+
+    for (map<StatPropMsgHead, StatPropMsgBody>::const_iterator it = propMsg.begin(); it != propMsg.end(); ++it)
+    {
+        //tarsproperty用连接的ip, 不用上报的ip
+        StatPropMsgHead head = it->first;
+        head.ip = "";
+
+        map<StatPropMsgHead, StatPropMsgBody>::iterator itMsg = _propMsg.find(head);
+        if (itMsg == _propMsg.end())
+        {
+            _propMsg.insert(make_pair(head, it->second));
+        }
+        else
+        {
+            mergeProp(itMsg->second, it->second);
+        }
+    }
+
+    ++_propReportNum;
+}
+
+void ReportAggregateThread::mergeProp(StatPropMsgBody &body, const StatPropMsgBody &in)
+{
+    map<string, string> mSumib;
+
+    for (size_t i = 0; i < body.vInfo.size(); i++)
+    {
+        mSumib.insert(make_pair(body.vInfo[i].policy, body.vInfo[i].value));
+    }
+
+    for (size_t i = 0; i < in.vInfo.size(); i++)
+    {
+        const string &sPolicy = in.vInfo[i].policy;
+        const string &inValue = in.vInfo[i].value;
+
+        map<string, string>::iterator it = mSumib.find(sPolicy);
+        if (it == mSumib.end())
+        {
+            mSumib.insert(make_pair(sPolicy, inValue));
+        }
+        else if (sPolicy == "Count" || sPolicy == "Sum")
+        {
+            it->second = TC_Common::tostr(TC_Common::strto<long long>(it->second) + TC_Common::strto<long long>(inValue));
+        }
+        else if (sPolicy == "Min")
+        {
+            it->second = TC_Common::tostr(min(TC_Common::strto<long long>(it->second), TC_Common::strto<long long>(inValue)));
+        }
+        else if (sPolicy == "Max")
+        {
+            it->second = TC_Common::tostr(max(TC_Common::strto<long long>(it->second), TC_Common::strto<long long>(inValue)));
+        }
+        else if (sPolicy == "Distr")
+        {
+            vector<string> fields  = TC_Common::sepstr<string>(it->second, ",");
+            vector<string> fieldIn = TC_Common::sepstr<string>(inValue, ",");
+
+            //分布区间不一致时不能合并, 保留原来的
+            if (fields.size() != fieldIn.size())
+            {
+                continue;
+            }
+
+            string tmpValue;
+            for (size_t k = 0; k < fields.size(); k++)
+            {
+                vector<string> sTmp  = TC_Common::sepstr<string>(fields[k], "|");
+                vector<string> inTmp = TC_Common::sepstr<string>(fieldIn[k], "|");
+                if (sTmp.size() == 2 && inTmp.size() == 2)
+                {
+                    sTmp[1] = TC_Common::tostr(TC_Common::strto<long long>(sTmp[1]) + TC_Common::strto<long long>(inTmp[1]));
+                    fields[k] = sTmp[0] + "|" + sTmp[1];
+                }
+
+                tmpValue += (k == 0 ? "" : ",") + fields[k];
+            }
+            it->second = tmpValue;
+        }
+        else if (sPolicy == "Avg")
+        {
+            //合并后带上记录数, tarsproperty按"总和=记录数"继续合并
+            vector<string> sTmp  = TC_Common::sepstr<string>(it->second, "=");
+            vector<string> inTmp = TC_Common::sepstr<string>(inValue, "=");
+            if (sTmp.empty() || inTmp.empty())
+            {
+                continue;
+            }
+
+            double tmpValueSum = TC_Common::strto<double>(sTmp[0]) + TC_Common::strto<double>(inTmp[0]);
+            long tmpCntSum = (2 == inTmp.size() ? TC_Common::strto<long>(inTmp[1]) : 1) + (2 == sTmp.size() ? TC_Common::strto<long>(sTmp[1]) : 1);
+
+            it->second = TC_Common::tostr(tmpValueSum) + "=" + TC_Common::tostr(tmpCntSum);
+        }
+    }
+
+    body.vInfo.clear();
+    for (map<string, string>::iterator it = mSumib.begin(); it != mSumib.end(); ++it)
+    {
+        StatPropInfo info;
+        info.policy = it->first;
+        info.value  = it->second;
+        body.vInfo.push_back(info);
+    }
+}
+
+void ReportAggregateThread::reportSampleMsg(const vector<StatSampleMsg> &msg)
+{
+    _statPrx->async_reportSampleMsg(NULL, msg);
+}
+
+void ReportAggregateThread::report()
+{
+    map<StatMicMsgHead, StatMicMsgBody> micMsg[2];
+    map<StatPropMsgHead, StatPropMsgBody> propMsg;
+    size_t micReportNum  = 0;
+    size_t propReportNum = 0;
+
+    {
+        TC_ThreadLock::Lock lock(_lock);
+        micMsg[0].swap(_micMsg[0]);
+        micMsg[1].swap(_micMsg[1]);
+        propMsg.swap(_propMsg);
+
+        micReportNum    = _micReportNum;
+        propReportNum   = _propReportNum;
+        _micReportNum   = 0;
+        _propReportNum  = 0;
+    }
+
+    size_t micRpc = 0;
+    for (int i = 0; i < 2; i++)
+    {
+        map<StatMicMsgHead, StatMicMsgBody> batch;
+        for (map<StatMicMsgHead, StatMicMsgBody>::iterator it = micMsg[i].begin(); it != micMsg[i].end(); ++it)
+        {
+            batch.insert(*it);
+            if (batch.size() >= _maxBatch)
+            {
+                _statPrx->async_reportMicMsg(NULL, batch, i == 1);
+                batch.clear();
+                ++micRpc;
+            }
+        }
+
+        if (!batch.empty())
+        {
+            _statPrx->async_reportMicMsg(NULL, batch, i == 1);
+            ++micRpc;
+        }
+    }
+
+    size_t propRpc = 0;
+    map<StatPropMsgHead, StatPropMsgBody> batch;
+    for (map<StatPropMsgHead, StatPropMsgBody>::iterator it = propMsg.begin(); it != propMsg.end(); ++it)
+    {
+        batch.insert(*it);
+        if (batch.size() >= _maxBatch)
+        {
+            _propertyPrx->async_reportPropMsg(NULL, batch);
+            batch.clear();
+            ++propRpc;
+        }
+    }
+
+    if (!batch.empty())
+    {
+        _propertyPrx->async_reportPropMsg(NULL, batch);
+        ++propRpc;
+    }
+
+    if (micReportNum > 0 || propReportNum > 0)
+    {
+        NODE_LOG("ReportAggregateThread")->debug() << FILE_FUN << "stat reports:" << micReportNum << "->" << micRpc << ", records:" << micMsg[0].size() + micMsg[1].size()
+                                                   << "|property reports:" << propReportNum << "->" << propRpc << ", records:" << propMsg.size() << endl;
+    }
+}
+
+void ReportAggregateThread::run()
+{
+    time_t tLastReport = TNOW;
+
+    while (!_shutDown)
+    {
+        timedWait(1000);
+
+        //每_interval秒上报一次, 退出时把剩余的数据报上去
+        if (!_shutDown && TNOW - tLastReport < _interval)
+        {
+            continue;
+        }
+
+        tLastReport = TNOW;
+
+        try
+        {
+            report();
+        }
+        catch(exception& e)
+        {
+            NODE_LOG("ReportAggregateThread")->error()<<FILE_FUN<<"catch exception|"<<e.what()<<endl;
+        }
+        catch(...)
+        {
+            NODE_LOG("ReportAggregateThread")->error()<<FILE_FUN<<"catch unkown exception|"<<endl;
+        }
+    }
+}
@@ -0,0 +1,113 @@
+/**
+ * Tencent is pleased to support the open source community by making Tars available.
+ *
+ * Copyright (C) 2016THL A29 Limited, a Tencent company. All rights reserved.
+ *
+ * Licensed under the BSD 3-Clause License (the "License"); you may not use this file except 
+ * in compliance with the License. You may obtain a copy of the License at
+ *
+ * https://opensource.org/licenses/BSD-3-Clause
+ *
+ * Unless required by applicable law or agreed to in writing, software distributed 
+ * under the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR 
+ * CONDITIONS OF ANY KIND, either express or implied. See the License for the 
+ * specific language governing permissions and limitations under the License.
+ */
+
+
+#ifndef __REPORT_AGGREGATE_THREAD_H_
+#define __REPORT_AGGREGATE_THREAD_H_
+
+#include <map>
+#include "servant/StatF.h"
+#include "servant/PropertyF.h"
+#include "util/tc_monitor.h"
+#include "util/tc_thread.h"
+
+using namespace tars;
+using namespace std;
+
+/**
+ * 节点本地的调用统计和属性上报汇聚
+ * 本机服务把reportMicMsg/reportPropMsg上报到node, node按一个上报周期合并后再批量上报给tarsstat/tarsproperty,
+ * 中心服务收到的请求数从每个进程一次变成每台机器一次.
+ * 合并的key与StatHashMap/PropertyHashMap一致, 中心服务用连接的ip填充的字段(主调或被调ip, 属性ip)在这里清空,
+ * 由node的连接重新填充, 同一台机器上的ip相同, 入库结果不变.
+ */
+class ReportAggregateThread : public TC_Thread
+{
+public:
+    /**
+     * 构造函数
+     */
+    ReportAggregateThread();
+
+    /**
+     * 析构函数
+     */
+    ~ReportAggregateThread();
+
+    /**
+     * 结束线程, 剩余的数据上报后退出
+     */
+    void terminate();
+
+    /**
+     * 合并调用统计
+     */
+    void addMicMsg(const map<StatMicMsgHead, StatMicMsgBody> &statmsg, bool bFromClient);
+
+    /**
+     * 合并属性上报
+     */
+    void addPropMsg(const map<StatPropMsgHead, StatPropMsgBody> &propMsg);
+
+    /**
+     * 采样数据量小, 直接转发
+     */
+    void reportSampleMsg(const vector<StatSampleMsg> &msg);
+
+    /**
+     * 合并同一个属性的两次上报, 规则与PropertyHashMap::add一致
+     */
+    static void mergeProp(StatPropMsgBody &body, const StatPropMsgBody &in);
+
+protected:
+
+    virtual void run();
+
+    /**
+     * 上报一个周期合并后的数据
+     */
+    void report();
+
+    bool timedWait(int millsecond);
+
+protected:
+
+    bool                _shutDown;
+
+    //上报周期(秒)
+    int                 _interval;
+
+    //每次rpc最多上报的条数
+    size_t              _maxBatch;
+
+    StatFPrx            _statPrx;
+
+    PropertyFPrx        _propertyPrx;
+
+    TC_ThreadLock       _lock;
+
+    //按bFromClient区分
+    map<StatMicMsgHead, StatMicMsgBody>     _micMsg[2];
+
+    map<StatPropMsgHead, StatPropMsgBody>   _propMsg;
+
+    //本周期收到的上报次数
+    size_t              _micReportNum;
+
+    size_t              _propReportNum;
+};
+
+#endif
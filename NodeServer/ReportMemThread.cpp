@@ -18,6 +18,7 @@
 #include "RegistryProxy.h"
 #include "util/tc_timeprovider.h"
 #include "util.h"
+#include "ResourceSampler.h"
 
 ReportMemThread::ReportMemThread( )
 {
@@ -79,6 +80,9 @@ void ReportMemThread::run()
 
 void ReportMemThread::report()
 {
+    //一次遍历采样所有服务, 结果供属性上报和getNodeLoad使用
+    ResourceSampler::getInstance()->sample();
+
     string sServerId;
     map<string, ServerGroup> mmServerList       = ServerFactory::getInstance()->getAllServers();
     map<string, ServerGroup>::const_iterator it = mmServerList.begin();
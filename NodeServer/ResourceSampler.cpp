@@ -0,0 +1,441 @@
+/**
+ * Tencent is pleased to support the open source community by making Tars available.
+ *
+ * Copyright (C) 2016THL A29 Limited, a Tencent company. All rights reserved.
+ *
+ * Licensed under the BSD 3-Clause License (the "License"); you may not use this file except 
+ * in compliance with the License. You may obtain a copy of the License at
+ *
+ * https://opensource.org/licenses/BSD-3-Clause
+ *
+ * Unless required by applicable law or agreed to in writing, software distributed 
+ * under the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR 
+ * CONDITIONS OF ANY KIND, either express or implied. See the License for the 
+ * specific language governing permissions and limitations under the License.
+ */
+
+#include "ResourceSampler.h"
+#include "ServerFactory.h"
+#include "util/tc_timeprovider.h"
+#include "util.h"
+#include <set>
+
+#if TARGET_PLATFORM_LINUX
+#include <dirent.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#endif
+
+extern TC_Config* g_pconf;
+
+/**
+ * 在以'\0'结尾的内容中查找key, 返回key之后的数值
+ */
+static int64_t keyValue(const char *buff, const char *key)
+{
+    const char *p = strstr(buff, key);
+    if (p == NULL)
+    {
+        return 0;
+    }
+
+    return strtoll(p + strlen(key), NULL, 10);
+}
+
+ResourceSampler::ResourceSampler()
+: _clkTck(100)
+, _pageKb(4)
+, _lastNodeTotal(0)
+, _lastNodeIdle(0)
+{
+    int historySize = TC_Common::strto<int>(g_pconf->get("/tars/node/keepalive<resourceHistorySize>", "60"));
+    _historySize    = historySize < 1 ? 1 : static_cast<size_t>(historySize);
+
+#if TARGET_PLATFORM_LINUX
+    _clkTck = sysconf(_SC_CLK_TCK) > 0 ? sysconf(_SC_CLK_TCK) : 100;
+    _pageKb = sysconf(_SC_PAGESIZE) > 0 ? sysconf(_SC_PAGESIZE) / 1024 : 4;
+#endif
+}
+
+int ResourceSampler::readFile(const char *path)
+{
+#if TARGET_PLATFORM_LINUX
+    int fd = ::open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0)
+    {
+        return -1;
+    }
+
+    ssize_t len = ::read(fd, _buff, sizeof(_buff) - 1);
+    ::close(fd);
+
+    _buff[len > 0 ? len : 0] = '\0';
+
+    return static_cast<int>(len);
+#else
+    return -1;
+#endif
+}
+
+void ResourceSampler::sample()
+{
+#if TARGET_PLATFORM_LINUX
+    int64_t nowMs = TC_TimeProvider::getInstance()->getNowMs();
+
+    sampleNode(nowMs);
+
+    set<string> setServerId;
+
+    map<string, ServerGroup> mmServerList = ServerFactory::getInstance()->getAllServers();
+    for (map<string, ServerGroup>::const_iterator it = mmServerList.begin(); it != mmServerList.end(); ++it)
+    {
+        for (map<string, ServerObjectPtr>::const_iterator p = it->second.begin(); p != it->second.end(); ++p)
+        {
+            ServerObjectPtr pServerObjectPtr = p->second;
+            if (!pServerObjectPtr || pServerObjectPtr->getPid() <= 0)
+            {
+                continue;
+            }
+
+            const string &serverId = pServerObjectPtr->getServerId();
+            setServerId.insert(serverId);
+
+            TC_ThreadLock::Lock lock(_lock);
+
+            ProcResource &proc = _procs[serverId];
+            if (proc.pid != pServerObjectPtr->getPid() || proc.container != pServerObjectPtr->isContainer())
+            {
+                //进程重启, 重新计算cpu, 历史数据保留
+                proc.pid          = pServerObjectPtr->getPid();
+                proc.container    = pServerObjectPtr->isContainer();
+                proc.lastCpuUsec  = 0;
+                proc.lastSampleMs = 0;
+                proc.cgroupCpuFile.clear();
+                proc.cgroupMemFile.clear();
+
+                if (proc.container)
+                {
+                    resolveCgroup(proc);
+                }
+            }
+
+            ResourceSample sample;
+            if (!sampleProc(proc, nowMs, sample))
+            {
+                continue;
+            }
+
+            if (proc.history.size() != _historySize)
+            {
+                proc.history.resize(_historySize);
+                proc.next  = 0;
+                proc.count = 0;
+            }
+
+            proc.history[proc.next] = sample;
+            proc.next = (proc.next + 1) % _historySize;
+            proc.count = proc.count < _historySize ? proc.count + 1 : _historySize;
+        }
+    }
+
+    //去掉已经删除或停止的服务
+    TC_ThreadLock::Lock lock(_lock);
+    for (map<string, ProcResource>::iterator it = _procs.begin(); it != _procs.end(); )
+    {
+        if (setServerId.find(it->first) == setServerId.end())
+        {
+            _procs.erase(it++);
+        }
+        else
+        {
+            ++it;
+        }
+    }
+#endif
+}
+
+bool ResourceSampler::sampleProc(ProcResource &proc, int64_t nowMs, ResourceSample &sample)
+{
+#if TARGET_PLATFORM_LINUX
+    char path[256];
+
+    snprintf(path, sizeof(path), "/proc/%lld/stat", (long long)proc.pid);
+    if (readFile(path) <= 0)
+    {
+        return false;
+    }
+
+    //进程名可能包含空格, 从最后一个')'之后开始解析, 第一个字段是第3列的进程状态
+    const char *p = strrchr(_buff, ')');
+    if (p == NULL || p[1] == '\0' || p[2] == '\0')
+    {
+        return false;
+    }
+    p += 3;
+
+    //第4列到第24列
+    uint64_t fields[21] = {0};
+    for (size_t i = 0; i < sizeof(fields) / sizeof(fields[0]); i++)
+    {
+        char *end = NULL;
+        fields[i] = strtoull(p, &end, 10);
+        if (end == p)
+        {
+            break;
+        }
+        p = end;
+    }
+
+    //utime(14) + stime(15), num_threads(20), rss(24)
+    uint64_t cpuUsec = (fields[10] + fields[11]) * 1000000 / _clkTck;
+    sample.threadNum = static_cast<int32_t>(fields[16]);
+    sample.rssKb     = static_cast<int64_t>(fields[20]) * _pageKb;
+
+    //容器取整个cgroup的占用
+    if (!proc.cgroupCpuFile.empty() && readFile(proc.cgroupCpuFile.c_str()) > 0)
+    {
+        cpuUsec = proc.cgroupV2 ? keyValue(_buff, "usage_usec") : strtoull(_buff, NULL, 10) / 1000;
+    }
+
+    if (!proc.cgroupMemFile.empty() && readFile(proc.cgroupMemFile.c_str()) > 0)
+    {
+        sample.rssKb = strtoll(_buff, NULL, 10) / 1024;
+    }
+
+    if (proc.lastSampleMs > 0 && nowMs > proc.lastSampleMs && cpuUsec >= proc.lastCpuUsec)
+    {
+        sample.cpu = (cpuUsec - proc.lastCpuUsec) * 100.0f / ((nowMs - proc.lastSampleMs) * 1000.0f);
+    }
+    proc.lastCpuUsec  = cpuUsec;
+    proc.lastSampleMs = nowMs;
+
+    //cancelled_write_bytes也包含write_bytes, 按行首匹配
+    snprintf(path, sizeof(path), "/proc/%lld/io", (long long)proc.pid);
+    if (readFile(path) > 0)
+    {
+        sample.readBytes  = keyValue(_buff, "\nread_bytes:");
+        sample.writeBytes = keyValue(_buff, "\nwrite_bytes:");
+    }
+
+    snprintf(path, sizeof(path), "/proc/%lld/fd", (long long)proc.pid);
+    DIR *dir = opendir(path);
+    if (dir != NULL)
+    {
+        struct dirent *entry = NULL;
+        while ((entry = readdir(dir)) != NULL)
+        {
+            if (entry->d_name[0] != '.')
+            {
+                ++sample.fdNum;
+            }
+        }
+        closedir(dir);
+    }
+
+    sample.sampleTime = nowMs / 1000;
+
+    return true;
+#else
+    return false;
+#endif
+}
+
+void ResourceSampler::sampleNode(int64_t nowMs)
+{
+#if TARGET_PLATFORM_LINUX
+    NodeResource node;
+    node.sampleTime = nowMs / 1000;
+
+    //第一行: cpu user nice system idle iowait irq softirq steal
+    if (readFile("/proc/stat") > 0 && strncmp(_buff, "cpu ", 4) == 0)
+    {
+        const char *p = _buff + 4;
+        uint64_t total = 0;
+        uint64_t idle  = 0;
+        for (int i = 0; i < 8; i++)
+        {
+            char *end = NULL;
+            uint64_t value = strtoull(p, &end, 10);
+            if (end == p)
+            {
+                break;
+            }
+            p = end;
+
+            total += value;
+            if (i == 3 || i == 4)
+            {
+                idle += value;
+            }
+        }
+
+        if (_lastNodeTotal > 0 && total > _lastNodeTotal && idle >= _lastNodeIdle)
+        {
+            node.cpu = 100.0f - (idle - _lastNodeIdle) * 100.0f / (total - _lastNodeTotal);
+        }
+        _lastNodeTotal = total;
+        _lastNodeIdle  = idle;
+    }
+
+    if (readFile("/proc/meminfo") > 0)
+    {
+        node.memTotalKb = keyValue(_buff, "MemTotal:");
+        node.memAvailKb = keyValue(_buff, "MemAvailable:");
+    }
+
+    double loadAvg[3];
+    if (getloadavg(loadAvg, 3) != -1)
+    {
+        node.load1  = static_cast<float>(loadAvg[0]);
+        node.load5  = static_cast<float>(loadAvg[1]);
+        node.load15 = static_cast<float>(loadAvg[2]);
+    }
+
+    TC_ThreadLock::Lock lock(_lock);
+    _node = node;
+#endif
+}
+
+void ResourceSampler::resolveCgroup(ProcResource &proc)
+{
+#if TARGET_PLATFORM_LINUX
+    char path[64];
+    snprintf(path, sizeof(path), "/proc/%lld/cgroup", (long long)proc.pid);
+    if (readFile(path) <= 0)
+    {
+        return;
+    }
+
+    //每行格式: hierarchy-ID:controller-list:cgroup-path, cgroup v2只有一行 0::path
+    string v2Path, cpuPath, memPath;
+    char *line = _buff;
+    while (line != NULL && *line != '\0')
+    {
+        char *nl = strchr(line, '\n');
+        if (nl != NULL)
+        {
+            *nl = '\0';
+        }
+
+        char *c1 = strchr(line, ':');
+        char *c2 = c1 != NULL ? strchr(c1 + 1, ':') : NULL;
+        if (c2 != NULL)
+        {
+            string controllers(c1 + 1, c2);
+            if (controllers.empty())
+            {
+                v2Path = c2 + 1;
+            }
+            else if (controllers.find("cpuacct") != string::npos)
+            {
+                cpuPath = c2 + 1;
+            }
+            else if (controllers == "memory")
+            {
+                memPath = c2 + 1;
+            }
+        }
+
+        line = nl != NULL ? nl + 1 : NULL;
+    }
+
+    //node本身运行在容器中时看不到宿主机的cgroup路径, 文件不存在时退回到进程数据
+    if (!cpuPath.empty())
+    {
+        proc.cgroupV2 = false;
+
+        const char *cpuRoot[] = { "/sys/fs/cgroup/cpu,cpuacct", "/sys/fs/cgroup/cpuacct" };
+        for (size_t i = 0; i < sizeof(cpuRoot) / sizeof(cpuRoot[0]); i++)
+        {
+            string file = string(cpuRoot[i]) + cpuPath + "/cpuacct.usage";
+            if (access(file.c_str(), R_OK) == 0)
+            {
+                proc.cgroupCpuFile = file;
+                break;
+            }
+        }
+
+        string file = "/sys/fs/cgroup/memory" + memPath + "/memory.usage_in_bytes";
+        if (!memPath.empty() && access(file.c_str(), R_OK) == 0)
+        {
+            proc.cgroupMemFile = file;
+        }
+    }
+    else if (!v2Path.empty())
+    {
+        proc.cgroupV2 = true;
+
+        string file = "/sys/fs/cgroup" + v2Path + "/cpu.stat";
+        if (access(file.c_str(), R_OK) == 0)
+        {
+            proc.cgroupCpuFile = file;
+        }
+
+        file = "/sys/fs/cgroup" + v2Path + "/memory.current";
+        if (access(file.c_str(), R_OK) == 0)
+        {
+            proc.cgroupMemFile = file;
+        }
+    }
+#endif
+}
+
+bool ResourceSampler::getLatest(const string &serverId, ResourceSample &sample)
+{
+    TC_ThreadLock::Lock lock(_lock);
+
+    map<string, ProcResource>::const_iterator it = _procs.find(serverId);
+    if (it == _procs.end() || it->second.count == 0)
+    {
+        return false;
+    }
+
+    const ProcResource &proc = it->second;
+    sample = proc.history[(proc.next + proc.history.size() - 1) % proc.history.size()];
+
+    return true;
+}
+
+void ResourceSampler::getHistory(const string &serverId, vector<ResourceSample> &vHistory)
+{
+    vHistory.clear();
+
+    TC_ThreadLock::Lock lock(_lock);
+
+    map<string, ProcResource>::const_iterator it = _procs.find(serverId);
+    if (it == _procs.end())
+    {
+        return;
+    }
+
+    const ProcResource &proc = it->second;
+    for (size_t i = 0; i < proc.count; i++)
+    {
+        vHistory.push_back(proc.history[(proc.next + proc.history.size() - 1 - i) % proc.history.size()]);
+    }
+}
+
+void ResourceSampler::getAllLatest(map<string, pair<int64_t, ResourceSample> > &mSample)
+{
+    mSample.clear();
+
+    TC_ThreadLock::Lock lock(_lock);
+
+    for (map<string, ProcResource>::const_iterator it = _procs.begin(); it != _procs.end(); ++it)
+    {
+        const ProcResource &proc = it->second;
+        if (proc.count > 0)
+        {
+            mSample[it->first] = make_pair(proc.pid, proc.history[(proc.next + proc.history.size() - 1) % proc.history.size()]);
+        }
+    }
+}
+
+NodeResource ResourceSampler::getNode()
+{
+    TC_ThreadLock::Lock lock(_lock);
+
+    return _node;
+}
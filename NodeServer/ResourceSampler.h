@@ -0,0 +1,148 @@
+/**
+ * Tencent is pleased to support the open source community by making Tars available.
+ *
+ * Copyright (C) 2016THL A29 Limited, a Tencent company. All rights reserved.
+ *
+ * Licensed under the BSD 3-Clause License (the "License"); you may not use this file except 
+ * in compliance with the License. You may obtain a copy of the License at
+ *
+ * https://opensource.org/licenses/BSD-3-Clause
+ *
+ * Unless required by applicable law or agreed to in writing, software distributed 
+ * under the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR 
+ * CONDITIONS OF ANY KIND, either express or implied. See the License for the 
+ * specific language governing permissions and limitations under the License.
+ */
+
+#ifndef __RESOURCE_SAMPLER_H_
+#define __RESOURCE_SAMPLER_H_
+
+#include <map>
+#include <vector>
+#include "util/tc_platform.h"
+#include "util/tc_monitor.h"
+#include "util/tc_singleton.h"
+
+using namespace tars;
+using namespace std;
+
+/**
+ * 一次采样的服务资源占用
+ */
+struct ResourceSample
+{
+    time_t      sampleTime  = 0;
+    float       cpu         = 0;        //cpu占用百分比, 多核时可以超过100
+    int64_t     rssKb       = 0;        //物理内存, 容器取cgroup的内存占用
+    int64_t     readBytes   = 0;        //累计读磁盘字节数
+    int64_t     writeBytes  = 0;        //累计写磁盘字节数
+    int32_t     fdNum       = 0;
+    int32_t     threadNum   = 0;
+};
+
+/**
+ * 一次采样的机器资源占用
+ */
+struct NodeResource
+{
+    time_t      sampleTime  = 0;
+    float       cpu         = 0;        //整机cpu占用百分比
+    int64_t     memTotalKb  = 0;
+    int64_t     memAvailKb  = 0;
+    float       load1       = -1.0f;
+    float       load5       = -1.0f;
+    float       load15      = -1.0f;
+};
+
+/**
+ * 服务资源采样
+ * 由ReportMemThread周期调用sample, 一次遍历读取所有服务的/proc和cgroup文件,
+ * 结果和最近一段时间的历史保存在内存中, 属性上报和getNodeLoad都直接读取采样结果
+ */
+class ResourceSampler : public TC_Singleton<ResourceSampler>
+{
+public:
+    ResourceSampler();
+
+    /**
+     * 采样本机以及所有服务
+     */
+    void sample();
+
+    /**
+     * 服务最近一次采样
+     * @return 没有采样数据时返回false
+     */
+    bool getLatest(const string &serverId, ResourceSample &sample);
+
+    /**
+     * 服务的采样历史, 从新到旧
+     */
+    void getHistory(const string &serverId, vector<ResourceSample> &vHistory);
+
+    /**
+     * 所有服务最近一次采样
+     */
+    void getAllLatest(map<string, pair<int64_t, ResourceSample> > &mSample);
+
+    /**
+     * 本机最近一次采样
+     */
+    NodeResource getNode();
+
+protected:
+    struct ProcResource
+    {
+        int64_t         pid             = 0;
+        bool            container       = false;
+        string          cgroupCpuFile;              //容器的cgroup cpu统计文件, 为空时取进程数据
+        string          cgroupMemFile;
+        bool            cgroupV2        = false;
+        uint64_t        lastCpuUsec     = 0;        //上次采样的累计cpu时间
+        int64_t         lastSampleMs    = 0;
+        vector<ResourceSample>  history;            //环形缓冲区
+        size_t          next            = 0;        //下一个写入位置
+        size_t          count           = 0;
+    };
+
+    /**
+     * 采样单个进程, 需要加锁调用
+     */
+    bool sampleProc(ProcResource &proc, int64_t nowMs, ResourceSample &sample);
+
+    /**
+     * 采样本机cpu/内存/负载
+     */
+    void sampleNode(int64_t nowMs);
+
+    /**
+     * 解析容器的cgroup文件路径
+     */
+    void resolveCgroup(ProcResource &proc);
+
+    /**
+     * 读取文件到_buff, 返回读取的长度, 失败返回-1
+     */
+    int readFile(const char *path);
+
+protected:
+    size_t                          _historySize;
+
+    long                            _clkTck;
+
+    long                            _pageKb;
+
+    char                            _buff[8192];
+
+    uint64_t                        _lastNodeTotal;     //上次采样/proc/stat的总时间
+
+    uint64_t                        _lastNodeIdle;
+
+    NodeResource                    _node;
+
+    map<string, ProcResource>       _procs;
+
+    TC_ThreadLock                   _lock;
+};
+
+#endif
@@ -66,6 +66,18 @@ int ServerFactory::eraseServer( const string& application, const string& serverN
     }
 
     _mmServerList[application].erase( serverName );
+
+    if ( g_app.getHeartbeatShm() )
+    {
+        g_app.getHeartbeatShm()->release( application + "." + serverName );
+    }
+
+#if TARGET_PLATFORM_LINUX
+    if ( g_app.getProcessWatchThread() )
+    {
+        g_app.getProcessWatchThread()->unwatch( application + "." + serverName );
+    }
+#endif
     if ( p1->second.empty() )
     {
         _mmServerList.erase( application );
@@ -295,6 +307,17 @@ ServerObjectPtr ServerFactory::createServer(const ServerDescriptor& tDesc, strin
             _bReportLoadInfo=false;
         }
 
+        //node重启前启动的服务还在写原来的槽位, 恢复槽位后才能继续读到它的共享内存心跳
+        if (g_app.getHeartbeatShm())
+        {
+            vector<string> vAdapters;
+            int iSlot = g_app.getHeartbeatShm()->find(pServerObjectPtr->getServerId(), vAdapters);
+            if (iSlot >= 0)
+            {
+                pServerObjectPtr->setHeartbeatSlot(iSlot, vAdapters);
+            }
+        }
+
         _mmServerList[application][serverName] = pServerObjectPtr;
         return pServerObjectPtr;
     }
@@ -13,6 +13,11 @@
 #include "CommandPatch.h"
 #include "CommandNotify.h"
 #include "NodeServer.h"
+#include "ResourceSampler.h"
+#include <algorithm>
+#if !TARGET_PLATFORM_WINDOWS
+#include <sys/stat.h>
+#endif
 
 extern BatchPatch * g_BatchPatchThread;
 
@@ -839,52 +844,94 @@ int ServerManager::getNodeLoad(const string& application, const string& serverNa
 #if TARGET_PLATFORM_WINDOWS
 	fileData = "not support!";
 #else
-	string cmd = "top -c -bw 160 -n 1 -o '%CPU' -o '%MEM'";
+	//资源数据由ReportMemThread周期采样, 这里只做格式化, 不再调用top
+	ResourceSampler *sampler = ResourceSampler::getInstance();
 
-	string errstr;
-	fileData = TC_Port::exec(cmd.c_str(), errstr);
-	if (fileData.empty()) {
-		if (!errstr.empty()) {
-			fileData = errstr;
-			NODE_LOG(serverId)->error() << errstr << endl;
+	char line[256];
+
+	NodeResource node = sampler->getNode();
+	snprintf(line, sizeof(line), "node: %s, cpu: %.1f%%, load average: %.2f, %.2f, %.2f, mem total: %lld kB, available: %lld kB\n",
+		TC_Common::tm2str(node.sampleTime).c_str(), node.cpu, node.load1, node.load5, node.load15, (long long)node.memTotalKb, (long long)node.memAvailKb);
+	fileData = line;
+
+	map<string, pair<int64_t, ResourceSample> > mSample;
+	sampler->getAllLatest(mSample);
+
+	//按cpu, 内存排序
+	vector<pair<string, pair<int64_t, ResourceSample> > > vSample(mSample.begin(), mSample.end());
+	std::sort(vSample.begin(), vSample.end(), [](const pair<string, pair<int64_t, ResourceSample> > &a, const pair<string, pair<int64_t, ResourceSample> > &b){
+		if (a.second.second.cpu != b.second.second.cpu)
+		{
+			return a.second.second.cpu > b.second.second.cpu;
 		}
+		return a.second.second.rssKb > b.second.second.rssKb;
+	});
+
+	snprintf(line, sizeof(line), "\n%-48s %10s %8s %12s %8s %8s %16s %16s\n", "SERVER", "PID", "%CPU", "RES(kB)", "THREADS", "FDS", "READ(B)", "WRITE(B)");
+	fileData += line;
+	for (size_t i = 0; i < vSample.size(); i++)
+	{
+		const ResourceSample &sample = vSample[i].second.second;
+		snprintf(line, sizeof(line), "%-48s %10lld %8.1f %12lld %8d %8d %16lld %16lld\n", vSample[i].first.c_str(), (long long)vSample[i].second.first,
+			sample.cpu, (long long)sample.rssKb, sample.threadNum, sample.fdNum, (long long)sample.readBytes, (long long)sample.writeBytes);
+		fileData += line;
 	}
 
 	fileData += "#global-top-end#";
 
 	if (pid > 0)
 	{
-		cmd = "top -b -n 1 -o '%CPU' -o '%MEM' -H -p " + TC_Common::tostr(pid);
 		fileData += "\n\n";
 		fileData += "#this-top-begin#" + string(100, '-');
 		fileData += "\n";
 
-		errstr.clear();
-		fileData += TC_Port::exec(cmd.c_str(), errstr);
-		if (fileData.empty()) {
-			if (!errstr.empty()) {
-				fileData += errstr;
-				NODE_LOG(serverId)->error() << errstr << endl;
-			}
+		vector<ResourceSample> vHistory;
+		sampler->getHistory(serverId, vHistory);
+
+		snprintf(line, sizeof(line), "%-20s %8s %12s %8s %8s %16s %16s\n", "TIME", "%CPU", "RES(kB)", "THREADS", "FDS", "READ(B)", "WRITE(B)");
+		fileData += line;
+		for (size_t i = 0; i < vHistory.size(); i++)
+		{
+			const ResourceSample &sample = vHistory[i];
+			snprintf(line, sizeof(line), "%-20s %8.1f %12lld %8d %8d %16lld %16lld\n", TC_Common::tm2str(sample.sampleTime).c_str(),
+				sample.cpu, (long long)sample.rssKb, sample.threadNum, sample.fdNum, (long long)sample.readBytes, (long long)sample.writeBytes);
+			fileData += line;
 		}
-		// fileData += string(buf);
+
 		fileData += "#this-top-end#";
 	}
 
-	// memset(buf, 0, sizeof(buf));
-	cmd = "cd " + ServerConfig::TarsPath + FILE_SEP + "app_log; ls -alth core.*";
 	fileData += "\n\n";
 	fileData += "#core-file-begin#" + string(100, '-');
 	fileData += "\n";
 
-	errstr.clear();
-	fileData = TC_Port::exec(cmd.c_str(), errstr);
-	if (fileData.empty()) {
-		if (!errstr.empty()) {
-			fileData = errstr;
-			NODE_LOG(serverId)->error() << errstr << endl;
+	vector<string> vFiles;
+	TC_File::listDirectory(ServerConfig::TarsPath + FILE_SEP + "app_log", vFiles, false);
+
+	vector<pair<time_t, string> > vCore;
+	for (size_t i = 0; i < vFiles.size(); i++)
+	{
+		string fileName = TC_File::extractFileName(vFiles[i]);
+		if (fileName.compare(0, 5, "core.") != 0)
+		{
+			continue;
+		}
+
+		struct stat st;
+		if (::stat(vFiles[i].c_str(), &st) == 0)
+		{
+			snprintf(line, sizeof(line), "%-20s %16lld %s\n", TC_Common::tm2str(st.st_mtime).c_str(), (long long)st.st_size, fileName.c_str());
+			vCore.push_back(make_pair(st.st_mtime, string(line)));
 		}
 	}
+
+	//与ls -t一致, 最新的在前
+	std::sort(vCore.begin(), vCore.end(), [](const pair<time_t, string> &a, const pair<time_t, string> &b){ return a.first > b.first; });
+	for (size_t i = 0; i < vCore.size(); i++)
+	{
+		fileData += vCore[i].second;
+	}
+
 	NODE_LOG(serverId)->debug() << fileData << endl;
 #endif
 
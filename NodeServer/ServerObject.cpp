@@ -27,6 +27,7 @@
 #include "CommandStop.h"
 #include "CommandDestroy.h"
 #include "CommandAddFile.h"
+#include "ResourceSampler.h"
 
 ServerObject::ServerObject( const ServerDescriptor& tDesc)
 : _tarsServer(true)
@@ -392,6 +393,15 @@ string ServerObject::toStringState(InternalServerState eState) const
 
 int ServerObject::checkPid()
 {
+#if TARGET_PLATFORM_LINUX
+	//已监听退出事件且没有退出, 不需要inspect容器或者kill(pid, 0)
+	ProcessWatchThread *pWatch = g_app.getProcessWatchThread();
+	if (pWatch && _pid > 0 && pWatch->isWatchedAlive(_serverId, _pid))
+	{
+		return 0;
+	}
+#endif
+
 	if (isContainer())
 	{
 		TC_Docker docker;
@@ -414,6 +424,7 @@ int ServerObject::checkPid()
 			{
 				_procStartTime = TC_Common::UTC2LocalTime(startTime);
 				setPid(pid);
+				watchPid(pid);
 
 				return 0;
 			}
@@ -465,6 +476,8 @@ int ServerObject::checkPid()
 				return -1;
 			}
 
+			watchPid(_pid);
+
 			return 0;
 #endif
 		}
@@ -476,6 +489,17 @@ int ServerObject::checkPid()
 
 }
 
+void ServerObject::watchPid(int64_t pid)
+{
+#if TARGET_PLATFORM_LINUX
+	ProcessWatchThread *pWatch = g_app.getProcessWatchThread();
+	if (pWatch && pid > 0)
+	{
+		pWatch->watch(_serverId, pid, isContainer());
+	}
+#endif
+}
+
 void ServerObject::keepAlive(const ServerInfo &si, const string &adapter)
 {
 	keepAlive(si.pid, adapter);
@@ -585,9 +609,61 @@ int ServerObject::getLastKeepAliveTime(const string &adapter)
 }
 
 
+void ServerObject::setHeartbeatSlot(int index, const vector<string> &adapters)
+{
+    Lock lock(*this);
+    _heartbeatSlot     = index;
+    _heartbeatAdapters = adapters;
+}
+
+void ServerObject::syncHeartbeat()
+{
+    HeartbeatShm *pShm = g_app.getHeartbeatShm();
+    if (!pShm)
+    {
+        return;
+    }
+
+    Lock lock(*this);
+    if (_heartbeatSlot < 0)
+    {
+        return;
+    }
+
+    for (size_t i = 0; i < _heartbeatAdapters.size(); i++)
+    {
+        int64_t pid = 0;
+        time_t t = (time_t)pShm->getHeartbeat(_heartbeatSlot + (int)i, pid);
+
+        map<string, time_t>::iterator it = _adapterKeepAliveTime.find(_heartbeatAdapters[i]);
+        if (t <= 0 || it == _adapterKeepAliveTime.end() || t <= it->second)
+        {
+            continue;
+        }
+
+        if (_state == ServerObject::Active)
+        {
+            it->second = t;
+            if (t > _keepAliveTime)
+            {
+                _keepAliveTime = t;
+            }
+        }
+        else
+        {
+            //需要切换状态或者更新pid, 与rpc心跳的处理一致
+            keepAlive(pid, _heartbeatAdapters[i]);
+        }
+    }
+}
+
 bool ServerObject::isTimeOut(int iTimeout)
 {
     Lock lock(*this);
+
+    //共享内存心跳与rpc心跳取最新的
+    syncHeartbeat();
+
     time_t now = TNOW;
     if(now - _keepAliveTime > iTimeout)
     {
@@ -829,6 +905,8 @@ bool ServerObject::checkServer(int iTimeout)
     {
         string sResult;
 
+        syncHeartbeat();
+
 	    int flag = checkPid();
         
         //可能会出现刚startServer完后，就会马上进行心跳检测。
@@ -877,14 +955,25 @@ bool ServerObject::checkServer(int iTimeout)
         //启动服务
         if( _state == ServerObject::Inactive && isAutoStart() == true)
         {
+            //已经在启动队列中或者正在启动
+            AutoStart *autoStart = g_app.getAutoStart();
+            if (autoStart && !autoStart->push_back(this))
+            {
+                return false;
+            }
+
             sResult = sResult == ""?"[alarm] down, server is inactive":sResult;
             NODE_LOG(_serverId)->debug() <<FILE_FUN<<_serverId<<" "<<sResult << ", _state:" << toStringState(_state) << endl;
 	        NODE_LOG("KeepAliveThread")->debug() <<FILE_FUN<<_serverId<<" "<<sResult << "|_state:" << toStringState(_state) << endl;
 
 	        g_app.reportServer(_serverId, "", getNodeInfo().nodeName, sResult);
 
-            CommandStart command(this);
-            command.doProcess();
+            //由启动线程并发拉起, 不阻塞保活线程检查其它服务
+            if (!autoStart)
+            {
+                CommandStart command(this);
+                command.doProcess();
+            }
 
 	        //配置了coredump检测才进行操作
             if(_limitStateInfo.bEnableCoreLimit)
@@ -916,42 +1005,17 @@ void ServerObject::reportMemProperty()
 {
     try
     {
-        char sTmp[64] ={0};
-        snprintf(sTmp,sizeof(sTmp), "%llu", _pid);
-        string spid = string(sTmp);
-
-        string filename = "/proc/" + spid + "/statm";
-        string stream;
-        stream = TC_File::load2str(filename);
-        if(!stream.empty())
+        //由ReportMemThread统一采样, 这里只读取最近一次的结果
+        ResourceSample sample;
+        if (ResourceSampler::getInstance()->getLatest(_serverId, sample))
         {
-            NODE_LOG("ReportThread")->debug()<<FILE_FUN<<"filename:"<<filename<<",stream:"<<stream<<endl;
-            //>>改成上报物理内存
-            vector<string> vtStatm = TC_Common::sepstr<string>(stream, " ");
-            if (vtStatm.size() < 2)
-            {
-                NODE_LOG("ReportThread")->error() <<FILE_FUN<< "cannot get server[" + _serverId  + "] physical mem size|stream|" << stream  << endl;
-            }
-            else
-            {
-                stream = vtStatm[1];
-            }
-
-            if(TC_Common::isdigit(stream))
-            {
-                REPORT_MAX(_serverId, _serverId+".memsize", TC_Common::strto<int>(stream) * 4);
-                NODE_LOG("ReportThread")->debug()<<FILE_FUN<<"report_max("<<_serverId<<".memsize,"<<TC_Common::strto<int>(stream)*4<<")OK."<<endl;
-                return;
-            }
-            else
-            {
-                NODE_LOG("ReportThread")->error()<<FILE_FUN<<"stream : "<<stream<<" ,is not a digit."<<endl;
-            }
-       }
-       else
-       {
-           NODE_LOG("ReportThread")->error()<<FILE_FUN<<"stream is empty: "<<stream<<endl;
-       }
+            REPORT_MAX(_serverId, _serverId+".memsize", sample.rssKb);
+            NODE_LOG("ReportThread")->debug()<<FILE_FUN<<"report_max("<<_serverId<<".memsize,"<<sample.rssKb<<")OK."<<endl;
+        }
+        else
+        {
+            NODE_LOG("ReportThread")->debug()<<FILE_FUN<<_serverId<<"|pid:"<<_pid<<"|no resource sample"<<endl;
+        }
     }
     catch(exception &ex)
     {
@@ -201,6 +201,11 @@ public:
     */
     int checkPid();
 
+    /**
+    * 确认存活后监听进程退出事件, 监听期间checkPid不需要真实检查
+    */
+    void watchPid(int64_t pid);
+
     /**
     * 设置server对应pid
     */
@@ -264,6 +269,18 @@ public:
      */
     bool isTimeOut(int iTimeout);
 
+    /**
+     * 设置服务在共享内存心跳表中的槽位, 启动服务前分配
+     * @param index 起始槽位, -1表示没有槽位
+     * @param adapters 每个槽位对应的adapter
+     */
+    void setHeartbeatSlot(int index, const vector<string> &adapters);
+
+    /**
+     * 读取共享内存心跳表, 有更新的心跳按keepAlive处理
+     */
+    void syncHeartbeat();
+
 	/*
 	 *	是否已经通过commandStart启动成功
 	 */
@@ -613,6 +630,8 @@ private:
     bool				 _started;				//是否已经通过commandStart启动成功
 	int64_t              _startTime;			//启动的时间,作为checkpid系统延迟判断的起点
 	time_t               _procStartTime = 0;    // 进程启动时间， 从系统中获取
+	int                  _heartbeatSlot = -1;   //共享内存心跳表中的起始槽位
+	vector<string>       _heartbeatAdapters;    //每个槽位对应的adapter
 };
 
 typedef TC_AutoPtr<ServerObject> ServerObjectPtr;
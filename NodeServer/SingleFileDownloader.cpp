@@ -17,31 +17,467 @@
 #include "SingleFileDownloader.h"
 #include "NodeServer.h"
 #include "util.h"
+#include "Md5Hasher.h"
+#include "util/tc_md5.h"
+#include "tars_range.h"
+#include <atomic>
+#include <mutex>
+#include <thread>
+
+#if !TARGET_PLATFORM_WINDOWS
+#include <fcntl.h>
+#include <unistd.h>
+#endif
 
 DownloadTaskFactory* DownloadTaskFactory::_instance = new DownloadTaskFactory();
 
-int SingleFileDownloader::download(const PatchPrx &patchPrx, const string &remoteFile, const string &localFile, const DownloadEventPtr &pPtr, const string &application, const string &serverName, const string &nodeName, std::string & sResult)
+//并行下载的状态, 所有下载线程共享
+struct ChunkDownloadContext
+{
+    vector<DownloadSource>  vSource;            //按优先级排列的下载源, 最后一个是patch
+    vector<char>            vSourceFailed;      //下载出错的源, 不再使用
+    string                  remoteFile;
+    string                  serverId;
+    FileInfo                fileInfo;
+    DownloadEventPtr        pPtr;
+    size_t                  chunkSize = 0;
+
+    vector<size_t>          vPending;           //待下载的块
+    std::atomic<size_t>     next{0};            //下一个领取的块在vPending中的位置
+    std::atomic<size_t>     downloaded{0};      //已下载的字节数
+
+    std::mutex              lock;
+    int                     ret = 0;            //第一个出错的错误码
+    string                  sResult;
+
+#if TARGET_PLATFORM_WINDOWS
+    FILE                    *fp = NULL;
+#else
+    int                     fd = -1;
+#endif
+    FILE                    *rangesFp = NULL;
+
+    vector<char>            vDone;              //各块是否已写入文件
+    std::mutex              hashLock;           //同一时间只有一个线程计算md5
+    size_t                  hashNext = 0;       //下一个计入md5的块, 只在hashLock内访问
+    Md5Hasher               hasher;
+    vector<char>            hashBuffer;
+
+    //第一个可用的下载源, 最后一个源不会被标记为出错
+    size_t getSource()
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        size_t i = 0;
+        while (i + 1 < vSource.size() && vSourceFailed[i])
+        {
+            ++i;
+        }
+        return i;
+    }
+
+    void sourceFailed(size_t i)
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        vSourceFailed[i] = 1;
+    }
+
+    bool failed()
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        return ret != 0;
+    }
+
+    void setError(int iRet, const string &sErr)
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        if (ret == 0)
+        {
+            ret     = iRet;
+            sResult = sErr;
+        }
+    }
+
+    bool writeAt(size_t offset, const char *data, size_t len)
+    {
+#if TARGET_PLATFORM_WINDOWS
+        std::lock_guard<std::mutex> guard(lock);
+        return _fseeki64(fp, offset, SEEK_SET) == 0 && fwrite(data, 1, len, fp) == len;
+#else
+        while (len > 0)
+        {
+            ssize_t n = ::pwrite(fd, data, len, offset);
+            if (n < 0 && errno == EINTR)
+            {
+                continue;
+            }
+            if (n <= 0)
+            {
+                return false;
+            }
+            data   += n;
+            offset += n;
+            len    -= n;
+        }
+        return true;
+#endif
+    }
+
+    bool readAt(size_t offset, char *data, size_t len)
+    {
+#if TARGET_PLATFORM_WINDOWS
+        std::lock_guard<std::mutex> guard(lock);
+        return _fseeki64(fp, offset, SEEK_SET) == 0 && fread(data, 1, len, fp) == len;
+#else
+        while (len > 0)
+        {
+            ssize_t n = ::pread(fd, data, len, offset);
+            if (n < 0 && errno == EINTR)
+            {
+                continue;
+            }
+            if (n <= 0)
+            {
+                return false;
+            }
+            data   += n;
+            offset += n;
+            len    -= n;
+        }
+        return true;
+#endif
+    }
+
+    void chunkDone(size_t index)
+    {
+        {
+            std::lock_guard<std::mutex> guard(lock);
+            vDone[index] = 1;
+            fprintf(rangesFp, "%zu\n", index);
+            fflush(rangesFp);
+        }
+
+        if (!updateHash(false))
+        {
+            setError(-5, "read file '" + remoteFile + "' error!");
+        }
+    }
+
+    //md5必须按顺序计算, 把从hashNext开始已写入的连续块计入md5
+    //块刚写入还在page cache中, 不需要下载完成后再从磁盘读一遍整个文件
+    //wait为false时如果其它线程正在计算就直接返回, 剩下的块由后面完成的线程或者下载结束后补算
+    bool updateHash(bool wait)
+    {
+        std::unique_lock<std::mutex> hashGuard(hashLock, std::defer_lock);
+        if (wait)
+        {
+            hashGuard.lock();
+        }
+        else if (!hashGuard.try_lock())
+        {
+            return true;
+        }
+
+        while (true)
+        {
+            {
+                std::lock_guard<std::mutex> guard(lock);
+                if (hashNext >= vDone.size() || !vDone[hashNext])
+                {
+                    break;
+                }
+            }
+
+            size_t begin = hashNext * chunkSize;
+            size_t len   = std::min(chunkSize, (size_t)fileInfo.size - begin);
+
+            hashBuffer.resize(len);
+            if (len > 0 && !readAt(begin, &hashBuffer[0], len))
+            {
+                return false;
+            }
+
+            hasher.update(hashBuffer.data(), len);
+            if (pPtr)
+            {
+                pPtr->onData(hashBuffer.data(), len);
+            }
+            ++hashNext;
+        }
+
+        return true;
+    }
+};
+
+set<size_t> SingleFileDownloader::loadRanges(const string &rangesFile, const FileInfo &fileInfo, size_t chunkSize)
+{
+    set<size_t> setDone;
+    if (!TC_File::isFileExist(rangesFile))
+    {
+        return setDone;
+    }
+
+    //第一行: 文件大小 md5 块大小, 之后每行一个已完成的块
+    vector<string> vLines = TC_Common::sepstr<string>(TC_File::load2str(rangesFile), "\n");
+    if (vLines.empty() || vLines[0] != TC_Common::tostr(fileInfo.size) + " " + fileInfo.md5 + " " + TC_Common::tostr(chunkSize))
+    {
+        return setDone;
+    }
+
+    size_t chunkNum = (fileInfo.size + chunkSize - 1) / chunkSize;
+    for (size_t i = 1; i < vLines.size(); i++)
+    {
+        //最后一行可能没写完整
+        if (!TC_Common::isdigit(vLines[i]))
+        {
+            continue;
+        }
+
+        size_t index = TC_Common::strto<size_t>(vLines[i]);
+        if (index < chunkNum)
+        {
+            setDone.insert(index);
+        }
+    }
+
+    return setDone;
+}
+
+int SingleFileDownloader::downloadChunk(ChunkDownloadContext *context, size_t index, vector<char> &buffer)
+{
+    size_t begin = index * context->chunkSize;
+    size_t end   = std::min(begin + context->chunkSize, (size_t)context->fileInfo.size);
+    size_t pos   = begin;
+
+    //整个块作为一个范围请求, 服务端按自己的rangeMax截断, 老的patch/节点不认识范围参数时按它配置的size返回,
+    //所以一个块仍然可能需要多次请求
+    while (pos < end)
+    {
+        if (context->failed())
+        {
+            return -1;
+        }
+
+        buffer.clear();
+
+        int downloadRet = -1;
+
+        //文件的第一个请求要求带上文件大小和md5
+        bool withInfo = (pos == 0);
+        map<string, string> reqContext;
+        map<string, string> rspContext;
+        TarsRange::setRequest(reqContext, pos, end - pos, withInfo);
+
+        //从第一个可用的源下载, 其它节点出错时换下一个源, 最后由patch兜底
+        while (true)
+        {
+            size_t source = context->getSource();
+            const DownloadSource &src = context->vSource[source];
+
+            downloadRet = -1;
+
+            //最多尝试两次
+            for (int i = 0; i < 2; i++)
+            {
+                try
+                {
+                    rspContext.clear();
+                    downloadRet = src.patchPrx->download(src.remoteFile, (int)pos, buffer, reqContext, &rspContext);
+                    break;
+                }
+                catch (TarsException& ex)
+                {
+                    NODE_LOG(context->serverId)->error() << "SingleFileDownloader::download " << (src.remoteFile + " TarsException " + ex.what()) << "|pos:" << pos << endl;
+                }
+            }
+
+            if ((downloadRet == 0 && !buffer.empty()) || source + 1 >= context->vSource.size())
+            {
+                break;
+            }
+
+            NODE_LOG(context->serverId)->error() << "SingleFileDownloader::download from " << src.patchPrx->tars_name() << " error, downloadRet:" << downloadRet << "|pos:" << pos << ", try next source" << endl;
+            context->sourceFailed(source);
+            buffer.clear();
+        }
+
+        if (downloadRet < 0)
+        {
+            NODE_LOG(context->serverId)->error() << "SingleFileDownloader::download " << "|downloadRet:" << downloadRet << "|remoteFile:" << context->remoteFile << "|pos:" << pos << endl;
+            context->setError(downloadRet - 100, context->remoteFile + " download from patch error " + TC_Common::tostr(downloadRet));
+            return -1;
+        }
+
+        if (downloadRet == 1 || buffer.empty())
+        {
+            //文件比listFileInfo时短, 发布过程中文件被修改了
+            context->setError(-6, context->remoteFile + " not download finish");
+            return -1;
+        }
+
+        size_t fileSize = 0;
+        string fileMd5;
+        if (withInfo && TarsRange::getFileInfo(rspContext, fileSize, fileMd5)
+            && (fileSize != (size_t)context->fileInfo.size || fileMd5 != context->fileInfo.md5))
+        {
+            //和listFileInfo时不一致, 发布过程中文件被修改了
+            NODE_LOG(context->serverId)->error() << "SingleFileDownloader::download " << context->remoteFile << " changed, size:" << fileSize << "|md5:" << fileMd5 << endl;
+            context->setError(-6, context->remoteFile + " changed while downloading");
+            return -1;
+        }
+
+        size_t len = std::min(buffer.size(), end - pos);
+        if (!context->writeAt(pos, &buffer[0], len))
+        {
+            NODE_LOG(context->serverId)->error() << "SingleFileDownloader::download pwrite error:" << errno << "|pos:" << pos << endl;
+            context->setError(-5, "pwrite file '" + context->remoteFile + "' error!");
+            return -1;
+        }
+
+        pos += len;
+
+        size_t downloaded = context->downloaded.fetch_add(len) + len;
+        if (context->pPtr)
+        {
+            context->pPtr->onDownloading(context->fileInfo, (int)downloaded);
+        }
+    }
+
+    context->chunkDone(index);
+
+    return 0;
+}
+
+void SingleFileDownloader::downloadChunks(ChunkDownloadContext *context)
 {
+    vector<char> buffer;
+
+    try
+    {
+        while (!context->failed())
+        {
+            size_t i = context->next.fetch_add(1);
+            if (i >= context->vPending.size())
+            {
+                break;
+            }
+
+            if (downloadChunk(context, context->vPending[i], buffer) != 0)
+            {
+                break;
+            }
+        }
+    }
+    catch (exception &ex)
+    {
+        context->setError(-6, context->remoteFile + " download exception:" + ex.what());
+    }
+    catch (...)
+    {
+        context->setError(-6, context->remoteFile + " download unknown exception");
+    }
+}
+
+int SingleFileDownloader::download(const PatchPrx &patchPrx, const string &remoteFile, const string &localFile, const DownloadEventPtr &pPtr, const string &application, const string &serverName, const string &nodeName, std::string & sResult, std::string & sMd5)
+{
+    vector<DownloadSource> vSource(1);
+    vSource[0].patchPrx   = patchPrx;
+    vSource[0].remoteFile = remoteFile;
+
+    return download(vSource, localFile, pPtr, application, serverName, nodeName, sResult, sMd5);
+}
+
+int SingleFileDownloader::download(const vector<DownloadSource> &vSource, const string &localFile, const DownloadEventPtr &pPtr, const string &application, const string &serverName, const string &nodeName, std::string & sResult, std::string & sMd5, const std::string & sExpectMd5)
+{
+    sMd5 = "";
+
 	string serverId = application + "." + serverName;
 
+    if (vSource.empty())
+    {
+        sResult = "no download source";
+        NODE_LOG(serverId)->error() << "SingleFileDownloader::download error:"<< sResult << endl;
+        return -1;
+    }
+
+    //对方节点没有进展超过这个时间才换下一个源
+    int waitTime = TC_Common::strto<int>(g_pconf->get("/tars/node<peerWaitTime>", "60"));
+
     vector<FileInfo> vFiles;
     int ret = 0;
-    
-    for( int i = 0; i < 2; i ++)
+    size_t first = 0;
+
+    const string waitFile = localFile + ".wait";
+
+    //依次从各个源获取文件信息, 第一个成功的源及其后面的源用于下载
+    for (; first < vSource.size(); first++)
     {
-        try
+        const DownloadSource &src = vSource[first];
+        bool last = (first + 1 == vSource.size());
+
+        //对方报告的下载进度, 有变化就继续等
+        int64_t progress   = -1;
+        int64_t lastChange = TNOWMS;
+
+        while (true)
         {
-            ret = patchPrx->listFileInfo(remoteFile, vFiles);
+            ret = 0;
+            vFiles.clear();
+
+            for( int i = 0; i < 2; i ++)
+            {
+                try
+                {
+                    ret = src.patchPrx->listFileInfo(src.remoteFile, vFiles);
+                    break;
+                }
+                catch(TarsException& ex)
+                {
+                    if (last)
+                    {
+                        g_app.reportServer(application + "." + serverName, "", nodeName, string("download error:") + ex.what());
+                    }
+                    NODE_LOG(serverId)->error() << "SingleFileDownloader::download " << (src.remoteFile + " TarsException " + ex.what())<< endl;
+                }
+            }
+
+            //分发树中的节点正在下载同一个包, 或者任务中各节点同时开始, 对方还没开始下载, 等它下载完
+            //对方一直有进展就一直等, 不然树上的节点都会在超时后同时回到patch下载
+            if (!last && (ret == PEER_PATCH_DOWNLOADING || ret == PEER_PATCH_NOT_FOUND))
+            {
+                int64_t current = (ret == PEER_PATCH_DOWNLOADING && !vFiles.empty()) ? vFiles[0].size : -1;
+                if (current != progress)
+                {
+                    progress   = current;
+                    lastChange = TNOWMS;
+                }
+
+                if (TNOWMS - lastChange < waitTime * 1000)
+                {
+                    //自己还没开始下载, 把上游的进度转告给等待自己的节点, 否则它们会认为没有进展
+                    TC_File::save2file(waitFile, TC_Common::tostr(progress));
+                    TC_Common::msleep(1000);
+                    continue;
+                }
+
+                NODE_LOG(serverId)->debug() << "SingleFileDownloader::download " << src.patchPrx->tars_name() << " no progress in " << waitTime << "s, ret:" << ret << endl;
+            }
+
             break;
         }
-        catch(TarsException& ex)
+
+        if ((ret == 1 && !vFiles.empty()) || last)
         {
-            g_app.reportServer(application + "." + serverName, "", nodeName, string("download error:") + ex.what());     
-            NODE_LOG(serverId)->error() << "SingleFileDownloader::download " << (remoteFile + " TarsException " + ex.what())<< endl;
+            break;
         }
+
+        NODE_LOG(serverId)->debug() << "SingleFileDownloader::download " << src.patchPrx->tars_name() << " not available, ret:" << ret << ", try next source" << endl;
     }
 
-	NODE_LOG(serverId)->debug() << "SingleFileDownloader::download file count:"<< vFiles.size() << endl;
+    TC_File::removeFile(waitFile, false);
+
+    const string &remoteFile = vSource[first].remoteFile;
+
+	NODE_LOG(serverId)->debug() << "SingleFileDownloader::download file count:"<< vFiles.size() << "|source:" << vSource[first].patchPrx->tars_name() << endl;
 
 	//1表示是文件
     if(ret != 1)
@@ -60,85 +496,175 @@ int SingleFileDownloader::download(const PatchPrx &patchPrx, const string &remot
         return -2;
     }
 
-    FileInfo fileInfo = vFiles[0];
+    ChunkDownloadContext context;
+    context.vSource.assign(vSource.begin() + first, vSource.end());
+    context.vSourceFailed.resize(context.vSource.size(), 0);
+    context.remoteFile  = remoteFile;
+    context.serverId    = serverId;
+    context.fileInfo    = vFiles[0];
+    context.pPtr        = pPtr;
+    context.chunkSize   = TC_Common::toSize(g_pconf->get("/tars/node<downloadChunkSize>", DOWNLOAD_CHUNK_SIZE), 1024*1024);
+    context.chunkSize   = context.chunkSize < 64*1024 ? 64*1024 : context.chunkSize;
 
-    FILE *fp = fopen(localFile.c_str(), "wb");
-    if (!fp)
+    int threads = TC_Common::strto<int>(g_pconf->get("/tars/node<downloadThreads>", "4"));
+    threads = threads < 1 ? 1 : threads;
+
+    const size_t fileSize = context.fileInfo.size;
+    const string partFile   = localFile + ".part";
+    const string rangesFile = partFile + ".ranges";
+
+    //同一个文件之前下载中断过, 只下载未完成的块
+    set<size_t> setDone;
+    if (TC_File::isFileExist(partFile) && (size_t)TC_File::getFileSize(partFile) == fileSize)
     {
+        setDone = loadRanges(rangesFile, context.fileInfo, context.chunkSize);
+    }
+
+    size_t chunkNum = (fileSize + context.chunkSize - 1) / context.chunkSize;
+    context.vDone.resize(chunkNum, 0);
+    for (size_t i = 0; i < chunkNum; i++)
+    {
+        if (setDone.find(i) == setDone.end())
+        {
+            context.vPending.push_back(i);
+        }
+        else
+        {
+            context.vDone[i] = 1;
+            context.downloaded += std::min(context.chunkSize, fileSize - i * context.chunkSize);
+        }
+    }
+
+    NODE_LOG(serverId)->debug() << "SingleFileDownloader::download " << remoteFile << "|size:" << fileSize << "|chunks:" << chunkNum
+                                << "|resume chunks:" << setDone.size() << "|threads:" << threads << endl;
+
+    bool opened = false;
+#if TARGET_PLATFORM_WINDOWS
+    context.fp = fopen(partFile.c_str(), setDone.empty() ? "w+b" : "r+b");
+    opened = (context.fp != NULL);
+#else
+    context.fd = ::open(partFile.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+    if (context.fd >= 0 && setDone.empty())
+    {
+        //预先分配空间, 各块按偏移写入
+        opened = (::ftruncate(context.fd, 0) == 0 && ::ftruncate(context.fd, fileSize) == 0);
+    }
+    else
+    {
+        opened = (context.fd >= 0);
+    }
+#endif
+
+    if (opened)
+    {
+        context.rangesFp = fopen(rangesFile.c_str(), setDone.empty() ? "w" : "a");
+        if (context.rangesFp && setDone.empty())
+        {
+            fprintf(context.rangesFp, "%s\n", (TC_Common::tostr(fileSize) + " " + context.fileInfo.md5 + " " + TC_Common::tostr(context.chunkSize)).c_str());
+            fflush(context.rangesFp);
+        }
+        opened = (context.rangesFp != NULL);
+    }
+
+    if (!opened)
+    {
+        ret = -3;
         sResult = localFile + " can not write";
         g_app.reportServer(application + "." + serverName, "", nodeName, string("download error:") + sResult);
 	    NODE_LOG(serverId)->error() << "SingleFileDownloader::download error:"<< sResult << endl;
-        return -3;
     }
+    else
+    {
+        if (pPtr)
+        {
+            pPtr->onDownloading(context.fileInfo, (int)context.downloaded);
+        }
 
-    //循环下载文件到本地
-    vector<char> buffer;
-    int pos         = 0;
-    int downloadRet = 0;
-    bool fileEnded  = false;
-    while (true)
+        //多个块同时请求, 当前线程也参与下载
+        vector<std::thread> vThreads;
+        for (int i = 1; i < threads && (size_t)i < context.vPending.size(); i++)
+        {
+            vThreads.push_back(std::thread(&SingleFileDownloader::downloadChunks, &context));
+        }
+
+        downloadChunks(&context);
+
+        for (size_t i = 0; i < vThreads.size(); i++)
+        {
+            vThreads[i].join();
+        }
+
+        ret = context.ret;
+        if (ret != 0)
+        {
+            sResult = context.sResult;
+        }
+        else if (context.updateHash(true) && context.hashNext == chunkNum)
+        {
+            //续传的块和没来得及计算的块在这里补算
+            sMd5 = context.hasher.final();
+        }
+    }
+
+#if TARGET_PLATFORM_WINDOWS
+    if (context.fp)
     {
-        buffer.clear();
+        fclose(context.fp);
+    }
+#else
+    if (context.fd >= 0)
+    {
+        ::close(context.fd);
+    }
+#endif
 
-        //最多尝试两次
-        for( int i = 0; i < 2; i ++)
+    if (context.rangesFp)
+    {
+        fclose(context.rangesFp);
+    }
+
+    if (ret == 0 && !sExpectMd5.empty())
+    {
+        if (sMd5.empty())
         {
-            try
-            {
-                downloadRet = patchPrx->download(remoteFile, pos, buffer);
-                break;
-            }
-            catch(TarsException& ex)
-            {
-                g_app.reportServer(application + "." + serverName, "", nodeName, string("download error:") + sResult);     
-	            NODE_LOG(serverId)->error() << "SingleFileDownloader::download "<< (remoteFile + " TarsException " + ex.what()) << endl;
-            }
+            sMd5 = TC_MD5::md5file(partFile);
         }
 
-        if (downloadRet < 0)
+        if (TC_Common::lower(sMd5) != TC_Common::lower(sExpectMd5))
         {
-	        NODE_LOG(serverId)->error() << "SingleFileDownloader::download " << "|downloadRet:" << downloadRet << "|remoteFile:"  << remoteFile << endl;
-            sResult = remoteFile + " download from patch error " + TC_Common::tostr(downloadRet);
-            ret = downloadRet - 100;
-            g_app.reportServer(application + "." + serverName, "", nodeName, string("download error:") + sResult);     
-            break;
+            //内容不对, 不能续传
+            ret = -6;
+            sResult = string("request md5:") + sExpectMd5 + ", local file md5:" + sMd5 + ", md5 is not equal";
+            TC_File::removeFile(partFile, false);
+            TC_File::removeFile(rangesFile, false);
         }
-        else if (downloadRet == 0)
+    }
+
+    if (ret == 0)
+    {
+        //全部完成并校验后才出现在localFile, 中断时保留.part和.ranges用于续传
+        TC_File::removeFile(localFile, false);
+        if (::rename(partFile.c_str(), localFile.c_str()) != 0)
         {
-            size_t r = fwrite((void*)&buffer[0], 1, buffer.size(), fp);
-            if (r == 0)
-            {
-	            NODE_LOG(serverId)->error() << "SingleFileDownloader::download fwrite file '" + localFile + "' error!" << endl;
-                sResult = "fwrite file '" + localFile + "' error!";
-                g_app.reportServer(application + "." + serverName, "", nodeName, string("download error:") + sResult);     
-                ret = -5;
-                break;
-            }
-            pos += r;
-            if(pPtr)
-            {
-                pPtr->onDownloading(fileInfo, pos);
-            }
+            ret = -5;
+            sResult = "rename file '" + partFile + "' error!";
         }
-        else if (downloadRet == 1)
+        else
         {
-	        NODE_LOG(serverId)->debug() << "SingleFileDownloader::download load succ " << remoteFile << "|pos:"<<pos<<endl;
-            g_app.reportServer(application + "." + serverName, "", nodeName, string("download succ"));     
-            ret = 0;
-            fileEnded = true;
-            break;
+            TC_File::removeFile(rangesFile, false);
         }
     }
 
-    if(!fileEnded)
+    if (ret == 0)
     {
-        ret = -6;
-        sResult = remoteFile + " not download finish";
-	    NODE_LOG(serverId)->error() << "SingleFileDownloader::download error:" << sResult << endl;
+	    NODE_LOG(serverId)->debug() << "SingleFileDownloader::download load succ " << remoteFile << "|size:" << fileSize << "|md5:" << sMd5 << endl;
+        g_app.reportServer(application + "." + serverName, "", nodeName, string("download succ"));
+    }
+    else if (ret != -3)
+    {
+	    NODE_LOG(serverId)->error() << "SingleFileDownloader::download error:" << sResult << "|ret:" << ret << endl;
         g_app.reportServer(application + "." + serverName, "", nodeName, string("download error:") + sResult);
     }
 
-    fclose(fp);
-
     return ret;
 }
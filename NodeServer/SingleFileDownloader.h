@@ -26,6 +26,11 @@ class DownloadEvent : public TC_HandleBase
 {
 public:
     virtual void onDownloading(const FileInfo &fi, int pos) = 0;
+
+    /**
+     * 按文件顺序收到的数据(包括续传时已下载的部分), 可以边下载边处理, 默认不处理
+     */
+    virtual void onData(const char *data, size_t len) {}
 };
 
 typedef TC_AutoPtr<DownloadEvent> DownloadEventPtr;
@@ -80,13 +85,61 @@ private:
     static DownloadTaskFactory* _instance;
 };
 
+//配置/tars/node<downloadChunkSize>的默认值: 下载时的块大小, 也是节点对外提供发布包时每次返回的大小
+#define DOWNLOAD_CHUNK_SIZE     "8M"
+
+//节点间分发发布包时, 对方节点正在下载同一个包, 返回的文件信息中size表示对方的下载进度, 有变化说明还在下载
+#define PEER_PATCH_DOWNLOADING  (-10)
+
+//对方节点还没有这个包(可能还没开始下载)
+#define PEER_PATCH_NOT_FOUND    (-2)
+
+//对方节点的PatchAdapter没有配置allow, 不对外提供发布包
+#define PEER_PATCH_DISABLED     (-11)
+
+//对方节点是通过差量还原的, 只有解压后的tar, 没有发布包
+#define PEER_PATCH_NO_PACKAGE   (-12)
+
+//下载源, patch或者已经有发布包的其它节点
+struct DownloadSource
+{
+    PatchPrx    patchPrx;
+    string      remoteFile;
+};
+
+struct ChunkDownloadContext;
+
 //从patch上下载单个文件
+//文件按块并行下载到预先分配好的localFile.part中, 已完成的块记录在localFile.part.ranges,
+//下载中断后再次下载同一个文件(大小和md5不变)时只下载未完成的块, 全部完成后改名为localFile
+//下载过程中按顺序计算md5, 成功时通过sMd5返回, 计算失败时sMd5为空, 由调用者自行计算
+//指定了sExpectMd5时, 在.part改名为localFile之前校验, 不一致时删除.part并返回失败, localFile一定是校验过的
 class SingleFileDownloader
 {
 public:
-    static int download(const PatchPrx &patchPrx, const string &remoteFile, const string &localFile, const DownloadEventPtr &pPtr, const string &application, const string &serverName, const string &nodeName, std::string & sResult);
+    static int download(const PatchPrx &patchPrx, const string &remoteFile, const string &localFile, const DownloadEventPtr &pPtr, const string &application, const string &serverName, const string &nodeName, std::string & sResult, std::string & sMd5);
+
+    /**
+     * 从多个源下载, 按顺序使用, 某个源出错后换下一个, 最后一个源(patch)出错才失败
+     * 源是节点时, 如果它正在下载或者还没有同一个包, 等它下载完, 连续peerWaitTime秒没有进展才换下一个源
+     */
+    static int download(const vector<DownloadSource> &vSource, const string &localFile, const DownloadEventPtr &pPtr, const string &application, const string &serverName, const string &nodeName, std::string & sResult, std::string & sMd5, const std::string & sExpectMd5 = "");
 
 private:
+    /**
+     * 读取已完成的块, 文件大小/md5/块大小不一致时返回空
+     */
+    static set<size_t> loadRanges(const string &rangesFile, const FileInfo &fileInfo, size_t chunkSize);
+
+    /**
+     * 下载线程, 依次领取未完成的块下载
+     */
+    static void downloadChunks(ChunkDownloadContext *context);
+
+    /**
+     * 下载一个块, 返回0成功, 其它为错误码
+     */
+    static int downloadChunk(ChunkDownloadContext *context, size_t index, vector<char> &buffer);
 };
 //////////////////////////////////////////////////////////////
 #endif
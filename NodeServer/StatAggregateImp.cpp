@@ -0,0 +1,45 @@
+/**
+ * Tencent is pleased to support the open source community by making Tars available.
+ *
+ * Copyright (C) 2016THL A29 Limited, a Tencent company. All rights reserved.
+ *
+ * Licensed under the BSD 3-Clause License (the "License"); you may not use this file except 
+ * in compliance with the License. You may obtain a copy of the License at
+ *
+ * https://opensource.org/licenses/BSD-3-Clause
+ *
+ * Unless required by applicable law or agreed to in writing, software distributed 
+ * under the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR 
+ * CONDITIONS OF ANY KIND, either express or implied. See the License for the 
+ * specific language governing permissions and limitations under the License.
+ */
+
+
+#include "StatAggregateImp.h"
+#include "NodeServer.h"
+
+int StatAggregateImp::reportMicMsg(const map<tars::StatMicMsgHead, tars::StatMicMsgBody> &statmsg, bool bFromClient, CurrentPtr current)
+{
+    ReportAggregateThread *pAggregate = g_app.getReportAggregateThread();
+    if (!pAggregate)
+    {
+        return -1;
+    }
+
+    pAggregate->addMicMsg(statmsg, bFromClient);
+
+    return 0;
+}
+
+int StatAggregateImp::reportSampleMsg(const vector<StatSampleMsg> &msg, CurrentPtr current)
+{
+    ReportAggregateThread *pAggregate = g_app.getReportAggregateThread();
+    if (!pAggregate)
+    {
+        return -1;
+    }
+
+    pAggregate->reportSampleMsg(msg);
+
+    return 0;
+}
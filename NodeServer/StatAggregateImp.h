@@ -0,0 +1,57 @@
+/**
+ * Tencent is pleased to support the open source community by making Tars available.
+ *
+ * Copyright (C) 2016THL A29 Limited, a Tencent company. All rights reserved.
+ *
+ * Licensed under the BSD 3-Clause License (the "License"); you may not use this file except 
+ * in compliance with the License. You may obtain a copy of the License at
+ *
+ * https://opensource.org/licenses/BSD-3-Clause
+ *
+ * Unless required by applicable law or agreed to in writing, software distributed 
+ * under the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR 
+ * CONDITIONS OF ANY KIND, either express or implied. See the License for the 
+ * specific language governing permissions and limitations under the License.
+ */
+
+
+#ifndef __STAT_AGGREGATE_IMP_H_
+#define __STAT_AGGREGATE_IMP_H_
+
+#include "servant/StatF.h"
+
+using namespace tars;
+
+/**
+ * 节点本地的调用统计上报接口
+ * 接口与tarsstat相同, 本机服务把client<stat>配置成node的StatObj即可, 数据由ReportAggregateThread合并后上报
+ */
+class StatAggregateImp : public StatF
+{
+public:
+    /**
+     * 初始化
+     */
+    virtual void initialize() {};
+
+    /**
+     * 退出
+     */
+    virtual void destroy() {};
+
+    /**
+     * 上报模块间调用信息
+     * @param statmsg, 上报信息
+     * @return int, 返回0表示成功
+     */
+    virtual int reportMicMsg(const map<tars::StatMicMsgHead, tars::StatMicMsgBody> &statmsg, bool bFromClient, CurrentPtr current);
+
+    /**
+     * 上报模块间调用采样信息
+     * @param msg, 上报信息
+     * @return int, 返回0表示成功
+     */
+    virtual int reportSampleMsg(const vector<StatSampleMsg> &msg, CurrentPtr current);
+};
+
+#endif
@@ -0,0 +1,660 @@
+/**
+ * Tencent is pleased to support the open source community by making Tars available.
+ *
+ * Copyright (C) 2016THL A29 Limited, a Tencent company. All rights reserved.
+ *
+ * Licensed under the BSD 3-Clause License (the "License"); you may not use this file except 
+ * in compliance with the License. You may obtain a copy of the License at
+ *
+ * https://opensource.org/licenses/BSD-3-Clause
+ *
+ * Unless required by applicable law or agreed to in writing, software distributed 
+ * under the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR 
+ * CONDITIONS OF ANY KIND, either express or implied. See the License for the 
+ * specific language governing permissions and limitations under the License.
+ */
+
+#include "TarExtractor.h"
+#include "util/tc_file.h"
+#include "util/tc_common.h"
+
+#if !TARGET_PLATFORM_WINDOWS
+
+#include <zlib.h>
+#include <fcntl.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+using namespace tars;
+
+#define TAR_BLOCK_SIZE  512
+
+//长文件名/pax扩展头的最大长度
+#define TAR_MAX_META    (1024 * 1024)
+
+//解析tar头中的数字, 一般是八进制字符串, 最高位为1时是base-256编码(gnu大文件)
+static int64_t parseNumber(const char *p, size_t len)
+{
+    int64_t v = 0;
+    if (len > 0 && (p[0] & 0x80))
+    {
+        v = p[0] & 0x3f;
+        for (size_t i = 1; i < len; i++)
+        {
+            v = (v << 8) | (unsigned char)p[i];
+        }
+        return v;
+    }
+
+    size_t i = 0;
+    while (i < len && (p[i] == ' ' || p[i] == '\0'))
+    {
+        i++;
+    }
+
+    for (; i < len && p[i] >= '0' && p[i] <= '7'; i++)
+    {
+        v = (v << 3) + (p[i] - '0');
+    }
+
+    return v;
+}
+
+static string parseString(const char *p, size_t len)
+{
+    return string(p, strnlen(p, len));
+}
+
+TarExtractor::TarExtractor(const string &destPath)
+: _destPath(TC_File::simplifyDirectory(destPath))
+, _destFd(-1)
+, _finished(false)
+, _detected(false)
+, _raw(false)
+, _zs(new z_stream())
+, _zsEnd(false)
+, _out(256 * 1024)
+, _state(TAR_HEADER)
+, _blockLen(0)
+, _zeroBlocks(0)
+, _remaining(0)
+, _padding(0)
+, _metaType(0)
+, _paxSize(-1)
+, _entryMode(0)
+, _entryMtime(0)
+, _fd(-1)
+{
+    memset(_zs, 0, sizeof(z_stream));
+
+    //15+32: 自动识别gzip/zlib头
+    if (inflateInit2(_zs, 15 + 32) != Z_OK)
+    {
+        setError("inflateInit2 error");
+    }
+
+    _destFd = ::open(_destPath.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (_destFd < 0)
+    {
+        setError("open " + _destPath + " error:" + strerror(errno));
+    }
+}
+
+TarExtractor::~TarExtractor()
+{
+    if (_fd >= 0)
+    {
+        ::close(_fd);
+    }
+
+    if (_destFd >= 0)
+    {
+        ::close(_destFd);
+    }
+
+    inflateEnd(_zs);
+    delete _zs;
+}
+
+void TarExtractor::setError(const string &sErr)
+{
+    if (_error.empty())
+    {
+        _error = sErr;
+    }
+
+    if (_fd >= 0)
+    {
+        ::close(_fd);
+        _fd = -1;
+    }
+}
+
+void TarExtractor::input(const char *data, size_t len)
+{
+    if (!_error.empty() || _finished || len == 0)
+    {
+        return;
+    }
+
+    if (!_detected)
+    {
+        //gzip以0x1f 0x8b开头, tar的第一个字节是文件名
+        _detected = true;
+        _raw      = ((unsigned char)data[0] != 0x1f);
+    }
+
+    if (_raw)
+    {
+        onTarData(data, len);
+        return;
+    }
+
+    _zs->next_in  = (Bytef *)data;
+    _zs->avail_in = (uInt)len;
+
+    do
+    {
+        //多个gzip流拼接在一起
+        if (_zsEnd)
+        {
+            inflateReset(_zs);
+            _zsEnd = false;
+        }
+
+        _zs->next_out  = (Bytef *)&_out[0];
+        _zs->avail_out = (uInt)_out.size();
+
+        int ret = inflate(_zs, Z_NO_FLUSH);
+        if (ret != Z_OK && ret != Z_STREAM_END && ret != Z_BUF_ERROR)
+        {
+            setError(string("gzip data error:") + (_zs->msg ? _zs->msg : TC_Common::tostr(ret)));
+            return;
+        }
+
+        size_t produced = _out.size() - _zs->avail_out;
+        onTarData(&_out[0], produced);
+
+        if (ret == Z_STREAM_END)
+        {
+            _zsEnd = true;
+        }
+        else if (ret == Z_BUF_ERROR && produced == 0)
+        {
+            break;
+        }
+    }
+    while ((_zs->avail_in > 0 || _zs->avail_out == 0) && _error.empty() && !_finished);
+}
+
+bool TarExtractor::finish()
+{
+    if (!_finished && (_zsEnd || _raw) && _state == TAR_HEADER && _blockLen == 0)
+    {
+        _finished = true;
+    }
+
+    if (!_finished && _error.empty())
+    {
+        setError("tgz data is not complete");
+    }
+
+    return _finished && _error.empty();
+}
+
+void TarExtractor::skip(uint64_t n)
+{
+    _remaining = n;
+    _state     = (n > 0 ? TAR_SKIP : TAR_HEADER);
+}
+
+void TarExtractor::onTarData(const char *data, size_t len)
+{
+    while (len > 0 && _error.empty())
+    {
+        size_t n = 0;
+
+        switch (_state)
+        {
+            case TAR_HEADER:
+                n = std::min(len, (size_t)TAR_BLOCK_SIZE - _blockLen);
+                memcpy(_block + _blockLen, data, n);
+                _blockLen += n;
+                if (_blockLen == TAR_BLOCK_SIZE)
+                {
+                    _blockLen = 0;
+                    onHeader();
+                }
+                break;
+
+            case TAR_DATA:
+                n = (size_t)std::min((uint64_t)len, _remaining);
+                for (size_t off = 0; off < n; )
+                {
+                    ssize_t w = ::write(_fd, data + off, n - off);
+                    if (w < 0 && errno == EINTR)
+                    {
+                        continue;
+                    }
+                    if (w <= 0)
+                    {
+                        setError("write " + _entryPath + " error:" + strerror(errno));
+                        return;
+                    }
+                    off += w;
+                }
+                _remaining -= n;
+                if (_remaining == 0)
+                {
+                    onFileEnd();
+                }
+                break;
+
+            case TAR_META:
+                n = (size_t)std::min((uint64_t)len, _remaining);
+                _meta.append(data, n);
+                _remaining -= n;
+                if (_remaining == 0)
+                {
+                    onMeta();
+                }
+                break;
+
+            case TAR_SKIP:
+                n = (size_t)std::min((uint64_t)len, _remaining);
+                _remaining -= n;
+                if (_remaining == 0)
+                {
+                    _state = TAR_HEADER;
+                }
+                break;
+
+            case TAR_END:
+                //结束标记之后的填充不处理
+                return;
+        }
+
+        data += n;
+        len  -= n;
+    }
+}
+
+bool TarExtractor::splitPath(const string &name, vector<string> &vItem)
+{
+    vItem.clear();
+
+    if (name.empty() || name[0] == '/')
+    {
+        return false;
+    }
+
+    vector<string> v = TC_Common::sepstr<string>(name, "/");
+    for (size_t i = 0; i < v.size(); i++)
+    {
+        if (v[i] == "..")
+        {
+            return false;
+        }
+
+        if (v[i] != ".")
+        {
+            vItem.push_back(v[i]);
+        }
+    }
+
+    return !vItem.empty();
+}
+
+int TarExtractor::openDir(const vector<string> &vItem, size_t n, bool create)
+{
+    int fd = ::dup(_destFd);
+
+    for (size_t i = 0; i < n && fd >= 0; i++)
+    {
+        if (create && ::mkdirat(fd, vItem[i].c_str(), 0755) != 0 && errno != EEXIST)
+        {
+            ::close(fd);
+            return -1;
+        }
+
+        //已经存在的软链接打开失败(ELOOP/ENOTDIR), 不会跟随到其它目录
+        int next = ::openat(fd, vItem[i].c_str(), O_RDONLY | O_DIRECTORY | O_NOFOLLOW | O_CLOEXEC);
+        ::close(fd);
+        fd = next;
+    }
+
+    return fd;
+}
+
+void TarExtractor::onHeader()
+{
+    //全0的块是结束标记
+    bool zero = true;
+    for (size_t i = 0; i < TAR_BLOCK_SIZE && zero; i++)
+    {
+        zero = (_block[i] == 0);
+    }
+
+    if (zero)
+    {
+        _finished = true;
+        _state    = TAR_END;
+        return;
+    }
+
+    //校验和: 校验和字段按8个空格计算, 兼容有符号的实现
+    int64_t checksum = parseNumber(_block + 148, 8);
+    int64_t usum = 0;
+    int64_t ssum = 0;
+    for (size_t i = 0; i < TAR_BLOCK_SIZE; i++)
+    {
+        char c = (i >= 148 && i < 156) ? ' ' : _block[i];
+        usum += (unsigned char)c;
+        ssum += (signed char)c;
+    }
+
+    if (checksum != usum && checksum != ssum)
+    {
+        setError("tar header checksum error");
+        return;
+    }
+
+    char type      = _block[156];
+    int64_t size   = parseNumber(_block + 124, 12);
+
+    //长文件名和pax扩展头, 数据在后面
+    if (type == 'L' || type == 'K' || type == 'x')
+    {
+        if (size > TAR_MAX_META)
+        {
+            setError("tar extended header too long");
+            return;
+        }
+
+        _metaType  = type;
+        _padding   = (TAR_BLOCK_SIZE - size % TAR_BLOCK_SIZE) % TAR_BLOCK_SIZE;
+        _remaining = size;
+        _meta.clear();
+        _state = TAR_META;
+        if (size == 0)
+        {
+            onMeta();
+        }
+        return;
+    }
+
+    if (type == 'g')
+    {
+        skip(size + (TAR_BLOCK_SIZE - size % TAR_BLOCK_SIZE) % TAR_BLOCK_SIZE);
+        return;
+    }
+
+    if (_paxSize >= 0)
+    {
+        size = _paxSize;
+    }
+
+    string name = _longName;
+    if (name.empty())
+    {
+        name = parseString(_block, 100);
+
+        //ustar的前缀
+        string prefix = parseString(_block + 345, 155);
+        if (memcmp(_block + 257, "ustar", 5) == 0 && !prefix.empty())
+        {
+            name = prefix + "/" + name;
+        }
+    }
+
+    string link = _longLink.empty() ? parseString(_block + 157, 100) : _longLink;
+
+    _longName.clear();
+    _longLink.clear();
+    _paxSize = -1;
+
+    vector<string> vItem;
+    if (!splitPath(name, vItem))
+    {
+        setError("invalid path in tar:" + name);
+        return;
+    }
+
+    string path = TC_File::simplifyDirectory(_destPath + FILE_SEP + name);
+
+    _entryPath  = path;
+    _entryMode  = (int)(parseNumber(_block + 100, 8) & 07777);
+    _entryMtime = parseNumber(_block + 136, 12);
+    _padding    = (TAR_BLOCK_SIZE - size % TAR_BLOCK_SIZE) % TAR_BLOCK_SIZE;
+
+    const string &base = vItem.back();
+
+    switch (type)
+    {
+        case '0':
+        case '\0':
+        case '7':
+        {
+            int dirFd = openDir(vItem, vItem.size() - 1, true);
+            if (dirFd < 0)
+            {
+                setError("open dir of " + path + " error:" + strerror(errno));
+                return;
+            }
+
+            ::unlinkat(dirFd, base.c_str(), 0);
+            _fd = ::openat(dirFd, base.c_str(), O_WRONLY | O_CREAT | O_EXCL | O_NOFOLLOW | O_CLOEXEC, 0600);
+            ::close(dirFd);
+            if (_fd < 0)
+            {
+                setError("open " + path + " error:" + strerror(errno));
+                return;
+            }
+
+            _remaining = size;
+            _state     = TAR_DATA;
+            if (size == 0)
+            {
+                onFileEnd();
+            }
+            return;
+        }
+        case '5':
+        {
+            //目录需要可写, 后面的文件才能解压进去
+            int dirFd = openDir(vItem, vItem.size(), true);
+            if (dirFd < 0 || ::fchmod(dirFd, _entryMode | 0700) != 0)
+            {
+                setError("mkdir " + path + " error:" + strerror(errno));
+                if (dirFd >= 0)
+                {
+                    ::close(dirFd);
+                }
+                return;
+            }
+            ::close(dirFd);
+            break;
+        }
+        case '2':
+        {
+            //和tar xzf一样, 目标可以是绝对路径或者解压目录之外(比如/usr/lib/...),
+            //解压时所有路径都逐级openat(O_NOFOLLOW), 不会经过这个链接
+            if (link.empty())
+            {
+                setError("invalid symlink in tar:" + path);
+                return;
+            }
+
+            int dirFd = openDir(vItem, vItem.size() - 1, true);
+            if (dirFd < 0)
+            {
+                setError("open dir of " + path + " error:" + strerror(errno));
+                return;
+            }
+
+            ::unlinkat(dirFd, base.c_str(), 0);
+            int ret = ::symlinkat(link.c_str(), dirFd, base.c_str());
+            ::close(dirFd);
+            if (ret != 0)
+            {
+                setError("symlink " + path + " error:" + strerror(errno));
+                return;
+            }
+            break;
+        }
+        case '1':
+        {
+            vector<string> vTarget;
+            if (!splitPath(link, vTarget))
+            {
+                setError("invalid link in tar:" + link);
+                return;
+            }
+
+            int targetFd = openDir(vTarget, vTarget.size() - 1, false);
+            int dirFd    = openDir(vItem, vItem.size() - 1, true);
+            int ret      = -1;
+            if (targetFd >= 0 && dirFd >= 0)
+            {
+                ::unlinkat(dirFd, base.c_str(), 0);
+
+                //flags为0, 目标是软链接时链接软链接本身
+                ret = ::linkat(targetFd, vTarget.back().c_str(), dirFd, base.c_str(), 0);
+            }
+
+            int err = errno;
+            if (targetFd >= 0)
+            {
+                ::close(targetFd);
+            }
+            if (dirFd >= 0)
+            {
+                ::close(dirFd);
+            }
+
+            if (ret != 0)
+            {
+                setError("link " + path + " to " + link + " error:" + strerror(err));
+                return;
+            }
+            break;
+        }
+        default:
+            //设备文件, fifo等不解压
+            break;
+    }
+
+    skip(size + _padding);
+}
+
+void TarExtractor::onMeta()
+{
+    if (_metaType == 'L')
+    {
+        _longName = parseString(_meta.c_str(), _meta.size());
+    }
+    else if (_metaType == 'K')
+    {
+        _longLink = parseString(_meta.c_str(), _meta.size());
+    }
+    else
+    {
+        //pax记录: "长度 key=value\n", 长度包括整条记录
+        size_t pos = 0;
+        while (pos < _meta.size())
+        {
+            size_t space = _meta.find(' ', pos);
+            if (space == string::npos)
+            {
+                break;
+            }
+
+            size_t recordLen = TC_Common::strto<size_t>(_meta.substr(pos, space - pos));
+            if (recordLen == 0 || pos + recordLen > _meta.size())
+            {
+                break;
+            }
+
+            string record = _meta.substr(space + 1, pos + recordLen - space - 2);
+            size_t eq = record.find('=');
+            if (eq != string::npos)
+            {
+                string key = record.substr(0, eq);
+                if (key == "path")
+                {
+                    _longName = record.substr(eq + 1);
+                }
+                else if (key == "linkpath")
+                {
+                    _longLink = record.substr(eq + 1);
+                }
+                else if (key == "size")
+                {
+                    _paxSize = TC_Common::strto<int64_t>(record.substr(eq + 1));
+                }
+            }
+
+            pos += recordLen;
+        }
+    }
+
+    _meta.clear();
+    skip(_padding);
+}
+
+void TarExtractor::onFileEnd()
+{
+    ::fchmod(_fd, _entryMode);
+
+    struct timespec times[2];
+    times[0].tv_sec  = _entryMtime;
+    times[0].tv_nsec = 0;
+    times[1]         = times[0];
+    ::futimens(_fd, times);
+
+    if (::close(_fd) != 0)
+    {
+        _fd = -1;
+        setError("close " + _entryPath + " error:" + strerror(errno));
+        return;
+    }
+
+    _fd = -1;
+    skip(_padding);
+}
+
+int TarExtractor::extractFile(const string &tgzFile, const string &destPath, string &sResult)
+{
+    FILE *fp = fopen(tgzFile.c_str(), "rb");
+    if (!fp)
+    {
+        sResult = "open " + tgzFile + " error:" + strerror(errno);
+        return -1;
+    }
+
+    TarExtractor extractor(destPath);
+
+    vector<char> buffer(256 * 1024);
+    size_t n;
+    while ((n = fread(&buffer[0], 1, buffer.size(), fp)) > 0)
+    {
+        extractor.input(&buffer[0], n);
+        if (!extractor.getError().empty())
+        {
+            break;
+        }
+    }
+
+    fclose(fp);
+
+    if (!extractor.finish())
+    {
+        sResult = "extract " + tgzFile + " error:" + extractor.getError();
+        return -1;
+    }
+
+    return 0;
+}
+
+#endif
@@ -0,0 +1,156 @@
+/**
+ * Tencent is pleased to support the open source community by making Tars available.
+ *
+ * Copyright (C) 2016THL A29 Limited, a Tencent company. All rights reserved.
+ *
+ * Licensed under the BSD 3-Clause License (the "License"); you may not use this file except 
+ * in compliance with the License. You may obtain a copy of the License at
+ *
+ * https://opensource.org/licenses/BSD-3-Clause
+ *
+ * Unless required by applicable law or agreed to in writing, software distributed 
+ * under the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR 
+ * CONDITIONS OF ANY KIND, either express or implied. See the License for the 
+ * specific language governing permissions and limitations under the License.
+ */
+
+#ifndef __TAR_EXTRACTOR_H_
+#define __TAR_EXTRACTOR_H_
+
+#include <string>
+#include <vector>
+#include <stdint.h>
+#include "util/tc_platform.h"
+
+using namespace std;
+
+struct z_stream_s;
+
+/**
+ * 进程内解压tgz(gzip + tar), 代替fork出busybox tar xzf, 也支持没有压缩的tar
+ * 数据可以分多次输入, 下载过程中按顺序收到的数据直接解压, 不需要等整个文件下载完
+ * 支持ustar/gnu长文件名/pax扩展头, 普通文件/目录/软链接/硬链接,
+ * 文件名是绝对路径或者包含..的直接报错, 软链接的目标原样创建(可以是绝对路径或者destPath之外),
+ * 所有路径都从destPath开始逐级openat(O_NOFOLLOW), 不会经过包里(或目录中已有)的软链接写到destPath之外
+ * 数据没有校验过时只能解压到临时的目录, 校验失败时整个目录丢掉
+ * 只在非windows平台实现(依赖zlib)
+ */
+class TarExtractor
+{
+public:
+    /**
+     * @param destPath 解压目录, 需要已经存在
+     */
+    TarExtractor(const string &destPath);
+
+    ~TarExtractor();
+
+    /**
+     * 输入gzip压缩(或没有压缩)的tar数据, 根据第一个字节识别格式, 出错后忽略后续的数据
+     */
+    void input(const char *data, size_t len);
+
+    /**
+     * 输入结束, 返回是否已经完整解压且没有出错
+     * 没有tar结束标记时, gzip流结束且刚好在两个成员之间也认为是完整的
+     */
+    bool finish();
+
+    /**
+     * 错误信息, 为空表示没有出错
+     */
+    const string &getError() const { return _error; }
+
+    /**
+     * 解压目录
+     */
+    const string &getDestPath() const { return _destPath; }
+
+    /**
+     * 解压整个文件
+     * @return 0成功, 其它失败
+     */
+    static int extractFile(const string &tgzFile, const string &destPath, string &sResult);
+
+protected:
+    enum State
+    {
+        TAR_HEADER,         //读取512字节的头
+        TAR_DATA,           //普通文件数据
+        TAR_META,           //长文件名/pax扩展头的数据
+        TAR_SKIP,           //不处理的数据和对齐的填充
+        TAR_END,            //已结束
+    };
+
+    void setError(const string &sErr);
+
+    /**
+     * 解压后的tar数据
+     */
+    void onTarData(const char *data, size_t len);
+
+    /**
+     * 解析头, 准备接收数据
+     */
+    void onHeader();
+
+    /**
+     * 长文件名/pax扩展头数据接收完
+     */
+    void onMeta();
+
+    /**
+     * 普通文件的数据接收完
+     */
+    void onFileEnd();
+
+    /**
+     * 跳过n个字节后读取下一个头
+     */
+    void skip(uint64_t n);
+
+    /**
+     * 检查并拆分成路径的各级, 绝对路径或者包含..时返回false
+     */
+    bool splitPath(const string &name, vector<string> &vItem);
+
+    /**
+     * 从解压目录开始逐级打开前n级目录, 不跟随软链接, create为true时创建不存在的目录
+     * @return 目录的fd, 失败返回-1
+     */
+    int openDir(const vector<string> &vItem, size_t n, bool create);
+
+protected:
+    string          _destPath;
+    int             _destFd;
+    string          _error;
+    bool            _finished;
+    bool            _detected;          //是否已经识别格式
+    bool            _raw;               //没有压缩的tar
+
+    z_stream_s      *_zs;
+    bool            _zsEnd;
+    vector<char>    _out;
+
+    State           _state;
+    char            _block[512];
+    size_t          _blockLen;
+    int             _zeroBlocks;
+
+    uint64_t        _remaining;         //当前成员未接收的数据
+    size_t          _padding;           //当前成员数据后的填充
+
+    char            _metaType;
+    string          _meta;
+
+    string          _longName;          //gnu长文件名或pax中的path, 对下一个成员有效
+    string          _longLink;
+    int64_t         _paxSize;           //pax中的size, 对下一个成员有效, -1表示没有
+
+    string          _entryPath;         //当前写入的文件
+    int             _entryMode;
+    int64_t         _entryMtime;
+    int             _fd;
+};
+
+#endif
@@ -15,266 +15,180 @@
  */
 
 #include <sys/stat.h>
-// #include <unistd.h>
+#include <fcntl.h>
+#if !TARGET_PLATFORM_WINDOWS
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
 #include "util/tc_port.h"
 #include "PatchCache.h"
 #include "PatchServer.h"
 
 using namespace tars;
 
-int PatchCache::load(const std::string & sFile, std::pair<char *, size_t> & mem)
+PatchCache::MappedFile::~MappedFile()
 {
-    TLOGDEBUG("PatchCache::load sFile:" << sFile << endl);
-
-    struct MemState * cur = NULL;
-
-    TC_ThreadLock::Lock lock(_mutex);
-    
-    try
+    if (MemBuf != NULL)
     {
-        TC_Port::stat_t st;
-        memset(&st, 0, sizeof(struct stat));
-
-        if (TC_Port::lstat(sFile.c_str(), &st) != 0)
-        {
-            TLOGERROR("PatchCache::load sFile:" << sFile << "|lstat file error:" << strerror(errno) << endl);
-            return -1;
-        }
-        
-        if ((size_t)st.st_size > _MemMax || (size_t)st.st_size < _MemMin)
-        {
-            TLOGERROR("PatchCache::load sFile:" << sFile << "|invalid file size must(" << _MemMax << ">" << st.st_size << ">" << _MemMin << ")" << endl);
-            return -1;
-        }
+#if TARGET_PLATFORM_WINDOWS
+        delete[] MemBuf;
+#else
+        munmap(MemBuf, FileSize);
+#endif
+        MemBuf = NULL;
+    }
+}
 
-        //查看是否已经加载入内存
-        std::map<std::string, struct MemState *>::iterator it = _mapFiles.find(sFile);
-        if (it != _mapFiles.end())
-        {
-            cur = it->second;
-            
-            if ((cur->MemLoad  == EM_LOADING || cur->MemLoad == EM_RELOAD))//错误都为1状态
-            {
-                TLOGERROR("PatchCache::load sFile:" << sFile << "|loading file now|MemLoad:" << cur->MemLoad << "|MemCount:" << cur->MemCount << "|FileName:" << cur->FileName << endl);
+PatchCache::MappedFilePtr PatchCache::__mapFile(const std::string & sFile)
+{
+    MappedFilePtr mf = std::make_shared<MappedFile>();
+    mf->FileName = sFile;
 
-                //这里是由于内存分配不足，导致出现loading的状态
-                _mapFiles.erase(sFile);
+#if TARGET_PLATFORM_WINDOWS
+    TC_Port::stat_t st;
+    if (TC_Port::lstat(sFile.c_str(), &st) != 0)
+    {
+        return NULL;
+    }
 
-                return -1;
-            }
-            
-            if (cur->FileSize == (size_t)st.st_size && cur->FileTime == st.st_mtime && cur->FileInode == st.st_ino)
-            {
-                mem.first       = cur->MemBuf;
-                mem.second      = cur->FileSize;
-                cur->MemTime    = time(NULL);
-                cur->MemCount++;
+    mf->FileSize    = st.st_size;
+    mf->FileInode   = st.st_ino;
+    mf->FileTime    = st.st_mtime;
+    mf->MemBuf      = new char[mf->FileSize];
 
-                TLOGDEBUG("PatchCache::load sFile:" << sFile << "|reuse file in mem" << endl);
-                return 0;
-            }
-            else
-            {
-                cur->FileSize   = st.st_size;
-                cur->FileInode  = st.st_ino;
-                cur->FileTime   = st.st_mtime;
-                cur->MemLoad    = EM_RELOAD;
-                
-                mem.first       = cur->MemBuf;
-                mem.second      = st.st_size;
-                
-                TLOGDEBUG("PatchCache::load sFile:" << sFile << "|need reload file" << endl);
-            }
-        }
-        else
-        {
-            if (__getMem(sFile, cur) == -1)
-            {
-                TLOGERROR("PatchCache::load sFile:" << sFile << "|get free mem fault" << endl);
-                return -1;
-            }
-
-            cur->FileName   = sFile;
-            cur->FileSize   = st.st_size;
-            cur->FileInode  = st.st_ino;
-            cur->FileTime   = st.st_mtime;
+    FILE * fp = TC_Port::fopen(sFile.c_str(), "rb");
+    if (fp == NULL)
+    {
+        return NULL;
+    }
 
-            mem.first       = cur->MemBuf;
-            mem.second      = cur->FileSize;
+    size_t r = fread(mf->MemBuf, 1, mf->FileSize, fp);
+    fclose(fp);
 
-            if (_mapFiles.find(sFile) == _mapFiles.end())
-            {
-                _mapFiles.insert(make_pair(sFile,cur));
-            }
-        }
-    }
-    catch (std::exception & ex)
+    if (r != mf->FileSize)
     {
-        TLOGERROR("PatchCache::load sFile:" << sFile << "|exception:" << ex.what() << endl);
-        return -1;
+        TLOGERROR("PatchCache::__mapFile sFile:" << sFile << "|read:" << r << "|size:" << mf->FileSize << endl);
+        return NULL;
     }
-    catch (...)
+#else
+    int fd = open(sFile.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0)
     {
-        TLOGERROR("PatchCache::load sFile:" << sFile << "|unknown Exception" << endl);
-        return -1;
+        TLOGERROR("PatchCache::__mapFile sFile:" << sFile << "|open file error:" << strerror(errno) << endl);
+        return NULL;
     }
-    
-    if (__loadFile(sFile, cur->MemBuf, cur->FileSize) == 0)
-    {
-        cur->MemCount++;
-        cur->MemTime = time(NULL);
-        cur->MemLoad = EM_LOADED;
 
-        return 0;
+    //以打开的文件为准, 避免stat之后文件被替换
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size <= 0)
+    {
+        close(fd);
+        return NULL;
     }
-    else
+
+    void *addr = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+
+    if (addr == MAP_FAILED)
     {
-        cur->MemTime = 0;
-        cur->MemLoad = EM_NLOAD;
-        return -1;
+        TLOGERROR("PatchCache::__mapFile sFile:" << sFile << "|mmap error:" << strerror(errno) << endl);
+        return NULL;
     }
 
-    return -1;
+    //很多节点同时下载同一个文件的不同范围, 不是顺序访问, 缓存的都是热文件, 直接预读整个文件
+    madvise(addr, st.st_size, MADV_WILLNEED);
+
+    mf->FileSize    = st.st_size;
+    mf->FileInode   = st.st_ino;
+    mf->FileTime    = st.st_mtime;
+    mf->MemBuf      = (char *)addr;
+#endif
+
+    return mf;
 }
 
-int PatchCache::release(const std::string & sFile)
+void PatchCache::__erase(Shard &shard, std::unordered_map<std::string, std::list<MappedFilePtr>::iterator>::iterator it)
 {
-    TLOGDEBUG("PatchCache::release sFile:" << sFile << endl);
+    shard.Bytes -= (*it->second)->FileSize;
+    shard.Lru.erase(it->second);
+    shard.Files.erase(it);
+}
 
-    try
-    {
-        TC_ThreadLock::Lock lock(_mutex);
-        
-        std::map<std::string, MemState *>::iterator it = _mapFiles.find(sFile);
-        if (it == _mapFiles.end())
-        {
-            TLOGERROR("PatchCache::release Find '" << sFile << "' fault" << endl);
-            return -1;
-        }
+PatchCache::MappedFilePtr PatchCache::load(const std::string & sFile)
+{
+    TC_Port::stat_t st;
+    memset(&st, 0, sizeof(st));
 
-        it->second->MemCount--;
-        
-        TLOGDEBUG("PatchCache::release sFile:" << sFile << "|count:" << it->second->MemCount << endl);
-        return 0;
-    }
-    catch (std::exception & ex)
+    if (TC_Port::lstat(sFile.c_str(), &st) != 0)
     {
-        TLOGERROR("PatchCache::release sFile:" << sFile  << "|exception:" << ex.what() << endl);
+        TLOGERROR("PatchCache::load sFile:" << sFile << "|lstat file error:" << strerror(errno) << endl);
+        return NULL;
     }
-    catch (...)
+
+    if ((size_t)st.st_size > _MemMax || (size_t)st.st_size < _MemMin)
     {
-        TLOGERROR("PatchCache::release sFile:" << sFile  << "|unknown Exception" << endl);
+        TLOGDEBUG("PatchCache::load sFile:" << sFile << "|file size not cached(" << _MemMax << ">" << st.st_size << ">" << _MemMin << ")" << endl);
+        return NULL;
     }
-    
-    return -1;
-}
 
-int PatchCache::__getMem(const std::string & sFile, struct MemState *& cur)
-{
-    TLOGDEBUG("PatchCache::__getMem sFile:" << sFile << endl);
+    Shard &shard = _shards[std::hash<std::string>()(sFile) % SHARD_NUM];
 
-    cur = NULL;
-    
-    for (size_t i = 0; i < _vecMems.size(); i++)
     {
-        struct MemState * st = _vecMems[i];
+        TC_ThreadLock::Lock lock(shard.Mutex);
 
-        TLOGDEBUG("PatchCache::__getMem sFile:" << sFile << "|MemLoad:"<<st->MemLoad << "|MemCount:" << st->MemCount << "|MemTime:" << st->MemTime << "|FileName:" << st->FileName << endl);
-
-        if ((st->MemLoad == EM_NLOAD || st->MemLoad == EM_LOADED) && st->MemCount == 0 && st->MemTime + g_app.getExpireTime() <= time(NULL))
+        auto it = shard.Files.find(sFile);
+        if (it != shard.Files.end())
         {
-            _mapFiles.erase(_vecMems[i]->FileName);
+            const MappedFilePtr &mf = *it->second;
+            if (mf->FileSize == (size_t)st.st_size && mf->FileTime == st.st_mtime && mf->FileInode == (size_t)st.st_ino)
+            {
+                shard.Lru.splice(shard.Lru.begin(), shard.Lru, it->second);
+                return mf;
+            }
 
-            cur = _vecMems[i];
-            break;
+            //文件已经变化, 正在使用旧映射的请求不受影响
+            TLOGDEBUG("PatchCache::load sFile:" << sFile << "|file changed, remap" << endl);
+            __erase(shard, it);
         }
     }
-    
-    if (cur == NULL && _vecMems.size() < _MemNum)
-    {
-        cur = new MemState();
-        cur->MemBuf = (char *)malloc(_MemMax);//从这里开始新建
-
-        _vecMems.push_back(cur);
 
-        _mapFiles.insert(std::make_pair(sFile, cur));
+    //映射不用读文件, 放在锁外面
+    MappedFilePtr mf = __mapFile(sFile);
+    if (!mf)
+    {
+        return NULL;
     }
 
-    if (cur != NULL)
-    {
-        cur->MemCount   = 0;
-        cur->MemSize    = _MemMax;
-        cur->MemLoad    = EM_LOADING;
+    TC_ThreadLock::Lock lock(shard.Mutex);
 
-        if (cur->MemBuf == NULL)//有可能内存分配失败
+    auto it = shard.Files.find(sFile);
+    if (it != shard.Files.end())
+    {
+        //其它请求同时映射了同一个文件
+        if ((*it->second)->FileInode == mf->FileInode && (*it->second)->FileTime == mf->FileTime && (*it->second)->FileSize == mf->FileSize)
         {
-            //从vector删除新的分配内存失败的元素
-            _vecMems.erase(remove(_vecMems.begin(),_vecMems.end(),cur));
-
-            TLOGERROR("PatchCache::__getMem sFile:" << sFile << "|cur->MemBuf NULL" << endl);
-
-            return -1;
+            return *it->second;
         }
 
-        return 0;
+        __erase(shard, it);
     }
 
-    TLOGERROR("PatchCache::__getMem sFile:" << sFile << "|not enough mem" << endl);
-
-    return -1;
-}
+    shard.Lru.push_front(mf);
+    shard.Files[sFile] = shard.Lru.begin();
+    shard.Bytes += mf->FileSize;
 
-int PatchCache::__loadFile(const std::string & sFile, char * szBuff, size_t sizeLen)
-{
-    TLOGDEBUG("PatchCache::__loadFile sFile:" << sFile << "|sizeLen:" << sizeLen << endl);
-    
-    if(szBuff == NULL)
-    {
-        TLOGERROR("PatchCache::__loadFile sFile:" << sFile << "|sizeLen:" << sizeLen << "|szBuff NULL"<< endl);
-
-        return -4;
-    }
-
-    FILE * fp = fopen(sFile.c_str(), "rb");
-    if (fp == NULL)
+    //按字节数淘汰最久没用的, 刚放入的不淘汰
+    size_t shardMax = _MemTotal / SHARD_NUM;
+    while (shard.Bytes > shardMax && shard.Lru.size() > 1)
     {
-        TLOGERROR("PatchCache::__loadFile sFile:" << sFile << "|sizeLen:" << sizeLen << "|open file error:" << strerror(errno) << endl);
-        return -1;
-    }
-    
-    //从指定位置开始读数据
-    if (fseek(fp, 0, SEEK_SET) == -1)
-    {
-        fclose(fp);
+        const MappedFilePtr &last = shard.Lru.back();
 
-        TLOGERROR("PatchCache::__loadFile sFile:" << sFile << "|sizeLen:" << sizeLen << "|fseek error:" << strerror(errno) << endl);
-        return -2;
-    }
+        TLOGDEBUG("PatchCache::load evict:" << last->FileName << "|size:" << last->FileSize << endl);
 
-    //开始读取文件
-    size_t r = fread(szBuff, 1, sizeLen, fp);
-    if (r > 0)
-    {
-        //成功读取r字节数据
-        fclose(fp);
-        TLOGDEBUG("PatchCache::__loadFile sFile:" << sFile << "|sizeLen:" << sizeLen << "|r:" << r << endl);
-        return 0;
+        __erase(shard, shard.Files.find(last->FileName));
     }
-    else
-    {
-        //到文件末尾了
-        if (feof(fp))
-        {
-            fclose(fp);
-            TLOGDEBUG("PatchCache::__loadFile sFile:" << sFile << "|sizeLen:" << sizeLen << "|to tail ok" << endl);
-            return 1;
-        }
 
-        //读取文件出错了
-        TLOGERROR("PatchCache::__loadFile sFile:" << sFile << "|sizeLen:" << sizeLen << "|r:" << r << "|error:" << strerror(errno) << endl);
-        fclose(fp);
-        return -3;
-    }
+    TLOGDEBUG("PatchCache::load sFile:" << sFile << "|size:" << mf->FileSize << "|shard bytes:" << shard.Bytes << endl);
 
+    return mf;
 }
-
@@ -18,67 +18,89 @@
 #define __PATCH_CACHE_H_
 
 #include <string>
-#include <map>
-#include <vector>
+#include <list>
+#include <memory>
+#include <unordered_map>
 #include "util/tc_monitor.h"
 
 const size_t SIZE_BUMEM_MIN =   1 * 1024 * 1024;
-const size_t SIZE_BUMEM_MAX = 100 * 1024 * 1024;
 
+/**
+ * 发布文件的内存缓存
+ * 文件只读映射到内存(大小与文件一致, 与系统的page cache共用), 按文件名分片加锁, 每个分片按字节数做LRU淘汰.
+ * load返回映射的引用计数指针, 淘汰时只是从缓存中去掉, 还在使用的请求结束后才真正解除映射.
+ * 映射期间文件不能被原地截断或者改写(会导致SIGBUS), 替换发布文件需要写临时文件后rename.
+ */
 class PatchCache
 {
-private:
-    enum FileLoad 
+public:
+    struct MappedFile
     {
-        EM_NLOAD    = 0,
-        EM_LOADING  = 1,
-        EM_RELOAD   = 2,
-        EM_LOADED   = 3   
-    };
+        MappedFile() : FileSize(0), FileInode(0), FileTime(0), MemBuf(NULL) {}
 
-    struct MemState
-    {
-        string      FileName;       //文件路径
+        ~MappedFile();
+
+        std::string FileName;       //文件路径
         size_t      FileSize;       //文件大小
         size_t      FileInode;      //Inode索引号
-        time_t      FileTime;       //文件创建时间
-
-        char *      MemBuf;         //该块内存的起始地址
-        size_t      MemSize;        //该块内存的大小
-        size_t      MemCount;       //指向该块内存的数目
-        time_t      MemTime;        //该块内存最后操纵时间
-        FileLoad    MemLoad;        //该块内存已经加载成功
+        time_t      FileTime;       //文件修改时间
+        char *      MemBuf;         //映射的起始地址
     };
-public:
-    void setMemOption(const size_t MemMax, const size_t MemMin, const size_t MemNum)
+
+    typedef std::shared_ptr<MappedFile> MappedFilePtr;
+
+    PatchCache() : _MemMax(0), _MemMin(SIZE_BUMEM_MIN), _MemTotal(0) {}
+
+    /**
+     * @param MemMax, 超过该大小的文件不缓存
+     * @param MemMin, 小于该大小的文件不缓存
+     * @param MemTotal, 缓存的文件总大小
+     */
+    void setMemOption(const size_t MemMax, const size_t MemMin, const size_t MemTotal)
     {
-        _MemMax     = MemMax > SIZE_BUMEM_MAX ? SIZE_BUMEM_MAX : MemMax;
+        _MemMax     = MemMax;
         _MemMin     = MemMin < SIZE_BUMEM_MIN ? SIZE_BUMEM_MIN : MemMin;
-        _MemNum     = MemNum;
+        _MemTotal   = MemTotal;
     }
 
-    int load(const std::string & sFile, std::pair<char *, size_t> & mem);
-
-    int release(const std::string & sFile);
+    /**
+     * 获取文件的映射, 文件变化时重新映射
+     * @return 文件不能缓存时返回NULL
+     */
+    MappedFilePtr load(const std::string & sFile);
 
 private:
-    int __loadFile(const std::string & sFile, char * szBuff, size_t sizeLen);
+    enum
+    {
+        SHARD_NUM = 16,
+    };
+
+    struct Shard
+    {
+        Shard() : Bytes(0) {}
 
-    int __getMem  (const std::string & sFile, struct MemState *& cur);
+        tars::TC_ThreadLock     Mutex;
 
-private:
-    tars::TC_ThreadLock _mutex;
+        //最近使用的在前面
+        std::list<MappedFilePtr> Lru;
 
-    std::vector<MemState *>             _vecMems;
+        std::unordered_map<std::string, std::list<MappedFilePtr>::iterator> Files;
 
-    std::map<std::string, MemState *>   _mapFiles;
+        size_t                  Bytes;
+    };
+
+    MappedFilePtr __mapFile(const std::string & sFile);
+
+    void __erase(Shard &shard, std::unordered_map<std::string, std::list<MappedFilePtr>::iterator>::iterator it);
+
+private:
+    Shard  _shards[SHARD_NUM];
 
     size_t _MemMax;
 
     size_t _MemMin;
 
-    size_t _MemNum;
+    size_t _MemTotal;
 };
 
 #endif
-
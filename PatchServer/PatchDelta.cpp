@@ -0,0 +1,238 @@
+/**
+ * Tencent is pleased to support the open source community by making Tars available.
+ *
+ * Copyright (C) 2016THL A29 Limited, a Tencent company. All rights reserved.
+ *
+ * Licensed under the BSD 3-Clause License (the "License"); you may not use this file except 
+ * in compliance with the License. You may obtain a copy of the License at
+ *
+ * https://opensource.org/licenses/BSD-3-Clause
+ *
+ * Unless required by applicable law or agreed to in writing, software distributed 
+ * under the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR 
+ * CONDITIONS OF ANY KIND, either express or implied. See the License for the 
+ * specific language governing permissions and limitations under the License.
+ */
+
+
+#include <sys/stat.h>
+#include "util/tc_file.h"
+#include "util/tc_port.h"
+#include "util/tc_common.h"
+#include "servant/RemoteLogger.h"
+#include "tars_delta.h"
+#include "PatchDelta.h"
+#include "PatchManifest.h"
+
+using namespace tars;
+
+extern PatchManifest g_PatchManifest;
+
+#define DELTA_DIR "TARSBatchPatchingDelta"
+
+static bool isMd5(const string &s)
+{
+    return s.length() == 32 && s.find_first_not_of("0123456789abcdef") == string::npos;
+}
+
+void PatchDelta::setOption(const string &directory, const string &uploadDirectory, size_t maxSize, int maxRatio, int keepTime)
+{
+    _directory       = directory;
+    _uploadDirectory = uploadDirectory;
+    _maxSize         = maxSize;
+    _maxRatio        = maxRatio;
+    _keepTime        = keepTime;
+}
+
+bool PatchDelta::isDeltaPath(const string &path)
+{
+    vector<string> v = TC_Common::sepstr<string>(path, "/\\");
+
+    return v.size() == 4 && v[0] == DELTA_DIR;
+}
+
+int PatchDelta::prepare(const string &path)
+{
+    //DELTA_DIR/App/Server/<from>_<to>.delta
+    vector<string> v = TC_Common::sepstr<string>(path, "/\\");
+    if (path.find("..") != string::npos || v.size() != 4 || v[0] != DELTA_DIR || v[3].length() != 71 || v[3].substr(65) != ".delta")
+    {
+        TLOG_ERROR("PatchDelta::prepare path:" << path << "|invalid" << endl);
+        return -1;
+    }
+
+    string fromMd5 = v[3].substr(0, 32);
+    string toMd5   = v[3].substr(33, 32);
+    if (!isMd5(fromMd5) || !isMd5(toMd5) || v[3][32] != '_' || fromMd5 == toMd5)
+    {
+        TLOG_ERROR("PatchDelta::prepare path:" << path << "|invalid md5" << endl);
+        return -1;
+    }
+
+    string deltaFile = _directory + FILE_SEP + DELTA_DIR + FILE_SEP + v[1] + FILE_SEP + v[2] + FILE_SEP + v[3];
+    string noneFile  = deltaFile + ".none";
+
+    if (TC_File::isFileExist(deltaFile))
+    {
+        return 0;
+    }
+
+    //之前生成过但差量太大
+    if (TC_File::isFileExist(noneFile))
+    {
+        return -2;
+    }
+
+    {
+        TC_ThreadLock::Lock lock(_mutex);
+        if (_making.insert(deltaFile).second)
+        {
+            vector<string> req;
+            req.push_back(v[1]);
+            req.push_back(v[2]);
+            req.push_back(fromMd5);
+            req.push_back(toMd5);
+            req.push_back(deltaFile);
+            _queue.push_back(req);
+        }
+    }
+
+    return -7;
+}
+
+void PatchDelta::terminate()
+{
+    _terminate = true;
+    _queue.notifyT();
+
+    if (isAlive())
+    {
+        getThreadControl().join();
+    }
+}
+
+void PatchDelta::run()
+{
+    while (!_terminate)
+    {
+        try
+        {
+            vector<string> req;
+            if (_queue.pop_front(req, 1000))
+            {
+                make(req[0], req[1], req[2], req[3], req[4]);
+
+                TC_ThreadLock::Lock lock(_mutex);
+                _making.erase(req[4]);
+            }
+        }
+        catch (exception &ex)
+        {
+            TLOG_ERROR("PatchDelta::run catch exception:" << ex.what() << endl);
+        }
+        catch (...)
+        {
+            TLOG_ERROR("PatchDelta::run catch unkown exception" << endl);
+        }
+    }
+}
+
+int PatchDelta::make(const string &app, const string &serverName, const string &fromMd5, const string &toMd5, const string &deltaFile)
+{
+    //排队期间已经生成过
+    if (TC_File::isFileExist(deltaFile) || TC_File::isFileExist(deltaFile + ".none"))
+    {
+        return 0;
+    }
+
+    int64_t tBegin = TNOWMS;
+
+    string fromFile = findPackage(app, serverName, fromMd5);
+    string toFile   = findPackage(app, serverName, toMd5);
+    if (fromFile.empty() || toFile.empty())
+    {
+        TLOG_ERROR("PatchDelta::make delta:" << deltaFile << "|package not found, from:" << fromFile << "|to:" << toFile << endl);
+        return -3;
+    }
+
+    string sResult;
+    string fromContent;
+    string toContent;
+    if (TarsDelta::loadContent(fromFile, _maxSize, fromContent, sResult) != 0 || TarsDelta::loadContent(toFile, _maxSize, toContent, sResult) != 0)
+    {
+        TLOG_ERROR("PatchDelta::make delta:" << deltaFile << "|load error:" << sResult << endl);
+        return -4;
+    }
+
+    TC_File::makeDirRecursive(TC_File::extractFilePath(deltaFile));
+
+    if (TarsDelta::makeDelta(fromContent, toContent, toMd5, deltaFile, sResult) != 0)
+    {
+        TLOG_ERROR("PatchDelta::make delta:" << deltaFile << "|make delta error:" << sResult << endl);
+        return -5;
+    }
+
+    size_t deltaSize = TC_File::getFileSize(deltaFile);
+    size_t toSize    = TC_File::getFileSize(toFile);
+
+    TLOG_DEBUG("PatchDelta::make delta:" << deltaFile << "|from:" << fromFile << "|to:" << toFile << "|size:" << toSize << "|content size:" << toContent.size()
+               << "|delta size:" << deltaSize << "|cost:" << (TNOWMS - tBegin) << "ms" << endl);
+
+    //差量比新包(压缩后的)小不了多少时, 还不如直接下载新包
+    if ((double)deltaSize * 100 > (double)toSize * _maxRatio)
+    {
+        TC_File::removeFile(deltaFile, false);
+        TC_File::save2file(deltaFile + ".none", "");
+        return -6;
+    }
+
+    prune();
+
+    return 0;
+}
+
+string PatchDelta::findPackage(const string &app, const string &serverName, const string &md5)
+{
+    vector<string> vDir;
+    vDir.push_back(_uploadDirectory + FILE_SEP + app + FILE_SEP + serverName);
+    vDir.push_back(_directory + FILE_SEP + "TARSBatchPatchingV2" + FILE_SEP + app + FILE_SEP + serverName);
+    vDir.push_back(_directory + FILE_SEP + "TARSBatchPatching" + FILE_SEP + app + FILE_SEP + serverName);
+
+    for (size_t i = 0; i < vDir.size(); i++)
+    {
+        vector<string> vFiles;
+        TC_File::listDirectory(vDir[i], vFiles, false);
+
+        for (size_t j = 0; j < vFiles.size(); j++)
+        {
+            if (TC_File::isFileExistEx(vFiles[j], S_IFREG) && getFileMd5(vFiles[j]) == md5)
+            {
+                return vFiles[j];
+            }
+        }
+    }
+
+    return "";
+}
+
+string PatchDelta::getFileMd5(const string &file)
+{
+    return g_PatchManifest.getMd5(file);
+}
+
+void PatchDelta::prune()
+{
+    vector<string> vFiles;
+    TC_File::listDirectory(_directory + FILE_SEP + DELTA_DIR, vFiles, true);
+
+    time_t now = TNOW;
+    for (size_t i = 0; i < vFiles.size(); i++)
+    {
+        TC_Port::stat_t st;
+        if (TC_Port::lstat(vFiles[i].c_str(), &st) == 0 && S_ISREG(st.st_mode) && now - st.st_mtime > _keepTime)
+        {
+            TLOG_DEBUG("PatchDelta::prune remove:" << vFiles[i] << endl);
+            TC_File::removeFile(vFiles[i], false);
+        }
+    }
+}
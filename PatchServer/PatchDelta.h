@@ -0,0 +1,110 @@
+/**
+ * Tencent is pleased to support the open source community by making Tars available.
+ *
+ * Copyright (C) 2016THL A29 Limited, a Tencent company. All rights reserved.
+ *
+ * Licensed under the BSD 3-Clause License (the "License"); you may not use this file except 
+ * in compliance with the License. You may obtain a copy of the License at
+ *
+ * https://opensource.org/licenses/BSD-3-Clause
+ *
+ * Unless required by applicable law or agreed to in writing, software distributed 
+ * under the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR 
+ * CONDITIONS OF ANY KIND, either express or implied. See the License for the 
+ * specific language governing permissions and limitations under the License.
+ */
+
+
+#ifndef __PATCH_DELTA_H_
+#define __PATCH_DELTA_H_
+
+#include <string>
+#include <set>
+#include "util/tc_monitor.h"
+#include "util/tc_thread.h"
+#include "util/tc_thread_queue.h"
+
+using namespace std;
+
+/**
+ * 生成并缓存两个版本发布包之间的差量
+ * 节点请求的路径为 /TARSBatchPatchingDelta/App/Server/<旧包md5>_<新包md5>.delta,
+ * 文件不存在时交给后台线程根据md5在上传目录和发布目录中找到两个版本的包生成差量, 放在发布目录下, 之后按普通文件下载.
+ * 生成期间请求返回未就绪, 节点直接下载完整的包, 不占用处理请求的线程
+ */
+class PatchDelta : public tars::TC_Thread
+{
+public:
+    PatchDelta() : _maxSize(0), _maxRatio(50), _keepTime(0), _terminate(false) {}
+
+    /**
+     * @param maxSize, 发布包解压后超过该大小不生成差量
+     * @param maxRatio, 差量超过新包大小的百分比时认为没有意义
+     * @param keepTime, 差量文件保留的时间(秒)
+     */
+    void setOption(const string &directory, const string &uploadDirectory, size_t maxSize, int maxRatio, int keepTime);
+
+    /**
+     * 是否是差量文件的路径
+     */
+    static bool isDeltaPath(const string &path);
+
+    /**
+     * 准备好差量文件
+     * @param path, 相对发布目录的差量文件路径
+     * @return 0: 差量文件已经存在, -7: 已放入后台生成, 其它<0: 不能生成
+     */
+    int prepare(const string &path);
+
+    /**
+     * 结束线程
+     */
+    void terminate();
+
+protected:
+    virtual void run();
+
+    /**
+     * 生成差量文件
+     * @param deltaFile, 差量文件的完整路径
+     */
+    int make(const string &app, const string &serverName, const string &fromMd5, const string &toMd5, const string &deltaFile);
+
+    /**
+     * 在服务的上传目录和发布目录中找md5对应的发布包
+     */
+    string findPackage(const string &app, const string &serverName, const string &md5);
+
+    /**
+     * 计算文件的md5, 使用发布文件的清单缓存
+     */
+    string getFileMd5(const string &file);
+
+    /**
+     * 删除过期的差量文件
+     */
+    void prune();
+
+private:
+    string  _directory;
+
+    string  _uploadDirectory;
+
+    size_t  _maxSize;
+
+    int     _maxRatio;
+
+    int     _keepTime;
+
+    bool    _terminate;
+
+    //排队或正在生成的差量文件
+    tars::TC_ThreadLock         _mutex;
+
+    set<string>                 _making;
+
+    //只有一个线程生成差量, 两个版本的包都在内存中
+    tars::TC_ThreadQueue<vector<string> > _queue;
+};
+
+#endif
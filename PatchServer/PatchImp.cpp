@@ -20,9 +20,14 @@
 #include "servant/RemoteLogger.h"
 #include "PatchImp.h"
 #include "PatchCache.h"
+#include "tars_range.h"
+#include "PatchDelta.h"
+#include "PatchManifest.h"
 #include "PatchServer.h"
 
 extern PatchCache g_PatchCache;
+extern PatchDelta g_PatchDelta;
+extern PatchManifest g_PatchManifest;
 
 struct LIST
 {
@@ -33,13 +38,10 @@ struct LIST
     void operator()(const string &file)
     {
         //普通文件才同步, 连接文件有效
-        if(tars::TC_File::isFileExistEx(file, S_IFREG))
+        FileInfo fi;
+        if(tars::TC_File::isFileExistEx(file, S_IFREG) && g_PatchManifest.getFileInfo(file, fi))
         {
-            FileInfo fi;
             fi.path     = file.substr(_dir.length());
-            fi.size     = tars::TC_File::getFileSize(file);
-            fi.canExec  = tars::TC_File::canExecutable(file);
-            fi.md5      = tars::TC_MD5::md5file(file);
 
             _vf.push_back(fi);
 
@@ -53,6 +55,7 @@ struct LIST
 
 PatchImp::PatchImp()
 : _size(1024*1024)
+, _rangeMax(16*1024*1024)
 {
 }
 
@@ -63,6 +66,8 @@ void PatchImp::initialize()
         _directory       = TC_File::simplifyDirectory((*g_conf)["/tars<directory>"]);
         _uploadDirectory = TC_File::simplifyDirectory((*g_conf)["/tars<uploadDirectory>"]);
         _size            = TC_Common::toSize(g_conf->get("/tars<size>", "1M"), 1024*1024);
+        _rangeMax        = TC_Common::toSize(g_conf->get("/tars<rangeMax>", "16M"), 16*1024*1024);
+        _rangeMax        = _rangeMax < _size ? _size : _rangeMax;
     }
     catch(exception &ex)
     {
@@ -76,7 +81,7 @@ void PatchImp::initialize()
         exit(0);
     }
 
-    TLOG_DEBUG("PatchImp::initialize patch dirtectory:" << _directory  << "|uploadDirectory:" << _uploadDirectory << "|size:" << _size << endl);
+    TLOG_DEBUG("PatchImp::initialize patch dirtectory:" << _directory  << "|uploadDirectory:" << _uploadDirectory << "|size:" << _size << "|rangeMax:" << _rangeMax << endl);
 }
 
 
@@ -90,6 +95,13 @@ int PatchImp::listFileInfo(const string &path, vector<FileInfo> & vf, TarsCurren
 
     string dir = tars::TC_File::simplifyDirectory(_directory + FILE_SEP + path);
 
+    //差量文件第一次请求时放到后台生成, 还没有生成好时节点下载完整的包
+    if (PatchDelta::isDeltaPath(path) && g_PatchDelta.prepare(path) != 0)
+    {
+        TLOG_DEBUG("PatchImp::listFileInfo ip:" << current->getHostName()  << "|path:" << path << "|no delta" << endl);
+        return -1;
+    }
+
     int ret = __listFileInfo(dir, vf);
 
     stringstream ss;
@@ -103,20 +115,48 @@ int PatchImp::listFileInfo(const string &path, vector<FileInfo> & vf, TarsCurren
 
 int PatchImp::download(const string & file, int pos, vector<char> & vb, TarsCurrentPtr current)
 {
-    TLOG_DEBUG("PatchImp::download ip:" << current->getHostName()  << "|file:" << file << "|pos:" << pos << endl);
-
     string path = tars::TC_File::simplifyDirectory(_directory + FILE_SEP + file);
-    
+
+    //范围下载, 老的客户端没有带范围参数, 每次返回_size
+    size_t offset   = pos < 0 ? 0 : pos;
+    size_t size     = _size;
+    bool withInfo   = false;
+    size_t rangePos = 0;
+    size_t rangeLen = 0;
+    if (TarsRange::getRequest(current->getContext(), rangePos, rangeLen, withInfo))
+    {
+        offset  = rangePos;
+        size    = rangeLen == 0 ? _size : (rangeLen > _rangeMax ? _rangeMax : rangeLen);
+    }
+    else if (pos < 0)
+    {
+        return -1;
+    }
+
+    TLOG_DEBUG("PatchImp::download ip:" << current->getHostName()  << "|file:" << file << "|pos:" << offset << "|size:" << size << endl);
+
+    //第一个应答带上文件大小和md5, 客户端用来确认下载过程中文件没有变化
+    if (withInfo)
+    {
+        FileInfo fi;
+        if (g_PatchManifest.getFileInfo(path, fi))
+        {
+            map<string, string> rspContext;
+            TarsRange::setFileInfo(rspContext, fi.size, fi.md5);
+            current->setResponseContext(rspContext);
+        }
+    }
+
     int iRet = -1;
 
     if (iRet < 0)
     {
-        iRet = __downloadFromMem (path, pos, vb);
+        iRet = __downloadFromMem (path, offset, size, vb);
     }
 
     if (iRet < 0)
     {
-        iRet = __downloadFromFile(path, pos, vb);
+        iRet = __downloadFromFile(path, offset, size, vb);
     }
 
     return iRet;
@@ -145,7 +185,18 @@ int PatchImp::preparePatchFile(const string &app, const string &serverName, cons
         return -1;
     }
 
-    TC_File::copyFile(upfile, dstfile, true);
+    //先拷到临时文件再rename, 不能原地改写正在被PatchCache映射的文件
+    string tmpfile = dstfile + ".tmp";
+    TC_File::copyFile(upfile, tmpfile, true);
+    if (::rename(tmpfile.c_str(), dstfile.c_str()) != 0)
+    {
+        result = "rename " + tmpfile + " error!";
+        TLOG_ERROR("PatchImp::preparePatchFile rename file:" << tmpfile << "|error:" << strerror(errno) << endl);
+        return -3;
+    }
+
+    //节点马上会来listFileInfo, 提前计算好md5
+    g_PatchManifest.prepare(dstfile, upfile);
 
     return 0;
 }
@@ -175,10 +226,12 @@ int PatchImp::__listFileInfo(const string &path, vector<FileInfo> &vf)
     {
         //是文件
         FileInfo fi;
+        if (!g_PatchManifest.getFileInfo(path, fi))
+        {
+            return -1;
+        }
+
         fi.path     = tars::TC_File::extractFileName(path);
-        fi.size     = tars::TC_File::getFileSize(path);
-        fi.canExec  = tars::TC_File::canExecutable(path);
-        fi.md5      = tars::TC_MD5::md5file(path);
 
         vf.push_back(fi);
 
@@ -248,43 +301,38 @@ int PatchImp::upload(const std::string & app,const std::string & serverName,cons
     return 0;
 }
 
-int PatchImp::__downloadFromMem (const string & file, size_t pos, vector<char> & vb)
+int PatchImp::__downloadFromMem (const string & file, size_t pos, size_t size, vector<char> & vb)
 {
-    TLOG_DEBUG("PatchImp::__downloadFromMem file:" << file << "|pos:" << pos << "|size:" << _size << endl);
+    TLOG_DEBUG("PatchImp::__downloadFromMem file:" << file << "|pos:" << pos << "|size:" << size << endl);
 
-    pair<char *, size_t> mem;
-    if (g_PatchCache.load(file, mem) != 0)
+    PatchCache::MappedFilePtr mem = g_PatchCache.load(file);
+    if (!mem)
     {
         TLOG_ERROR("PatchImp::__downloadFromMem file:" << file << "|pos:" << pos << "|LoadFile error" << endl);
         return -1;
     }
 
-    if (pos >= mem.second)
+    if (pos >= mem->FileSize)
     {
         TLOG_DEBUG("PatchImp::__downloadFromMem file:" << file << "|pos:" << pos << "|to tail ok" << endl);
 
-        g_PatchCache.release(file);
-
         return 1;
     }
 
-    const size_t sizeBuf = mem.second - pos >= _size ? _size : mem.second - pos;
+    const size_t sizeBuf = mem->FileSize - pos >= size ? size : mem->FileSize - pos;
 
     TLOG_DEBUG("PatchImp::__downloadFromMem file:" << file << "|pos:" << pos << "|sizeBuf:" << sizeBuf << endl);
-    
-    vb.resize(sizeBuf);
 
-    memcpy((char *)&vb[0], mem.first + pos, sizeBuf);
-    
-    g_PatchCache.release(file);
+    //直接从映射的page cache拷到应答中, mem在应答编码前一直持有映射
+    vb.assign(mem->MemBuf + pos, mem->MemBuf + pos + sizeBuf);
 
     return 0;
 }
 
 
-int PatchImp::__downloadFromFile(const string & file, size_t pos, vector<char> & vb)
+int PatchImp::__downloadFromFile(const string & file, size_t pos, size_t size, vector<char> & vb)
 {
-    TLOG_DEBUG("PatchImp::__downloadFromFile file:" << file << "|pos:" << pos << "|size:" << _size << endl);
+    TLOG_DEBUG("PatchImp::__downloadFromFile file:" << file << "|pos:" << pos << "|size:" << size << endl);
 
     FILE * fp = fopen(file.c_str(), "rb");
     if (fp == NULL)
@@ -303,8 +351,8 @@ int PatchImp::__downloadFromFile(const string & file, size_t pos, vector<char> &
     }
 
     //开始读取文件
-    vb.resize(_size);
-    size_t r = fread((void*)(&vb[0]), 1, _size, fp);
+    vb.resize(size);
+    size_t r = fread((void*)(&vb[0]), 1, size, fp);
     if (r > 0)
     {
         //成功读取r字节数据
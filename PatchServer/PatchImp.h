@@ -54,6 +54,7 @@ public:
      * @param file, 文件完全路径
      * @param pos, 从什么位置开始下载
      * @return vector<byte>, 文件内容
+     * context中带了范围参数(见TarsRange)时按请求的位置和长度返回, 长度不超过rangeMax
      */
     int download(const string &file, int pos, vector<char> &vb, TarsCurrentPtr current);
     
@@ -94,13 +95,14 @@ public:
 protected:
     int __listFileInfo(const string &path, vector<FileInfo> &vf);
     
-    int __downloadFromMem (const string & file, size_t pos, vector<char> & vb);
+    int __downloadFromMem (const string & file, size_t pos, size_t size, vector<char> & vb);
     
-    int __downloadFromFile(const string & file, size_t pos, vector<char> & vb);
+    int __downloadFromFile(const string & file, size_t pos, size_t size, vector<char> & vb);
 
 protected:
     /**
      * 目录
+     * 其中的文件可能正被PatchCache映射, 放入或替换文件都要先写临时文件再rename, 原地截断或改写会导致SIGBUS
      */
     string _directory;
 
@@ -113,6 +115,11 @@ protected:
      * 每次同步大小
      */
     size_t _size;
+
+    /**
+     * 范围下载每次最多返回的大小
+     */
+    size_t _rangeMax;
 };
 
 #endif
@@ -0,0 +1,301 @@
+/**
+ * Tencent is pleased to support the open source community by making Tars available.
+ *
+ * Copyright (C) 2016THL A29 Limited, a Tencent company. All rights reserved.
+ *
+ * Licensed under the BSD 3-Clause License (the "License"); you may not use this file except 
+ * in compliance with the License. You may obtain a copy of the License at
+ *
+ * https://opensource.org/licenses/BSD-3-Clause
+ *
+ * Unless required by applicable law or agreed to in writing, software distributed 
+ * under the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR 
+ * CONDITIONS OF ANY KIND, either express or implied. See the License for the 
+ * specific language governing permissions and limitations under the License.
+ */
+
+
+#include <sys/stat.h>
+#include <fstream>
+#include "util/tc_file.h"
+#include "util/tc_common.h"
+#include "util/tc_md5.h"
+#include "util/tc_timeprovider.h"
+#include "servant/RemoteLogger.h"
+#include "PatchManifest.h"
+
+using namespace tars;
+
+static bool statFile(const string &file, uint64_t &inode, uint64_t &size, time_t &mtime, uint32_t &mode)
+{
+    struct stat st;
+    if (::stat(file.c_str(), &st) != 0 || !S_ISREG(st.st_mode))
+    {
+        return false;
+    }
+
+    inode = st.st_ino;
+    size  = st.st_size;
+    mtime = st.st_mtime;
+    mode  = st.st_mode;
+
+    return true;
+}
+
+void PatchManifest::setOption(const string &file, int saveInterval)
+{
+    _file         = file;
+    _saveInterval = saveInterval > 0 ? saveInterval : 60;
+
+    load();
+}
+
+bool PatchManifest::findEntry(const string &file, Entry &entry)
+{
+    Entry cur;
+    if (!statFile(file, cur.inode, cur.size, cur.mtime, cur.mode))
+    {
+        return false;
+    }
+
+    TC_ThreadLock::Lock lock(_mutex);
+
+    map<string, Entry>::const_iterator it = _entries.find(file);
+    if (it == _entries.end() || it->second.inode != cur.inode || it->second.size != cur.size || it->second.mtime != cur.mtime || it->second.mode != cur.mode)
+    {
+        return false;
+    }
+
+    entry = it->second;
+
+    return true;
+}
+
+bool PatchManifest::getEntry(const string &file, Entry &entry)
+{
+    while (true)
+    {
+        if (findEntry(file, entry))
+        {
+            return true;
+        }
+
+        TC_ThreadLock::Lock lock(_mutex);
+        if (_computing.find(file) == _computing.end())
+        {
+            _computing.insert(file);
+            break;
+        }
+
+        //其它线程正在计算, 等它的结果
+        _mutex.timedWait(1000);
+    }
+
+    Entry cur;
+    bool succ = statFile(file, cur.inode, cur.size, cur.mtime, cur.mode);
+    if (succ)
+    {
+        int64_t startMs = TNOWMS;
+
+        cur.canExec = TC_File::canExecutable(file);
+        cur.md5     = TC_Common::lower(TC_MD5::md5file(file));
+
+        TLOG_DEBUG("PatchManifest::getEntry file:" << file << "|size:" << cur.size << "|md5:" << cur.md5 << "|use:" << (TNOWMS - startMs) << "ms" << endl);
+
+        //计算期间文件变化了, 结果不缓存
+        Entry after;
+        succ = statFile(file, after.inode, after.size, after.mtime, after.mode) && !cur.md5.empty()
+               && after.inode == cur.inode && after.size == cur.size && after.mtime == cur.mtime && after.mode == cur.mode;
+    }
+
+    TC_ThreadLock::Lock lock(_mutex);
+
+    _computing.erase(file);
+    if (succ)
+    {
+        _entries[file] = cur;
+        _dirty = true;
+    }
+    _mutex.notifyAll();
+
+    entry = cur;
+
+    return !cur.md5.empty();
+}
+
+bool PatchManifest::getFileInfo(const string &file, FileInfo &fi)
+{
+    Entry entry;
+    if (!getEntry(file, entry))
+    {
+        return false;
+    }
+
+    fi.size     = entry.size;
+    fi.canExec  = entry.canExec;
+    fi.md5      = entry.md5;
+
+    return true;
+}
+
+string PatchManifest::getMd5(const string &file)
+{
+    Entry entry;
+    if (!getEntry(file, entry))
+    {
+        return "";
+    }
+
+    return entry.md5;
+}
+
+void PatchManifest::prepare(const string &file, const string &sameAs)
+{
+    _queue.push_back(make_pair(file, sameAs));
+}
+
+void PatchManifest::terminate()
+{
+    _terminate = true;
+    _queue.notifyT();
+
+    if (isAlive())
+    {
+        getThreadControl().join();
+    }
+
+    save();
+}
+
+void PatchManifest::run()
+{
+    time_t tLastSave = TNOW;
+
+    while (!_terminate)
+    {
+        try
+        {
+            pair<string, string> req;
+            if (_queue.pop_front(req, 1000))
+            {
+                Entry src, cur;
+                if (!req.second.empty() && findEntry(req.second, src) && statFile(req.first, cur.inode, cur.size, cur.mtime, cur.mode) && cur.size == src.size)
+                {
+                    //复制出来的文件, 不用再算一次md5
+                    cur.canExec = TC_File::canExecutable(req.first);
+                    cur.md5     = src.md5;
+
+                    TC_ThreadLock::Lock lock(_mutex);
+                    _entries[req.first] = cur;
+                    _dirty = true;
+                }
+                else
+                {
+                    getEntry(req.first, cur);
+                }
+            }
+
+            if (TNOW - tLastSave >= _saveInterval)
+            {
+                tLastSave = TNOW;
+                save();
+            }
+        }
+        catch (exception &ex)
+        {
+            TLOG_ERROR("PatchManifest::run catch exception:" << ex.what() << endl);
+        }
+        catch (...)
+        {
+            TLOG_ERROR("PatchManifest::run catch unkown exception" << endl);
+        }
+    }
+}
+
+void PatchManifest::load()
+{
+    ifstream ifs(_file.c_str());
+    if (!ifs)
+    {
+        return;
+    }
+
+    //每行: inode size mtime mode canExec md5 path
+    string line;
+    while (getline(ifs, line))
+    {
+        istringstream is(line);
+
+        Entry entry;
+        int canExec = 0;
+        if (!(is >> entry.inode >> entry.size >> entry.mtime >> entry.mode >> canExec >> entry.md5))
+        {
+            continue;
+        }
+
+        string file;
+        getline(is, file);
+        file = TC_Common::trimleft(file, " ");
+        if (file.empty() || entry.md5.length() != 32)
+        {
+            continue;
+        }
+
+        entry.canExec = (canExec != 0);
+
+        TC_ThreadLock::Lock lock(_mutex);
+        _entries[file] = entry;
+    }
+
+    TLOG_DEBUG("PatchManifest::load file:" << _file << "|entries:" << _entries.size() << endl);
+}
+
+void PatchManifest::save()
+{
+    map<string, Entry> entries;
+    {
+        TC_ThreadLock::Lock lock(_mutex);
+        if (!_dirty || _file.empty())
+        {
+            return;
+        }
+
+        _dirty = false;
+        entries = _entries;
+    }
+
+    ostringstream os;
+    vector<string> vRemoved;
+    for (map<string, Entry>::const_iterator it = entries.begin(); it != entries.end(); ++it)
+    {
+        //已经删除的文件不再保存
+        if (!TC_File::isFileExist(it->first))
+        {
+            vRemoved.push_back(it->first);
+            continue;
+        }
+
+        const Entry &e = it->second;
+        os << e.inode << " " << e.size << " " << e.mtime << " " << e.mode << " " << (e.canExec ? 1 : 0) << " " << e.md5 << " " << it->first << "\n";
+    }
+
+    {
+        TC_ThreadLock::Lock lock(_mutex);
+        for (size_t i = 0; i < vRemoved.size(); i++)
+        {
+            _entries.erase(vRemoved[i]);
+        }
+    }
+
+    string tmpFile = _file + ".tmp";
+    TC_File::makeDirRecursive(TC_File::extractFilePath(_file));
+    TC_File::save2file(tmpFile, os.str());
+
+    if (::rename(tmpFile.c_str(), _file.c_str()) != 0)
+    {
+        TLOG_ERROR("PatchManifest::save rename " << tmpFile << " error:" << strerror(errno) << endl);
+        return;
+    }
+
+    TLOG_DEBUG("PatchManifest::save file:" << _file << "|entries:" << entries.size() - vRemoved.size() << endl);
+}
@@ -0,0 +1,118 @@
+/**
+ * Tencent is pleased to support the open source community by making Tars available.
+ *
+ * Copyright (C) 2016THL A29 Limited, a Tencent company. All rights reserved.
+ *
+ * Licensed under the BSD 3-Clause License (the "License"); you may not use this file except 
+ * in compliance with the License. You may obtain a copy of the License at
+ *
+ * https://opensource.org/licenses/BSD-3-Clause
+ *
+ * Unless required by applicable law or agreed to in writing, software distributed 
+ * under the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR 
+ * CONDITIONS OF ANY KIND, either express or implied. See the License for the 
+ * specific language governing permissions and limitations under the License.
+ */
+
+
+#ifndef __PATCH_MANIFEST_H_
+#define __PATCH_MANIFEST_H_
+
+#include <string>
+#include <map>
+#include <set>
+#include "util/tc_monitor.h"
+#include "util/tc_thread.h"
+#include "util/tc_thread_queue.h"
+#include "Patch.h"
+
+using namespace std;
+
+/**
+ * 发布文件的清单缓存
+ * 按(路径, inode, 大小, 修改时间, 权限)缓存文件的md5和可执行属性, 同一个发布包被很多节点listFileInfo时只计算一次md5,
+ * 多个请求同时计算同一个文件时只有一个真正计算, 其它的等待结果.
+ * preparePatchFile放入新包后在后台线程中预先计算, 缓存定期保存到文件, 重启后继续使用.
+ */
+class PatchManifest : public tars::TC_Thread
+{
+public:
+    PatchManifest() : _saveInterval(60), _dirty(false), _terminate(false) {}
+
+    /**
+     * 加载保存的缓存
+     * @param file, 缓存保存的文件
+     * @param saveInterval, 有变化时保存的间隔(秒)
+     */
+    void setOption(const string &file, int saveInterval);
+
+    /**
+     * 文件的大小, 可执行属性和md5, path由调用者填写
+     * @return 文件不存在时返回false
+     */
+    bool getFileInfo(const string &file, FileInfo &fi);
+
+    /**
+     * 文件的md5, 文件不存在时返回空
+     */
+    string getMd5(const string &file);
+
+    /**
+     * 在后台计算文件的md5
+     * @param sameAs, file是从sameAs复制过来的, sameAs已经有缓存且大小一致时直接使用它的md5
+     */
+    void prepare(const string &file, const string &sameAs = "");
+
+    /**
+     * 结束线程并保存
+     */
+    void terminate();
+
+protected:
+    struct Entry
+    {
+        uint64_t    inode;
+        uint64_t    size;
+        time_t      mtime;
+        uint32_t    mode;
+        bool        canExec;
+        string      md5;
+    };
+
+    virtual void run();
+
+    /**
+     * 取缓存, 没有或者文件已经变化时计算
+     */
+    bool getEntry(const string &file, Entry &entry);
+
+    /**
+     * 缓存中file对应的有效结果
+     */
+    bool findEntry(const string &file, Entry &entry);
+
+    void load();
+
+    void save();
+
+protected:
+    string                          _file;
+
+    int                             _saveInterval;
+
+    tars::TC_ThreadLock             _mutex;
+
+    map<string, Entry>              _entries;
+
+    //正在计算md5的文件
+    set<string>                     _computing;
+
+    bool                            _dirty;
+
+    bool                            _terminate;
+
+    //后台计算的文件和它的来源
+    tars::TC_ThreadQueue<pair<string, string> > _queue;
+};
+
+#endif
@@ -14,11 +14,16 @@
  * specific language governing permissions and limitations under the License.
  */
 
+#include "util/tc_file.h"
 #include "PatchServer.h"
 #include "PatchImp.h"
 #include "PatchCache.h"
+#include "PatchDelta.h"
+#include "PatchManifest.h"
 
 PatchCache  g_PatchCache;
+PatchDelta  g_PatchDelta;
+PatchManifest g_PatchManifest;
 
 void PatchServer::initialize()
 {
@@ -30,17 +35,42 @@ void PatchServer::initialize()
 	size_t memMax   = TC_Common::toSize(g_conf->get("/tars<MemMax>", "300M"), 1024*1024);
     size_t memMin   = TC_Common::toSize(g_conf->get("/tars<MemMin>", "10K"), 1024*1024);
     size_t memNum   = TC_Common::strto<size_t>(g_conf->get("/tars<MemNum>", "10"));
+    //缓存的文件总大小, 没配置时兼容原来的MemMax*MemNum
+    size_t memTotal = TC_Common::toSize(g_conf->get("/tars<MemTotal>", ""), memMax * memNum);
 
-    g_PatchCache.setMemOption(memMax, memMin, memNum);
+    g_PatchCache.setMemOption(memMax, memMin, memTotal);
 
     _expireTime = TC_Common::strto<int>(g_conf->get("/tars<ExpireTime>", "30"));
 
-    TLOG_DEBUG("memMax:" << memMax << ", memMin:" << memMin << ", memNum:" << memNum << ", expireTime:" << _expireTime << endl);
+    TLOG_DEBUG("memMax:" << memMax << ", memMin:" << memMin << ", memTotal:" << memTotal << ", expireTime:" << _expireTime << endl);
+
+    //版本间的差量, 发布包解压后超过deltaMaxSize不生成, 在后台线程中生成
+    size_t deltaMaxSize = TC_Common::toSize(g_conf->get("/tars<deltaMaxSize>", "256M"), 1024*1024);
+    int deltaMaxRatio   = TC_Common::strto<int>(g_conf->get("/tars<deltaMaxRatio>", "50"));
+    int deltaKeepTime   = TC_Common::strto<int>(g_conf->get("/tars<deltaKeepTime>", "604800"));
+
+    g_PatchDelta.setOption(TC_File::simplifyDirectory((*g_conf)["/tars<directory>"]), TC_File::simplifyDirectory((*g_conf)["/tars<uploadDirectory>"]),
+                           deltaMaxSize, deltaMaxRatio, deltaKeepTime);
+    g_PatchDelta.start();
+
+    TLOG_DEBUG("deltaMaxSize:" << deltaMaxSize << ", deltaMaxRatio:" << deltaMaxRatio << ", deltaKeepTime:" << deltaKeepTime << endl);
+
+    //发布文件md5的缓存, 重启后继续使用
+    string manifestFile     = g_conf->get("/tars<manifestFile>", ServerConfig::DataPath + FILE_SEP + "patch_manifest.dat");
+    int manifestSaveInterval = TC_Common::strto<int>(g_conf->get("/tars<manifestSaveInterval>", "60"));
+
+    g_PatchManifest.setOption(manifestFile, manifestSaveInterval);
+    g_PatchManifest.start();
+
+    TLOG_DEBUG("manifestFile:" << manifestFile << ", manifestSaveInterval:" << manifestSaveInterval << endl);
 
 }
 
 void PatchServer::destroyApp()
 {
+    g_PatchDelta.terminate();
+    g_PatchManifest.terminate();
+
 //	TLOG_DEBUG("PatchServer::destroyApp ok" << endl);
 }
 
@@ -15,13 +15,20 @@
  */
 
 #include "CheckNodeThread.h"
+#include "RegistryServer.h"
 
 extern TC_Config * g_pconf;
+extern RegistryServer g_app;
+
+//时间轮刻度, 单位毫秒
+#define NODE_WHEEL_TICK_MS 100
 
 CheckNodeThread::CheckNodeThread()
 : _terminate(false)
 , _nodeTimeout(60)
 , _nodeTimeoutInterval(250)
+, _nodeTimeoutSlackMs(2000)
+, _wheel(NODE_WHEEL_TICK_MS, TC_Common::now2ms())
 {
 }
 
@@ -50,7 +57,10 @@ int CheckNodeThread::init()
     _nodeTimeoutInterval = TC_Common::strto<int>((*g_pconf).get("/tars/reap<nodeTimeoutInterval>", "60"));
     _nodeTimeoutInterval = _nodeTimeoutInterval < 15 ? 15 : _nodeTimeoutInterval;
 
-    TLOG_DEBUG("CheckNodeThread init ok."<<endl);
+    //时间轮到期时db中的last_heartbeat必须已经超时, 否则update不到这个node, 它也不会再进时间轮
+    _nodeTimeoutSlackMs = g_app.getHeartbeatFlushThread()->getFlushInterval() + 1000;
+
+    TLOG_DEBUG("CheckNodeThread init ok, timeout slack:" << _nodeTimeoutSlackMs << "ms" << endl);
 
     return 0;
 }
@@ -61,6 +71,50 @@ void CheckNodeThread::terminate()
     _terminate = true;
 }
 
+void CheckNodeThread::keepAlive(const string & nodeName)
+{
+    TC_ThreadLock::Lock lock(_wheelLock);
+    _wheel.refresh(nodeName, TC_Common::now2ms(), (int64_t)_nodeTimeout * 1000 + _nodeTimeoutSlackMs);
+}
+
+void CheckNodeThread::removeNode(const string & nodeName)
+{
+    TC_ThreadLock::Lock lock(_wheelLock);
+    _wheel.remove(nodeName);
+}
+
+void CheckNodeThread::checkExpiredNode()
+{
+    vector<string> vExpired;
+    {
+        TC_ThreadLock::Lock lock(_wheelLock);
+        _wheel.advance(TC_Common::now2ms(), vExpired);
+    }
+
+    if (vExpired.empty())
+    {
+        return;
+    }
+
+    //心跳写db失败期间db中的时间不可信, 放回时间轮稍后再检查
+    time_t tLastFlush = g_app.getHeartbeatFlushThread()->getLastFlushTime();
+    if (TNOW - tLastFlush >= _nodeTimeout / 2)
+    {
+        TLOG_ERROR("CheckNodeThread heartbeat not flushed since " << TC_Common::tm2str(tLastFlush) << ", recheck expired node later" << endl);
+
+        TC_ThreadLock::Lock lock(_wheelLock);
+        for (size_t i = 0; i < vExpired.size(); i++)
+        {
+            _wheel.refresh(vExpired[i], TC_Common::now2ms(), _nodeTimeoutSlackMs);
+        }
+        return;
+    }
+
+    TLOG_DEBUG("CheckNodeThread expired node:" << TC_Common::tostr(vExpired.begin(), vExpired.end(), ",") << endl);
+
+    _db.checkNodeTimeout(vExpired, _nodeTimeout);
+}
+
 void CheckNodeThread::run()
 {
     time_t tLastCheckNode = 0;
@@ -69,19 +123,32 @@ void CheckNodeThread::run()
     {
         try
         {
+            //时间轮中到期的node立即处理
+            checkExpiredNode();
+
             tNow = TC_TimeProvider::getInstance()->getNow();
-            //轮询心跳超时的node
+            //兜底的全表轮询, 处理本主控启动后从未上报过心跳的node
             if(tNow - tLastCheckNode >= _nodeTimeoutInterval)
             {
 			
                 tLastCheckNode = tNow;
-				
-                _db.checkNodeTimeout(_nodeTimeout);
+
+                //心跳先写内存再批量写db, db中的心跳时间只有在最近写入成功时才可信,
+                //写db持续失败时不做超时判断, 避免把所有node误置为inactive
+                time_t tLastFlush = g_app.getHeartbeatFlushThread()->getLastFlushTime();
+                if (tNow - tLastFlush < _nodeTimeout / 2)
+                {
+                    _db.checkNodeTimeout(_nodeTimeout);
+                }
+                else
+                {
+                    TLOG_ERROR("CheckNodeThread heartbeat not flushed since " << TC_Common::tm2str(tLastFlush) << ", skip node timeout check" << endl);
+                }
 
             }
 
             TC_ThreadLock::Lock lock(*this);
-            timedWait(1000); //ms
+            timedWait(NODE_WHEEL_TICK_MS); //ms
         }
         catch(exception & ex)
         {
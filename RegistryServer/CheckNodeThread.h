@@ -20,6 +20,7 @@
 #include <iostream>
 #include "util/tc_thread.h"
 #include "DbHandle.h"
+#include "TimerWheel.h"
 
 using namespace tars;
 
@@ -56,6 +57,24 @@ public:
      */
     virtual void run();
 
+    /**
+     * 收到node心跳或上报, 刷新该node的超时时间
+     * @param nodeName node名称
+     */
+    void keepAlive(const string & nodeName);
+
+    /**
+     * node主动下线, 不再检查超时
+     * @param nodeName node名称
+     */
+    void removeNode(const string & nodeName);
+
+protected:
+    /**
+     * 推进时间轮, 把到期的node批量置为不存活
+     */
+    void checkExpiredNode();
+
 protected:
     /*
      * 线程结束标志
@@ -77,6 +96,18 @@ protected:
      */
     int          _nodeTimeoutInterval;
 
+    /*
+     * 时间轮中超时时间额外的余量(毫秒): 心跳最多晚一个写db周期入库, last_heartbeat只精确到秒
+     */
+    int          _nodeTimeoutSlackMs;
+
+    /*
+     * node心跳超时时间轮, 刻度100ms
+     */
+    TimerWheel   _wheel;
+
+    TC_ThreadLock _wheelLock;
+
 };
 
 #endif
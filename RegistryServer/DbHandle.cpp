@@ -16,13 +16,15 @@
 
 #include <iterator>
 #include <algorithm>
+#include <cstdio>
+#include <errno.h>
 #include "DbHandle.h"
 #include "RegistryServer.h"
 #include "LoadBalanceThread.h"
 #include "util.h"
 #include "NodeManager.h"
 
-TC_ReadersWriterData<ObjectsCache> CDbHandle::_objectsCache;
+ObjectsSnapshotPtr CDbHandle::_objectsSnapshot = std::make_shared<ObjectsSnapshot>();
 
 TC_ReadersWriterData<std::map<int, CDbHandle::GroupPriorityEntry> > CDbHandle::_mapGroupPriority;
 
@@ -39,9 +41,29 @@ TC_ThreadLock CDbHandle::_mapServantFlowStatusLock;
 TC_ReadersWriterData<map<string, int> > CDbHandle::_groupIdMap;
 //key-group_name, value-组编号
 TC_ReadersWriterData<map<string, int> > CDbHandle::_groupNameMap;
+//ipv4前缀-组编号
+TC_ReadersWriterData<IpGroupTrie> CDbHandle::_groupIdTrie;
+
+vector<map<string, string> > CDbHandle::_serverGroupRule;
+//从1开始, 线程缓存中version为0的项视为无效
+std::atomic<uint32_t> CDbHandle::_groupIdVersion(1);
+
+//线程内ip->组编号缓存, 直接映射, 查询不加锁也不分配内存
+struct GroupIdCacheEntry
+{
+    uint32_t ip;
+    int      groupId;
+    uint32_t version;
+};
+
+static const uint32_t GROUP_ID_CACHE_BITS = 10;
+static thread_local GroupIdCacheEntry g_groupIdCache[1 << GROUP_ID_CACHE_BITS];
 
 TC_ReadersWriterData<CDbHandle::SetDivisionCache> CDbHandle::_setDivisionCache;
 
+std::atomic<uint64_t> CDbHandle::_routeVersion(1);
+EndpointsCache CDbHandle::_endpointsCache;
+
 tars::TC_Mysql CDbHandle::_mysqlQueryStat;
 bool CDbHandle::_isMysqlQueryStatInited = false;
 
@@ -93,6 +115,148 @@ void CDbHandle::updateMysql()
     catch(const std::exception& e)
     {
     }
+
+    //服务变更日志, 由触发器维护, registry按序号增量读取
+    try
+    {
+        _mysqlReg.execute("CREATE TABLE IF NOT EXISTS `t_server_change_log` ("
+                          "`id` bigint(20) NOT NULL AUTO_INCREMENT,"
+                          "`application` varchar(128) NOT NULL DEFAULT '',"
+                          "`server_name` varchar(128) NOT NULL DEFAULT '',"
+                          "`change_time` timestamp NOT NULL DEFAULT CURRENT_TIMESTAMP,"
+                          "PRIMARY KEY (`id`),"
+                          "KEY `index_change_time` (`change_time`)"
+                          ") ENGINE=InnoDB DEFAULT CHARSET=utf8");
+    }
+    catch(const std::exception& e)
+    {
+        TLOG_ERROR("CDbHandle::updateMysql create t_server_change_log error: " << e.what() << endl);
+        return;
+    }
+
+    //触发器已存在或者没有权限时忽略, 此时加载逻辑会退回到按registry_timestamp增量加载
+    const char *triggers[] = {
+        "CREATE TRIGGER `tr_server_conf_insert` AFTER INSERT ON `t_server_conf` FOR EACH ROW "
+        "INSERT INTO `t_server_change_log` (`application`, `server_name`) VALUES (NEW.application, NEW.server_name)",
+
+        "CREATE TRIGGER `tr_server_conf_update` AFTER UPDATE ON `t_server_conf` FOR EACH ROW "
+        "INSERT INTO `t_server_change_log` (`application`, `server_name`) SELECT NEW.application, NEW.server_name FROM DUAL "
+        "WHERE NOT (NEW.setting_state <=> OLD.setting_state AND NEW.present_state <=> OLD.present_state AND NEW.flow_state <=> OLD.flow_state "
+        "AND NEW.enable_group <=> OLD.enable_group AND NEW.ip_group_name <=> OLD.ip_group_name AND NEW.bak_flag <=> OLD.bak_flag "
+        "AND NEW.enable_set <=> OLD.enable_set AND NEW.set_name <=> OLD.set_name AND NEW.set_area <=> OLD.set_area AND NEW.set_group <=> OLD.set_group "
+        "AND NEW.node_name <=> OLD.node_name)",
+
+        "CREATE TRIGGER `tr_server_conf_delete` AFTER DELETE ON `t_server_conf` FOR EACH ROW "
+        "INSERT INTO `t_server_change_log` (`application`, `server_name`) VALUES (OLD.application, OLD.server_name)",
+
+        "CREATE TRIGGER `tr_adapter_conf_insert` AFTER INSERT ON `t_adapter_conf` FOR EACH ROW "
+        "INSERT INTO `t_server_change_log` (`application`, `server_name`) VALUES (NEW.application, NEW.server_name)",
+
+        "CREATE TRIGGER `tr_adapter_conf_update` AFTER UPDATE ON `t_adapter_conf` FOR EACH ROW "
+        "INSERT INTO `t_server_change_log` (`application`, `server_name`) SELECT NEW.application, NEW.server_name FROM DUAL "
+        "WHERE NOT (NEW.servant <=> OLD.servant AND NEW.endpoint <=> OLD.endpoint AND NEW.node_name <=> OLD.node_name)",
+
+        "CREATE TRIGGER `tr_adapter_conf_delete` AFTER DELETE ON `t_adapter_conf` FOR EACH ROW "
+        "INSERT INTO `t_server_change_log` (`application`, `server_name`) VALUES (OLD.application, OLD.server_name)",
+    };
+
+    for (size_t i = 0; i < sizeof(triggers) / sizeof(triggers[0]); i++)
+    {
+        try
+        {
+            _mysqlReg.execute(triggers[i]);
+        }
+        catch(const std::exception& e)
+        {
+        }
+    }
+}
+
+int CDbHandle::initServerChangeLog(int64_t &iChangeSeq)
+{
+    try
+    {
+        //六个触发器都存在才能保证不漏掉变更
+        TC_Mysql::MysqlData res = _mysqlReg.queryRecord("select count(*) as num from information_schema.triggers "
+                                                        "where trigger_schema=database() and trigger_name like 'tr\\_%\\_conf\\_%' "
+                                                        "and action_statement like '%t_server_change_log%'");
+        if (res.size() != 1 || TC_Common::strto<int>(res[0]["num"]) < 6)
+        {
+            TLOG_DEBUG("CDbHandle::initServerChangeLog triggers not ready, use registry_timestamp to load changes" << endl);
+            return -1;
+        }
+
+        //必须在全量加载的查询之前记录, 全量加载期间发生的变更会在下一次增量加载时重放
+        res = _mysqlReg.queryRecord("select ifnull(max(id), 0) as seq from t_server_change_log");
+        iChangeSeq = res.size() > 0 ? TC_Common::strto<int64_t>(res[0]["seq"]) : 0;
+
+        TLOG_DEBUG("CDbHandle::initServerChangeLog seq:" << iChangeSeq << endl);
+    }
+    catch (exception& ex)
+    {
+        TLOG_ERROR("CDbHandle::initServerChangeLog exception: " << ex.what() << endl);
+        return -1;
+    }
+
+    return 0;
+}
+
+int CDbHandle::loadServerChangeLog(int64_t &iChangeSeq, string &sCondition)
+{
+    sCondition.clear();
+
+    //序号连续性检查, 已处理序号之后的记录被清理掉说明停顿太久, 退回到按时间增量加载
+    TC_Mysql::MysqlData res = _mysqlReg.queryRecord("select ifnull(min(id), 0) as seq from t_server_change_log");
+    int64_t iMinSeq = res.size() > 0 ? TC_Common::strto<int64_t>(res[0]["seq"]) : 0;
+    if (iMinSeq > _lastChangeSeq + 1)
+    {
+        //序号已经断开, 下次全量加载成功后重新启用
+        _changeLogEnabled = false;
+        TLOG_ERROR("CDbHandle::loadServerChangeLog change log purged, last seq:" << _lastChangeSeq << ", min seq:" << iMinSeq << ", use registry_timestamp until next full load" << endl);
+        return -1;
+    }
+
+    //自增id的提交顺序和分配顺序可能不一致, 上次加载以来的记录总是重新读一次, 避免漏掉晚提交的小序号
+    string sSql = "select id, application, server_name from t_server_change_log "
+                  "where id > " + TC_Common::tostr(_lastChangeSeq) + " or change_time >= date_sub(now(), INTERVAL " + TC_Common::tostr(_changeLogWindow) + " SECOND) "
+                  "order by id limit 5000";
+
+    res = _mysqlReg.queryRecord(sSql);
+
+    set<pair<string, string> > setServers;
+    iChangeSeq = _lastChangeSeq;
+    for (size_t i = 0; i < res.size(); i++)
+    {
+        iChangeSeq = std::max(iChangeSeq, TC_Common::strto<int64_t>(res[i]["id"]));
+        setServers.insert(make_pair(res[i]["application"], res[i]["server_name"]));
+    }
+
+    for (auto it = setServers.begin(); it != setServers.end(); ++it)
+    {
+        sCondition += (sCondition.empty() ? "" : " or ");
+        sCondition += "(server.application='" + _mysqlReg.escapeString(it->first) + "' and server.server_name='" + _mysqlReg.escapeString(it->second) + "')";
+    }
+
+    TLOG_DEBUG("CDbHandle::loadServerChangeLog last seq:" << _lastChangeSeq << ", new seq:" << iChangeSeq << ", records:" << res.size() << ", servers:" << setServers.size() << endl);
+
+    return 0;
+}
+
+int CDbHandle::purgeServerChangeLog(int iKeepSeconds)
+{
+    try
+    {
+        _mysqlReg.execute("delete from t_server_change_log where change_time < date_sub(now(), INTERVAL " + TC_Common::tostr(iKeepSeconds) + " SECOND)");
+
+        TLOG_DEBUG("CDbHandle::purgeServerChangeLog affected:" << _mysqlReg.getAffectedRows() << endl);
+    }
+    catch (exception& ex)
+    {
+        TLOG_ERROR("CDbHandle::purgeServerChangeLog exception: " << ex.what() << endl);
+        return -1;
+    }
+
+    return 0;
 }
 
 int CDbHandle::loadDockerInfo(map<string, DockerRegistry> &info)
@@ -301,6 +465,73 @@ int CDbHandle::keepAlive(const string& name, const LoadInfo& li)
     return 0;
 }
 
+int CDbHandle::keepAliveBatch(const map<string, LoadInfo>& mapHeartbeat, set<string>& missing)
+{
+    //每条sql最多更新的node数, 避免sql超过max_allowed_packet
+    const size_t iBatchSize = 500;
+
+    try
+    {
+        int64_t iStart = TNOWMS;
+        size_t iAffected = 0;
+
+        map<string, LoadInfo>::const_iterator it = mapHeartbeat.begin();
+        while (it != mapHeartbeat.end())
+        {
+            string sNames;
+            string sAvg1;
+            string sAvg5;
+            string sAvg15;
+            set<string> batch;
+
+            for (size_t i = 0; i < iBatchSize && it != mapHeartbeat.end(); ++i, ++it)
+            {
+                string sName = "'" + _mysqlReg.escapeString(it->first) + "'";
+
+                sNames += (sNames.empty() ? "" : ",") + sName;
+                sAvg1  += " when " + sName + " then " + TC_Common::tostr<float>(it->second.avg1);
+                sAvg5  += " when " + sName + " then " + TC_Common::tostr<float>(it->second.avg5);
+                sAvg15 += " when " + sName + " then " + TC_Common::tostr<float>(it->second.avg15);
+
+                batch.insert(it->first);
+            }
+
+            string sSql = "update t_node_info "
+                          "set last_heartbeat=now(), present_state='active',"
+                          "    load_avg1=case node_name" + sAvg1 + " end,"
+                          "    load_avg5=case node_name" + sAvg5 + " end,"
+                          "    load_avg15=case node_name" + sAvg15 + " end "
+                          "where node_name in (" + sNames + ")";
+
+            _mysqlReg.execute(sSql);
+
+            size_t iRows = _mysqlReg.getAffectedRows();
+            iAffected += iRows;
+
+            //affected rows不含没有变化的行, 少于node数时查一下哪些node不存在
+            if (iRows < batch.size())
+            {
+                TC_Mysql::MysqlData res = _mysqlReg.queryRecord("select node_name from t_node_info where node_name in (" + sNames + ")");
+                for (size_t i = 0; i < res.size(); i++)
+                {
+                    batch.erase(res[i]["node_name"]);
+                }
+
+                missing.insert(batch.begin(), batch.end());
+            }
+        }
+
+        TLOG_DEBUG("CDbHandle::keepAliveBatch nodes:" << mapHeartbeat.size() << " affected:" << iAffected << " missing:" << missing.size() << "|cost:" << (TNOWMS - iStart) << endl);
+    }
+    catch (TC_Mysql_Exception& ex)
+    {
+        TLOG_ERROR("CDbHandle::keepAliveBatch exception: " << ex.what() << endl);
+        return 2;
+    }
+
+    return 0;
+}
+
 map<string, string> CDbHandle::getActiveNodeList(string& result)
 {
     map<string, string> mapNodeList;
@@ -520,19 +751,19 @@ string CDbHandle::getProfileTemplate(const string& sTemplateName, string& sResul
 void CDbHandle::getAllDynamicWeightServant(std::vector<string> &vtServant)
 {
     ostringstream log;
-    const auto &objectCache = _objectsCache.getReaderData();
-    log << objectCache.size() << "|";
-    for (const auto &objPair : objectCache)
+    ObjectsSnapshotPtr snapshot = getObjectsSnapshot();
+    log << snapshot->size() << "|";
+    snapshot->forEach([&](const string &servant, const ObjectItem &item)
     {
-        if (!objPair.second.vActiveEndpoints.empty())
+        if (!item.vActiveEndpoints.empty())
         {
-            if (LOAD_BALANCE_DYNAMIC_WEIGHT == objPair.second.vActiveEndpoints[0].weightType)
+            if (LOAD_BALANCE_DYNAMIC_WEIGHT == item.vActiveEndpoints[0].weightType)
             {
-                vtServant.push_back(objPair.first);
-                log << objPair.first << "; ";
+                vtServant.push_back(servant);
+                log << servant << "; ";
             }
         }
-    }
+    });
 
     log << "|vtServant size: " << vtServant.size();
     TLOG_DEBUG(log.str() << "|" << endl);
@@ -947,6 +1178,42 @@ int CDbHandle::checkNodeTimeout(unsigned uTimeout)
 
 }
 
+int CDbHandle::checkNodeTimeout(const vector<string>& vNodeName, unsigned uTimeout)
+{
+    if (vNodeName.empty())
+    {
+        return 0;
+    }
+
+    try
+    {
+        int64_t iStart = TNOWMS;
+
+        string sNodes;
+        for (size_t i = 0; i < vNodeName.size(); i++)
+        {
+            sNodes += (i == 0 ? "'" : ",'") + _mysqlReg.escapeString(vNodeName[i]) + "'";
+        }
+
+        string sSql = "update t_node_info as node "
+                      "    left join t_server_conf as server using (node_name) "
+                      "set node.present_state='inactive', server.present_state='inactive', server.process_id=0 "
+                      "where node.node_name in (" + sNodes + ") "
+                      "    and last_heartbeat < date_sub(now(), INTERVAL " + TC_Common::tostr(uTimeout) + " SECOND)";
+
+        _mysqlReg.execute(sSql);
+
+        TLOG_DEBUG("CDbHandle::checkNodeTimeout nodes:" << vNodeName.size() << " (" << uTimeout  << "s) affected:" << _mysqlReg.getAffectedRows() << "|cost:" << (TNOWMS - iStart) << endl);
+
+        return _mysqlReg.getAffectedRows();
+    }
+    catch (TC_Mysql_Exception& ex)
+    {
+        TLOG_ERROR("CDbHandle::checkNodeTimeout exception: " << ex.what() << endl);
+        return -1;
+    }
+}
+
 int CDbHandle::checkRegistryTimeout(unsigned uTimeout)
 {
     try
@@ -1106,17 +1373,28 @@ int CDbHandle::checkRegistryTimeout(unsigned uTimeout)
 
 int CDbHandle::getGroupId(const string& ip)
 {
-
-    map<string, int>& groupIdMap = _groupIdMap.getReaderData();
-    map<string, int>::iterator it = groupIdMap.find(ip);
-    if (it != groupIdMap.end())
+    uint32_t uip = 0;
+    if (IpGroupTrie::parseIp(ip, uip))
     {
-        return it->second;
+        uint32_t version = _groupIdVersion.load(std::memory_order_acquire);
+        GroupIdCacheEntry &entry = g_groupIdCache[(uip * 2654435761u) >> (32 - GROUP_ID_CACHE_BITS)];
+        if (entry.version == version && entry.ip == uip)
+        {
+            return entry.groupId;
+        }
+
+        int groupId = _groupIdTrie.getReaderData().find(uip);
+
+        entry.ip      = uip;
+        entry.groupId = groupId;
+        entry.version = version;
+
+        return groupId;
     }
 
-    uint32_t uip = stringIpToInt(ip);
-    string ipStar = Ip2StarStr(uip);
-    it = groupIdMap.find(ipStar);
+    //非ipv4地址, 只能精确匹配
+    map<string, int>& groupIdMap = _groupIdMap.getReaderData();
+    map<string, int>::iterator it = groupIdMap.find(ip);
     if (it != groupIdMap.end())
     {
         return it->second;
@@ -1196,8 +1474,10 @@ void CDbHandle::load2GroupMap(const vector<map<string, string> >& serverGroupRul
 {
     map<string, int>& groupIdMap = _groupIdMap.getWriterData();
     map<string, int>& groupNameMap = _groupNameMap.getWriterData();
+    IpGroupTrie& groupIdTrie = _groupIdTrie.getWriterData();
     groupIdMap.clear();  //规则改变 清除以前缓存
     groupNameMap.clear();
+    groupIdTrie.clear();
     vector<map<string, string> >::const_iterator it = serverGroupRule.begin();
     for (; it != serverGroupRule.end(); it++)
     {
@@ -1205,14 +1485,26 @@ void CDbHandle::load2GroupMap(const vector<map<string, string> >& serverGroupRul
         vector<string> vIp = TC_Common::sepstr<string>(it->find("allow_ip_rule")->second, "|");
         for (size_t j = 0; j < vIp.size(); j++)
         {
-            groupIdMap[vIp[j]] = groupId;
+            string rule = TC_Common::trim(vIp[j]);
+            if (!groupIdTrie.insert(rule, groupId))
+            {
+                groupIdMap[rule] = groupId;
+            }
         }
 
         groupNameMap[it->find("group_name")->second] = groupId;
     }
     _groupIdMap.swap();
     _groupNameMap.swap();
+    _groupIdTrie.swap();
+
+    _serverGroupRule = serverGroupRule;
 
+    //规则已切换, 作废所有线程缓存
+    _groupIdVersion.fetch_add(1, std::memory_order_release);
+    updateRouteVersion();
+
+    TLOG_DEBUG("CDbHandle::load2GroupMap prefix rules:" << groupIdTrie.size() << ", exact rules:" << groupIdMap.size() << endl);
 }
 
 
@@ -1238,6 +1530,7 @@ int CDbHandle::loadGroupPriority(bool fromInit)
         }
 
         _mapGroupPriority.swap();
+        updateRouteVersion();
 
         TLOG_DEBUG("loaded groups priority to cache virtual group size:" << mapPriority.size() << endl);
     }
@@ -1427,13 +1720,35 @@ int CDbHandle::loadObjectIdCache(const bool bRecoverProtect, const int iRecoverP
             loadGroupPriority(fromInit);
         }
 
+        //全量加载时重新确定变更日志的起点, 必须在全量加载的查询之前取
+        bool bChangeLogReady = false;
+        int64_t iFullLoadSeq = 0;
+        if (bLoadAll)
+        {
+            bChangeLogReady = (initServerChangeLog(iFullLoadSeq) == 0);
+        }
+
         //加载存活server及registry列表信息
         string sSql1 =
               "select adapter.servant,adapter.endpoint,server.enable_group,server.setting_state,server.present_state, server.flow_state, server.application,server.server_name,server.node_name,server.enable_set,server.set_name,server.set_area,server.set_group,server.ip_group_name,server.bak_flag "
               "from t_adapter_conf as adapter right join t_server_conf as server using (application, server_name, node_name)";
 
+        //按变更日志增量加载, 只查询有变化的服务
+        bool bUseChangeLog = false;
+        int64_t iChangeSeq = _lastChangeSeq;
+        if (!bLoadAll && _changeLogEnabled)
+        {
+            string sCondition;
+            bUseChangeLog = (loadServerChangeLog(iChangeSeq, sCondition) == 0);
+            if (bUseChangeLog)
+            {
+                //没有变化的服务时, 不需要查询服务表
+                sSql1 = sCondition.empty() ? "" : (sSql1 + " where " + sCondition);
+            }
+        }
+
         //增量加载逻辑
-        if (!bLoadAll)
+        if (!bLoadAll && !bUseChangeLog)
         {
             string sInterval = TC_Common::tm2str(TC_TimeProvider::getInstance()->getNow() - iLoadTimeInterval);
             sSql1 += " ,(select distinct application,server_name from t_server_conf";
@@ -1449,7 +1764,11 @@ int CDbHandle::loadObjectIdCache(const bool bRecoverProtect, const int iRecoverP
         TC_Mysql::MysqlData res;
 
         {
-            TC_Mysql::MysqlData res1  = _mysqlReg.queryRecord(sSql1);
+            TC_Mysql::MysqlData res1;
+            if (!sSql1.empty())
+            {
+                res1 = _mysqlReg.queryRecord(sSql1);
+            }
 
             TC_Mysql::MysqlData res2  = _mysqlReg.queryRecord(sSql2);
             TLOG_DEBUG("CDbHandle::loadObjectIdCache load " << (bLoadAll ? "all " : "") << "Active objects from db, records affected:" << (res1.size() + res2.size())
@@ -1620,6 +1939,18 @@ int CDbHandle::loadObjectIdCache(const bool bRecoverProtect, const int iRecoverP
         updateFlowStatusCache(mapFlowStatus, bLoadAll);
         updateDivisionCache(setDivisionCache, bLoadAll);
 
+        //缓存更新成功后才推进序号
+        if (bLoadAll)
+        {
+            //全量加载成功, 之前因为序号断开退回按时间加载的状态也一起恢复
+            _changeLogEnabled = bChangeLogReady;
+            _lastChangeSeq    = iFullLoadSeq;
+        }
+        else if (bUseChangeLog)
+        {
+            _lastChangeSeq = iChangeSeq;
+        }
+
         TLOG_DEBUG("loaded objects to cache  size:" << objectsCache.size() << endl);
         TLOG_DEBUG("loaded server status to cache size:" << mapStatus.size() << endl);
         TLOG_DEBUG("loaded server flow status to cache size:" << mapFlowStatus.size() << endl);
@@ -1707,25 +2038,48 @@ int CDbHandle::updateRegistryInfo2Db(bool bRegHeartbeatOff)
     return 0;
 }
 
-vector<EndpointF> CDbHandle::findObjectById(const string& id)
+void CDbHandle::updateRouteVersion()
 {
-    ObjectsCache::iterator it;
-    ObjectsCache& usingCache = _objectsCache.getReaderData();
+    _routeVersion.fetch_add(1, std::memory_order_release);
+}
 
-    if ((it = usingCache.find(id)) != usingCache.end())
-    {
-        // 不能是引用，会改变原始缓存数据
-        std::vector<tars::EndpointF> vtEp = it->second.vActiveEndpoints;
+void CDbHandle::cacheEndpoints(EndpointsCache::QueryKind kind, const string &id, int groupId, uint64_t version,
+                               const vector<EndpointF> &activeEp, const vector<EndpointF> &inactiveEp, int iRet)
+{
+    std::shared_ptr<EndpointsCache::Entry> entry = std::make_shared<EndpointsCache::Entry>();
+    entry->vActive   = activeEp;
+    entry->vInactive = inactiveEp;
+    entry->iRet      = iRet;
 
-        LOAD_BALANCE_INS->getDynamicWeight(id, vtEp);
+    _endpointsCache.put(kind, id, groupId, version, entry);
+}
 
-        return vtEp;
+vector<EndpointF> CDbHandle::findObjectById(const string& id)
+{
+    //版本号必须在读取缓存数据之前获取
+    uint64_t version = _routeVersion.load(std::memory_order_acquire);
+    EndpointsCache::EntryPtr entry = _endpointsCache.get(EndpointsCache::QUERY_ACTIVE, id, -1, version);
+    if (entry)
+    {
+        return entry->vActive;
     }
-    else
+
+    ObjectsSnapshotPtr snapshot = getObjectsSnapshot();
+    const ObjectItem *item = snapshot->find(id);
+
+    // 不能是引用，会改变原始缓存数据
+    std::vector<tars::EndpointF> vtEp;
+
+    if (item != NULL)
     {
-        vector<EndpointF> activeEp;
-        return activeEp;
+        vtEp = item->vActiveEndpoints;
+
+        LOAD_BALANCE_INS->getDynamicWeight(id, vtEp);
     }
+
+    cacheEndpoints(EndpointsCache::QUERY_ACTIVE, id, -1, version, vtEp, vector<EndpointF>(), 0);
+
+    return vtEp;
 }
 
 int CDbHandle::findObjectById4All(const string& id, vector<EndpointF>& activeEp, vector<EndpointF>& inactiveEp)
@@ -1733,13 +2087,22 @@ int CDbHandle::findObjectById4All(const string& id, vector<EndpointF>& activeEp,
 
     TLOG_DEBUG(__FUNCTION__ << " id: " << id << endl);
 
-    ObjectsCache::iterator it;
-    ObjectsCache& usingCache = _objectsCache.getReaderData();
+    uint64_t version = _routeVersion.load(std::memory_order_acquire);
+    EndpointsCache::EntryPtr entry = _endpointsCache.get(EndpointsCache::QUERY_ALL, id, -1, version);
+    if (entry)
+    {
+        activeEp   = entry->vActive;
+        inactiveEp = entry->vInactive;
+        return entry->iRet;
+    }
 
-    if ((it = usingCache.find(id)) != usingCache.end())
+    ObjectsSnapshotPtr snapshot = getObjectsSnapshot();
+    const ObjectItem *item = snapshot->find(id);
+
+    if (item != NULL)
     {
-        activeEp   = it->second.vActiveEndpoints;
-        inactiveEp = it->second.vInactiveEndpoints;
+        activeEp   = item->vActiveEndpoints;
+        inactiveEp = item->vInactiveEndpoints;
 
         LOAD_BALANCE_INS->getDynamicWeight(id, activeEp);
     }
@@ -1749,17 +2112,19 @@ int CDbHandle::findObjectById4All(const string& id, vector<EndpointF>& activeEp,
         inactiveEp.clear();
     }
 
+    cacheEndpoints(EndpointsCache::QUERY_ALL, id, -1, version, activeEp, inactiveEp, 0);
+
     return  0;
 }
 
-vector<EndpointF> CDbHandle::getEpsByGroupId(const vector<EndpointF>& vecEps, const GroupUseSelect GroupSelect, int iGroupId, ostringstream& os)
+vector<EndpointF> CDbHandle::getEpsByGroupId(const vector<EndpointF>& vecEps, const GroupUseSelect GroupSelect, int iGroupId, ostringstream* os)
 {
-    os << "|";
+    if (os) *os << "|";
     vector<EndpointF> vResult;
 
     for (unsigned i = 0; i < vecEps.size(); i++)
     {
-        os << vecEps[i].host << ":" << vecEps[i].port << "(" << vecEps[i].groupworkid << ");";
+        if (os) *os << vecEps[i].host << ":" << vecEps[i].port << "(" << vecEps[i].groupworkid << ");";
         if (GroupSelect == ENUM_USE_WORK_GROUPID && vecEps[i].groupworkid == iGroupId)
         {
             vResult.push_back(vecEps[i]);
@@ -1773,14 +2138,14 @@ vector<EndpointF> CDbHandle::getEpsByGroupId(const vector<EndpointF>& vecEps, co
     return vResult;
 }
 
-vector<EndpointF> CDbHandle::getEpsByGroupId(const vector<EndpointF>& vecEps, const GroupUseSelect GroupSelect, const set<int>& setGroupID, ostringstream& os)
+vector<EndpointF> CDbHandle::getEpsByGroupId(const vector<EndpointF>& vecEps, const GroupUseSelect GroupSelect, const set<int>& setGroupID, ostringstream* os)
 {
-    os << "|";
+    if (os) *os << "|";
     std::vector<EndpointF> vecResult;
 
     for (std::vector<EndpointF>::size_type i = 0; i < vecEps.size(); i++)
     {
-        os << vecEps[i].host << ":" << vecEps[i].port << "(" << vecEps[i].groupworkid << ")";
+        if (os) *os << vecEps[i].host << ":" << vecEps[i].port << "(" << vecEps[i].groupworkid << ")";
         if (GroupSelect == ENUM_USE_WORK_GROUPID && setGroupID.count(vecEps[i].groupworkid) == 1)
         {
             vecResult.push_back(vecEps[i]);
@@ -1794,37 +2159,37 @@ vector<EndpointF> CDbHandle::getEpsByGroupId(const vector<EndpointF>& vecEps, co
     return vecResult;
 }
 
-int CDbHandle::findObjectByIdInSameGroup(const string& id, const string& ip, vector<EndpointF>& activeEp, vector<EndpointF>& inactiveEp, ostringstream& os)
+int CDbHandle::findObjectByIdInSameGroup(const string& id, const string& ip, vector<EndpointF>& activeEp, vector<EndpointF>& inactiveEp, ostringstream* os)
 {
     activeEp.clear();
     inactiveEp.clear();
 
     int iClientGroupId  = getGroupId(ip);
 
-    os << "|(" << iClientGroupId << ")";
+    if (os) *os << "|(" << iClientGroupId << ")";
 
     if (iClientGroupId == -1)
     {
         return findObjectById4All(id, activeEp, inactiveEp);
     }
 
-    ObjectsCache::iterator it;
-    ObjectsCache& usingCache = _objectsCache.getReaderData();
+    ObjectsSnapshotPtr snapshot = getObjectsSnapshot();
+    const ObjectItem *item = snapshot->find(id);
 
-    if ((it = usingCache.find(id)) != usingCache.end())
+    if (item != NULL)
     {
-        activeEp    = getEpsByGroupId(it->second.vActiveEndpoints, ENUM_USE_WORK_GROUPID, iClientGroupId, os);
-        inactiveEp  = getEpsByGroupId(it->second.vInactiveEndpoints, ENUM_USE_WORK_GROUPID, iClientGroupId, os);
+        activeEp    = getEpsByGroupId(item->vActiveEndpoints, ENUM_USE_WORK_GROUPID, iClientGroupId, os);
+        inactiveEp  = getEpsByGroupId(item->vInactiveEndpoints, ENUM_USE_WORK_GROUPID, iClientGroupId, os);
 
         if (activeEp.size() == 0) //没有同组的endpoit,匹配未启用分组的服务
         {
-            activeEp    = getEpsByGroupId(it->second.vActiveEndpoints, ENUM_USE_WORK_GROUPID, -1, os);
-            inactiveEp  = getEpsByGroupId(it->second.vInactiveEndpoints, ENUM_USE_WORK_GROUPID, -1, os);
+            activeEp    = getEpsByGroupId(item->vActiveEndpoints, ENUM_USE_WORK_GROUPID, -1, os);
+            inactiveEp  = getEpsByGroupId(item->vInactiveEndpoints, ENUM_USE_WORK_GROUPID, -1, os);
         }
         if (activeEp.size() == 0) //没有同组的endpoit
         {
-            activeEp   = it->second.vActiveEndpoints;
-            inactiveEp = it->second.vInactiveEndpoints;
+            activeEp   = item->vActiveEndpoints;
+            inactiveEp = item->vInactiveEndpoints;
         }
     }
 
@@ -1833,27 +2198,42 @@ int CDbHandle::findObjectByIdInSameGroup(const string& id, const string& ip, vec
     return  0;
 }
 
-int CDbHandle::findObjectByIdInGroupPriority(const std::string& sID, const std::string& sIP, std::vector<EndpointF>& vecActive, std::vector<EndpointF>& vecInactive, std::ostringstream& os)
+int CDbHandle::findObjectByIdInGroupPriority(const std::string& sID, const std::string& sIP, std::vector<EndpointF>& vecActive, std::vector<EndpointF>& vecInactive, std::ostringstream* os)
 {
     vecActive.clear();
     vecInactive.clear();
 
     int iClientGroupID = getGroupId(sIP);
-    os << "|(" << iClientGroupID << ")";
+    if (os) *os << "|(" << iClientGroupID << ")";
     if (iClientGroupID == -1)
     {
         return findObjectById4All(sID, vecActive, vecInactive);
     }
 
-    ObjectsCache& usingCache = _objectsCache.getReaderData();
-    ObjectsCache::iterator itObject = usingCache.find(sID);
-    if (itObject == usingCache.end()) return 0;
+    //结果只与客户端所在的组有关, 同组的客户端共用缓存
+    uint64_t version = _routeVersion.load(std::memory_order_acquire);
+    EndpointsCache::EntryPtr entry = _endpointsCache.get(EndpointsCache::QUERY_GROUP_PRIORITY, sID, iClientGroupID, version);
+    if (entry)
+    {
+        vecActive   = entry->vActive;
+        vecInactive = entry->vInactive;
+        if (os) *os << "|(In Cache: Active=" << vecActive.size() << " Inactive=" << vecInactive.size() << ")";
+        return entry->iRet;
+    }
+
+    ObjectsSnapshotPtr snapshot = getObjectsSnapshot();
+    const ObjectItem *itObject = snapshot->find(sID);
+    if (itObject == NULL)
+    {
+        cacheEndpoints(EndpointsCache::QUERY_GROUP_PRIORITY, sID, iClientGroupID, version, vecActive, vecInactive, 0);
+        return 0;
+    }
 
     //首先在同组中查找
     {
-        vecActive     = getEpsByGroupId(itObject->second.vActiveEndpoints, ENUM_USE_WORK_GROUPID, iClientGroupID, os);
-        vecInactive    = getEpsByGroupId(itObject->second.vInactiveEndpoints, ENUM_USE_WORK_GROUPID, iClientGroupID, os);
-        os << "|(In Same Group: " << iClientGroupID << " Active=" << vecActive.size() << " Inactive=" << vecInactive.size() << ")";
+        vecActive     = getEpsByGroupId(itObject->vActiveEndpoints, ENUM_USE_WORK_GROUPID, iClientGroupID, os);
+        vecInactive    = getEpsByGroupId(itObject->vInactiveEndpoints, ENUM_USE_WORK_GROUPID, iClientGroupID, os);
+        if (os) *os << "|(In Same Group: " << iClientGroupID << " Active=" << vecActive.size() << " Inactive=" << vecInactive.size() << ")";
     }
 
     //启用分组，但同组中没有找到，在优先级序列中查找
@@ -1862,36 +2242,38 @@ int CDbHandle::findObjectByIdInGroupPriority(const std::string& sID, const std::
     {
         if (it->second.setGroupID.count(iClientGroupID) == 0)
         {
-            os << "|(Not In Priority " << it->second.sGroupID << ")";
+            if (os) *os << "|(Not In Priority " << it->second.sGroupID << ")";
             continue;
         }
-        vecActive    = getEpsByGroupId(itObject->second.vActiveEndpoints, ENUM_USE_WORK_GROUPID, it->second.setGroupID, os);
-        vecInactive    = getEpsByGroupId(itObject->second.vInactiveEndpoints, ENUM_USE_WORK_GROUPID, it->second.setGroupID, os);
-        os << "|(In Priority: " << it->second.sGroupID << " Active=" << vecActive.size() << " Inactive=" << vecInactive.size() << ")";
+        vecActive    = getEpsByGroupId(itObject->vActiveEndpoints, ENUM_USE_WORK_GROUPID, it->second.setGroupID, os);
+        vecInactive    = getEpsByGroupId(itObject->vInactiveEndpoints, ENUM_USE_WORK_GROUPID, it->second.setGroupID, os);
+        if (os) *os << "|(In Priority: " << it->second.sGroupID << " Active=" << vecActive.size() << " Inactive=" << vecInactive.size() << ")";
     }
 
     //没有同组的endpoit,匹配未启用分组的服务
     if (vecActive.empty())
     {
-        vecActive    = getEpsByGroupId(itObject->second.vActiveEndpoints, ENUM_USE_WORK_GROUPID, -1, os);
-        vecInactive    = getEpsByGroupId(itObject->second.vInactiveEndpoints, ENUM_USE_WORK_GROUPID, -1, os);
-        os << "|(In No Grouop: Active=" << vecActive.size() << " Inactive=" << vecInactive.size() << ")";
+        vecActive    = getEpsByGroupId(itObject->vActiveEndpoints, ENUM_USE_WORK_GROUPID, -1, os);
+        vecInactive    = getEpsByGroupId(itObject->vInactiveEndpoints, ENUM_USE_WORK_GROUPID, -1, os);
+        if (os) *os << "|(In No Grouop: Active=" << vecActive.size() << " Inactive=" << vecInactive.size() << ")";
     }
 
     //在未分组的情况下也没有找到，返回全部地址(此时基本上所有的服务都已挂掉)
     if (vecActive.empty())
     {
-        vecActive    = itObject->second.vActiveEndpoints;
-        vecInactive    = itObject->second.vInactiveEndpoints;
-        os << "|(In All: Active=" << vecActive.size() << " Inactive=" << vecInactive.size() << ")";
+        vecActive    = itObject->vActiveEndpoints;
+        vecInactive    = itObject->vInactiveEndpoints;
+        if (os) *os << "|(In All: Active=" << vecActive.size() << " Inactive=" << vecInactive.size() << ")";
     }
 
     LOAD_BALANCE_INS->getDynamicWeight(sID, vecActive);
 
+    cacheEndpoints(EndpointsCache::QUERY_GROUP_PRIORITY, sID, iClientGroupID, version, vecActive, vecInactive, 0);
+
     return 0;
 }
 
-int CDbHandle::findObjectByIdInSameStation(const std::string& sID, const std::string& sStation, std::vector<EndpointF>& vecActive, std::vector<EndpointF>& vecInactive, std::ostringstream& os)
+int CDbHandle::findObjectByIdInSameStation(const std::string& sID, const std::string& sStation, std::vector<EndpointF>& vecActive, std::vector<EndpointF>& vecInactive, std::ostringstream* os)
 {
     vecActive.clear();
     vecInactive.clear();
@@ -1908,24 +2290,24 @@ int CDbHandle::findObjectByIdInSameStation(const std::string& sID, const std::st
 
     if (itGroup == mapPriority.end())
     {
-        os << "|not found station:" << sStation;
+        if (os) *os << "|not found station:" << sStation;
         return -1;
     }
 
-    ObjectsCache& usingCache = _objectsCache.getReaderData();
-    ObjectsCache::iterator itObject = usingCache.find(sID);
-    if (itObject == usingCache.end()) return 0;
+    ObjectsSnapshotPtr snapshot = getObjectsSnapshot();
+    const ObjectItem *itObject = snapshot->find(sID);
+    if (itObject == NULL) return 0;
 
     //查找对应所有组下的IP地址
-    vecActive    = getEpsByGroupId(itObject->second.vActiveEndpoints, ENUM_USE_REAL_GROUPID, itGroup->second.setGroupID, os);
-    vecInactive    = getEpsByGroupId(itObject->second.vInactiveEndpoints, ENUM_USE_REAL_GROUPID, itGroup->second.setGroupID, os);
+    vecActive    = getEpsByGroupId(itObject->vActiveEndpoints, ENUM_USE_REAL_GROUPID, itGroup->second.setGroupID, os);
+    vecInactive    = getEpsByGroupId(itObject->vInactiveEndpoints, ENUM_USE_REAL_GROUPID, itGroup->second.setGroupID, os);
 
     LOAD_BALANCE_INS->getDynamicWeight(sID, vecActive);
 
     return 0;
 }
 
-int CDbHandle::findObjectByIdInSameSet(const string& sID, const vector<string>& vtSetInfo, std::vector<EndpointF>& vecActive, std::vector<EndpointF>& vecInactive, std::ostringstream& os)
+int CDbHandle::findObjectByIdInSameSet(const string& sID, const vector<string>& vtSetInfo, std::vector<EndpointF>& vecActive, std::vector<EndpointF>& vecInactive, std::ostringstream* os)
 {
     string sSetName   = vtSetInfo[0];
     string sSetArea   = vtSetInfo[0] + "." + vtSetInfo[1];
@@ -1991,7 +2373,7 @@ int CDbHandle::findObjectByIdInSameSet(const string& sID, const vector<string>&
 
 }
 
-int CDbHandle::findObjectByIdInSameSet(const string& sSetId, const vector<SetServerInfo>& vSetServerInfo, std::vector<EndpointF>& vecActive, std::vector<EndpointF>& vecInactive, std::ostringstream& os)
+int CDbHandle::findObjectByIdInSameSet(const string& sSetId, const vector<SetServerInfo>& vSetServerInfo, std::vector<EndpointF>& vecActive, std::vector<EndpointF>& vecInactive, std::ostringstream* os)
 {
     for (size_t i = 0; i < vSetServerInfo.size(); ++i)
     {
@@ -2077,27 +2459,25 @@ void CDbHandle::updateFlowStatusCache(const std::map<ServantStatusKey, int>& mSt
     }
 }
 
+ObjectsSnapshotPtr CDbHandle::getObjectsSnapshot()
+{
+    return std::atomic_load(&_objectsSnapshot);
+}
+
 void CDbHandle::updateObjectsCache(const ObjectsCache& objCache, bool updateAll)
 {
     //全量更新
     if (updateAll)
     {
-        _objectsCache.getWriterData() = objCache;
-        _objectsCache.swap();
+        std::atomic_store(&_objectsSnapshot, ObjectsSnapshot::create(objCache));
+        updateRouteVersion();
     }
-    else
+    else if (!objCache.empty())
     {
-        //用查询数据覆盖一下
-        _objectsCache.getWriterData() = _objectsCache.getReaderData();
-        ObjectsCache& tmpObjCache = _objectsCache.getWriterData();
-
-        ObjectsCache::const_iterator it = objCache.begin();
-        for (; it != objCache.end(); it++)
-        {
-            //增量的时候加载的是服务的所有节点，因此这里直接替换
-            tmpObjCache[it->first] = it->second;
-        }
-        _objectsCache.swap();
+        //只复制有变化的分片, 其余分片与当前快照共享
+        //更新只在ReapThread中进行, 不会有并发的写者
+        std::atomic_store(&_objectsSnapshot, getObjectsSnapshot()->update(objCache));
+        updateRouteVersion();
     }
 }
 
@@ -2130,6 +2510,266 @@ void CDbHandle::updateDivisionCache(const SetDivisionCache& setDivisionCache, bo
         _setDivisionCache.swap();
     }
 }
+//缓存快照文件标识及格式版本, 格式变化时递增版本号, 版本不一致的快照不加载
+#define CACHE_SNAPSHOT_MAGIC    "tarsregistry.cache"
+#define CACHE_SNAPSHOT_VERSION  1
+
+int CDbHandle::saveCacheSnapshot(const string& sFile)
+{
+    try
+    {
+        int64_t iStart = TNOWMS;
+
+        TarsOutputStream<BufferWriterString> os;
+        os.write(string(CACHE_SNAPSHOT_MAGIC), 0);
+        os.write((tars::Int32)CACHE_SNAPSHOT_VERSION, 1);
+        os.write((tars::Int64)TNOW, 2);
+
+        //对象列表
+        ObjectsCache objectsCache;
+        getObjectsSnapshot()->forEach([&objectsCache](const string& servant, const ObjectItem& item)
+        {
+            objectsCache.insert(objectsCache.end(), make_pair(servant, item));
+        });
+        os.write(objectsCache, 3);
+
+        //set划分, 按字段展开成并列的数组
+        {
+            vector<string> vServant, vSetName, vSetId, vSetArea;
+            vector<tars::Char> vActive;
+            vector<EndpointF> vEndpoint;
+
+            const SetDivisionCache& setDivisionCache = _setDivisionCache.getReaderData();
+            for (SetDivisionCache::const_iterator it = setDivisionCache.begin(); it != setDivisionCache.end(); ++it)
+            {
+                for (map<string, vector<SetServerInfo> >::const_iterator itSet = it->second.begin(); itSet != it->second.end(); ++itSet)
+                {
+                    for (size_t i = 0; i < itSet->second.size(); i++)
+                    {
+                        vServant.push_back(it->first);
+                        vSetName.push_back(itSet->first);
+                        vSetId.push_back(itSet->second[i].sSetId);
+                        vSetArea.push_back(itSet->second[i].sSetArea);
+                        vActive.push_back(itSet->second[i].bActive ? 1 : 0);
+                        vEndpoint.push_back(itSet->second[i].epf);
+                    }
+                }
+            }
+
+            os.write(vServant, 4);
+            os.write(vSetName, 5);
+            os.write(vSetId, 6);
+            os.write(vSetArea, 7);
+            os.write(vActive, 8);
+            os.write(vEndpoint, 9);
+        }
+
+        //分组规则
+        os.write(_serverGroupRule, 10);
+
+        //分组优先级
+        {
+            vector<string> vGroupId, vStation;
+            vector<vector<tars::Int32> > vGroupList;
+
+            const std::map<int, GroupPriorityEntry>& mapPriority = _mapGroupPriority.getReaderData();
+            for (std::map<int, GroupPriorityEntry>::const_iterator it = mapPriority.begin(); it != mapPriority.end(); ++it)
+            {
+                vGroupId.push_back(it->second.sGroupID);
+                vStation.push_back(it->second.sStation);
+                vGroupList.push_back(vector<tars::Int32>(it->second.setGroupID.begin(), it->second.setGroupID.end()));
+            }
+
+            os.write(vGroupId, 11);
+            os.write(vStation, 12);
+            os.write(vGroupList, 13);
+        }
+
+        //服务状态及流量状态
+        std::map<ServantStatusKey, int>* statusMaps[2] = { &_mapServantStatus, &_mapServantFlowStatus };
+        TC_ThreadLock* statusLocks[2] = { &_mapServantStatusLock, &_mapServantFlowStatusLock };
+        for (int n = 0; n < 2; n++)
+        {
+            vector<string> vApp, vServer, vNode;
+            vector<tars::Int32> vStatus;
+            {
+                TC_ThreadLock::Lock lock(*statusLocks[n]);
+                for (std::map<ServantStatusKey, int>::const_iterator it = statusMaps[n]->begin(); it != statusMaps[n]->end(); ++it)
+                {
+                    vApp.push_back(it->first.application);
+                    vServer.push_back(it->first.serverName);
+                    vNode.push_back(it->first.nodeName);
+                    vStatus.push_back(it->second);
+                }
+            }
+
+            os.write(vApp, 14 + n * 4);
+            os.write(vServer, 15 + n * 4);
+            os.write(vNode, 16 + n * 4);
+            os.write(vStatus, 17 + n * 4);
+        }
+
+        string sTmpFile = sFile + ".tmp";
+        TC_File::makeDirRecursive(TC_File::extractFilePath(sFile));
+        if (TC_File::save2file(sTmpFile, os.getByteBuffer()) != 0 || ::rename(sTmpFile.c_str(), sFile.c_str()) != 0)
+        {
+            TLOG_ERROR("CDbHandle::saveCacheSnapshot write " << sFile << " failed, errno:" << errno << endl);
+            return -1;
+        }
+
+        TLOG_DEBUG("CDbHandle::saveCacheSnapshot " << sFile << " objects:" << objectsCache.size() << " bytes:" << os.getLength() << "|cost:" << (TNOWMS - iStart) << endl);
+    }
+    catch (exception& ex)
+    {
+        TLOG_ERROR("CDbHandle::saveCacheSnapshot exception: " << ex.what() << endl);
+        return -1;
+    }
+
+    return 0;
+}
+
+int CDbHandle::loadCacheSnapshot(const string& sFile, int iMaxAge)
+{
+    if (!TC_File::isFileExist(sFile))
+    {
+        TLOG_DEBUG("CDbHandle::loadCacheSnapshot " << sFile << " not exist" << endl);
+        return -1;
+    }
+
+    try
+    {
+        int64_t iStart = TNOWMS;
+
+        string sBuffer = TC_File::load2str(sFile);
+
+        TarsInputStream<> is;
+        is.setBuffer(sBuffer.c_str(), sBuffer.length());
+
+        string sMagic;
+        tars::Int32 iVersion = 0;
+        tars::Int64 iSaveTime = 0;
+        is.read(sMagic, 0, true);
+        is.read(iVersion, 1, true);
+        is.read(iSaveTime, 2, true);
+
+        if (sMagic != CACHE_SNAPSHOT_MAGIC || iVersion != CACHE_SNAPSHOT_VERSION)
+        {
+            TLOG_ERROR("CDbHandle::loadCacheSnapshot " << sFile << " magic:" << sMagic << " version:" << iVersion << " not match" << endl);
+            return -2;
+        }
+
+        if (TNOW - iSaveTime > iMaxAge)
+        {
+            TLOG_ERROR("CDbHandle::loadCacheSnapshot " << sFile << " saved at " << TC_Common::tm2str(iSaveTime) << " is too old" << endl);
+            return -3;
+        }
+
+        //先全部解析完再更新缓存, 避免快照损坏时只恢复了一部分
+        ObjectsCache objectsCache;
+        is.read(objectsCache, 3, true);
+
+        SetDivisionCache setDivisionCache;
+        {
+            vector<string> vServant, vSetName, vSetId, vSetArea;
+            vector<tars::Char> vActive;
+            vector<EndpointF> vEndpoint;
+            is.read(vServant, 4, true);
+            is.read(vSetName, 5, true);
+            is.read(vSetId, 6, true);
+            is.read(vSetArea, 7, true);
+            is.read(vActive, 8, true);
+            is.read(vEndpoint, 9, true);
+
+            size_t iSize = vServant.size();
+            if (vSetName.size() != iSize || vSetId.size() != iSize || vSetArea.size() != iSize || vActive.size() != iSize || vEndpoint.size() != iSize)
+            {
+                TLOG_ERROR("CDbHandle::loadCacheSnapshot " << sFile << " set division size not match" << endl);
+                return -4;
+            }
+
+            for (size_t i = 0; i < iSize; i++)
+            {
+                SetServerInfo setInfo;
+                setInfo.sSetId   = vSetId[i];
+                setInfo.sSetArea = vSetArea[i];
+                setInfo.bActive  = (vActive[i] != 0);
+                setInfo.epf      = vEndpoint[i];
+                setDivisionCache[vServant[i]][vSetName[i]].push_back(setInfo);
+            }
+        }
+
+        vector<map<string, string> > serverGroupRule;
+        is.read(serverGroupRule, 10, true);
+
+        std::map<int, GroupPriorityEntry> mapPriority;
+        {
+            vector<string> vGroupId, vStation;
+            vector<vector<tars::Int32> > vGroupList;
+            is.read(vGroupId, 11, true);
+            is.read(vStation, 12, true);
+            is.read(vGroupList, 13, true);
+
+            if (vStation.size() != vGroupId.size() || vGroupList.size() != vGroupId.size())
+            {
+                TLOG_ERROR("CDbHandle::loadCacheSnapshot " << sFile << " group priority size not match" << endl);
+                return -4;
+            }
+
+            for (size_t i = 0; i < vGroupId.size(); i++)
+            {
+                mapPriority[i].sGroupID = vGroupId[i];
+                mapPriority[i].sStation = vStation[i];
+                mapPriority[i].setGroupID.insert(vGroupList[i].begin(), vGroupList[i].end());
+            }
+        }
+
+        std::map<ServantStatusKey, int> statusMaps[2];
+        for (int n = 0; n < 2; n++)
+        {
+            vector<string> vApp, vServer, vNode;
+            vector<tars::Int32> vStatus;
+            is.read(vApp, 14 + n * 4, true);
+            is.read(vServer, 15 + n * 4, true);
+            is.read(vNode, 16 + n * 4, true);
+            is.read(vStatus, 17 + n * 4, true);
+
+            if (vServer.size() != vApp.size() || vNode.size() != vApp.size() || vStatus.size() != vApp.size())
+            {
+                TLOG_ERROR("CDbHandle::loadCacheSnapshot " << sFile << " status size not match" << endl);
+                return -4;
+            }
+
+            for (size_t i = 0; i < vApp.size(); i++)
+            {
+                ServantStatusKey statusKey = { vApp[i], vServer[i], vNode[i] };
+                statusMaps[n][statusKey] = vStatus[i];
+            }
+        }
+
+        //分组信息一定要在服务信息之前
+        load2GroupMap(serverGroupRule);
+
+        _mapGroupPriority.getWriterData() = mapPriority;
+        _mapGroupPriority.swap();
+
+        updateStatusCache(statusMaps[0], true);
+        updateFlowStatusCache(statusMaps[1], true);
+        updateDivisionCache(setDivisionCache, true);
+        updateObjectsCache(objectsCache, true);
+
+        TLOG_DEBUG("CDbHandle::loadCacheSnapshot " << sFile << " saved at " << TC_Common::tm2str(iSaveTime)
+                   << " objects:" << objectsCache.size() << " set servants:" << setDivisionCache.size()
+                   << "|cost:" << (TNOWMS - iStart) << endl);
+    }
+    catch (exception& ex)
+    {
+        TLOG_ERROR("CDbHandle::loadCacheSnapshot " << sFile << " exception: " << ex.what() << endl);
+        return -5;
+    }
+
+    return 0;
+}
+
 void CDbHandle::sendSqlErrorAlarmSMS(const string &err)
 {
     string errInfo = " ERROR:" + g_app.getAdapterEndpoint().getHost() +  ": registry error: " + err + ", please check!";
@@ -25,10 +25,14 @@
 #include "jmem/jmem_hashmap.h"
 #include "util/tc_readers_writer_data.h"
 #include <set>
+#include <atomic>
 
 #include "Registry.h"
 #include "Node.h"
 #include "servant/RemoteLogger.h"
+#include "IpGroupTrie.h"
+#include "EndpointsCache.h"
+#include "ObjectsSnapshot.h"
 
 //#define GROUPCACHEFILE      "serverGroupCache.dat"
 //#define GROUPPROICACHEFILE  "GroupPrioCache.dat"
@@ -36,8 +40,6 @@
 using namespace tars;
 //////////////////////////////////////////////////////
 
-//<servant, ObjectItem>
-typedef map<string, ObjectItem> ObjectsCache;
 //typedef TarsHashMap<ObjectName, ObjectItem, ThreadLockPolicy, FileStorePolicy> FileHashMap;
 
 //_mapServantStatus的key
@@ -73,6 +75,9 @@ struct Tars : public TarsException
  */
 class CDbHandle
 {
+    //压测工具直接装载合成数据, 不经过数据库
+    friend class RegistryBench;
+
 private:
     struct GroupPriorityEntry
     {
@@ -105,9 +110,18 @@ public:
      */
     CDbHandle()
     : _enMultiSql(false)
+    , _changeLogEnabled(false)
+    , _lastChangeSeq(0)
+    , _changeLogWindow(15)
     {
     }
 
+    /**
+     * 增量加载时重新读取的最近变更日志的时间范围
+     * @param iSeconds 应大于增量加载的周期, 覆盖晚提交的小序号
+     */
+    void setChangeLogWindow(int iSeconds) { _changeLogWindow = iSeconds; }
+
     /**
      * 初始化
      * @param pconf 配置文件
@@ -154,6 +168,16 @@ public:
      */
     int keepAlive(const string & name, const LoadInfo & li);
 
+    /**
+     * 批量更新node心跳时间及机器负载, 合并为一条update ... case ... where node_name in (...)
+     * 只更新已有的记录, 不会创建没有注册信息的node
+     *
+     * @param mapHeartbeat node名称->node机器负载信息
+     * @param missing 输出t_node_info中不存在的node, 需要重新注册
+     * @return 0-成功 others-失败
+     */
+    int keepAliveBatch(const map<string, LoadInfo> & mapHeartbeat, set<string> & missing);
+
     /**
      * 获取活动node列表endpoint信息
      * @param out result 结果描述
@@ -287,11 +311,11 @@ public:
      * @param ip
      * @out param activeEp    存活的列表
      * @out param inactiveEp  非存活的列表
-     * @out param os          打印日志使用
+     * @out param os          打印日志使用, 为NULL时不记录
      *
      * @return 0-成功 others-失败
      */
-    int findObjectByIdInSameGroup(const string & id, const string & ip, vector<EndpointF>& activeEp, vector<EndpointF>& inactiveEp, ostringstream &os);
+    int findObjectByIdInSameGroup(const string & id, const string & ip, vector<EndpointF>& activeEp, vector<EndpointF>& inactiveEp, ostringstream *os);
 
     /** 根据id获取优先级序列中的对象
      *
@@ -299,11 +323,11 @@ public:
      * @param ip
      * @out param vecActive    存活的列表
      * @out param vecInactive  非存活的列表
-     * @out param os          打印日志使用
+     * @out param os          打印日志使用, 为NULL时不记录
      *
      * @return 0-成功 others-失败
      */
-    int findObjectByIdInGroupPriority(const std::string &sID, const std::string &sIP, std::vector<EndpointF> & vecActive, std::vector<EndpointF> & vecInactive, std::ostringstream & os);
+    int findObjectByIdInGroupPriority(const std::string &sID, const std::string &sIP, std::vector<EndpointF> & vecActive, std::vector<EndpointF> & vecInactive, std::ostringstream *os);
 
     /** 根据id和归属地获取全部对象
      *
@@ -311,11 +335,11 @@ public:
      * @param sStation 归属地
      * @out param vecActive    存活的列表
      * @out param vecInactive  非存活的列表
-     * @out param os          打印日志使用
+     * @out param os          打印日志使用, 为NULL时不记录
      *
      * @return 0-成功 others-失败
      */
-    int findObjectByIdInSameStation(const std::string &sID, const std::string & sStation, std::vector<EndpointF> & vecActive, std::vector<EndpointF> & vecInactive, std::ostringstream & os);
+    int findObjectByIdInSameStation(const std::string &sID, const std::string & sStation, std::vector<EndpointF> & vecActive, std::vector<EndpointF> & vecInactive, std::ostringstream *os);
 
     /** 根据id和set信息获取全部对象
      *
@@ -323,11 +347,11 @@ public:
      * @param vtSetInfo set信息
      * @out param vecActive    存活的列表
      * @out param vecInactive  非存活的列表
-     * @out param os          打印日志使用
+     * @out param os          打印日志使用, 为NULL时不记录
      *
      * @return 0-成功 others-失败
      */
-    int findObjectByIdInSameSet(const string &sID, const vector<string> &vtSetInfo, std::vector<EndpointF> & vecActive, std::vector<EndpointF> & vecInactive, std::ostringstream & os);
+    int findObjectByIdInSameSet(const string &sID, const vector<string> &vtSetInfo, std::vector<EndpointF> & vecActive, std::vector<EndpointF> & vecInactive, std::ostringstream *os);
 
     /** 根据setId获取全部对象
      *
@@ -335,11 +359,11 @@ public:
      * @param vSetServerInfo SetName下部署的服务信息
      * @out param vecActive    存活的列表
      * @out param vecInactive  非存活的列表
-     * @out param os          打印日志使用
+     * @out param os          打印日志使用, 为NULL时不记录
      *
      * @return 0-成功 others-失败
      */
-    int findObjectByIdInSameSet(const string &sSetId, const vector<SetServerInfo>& vSetServerInfo, std::vector<EndpointF> & vecActive, std::vector<EndpointF> & vecInactive, std::ostringstream & os);
+    int findObjectByIdInSameSet(const string &sSetId, const vector<SetServerInfo>& vSetServerInfo, std::vector<EndpointF> & vecActive, std::vector<EndpointF> & vecInactive, std::ostringstream *os);
     
     /**
      * 获取application列表
@@ -396,6 +420,31 @@ public:
      */
     int checkNodeTimeout(unsigned uTimeout);
 
+    /**
+     * 将指定的心跳超时节点及server状态设为不存活, 按node_name批量更新,
+     * db中的心跳时间仍需超时(可能已连到其他主控上报心跳)
+     * @param vNodeName 内存中检测到心跳超时的节点
+     * @param uTimeout  超时时间
+     * @return 影响的记录数, 失败返回-1
+     */
+    int checkNodeTimeout(const vector<string> & vNodeName, unsigned uTimeout);
+
+    /**
+     * 把当前的路由缓存(对象列表、set划分、分组规则、优先级、服务状态)写入快照文件
+     * 先写临时文件再改名, 保证快照文件总是完整的
+     * @param sFile 快照文件路径
+     * @return 0-成功 others-失败
+     */
+    int saveCacheSnapshot(const string & sFile);
+
+    /**
+     * 从快照文件恢复路由缓存, 用于启动时在访问db之前就能提供查询服务
+     * @param sFile   快照文件路径
+     * @param iMaxAge 快照最大有效时间, 单位秒, 超过则不加载
+     * @return 0-成功 others-快照不存在、版本不一致、过期或损坏
+     */
+    int loadCacheSnapshot(const string & sFile, int iMaxAge);
+
     /**
      * 轮询数据库，将心跳超时的registry设为不存活
      * @param iTiemout 超时时间
@@ -422,6 +471,13 @@ public:
      */
     int loadObjectIdCache(const bool bRecoverProtect, const int iRecoverProtectRate, const int iLoadTimeInterval=60, const bool bLoadAll=false, bool fromInit = false);
 
+    /**
+     * 清理过期的服务变更日志
+     * @param iKeepSeconds 保留最近多少秒的记录
+     * @return 0-成功 others-失败
+     */
+    int purgeServerChangeLog(int iKeepSeconds);
+
     /**
      * 加载组优先级到内存
      * @param NULL
@@ -464,6 +520,16 @@ public:
      */
     int loadIPPhysicalGroupInfo(bool fromInit);
 
+    /**
+     * 获取当前的对象列表快照, 持有返回值期间快照不会被释放
+     */
+    static ObjectsSnapshotPtr getObjectsSnapshot();
+
+    /**
+     * 路由相关数据(对象缓存/分组规则/组优先级/动态权重)变化后调用, 作废已缓存的查询结果
+     */
+    static void updateRouteVersion();
+
     /**
      * ip转换
      */
@@ -484,9 +550,15 @@ protected:
     /**
      * 根据group id获取Endpoint
      */
-    vector<EndpointF> getEpsByGroupId(const vector<EndpointF> & vecEps, const GroupUseSelect GroupSelect, int iGroupId, ostringstream &os);
+    vector<EndpointF> getEpsByGroupId(const vector<EndpointF> & vecEps, const GroupUseSelect GroupSelect, int iGroupId, ostringstream *os);
 
-    vector<EndpointF> getEpsByGroupId(const vector<EndpointF> & vecEps, const GroupUseSelect GroupSelect, const set<int> & setGroupID, ostringstream & os);
+    vector<EndpointF> getEpsByGroupId(const vector<EndpointF> & vecEps, const GroupUseSelect GroupSelect, const set<int> & setGroupID, ostringstream *os);
+
+    /**
+     * 缓存查询结果
+     */
+    void cacheEndpoints(EndpointsCache::QueryKind kind, const string &id, int groupId, uint64_t version,
+                        const vector<EndpointF> &activeEp, const vector<EndpointF> &inactiveEp, int iRet);
 
     /**
      * updateServerStateBatch的底层实现函数
@@ -530,6 +602,21 @@ private:
      */
     void updateDivisionCache(const SetDivisionCache& setDivisionCache,bool updateAll=false);
 
+    /**
+     * 检查变更日志的触发器是否就绪, 并取当前最大序号作为增量加载的起点
+     * @param iChangeSeq 当前最大序号, 全量加载成功后才生效
+     * @return 0-可用 others-不可用
+     */
+    int initServerChangeLog(int64_t &iChangeSeq);
+
+    /**
+     * 读取已处理序号之后的变更日志
+     * @param iChangeSeq 本次读到的最大序号
+     * @param sCondition 有变化的服务对应的查询条件, 没有变化时为空
+     * @return 0-成功 others-变更日志不连续, 到下次全量加载成功之前都按时间增量加载
+     */
+    int loadServerChangeLog(int64_t &iChangeSeq, string &sCondition);
+
     /**
      * 对数据库查询结果执行联合操作
      *
@@ -558,12 +645,21 @@ protected:
     //mysql连接对象
     TC_Mysql _mysqlReg;
 
+    //服务变更日志是否可用
+    bool _changeLogEnabled;
+
+    //已处理的最大变更日志序号
+    int64_t _lastChangeSeq;
+
+    //每次增量加载重新读取最近多少秒的变更日志
+    int _changeLogWindow;
+
 //    //node节点代理列表
 //    static map<string , NodePrx> _mapNodePrxCache;
 //    static TC_ThreadLock _NodePrxLock;
 
-    //对象列表缓存
-    static TC_ReadersWriterData<ObjectsCache>    _objectsCache;
+    //对象列表缓存, 只能通过std::atomic_load/atomic_store访问
+    static ObjectsSnapshotPtr                    _objectsSnapshot;
 
     //set划分缓存
     static TC_ReadersWriterData<SetDivisionCache> _setDivisionCache;
@@ -583,10 +679,25 @@ protected:
     //存在多线程更新_mapServantFlowStatus，需要加锁
     static TC_ThreadLock _mapServantFlowStatusLock;
 
-    //分组信息
+    //分组信息, _groupIdMap只保存无法按ipv4前缀解析的规则
     static TC_ReadersWriterData<map<string,int> > _groupIdMap;
     static TC_ReadersWriterData<map<string,int> > _groupNameMap;
 
+    //ipv4分组规则的最长前缀匹配树
+    static TC_ReadersWriterData<IpGroupTrie> _groupIdTrie;
+
+    //最近一次加载的原始分组规则, 写缓存快照用, 只在ReapThread中读写
+    static vector<map<string, string> > _serverGroupRule;
+
+    //路由版本号, 用于判断查询结果缓存是否有效
+    static std::atomic<uint64_t> _routeVersion;
+
+    //按(对象名, 查询类型, 分组)缓存的查询结果
+    static EndpointsCache _endpointsCache;
+
+    //分组规则版本号, 每次重新加载规则后递增, 用于淘汰线程内的ip->组编号缓存
+    static std::atomic<uint32_t> _groupIdVersion;
+
      // stat监控数据mysql连接对象
      static tars::TC_Mysql _mysqlQueryStat;
      static bool _isMysqlQueryStatInited;
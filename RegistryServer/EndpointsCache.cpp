@@ -0,0 +1,71 @@
+/**
+ * Tencent is pleased to support the open source community by making Tars available.
+ *
+ * Copyright (C) 2016THL A29 Limited, a Tencent company. All rights reserved.
+ *
+ * Licensed under the BSD 3-Clause License (the "License"); you may not use this file except
+ * in compliance with the License. You may obtain a copy of the License at
+ *
+ * https://opensource.org/licenses/BSD-3-Clause
+ *
+ * Unless required by applicable law or agreed to in writing, software distributed
+ * under the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+ * CONDITIONS OF ANY KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations under the License.
+ */
+
+#include "EndpointsCache.h"
+#include "util/tc_common.h"
+
+string EndpointsCache::makeKey(QueryKind kind, const string &id, int groupId)
+{
+    string key;
+    key.reserve(id.size() + 16);
+    key += id;
+    key += '|';
+    key += TC_Common::tostr(static_cast<int>(kind));
+    key += '|';
+    key += TC_Common::tostr(groupId);
+    return key;
+}
+
+EndpointsCache::EntryPtr EndpointsCache::get(QueryKind kind, const string &id, int groupId, uint64_t version)
+{
+    string key = makeKey(kind, id, groupId);
+    Shard &shard = _shards[std::hash<string>()(key) % SHARD_NUM];
+
+    TC_ThreadLock::Lock lock(shard.lock);
+    if (shard.version != version)
+    {
+        return NULL;
+    }
+
+    auto it = shard.data.find(key);
+    if (it == shard.data.end())
+    {
+        return NULL;
+    }
+
+    return it->second;
+}
+
+void EndpointsCache::put(QueryKind kind, const string &id, int groupId, uint64_t version, const EntryPtr &entry)
+{
+    string key = makeKey(kind, id, groupId);
+    Shard &shard = _shards[std::hash<string>()(key) % SHARD_NUM];
+
+    TC_ThreadLock::Lock lock(shard.lock);
+    if (shard.version > version)
+    {
+        //计算期间路由数据已更新, 结果已过期
+        return;
+    }
+
+    if (shard.version < version)
+    {
+        shard.data.clear();
+        shard.version = version;
+    }
+
+    shard.data[key] = entry;
+}
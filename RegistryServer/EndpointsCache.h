@@ -0,0 +1,79 @@
+/**
+ * Tencent is pleased to support the open source community by making Tars available.
+ *
+ * Copyright (C) 2016THL A29 Limited, a Tencent company. All rights reserved.
+ *
+ * Licensed under the BSD 3-Clause License (the "License"); you may not use this file except
+ * in compliance with the License. You may obtain a copy of the License at
+ *
+ * https://opensource.org/licenses/BSD-3-Clause
+ *
+ * Unless required by applicable law or agreed to in writing, software distributed
+ * under the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+ * CONDITIONS OF ANY KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations under the License.
+ */
+
+#ifndef __ENDPOINTS_CACHE_H__
+#define __ENDPOINTS_CACHE_H__
+
+#include <memory>
+#include <unordered_map>
+#include "util/tc_monitor.h"
+#include "QueryF.h"
+
+using namespace tars;
+
+//////////////////////////////////////////////////////
+/**
+ * 查询结果缓存
+ * 缓存按(对象名, 查询类型, 分组)计算好的endpoint列表(已经过分组过滤和动态权重处理),
+ * 每条记录带有生成时的路由版本号, 版本号变化(对象缓存/分组规则/动态权重更新)后自动失效
+ */
+class EndpointsCache
+{
+public:
+    enum QueryKind
+    {
+        QUERY_ACTIVE = 0,           //findObjectById
+        QUERY_ALL,                  //findObjectById4All
+        QUERY_GROUP_PRIORITY,       //findObjectByIdInGroupPriority, 分组为客户端的组编号
+    };
+
+    struct Entry
+    {
+        vector<EndpointF> vActive;
+        vector<EndpointF> vInactive;
+        int               iRet;
+    };
+
+    typedef std::shared_ptr<const Entry> EntryPtr;
+
+    /**
+     * 查找缓存
+     * @param version 调用方在读取路由数据之前取得的路由版本号
+     * @return 未命中或已失效返回NULL
+     */
+    EntryPtr get(QueryKind kind, const string &id, int groupId, uint64_t version);
+
+    /**
+     * 写入缓存, 版本号与分片中的版本号不一致时整个分片先清空
+     */
+    void put(QueryKind kind, const string &id, int groupId, uint64_t version, const EntryPtr &entry);
+
+protected:
+    static string makeKey(QueryKind kind, const string &id, int groupId);
+
+    struct Shard
+    {
+        TC_ThreadLock                            lock;
+        uint64_t                                 version = 0;
+        std::unordered_map<string, EntryPtr>     data;
+    };
+
+    enum { SHARD_NUM = 16 };
+
+    Shard _shards[SHARD_NUM];
+};
+
+#endif
@@ -0,0 +1,138 @@
+/**
+ * Tencent is pleased to support the open source community by making Tars available.
+ *
+ * Copyright (C) 2016THL A29 Limited, a Tencent company. All rights reserved.
+ *
+ * Licensed under the BSD 3-Clause License (the "License"); you may not use this file except
+ * in compliance with the License. You may obtain a copy of the License at
+ *
+ * https://opensource.org/licenses/BSD-3-Clause
+ *
+ * Unless required by applicable law or agreed to in writing, software distributed
+ * under the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+ * CONDITIONS OF ANY KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations under the License.
+ */
+
+#include "HeartbeatFlushThread.h"
+
+extern TC_Config * g_pconf;
+
+HeartbeatFlushThread::HeartbeatFlushThread()
+: _terminate(false)
+, _flushInterval(1000)
+, _lastFlushTime(0)
+{
+}
+
+HeartbeatFlushThread::~HeartbeatFlushThread()
+{
+    if (isAlive())
+    {
+        terminate();
+        notifyAll();
+        getThreadControl().join();
+    }
+}
+
+int HeartbeatFlushThread::init()
+{
+    TLOG_DEBUG("HeartbeatFlushThread init"<<endl);
+
+    //初始化配置db连接
+    _db.init(g_pconf);
+
+    //心跳写db周期
+    _flushInterval = TC_Common::strto<int>((*g_pconf).get("/tars/reap<heartbeatFlushInterval>", "1000"));
+    _flushInterval = _flushInterval < 100 ? 100 : _flushInterval;
+
+    _lastFlushTime = TNOW;
+
+    TLOG_DEBUG("HeartbeatFlushThread init ok, flush interval:" << _flushInterval << "ms" << endl);
+
+    return 0;
+}
+
+void HeartbeatFlushThread::terminate()
+{
+    TLOG_DEBUG("HeartbeatFlushThread terminate" << endl);
+    _terminate = true;
+}
+
+void HeartbeatFlushThread::keepAlive(const string & name, const LoadInfo & li)
+{
+    TC_ThreadLock::Lock lock(_pendingLock);
+    _pending[name] = li;
+}
+
+bool HeartbeatFlushThread::needRegister(const string & name)
+{
+    TC_ThreadLock::Lock lock(_pendingLock);
+    return _missing.erase(name) > 0;
+}
+
+void HeartbeatFlushThread::flush()
+{
+    map<string, LoadInfo> mapHeartbeat;
+    {
+        TC_ThreadLock::Lock lock(_pendingLock);
+        mapHeartbeat.swap(_pending);
+    }
+
+    if (mapHeartbeat.empty())
+    {
+        _lastFlushTime = TNOW;
+        return;
+    }
+
+    set<string> missing;
+    if (_db.keepAliveBatch(mapHeartbeat, missing) == 0)
+    {
+        _lastFlushTime = TNOW;
+
+        if (!missing.empty())
+        {
+            TLOG_ERROR("HeartbeatFlushThread::flush nodes not registered:" << TC_Common::tostr(missing.begin(), missing.end(), ",") << endl);
+
+            TC_ThreadLock::Lock lock(_pendingLock);
+            _missing.insert(missing.begin(), missing.end());
+        }
+        return;
+    }
+
+    //写失败, 放回内存表等下个周期重试, 期间收到的新心跳优先
+    TC_ThreadLock::Lock lock(_pendingLock);
+    _pending.insert(mapHeartbeat.begin(), mapHeartbeat.end());
+}
+
+void HeartbeatFlushThread::run()
+{
+    while(!_terminate)
+    {
+        try
+        {
+            flush();
+
+            TC_ThreadLock::Lock lock(*this);
+            timedWait(_flushInterval);
+        }
+        catch(exception & ex)
+        {
+            TLOG_ERROR("HeartbeatFlushThread exception:" << ex.what() << endl);
+        }
+        catch(...)
+        {
+            TLOG_ERROR("HeartbeatFlushThread unknown exception" << endl);
+        }
+    }
+
+    //退出前把剩余的心跳写入db
+    try
+    {
+        flush();
+    }
+    catch(exception & ex)
+    {
+        TLOG_ERROR("HeartbeatFlushThread exception:" << ex.what() << endl);
+    }
+}
@@ -0,0 +1,125 @@
+/**
+ * Tencent is pleased to support the open source community by making Tars available.
+ *
+ * Copyright (C) 2016THL A29 Limited, a Tencent company. All rights reserved.
+ *
+ * Licensed under the BSD 3-Clause License (the "License"); you may not use this file except
+ * in compliance with the License. You may obtain a copy of the License at
+ *
+ * https://opensource.org/licenses/BSD-3-Clause
+ *
+ * Unless required by applicable law or agreed to in writing, software distributed
+ * under the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+ * CONDITIONS OF ANY KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations under the License.
+ */
+
+#ifndef __HEARTBEAT_FLUSH_THREAD_H__
+#define __HEARTBEAT_FLUSH_THREAD_H__
+
+#include <iostream>
+#include <set>
+#include "util/tc_thread.h"
+#include "DbHandle.h"
+
+using namespace tars;
+
+//////////////////////////////////////////////////////
+/**
+ * node心跳合并写入线程
+ * servant线程只把心跳记录到内存表中, 本线程每个周期把内存表中的心跳
+ * 合并成一条update ... case ... where node_name in (...)写入t_node_info
+ */
+class HeartbeatFlushThread : public TC_Thread, public TC_ThreadLock
+{
+public:
+
+    /**
+     * 构造函数
+     */
+    HeartbeatFlushThread();
+
+    /**
+     * 析构函数
+     */
+    ~HeartbeatFlushThread();
+
+    /**
+     * 结束线程
+     */
+    void terminate();
+
+    /**
+     * 初始化
+     */
+    int init();
+
+    /**
+     * 轮询函数
+     */
+    virtual void run();
+
+    /**
+     * 记录node心跳, 只更新内存
+     * @param name node名称
+     * @param li   node机器负载信息
+     */
+    void keepAlive(const string & name, const LoadInfo & li);
+
+    /**
+     * node是否需要重新注册(t_node_info中已经没有它的记录), 返回true后清除标记
+     * @param name node名称
+     */
+    bool needRegister(const string & name);
+
+    /**
+     * 最近一次成功写入db的时间, 心跳超时检查以此判断db中的心跳是否可信
+     */
+    time_t getLastFlushTime() const { return _lastFlushTime; }
+
+    /**
+     * 写db周期, 单位毫秒
+     */
+    int getFlushInterval() const { return _flushInterval; }
+
+protected:
+    /**
+     * 把内存表中的心跳写入db
+     */
+    void flush();
+
+protected:
+    /*
+     * 线程结束标志
+     */
+    bool                    _terminate;
+
+    /*
+     * 数据库操作
+     */
+    CDbHandle               _db;
+
+    /*
+     * 写db周期, 单位毫秒
+     */
+    int                     _flushInterval;
+
+    /*
+     * 待写入的心跳, node名称->负载信息
+     */
+    map<string, LoadInfo>   _pending;
+
+    TC_ThreadLock           _pendingLock;
+
+    /*
+     * 写db时发现t_node_info中不存在的node, 下次心跳时通知它重新注册
+     */
+    set<string>             _missing;
+
+    /*
+     * 最近一次成功写入db的时间
+     */
+    volatile time_t         _lastFlushTime;
+};
+
+#endif
@@ -0,0 +1,202 @@
+/**
+ * Tencent is pleased to support the open source community by making Tars available.
+ *
+ * Copyright (C) 2016THL A29 Limited, a Tencent company. All rights reserved.
+ *
+ * Licensed under the BSD 3-Clause License (the "License"); you may not use this file except
+ * in compliance with the License. You may obtain a copy of the License at
+ *
+ * https://opensource.org/licenses/BSD-3-Clause
+ *
+ * Unless required by applicable law or agreed to in writing, software distributed
+ * under the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+ * CONDITIONS OF ANY KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations under the License.
+ */
+
+#include "IpGroupTrie.h"
+#include <stdlib.h>
+
+IpGroupTrie::IpGroupTrie()
+{
+    clear();
+}
+
+void IpGroupTrie::clear()
+{
+    Node root = { { -1, -1 }, -1 };
+    _nodes.clear();
+    _nodes.push_back(root);
+    _rules = 0;
+}
+
+bool IpGroupTrie::insert(const string &rule, int groupId)
+{
+    uint32_t prefix = 0;
+    int prefixLen   = 0;
+    if (!parseRule(rule, prefix, prefixLen))
+    {
+        return false;
+    }
+
+    int32_t cur = 0;
+    for (int i = 0; i < prefixLen; i++)
+    {
+        int bit = (prefix >> (31 - i)) & 1;
+        if (_nodes[cur].child[bit] == -1)
+        {
+            Node node = { { -1, -1 }, -1 };
+            _nodes.push_back(node);
+            _nodes[cur].child[bit] = static_cast<int32_t>(_nodes.size() - 1);
+        }
+        cur = _nodes[cur].child[bit];
+    }
+
+    _nodes[cur].groupId = groupId;
+    _rules++;
+
+    return true;
+}
+
+int IpGroupTrie::find(uint32_t ip) const
+{
+    int groupId = _nodes[0].groupId;
+    int32_t cur = 0;
+    for (int i = 0; i < 32; i++)
+    {
+        cur = _nodes[cur].child[(ip >> (31 - i)) & 1];
+        if (cur == -1)
+        {
+            break;
+        }
+        if (_nodes[cur].groupId != -1)
+        {
+            groupId = _nodes[cur].groupId;
+        }
+    }
+
+    return groupId;
+}
+
+bool IpGroupTrie::parseIp(const string &ip, uint32_t &out)
+{
+    uint32_t value  = 0;
+    uint32_t octet  = 0;
+    int      digits = 0;
+    int      dots   = 0;
+
+    for (size_t i = 0; i < ip.size(); i++)
+    {
+        char c = ip[i];
+        if (c >= '0' && c <= '9')
+        {
+            octet = octet * 10 + (c - '0');
+            if (++digits > 3 || octet > 255)
+            {
+                return false;
+            }
+        }
+        else if (c == '.')
+        {
+            if (digits == 0 || ++dots > 3)
+            {
+                return false;
+            }
+            value  = (value << 8) | octet;
+            octet  = 0;
+            digits = 0;
+        }
+        else
+        {
+            return false;
+        }
+    }
+
+    if (dots != 3 || digits == 0)
+    {
+        return false;
+    }
+
+    out = (value << 8) | octet;
+    return true;
+}
+
+bool IpGroupTrie::parseRule(const string &rule, uint32_t &prefix, int &prefixLen)
+{
+    string::size_type pos = rule.find('/');
+    if (pos != string::npos)
+    {
+        //CIDR格式
+        string sLen = rule.substr(pos + 1);
+        if (sLen.empty() || sLen.size() > 2 || sLen.find_first_not_of("0123456789") != string::npos)
+        {
+            return false;
+        }
+        prefixLen = atoi(sLen.c_str());
+        if (prefixLen > 32 || !parseIp(rule.substr(0, pos), prefix))
+        {
+            return false;
+        }
+    }
+    else
+    {
+        //星号格式, 只允许末尾若干段为*, 每段*缩短8位前缀
+        prefix    = 0;
+        prefixLen = 0;
+        int  fields = 0;
+        bool star   = false;
+        string::size_type begin = 0;
+        while (begin <= rule.size())
+        {
+            string::size_type end = rule.find('.', begin);
+            if (end == string::npos)
+            {
+                end = rule.size();
+            }
+
+            string field = rule.substr(begin, end - begin);
+            if (++fields > 4 || field.empty())
+            {
+                return false;
+            }
+
+            if (field == "*")
+            {
+                star = true;
+                prefix <<= 8;
+            }
+            else
+            {
+                if (star || field.size() > 3 || field.find_first_not_of("0123456789") != string::npos)
+                {
+                    return false;
+                }
+                int octet = atoi(field.c_str());
+                if (octet > 255)
+                {
+                    return false;
+                }
+                prefix = (prefix << 8) | static_cast<uint32_t>(octet);
+                prefixLen += 8;
+            }
+
+            begin = end + 1;
+        }
+
+        if (fields != 4)
+        {
+            return false;
+        }
+    }
+
+    if (prefixLen == 0)
+    {
+        prefix = 0;
+    }
+    else
+    {
+        prefix &= (0xFFFFFFFFu << (32 - prefixLen));
+    }
+
+    return true;
+}
@@ -0,0 +1,90 @@
+/**
+ * Tencent is pleased to support the open source community by making Tars available.
+ *
+ * Copyright (C) 2016THL A29 Limited, a Tencent company. All rights reserved.
+ *
+ * Licensed under the BSD 3-Clause License (the "License"); you may not use this file except
+ * in compliance with the License. You may obtain a copy of the License at
+ *
+ * https://opensource.org/licenses/BSD-3-Clause
+ *
+ * Unless required by applicable law or agreed to in writing, software distributed
+ * under the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+ * CONDITIONS OF ANY KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations under the License.
+ */
+
+#ifndef __IP_GROUP_TRIE_H__
+#define __IP_GROUP_TRIE_H__
+
+#include <string>
+#include <vector>
+#include <stdint.h>
+
+using namespace std;
+
+//////////////////////////////////////////////////////
+/**
+ * IPv4最长前缀匹配树, 用于ip到物理分组的映射
+ * 支持的规则格式:
+ *   1.1.1.1       精确匹配(/32)
+ *   1.1.1.*       星号规则, 末尾的*依次对应/24, /16, /8, /0
+ *   1.1.0.0/16    任意CIDR前缀
+ */
+class IpGroupTrie
+{
+public:
+    IpGroupTrie();
+
+    /**
+     * 清空所有规则
+     */
+    void clear();
+
+    /**
+     * 插入一条规则, 前缀相同时后插入的覆盖先插入的
+     * @param rule    规则字符串
+     * @param groupId 组编号
+     * @return 规则不是合法的ipv4规则时返回false
+     */
+    bool insert(const string &rule, int groupId);
+
+    /**
+     * 最长前缀匹配
+     * @param ip 主机序ip
+     * @return 组编号, 没有匹配返回-1
+     */
+    int find(uint32_t ip) const;
+
+    /**
+     * 规则条数
+     */
+    size_t size() const { return _rules; }
+
+    /**
+     * 解析点分十进制ipv4地址, 不分配内存
+     * @param ip  ip字符串
+     * @param out 主机序ip
+     * @return 非法ipv4地址返回false
+     */
+    static bool parseIp(const string &ip, uint32_t &out);
+
+    /**
+     * 解析规则为(前缀, 前缀长度)
+     */
+    static bool parseRule(const string &rule, uint32_t &prefix, int &prefixLen);
+
+protected:
+    struct Node
+    {
+        int32_t child[2];
+        int32_t groupId;
+    };
+
+    //节点池, _nodes[0]为根节点
+    vector<Node> _nodes;
+
+    size_t       _rules;
+};
+
+#endif
@@ -33,8 +33,12 @@ void LoadBalanceThread::init()
 
     _dynamicSwitch = TC_Common::strto<int>(g_pconf->get("/tars/loadbalance<loadswitch>", "0"));
 
+    _smoothFactor = TC_Common::strto<int>(g_pconf->get("/tars/loadbalance<smoothfactor>", "50"));
+    _smoothFactor = _smoothFactor <= 0 || _smoothFactor > WEIGHT_PERCENT_UNIT ? WEIGHT_PERCENT_UNIT : _smoothFactor;
+
     TLOG_DEBUG("init _dynamicSwitch: " << _dynamicSwitch << "|"
-                                      << "_loadInterval: " << _loadInterval << endl);
+                                      << "_loadInterval: " << _loadInterval << "|"
+                                      << "_smoothFactor: " << _smoothFactor << endl);
 }
 
 void LoadBalanceThread::terminate()
@@ -103,7 +107,7 @@ void LoadBalanceThread::updateDynamicWeight()
     mergeLoadInfo(loadCache);
     // 计算权重
     calculateWeight(loadCache);
-    // 更新双缓存，使用了移动语义，之后不要再使用loadCache
+    // 与上一周期的权重平滑后更新双缓存
     updateWeightCache(loadCache);
 }
 
@@ -136,40 +140,66 @@ void LoadBalanceThread::getDynamicWeight(const string &servant, std::vector<tars
         return;
     }
 
-    ostringstream log;
-    log << "servant: " << servant << "|";
-    const auto &loadCache = _loadCache.getReaderData();
-    auto iter = loadCache.find(servant);
+    const auto &weightCache = _weightCache.getReaderData();
+    auto iter = weightCache.find(servant);
     // obj查不到，可能上报的是服务名。用服务名再查一次
-    if (loadCache.end() == iter)
+    if (weightCache.end() == iter)
     {
-        auto pos(servant.find_last_of(static_cast<string>(".")));
+        auto pos(servant.find_last_of('.'));
         if (string::npos != pos)
         {
-            iter = loadCache.find(servant.substr(0, pos));
+            iter = weightCache.find(servant.substr(0, pos));
         }
     }
 
-    bool isFound(true);
-    if (loadCache.end() != iter) // 动态负载的key是servant或者服务名
+    bool isFound(weightCache.end() != iter); // 动态负载的key是servant或者服务名
+    if (isFound)
     {
-        log << "vtEndpoints size: " << vtEndpoints.size() << "|";
-        int weightSum(0); // 求和打日志用
         for (auto &endpoint : vtEndpoints)
         {
             if (LOAD_BALANCE_DYNAMIC_WEIGHT == endpoint.weightType)
             {
-                getDynamicWeight(iter->second.vtBalanceItem, endpoint);
+                getDynamicWeight(iter->second, endpoint);
             }
-            weightSum += endpoint.weight;
+        }
+    }
+
+    // 如果动态负载均衡关闭或者未找到对应servant，所有启用动态负载均衡的节点均修改为轮询方式
+    bool isModify(!_dynamicSwitch || !isFound);
+    if (isModify)
+    {
+        for (auto &endpoint : vtEndpoints)
+        {
+            if (LOAD_BALANCE_DYNAMIC_WEIGHT == endpoint.weightType)
+            {
+                endpoint.weightType = LOAD_BALANCE_LOOP;
+            }
+        }
+    }
 
+    // 每次查询都会调用，只有开启debug日志时才构建日志
+    if (LOG->isNeedLog(LocalRollLogger::DEBUG_LOG))
+    {
+        printDynamicWeight(servant, vtEndpoints, isFound, isModify);
+    }
+}
+
+void LoadBalanceThread::printDynamicWeight(const string &servant, const std::vector<tars::EndpointF> &vtEndpoints, bool isFound, bool isModify)
+{
+    ostringstream log;
+    log << "servant: " << servant << "|"
+        << "vtEndpoints size: " << vtEndpoints.size() << "|";
+    if (isFound)
+    {
+        int weightSum(0);
+        for (const auto &endpoint : vtEndpoints)
+        {
+            weightSum += endpoint.weight;
         }
-        // 构建日志
+
         log << "weightSum: " << weightSum << "|";
-        const size_t SIZE(vtEndpoints.size());
-        for (size_t i = 0; i < SIZE; ++i)
+        for (const auto &endpoint : vtEndpoints)
         {
-            const tars::EndpointF &endpoint = vtEndpoints[i];
             log << endpoint.host << ":"
                 << endpoint.port << ", "
                 << endpoint.weightType << ", "
@@ -181,45 +211,24 @@ void LoadBalanceThread::getDynamicWeight(const string &servant, std::vector<tars
     }
     else
     {
-        isFound = false;
         log << "not find|";
     }
 
-    // 如果动态负载均衡关闭或者未找到对应servant，所有启用动态负载均衡的节点均修改为轮询方式
-    if (!_dynamicSwitch || !isFound)
+    if (isModify)
     {
-        log << "vtEndpoints size: " << vtEndpoints.size() << "|modify: ";
-        for (auto &endpoint : vtEndpoints)
-        {
-            if (LOAD_BALANCE_DYNAMIC_WEIGHT == endpoint.weightType)
-            {
-                endpoint.weightType = LOAD_BALANCE_LOOP;
-
-                log << endpoint.host << ", "
-                    << endpoint.port << ", "
-                    << endpoint.weightType << ", "
-                    << endpoint.weight << "; ";
-            }
-        }
-
-        TLOG_DEBUG(log.str() << "|" << endl);
-        return;
+        log << "modify to loop|";
     }
 
     TLOG_DEBUG(log.str() << endl);
 }
 
-void LoadBalanceThread::getDynamicWeight(const vector<LoadBalanceItem> &vtLoadBalanceInfo, tars::EndpointF &endpointF)
+void LoadBalanceThread::getDynamicWeight(const std::unordered_map<string, int> &mapIp2Weight, tars::EndpointF &endpointF)
 {
-    for (const auto &info : vtLoadBalanceInfo)
+    auto iter = mapIp2Weight.find(endpointF.host);
+    if (mapIp2Weight.end() != iter)
     {
-        if (info.slaveIp == endpointF.host)
-        {
-            endpointF.weightType = LOAD_BALANCE_STATIC_WEIGHT; // 这里赋值为静态权重类型是因为直接复用EndpointManager里面的静态权重算法
-            endpointF.weight = info.weight;
-
-            break;
-        }
+        endpointF.weightType = LOAD_BALANCE_STATIC_WEIGHT; // 这里赋值为静态权重类型是因为直接复用EndpointManager里面的静态权重算法
+        endpointF.weight = iter->second;
     }
 
     // 如果数据异常权重为0则修改为轮询的方式，避免出现无rpc节点可调用的问题
@@ -318,12 +327,50 @@ void LoadBalanceThread::calculateWeight(LoadCache &loadCache)
     }
 }
 
+int LoadBalanceThread::smoothWeight(int newWeight, int oldWeight) const
+{
+    // 权重为0表示数据异常，查询时会改为轮询，不做平滑
+    if (newWeight <= 0 || oldWeight <= 0)
+    {
+        return newWeight;
+    }
+
+    // 指数加权移动平均：权重 = 新权重 * 系数 + 旧权重 * (1 - 系数)，避免单个统计周期的抖动造成流量大幅摆动
+    return (newWeight * _smoothFactor + oldWeight * (WEIGHT_PERCENT_UNIT - _smoothFactor)) / WEIGHT_PERCENT_UNIT;
+}
+
 void LoadBalanceThread::updateWeightCache(LoadCache &loadCache)
 {
-    auto &cache = _loadCache.getWriterData();
-    // 每次更新都覆盖，过早的统计数据对于当前来说可能已经不能准确的反应当前负载状况了
-    cache = std::move(loadCache);
-    _loadCache.swap();
+    // 只有本线程写，读上一周期的数据不需要加锁
+    const auto &oldCache = _weightCache.getReaderData();
+    auto &cache = _weightCache.getWriterData();
+    // 本周期没有统计数据的节点直接去掉，过早的统计数据对于当前来说可能已经不能准确的反应当前负载状况了
+    cache.clear();
+    for (const auto &loadPair : loadCache)
+    {
+        auto oldIter = oldCache.find(loadPair.first);
+        auto &mapIp2Weight = cache[loadPair.first];
+        mapIp2Weight.reserve(loadPair.second.vtBalanceItem.size());
+        for (const auto &loadInfo : loadPair.second.vtBalanceItem)
+        {
+            int weight(loadInfo.weight);
+            if (oldCache.end() != oldIter)
+            {
+                auto ipIter = oldIter->second.find(loadInfo.slaveIp);
+                if (oldIter->second.end() != ipIter)
+                {
+                    weight = smoothWeight(loadInfo.weight, ipIter->second);
+                }
+            }
+
+            mapIp2Weight[loadInfo.slaveIp] = weight;
+        }
+    }
+
+    _weightCache.swap();
+
+    // 权重变化后已缓存的查询结果失效
+    CDbHandle::updateRouteVersion();
 
     TLOG_DEBUG("updateWeightCache swap|" << endl);
 }
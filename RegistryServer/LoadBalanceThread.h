@@ -2,6 +2,7 @@
 
 #include <vector>
 #include <map>
+#include <unordered_map>
 #include "DbHandle.h"
 #include "util/tc_thread.h"
 #include "util/tc_autoptr.h"
@@ -37,6 +38,10 @@ struct LoadBalanceInfo
 class LoadBalanceThread : public TC_Thread, public TC_Singleton<LoadBalanceThread>
 {
     using LoadCache = std::map<string, LoadBalanceInfo>;
+    // servant -> (ip -> 平滑后的权重)
+    using WeightCache = std::unordered_map<string, std::unordered_map<string, int>>;
+    //压测工具直接装载合成权重, 不经过数据库
+    friend class RegistryBench;
 public:
     /*
      * 构造函数
@@ -71,14 +76,18 @@ private:
     void updateDynamicWeight();
     // 从DB加载负载数据
     void getMonitorDataFromDB(const vector<string> &vtServer, LoadCache &loadCache);
+    // 打印查询时的权重分配
+    void printDynamicWeight(const string &servant, const std::vector<tars::EndpointF> &vtEndpoints, bool isFound, bool isModify);
     // 单节点获取权重
-    void getDynamicWeight(const vector<LoadBalanceItem> &vtLoadBalanceInfo, tars::EndpointF &endpointF);
+    void getDynamicWeight(const std::unordered_map<string, int> &mapIp2Weight, tars::EndpointF &endpointF);
     // 合并去重相同节点的多条记录
     void mergeLoadInfo(LoadCache &loadCache);
     // 计算权重
     void calculateWeight(LoadCache &loadCache);
-    // 更新双缓存
+    // 平滑后更新双缓存
     void updateWeightCache(LoadCache &loadCache);
+    // 新权重与上一周期的权重做指数加权移动平均
+    int smoothWeight(int newWeight, int oldWeight) const;
 
     // 获取负载因子权重比例
     inline int getProportion(const string &weightFactor)
@@ -102,8 +111,8 @@ private:
      */
     CDbHandle                             _db;
 
-    // 存储动态负载信息的缓存
-    tars::TC_ReadersWriterData<LoadCache> _loadCache;
+    // 存储按(servant, ip)索引的动态权重
+    tars::TC_ReadersWriterData<WeightCache> _weightCache;
 
     // 轮询间隔，默认120秒
     int                                   _loadInterval{120};
@@ -111,6 +120,8 @@ private:
     map<string, int>                      _mapLoad2Proportion;
     // 是否开启动态负载均衡开关，0：关闭；非0：开启；
     int                                   _dynamicSwitch{0};
+    // 权重平滑系数，新一周期权重所占的百分比，100表示不平滑
+    int                                   _smoothFactor{50};
 };
 
 #define LOAD_BALANCE_INS LoadBalanceThread::getInstance()
\ No newline at end of file
@@ -0,0 +1,101 @@
+/**
+ * Tencent is pleased to support the open source community by making Tars available.
+ *
+ * Copyright (C) 2016THL A29 Limited, a Tencent company. All rights reserved.
+ *
+ * Licensed under the BSD 3-Clause License (the "License"); you may not use this file except
+ * in compliance with the License. You may obtain a copy of the License at
+ *
+ * https://opensource.org/licenses/BSD-3-Clause
+ *
+ * Unless required by applicable law or agreed to in writing, software distributed
+ * under the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+ * CONDITIONS OF ANY KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations under the License.
+ */
+
+#include "ObjectsSnapshot.h"
+
+ObjectsSnapshot::ObjectsSnapshot()
+: _size(0)
+{
+    //所有空分片共享同一个对象
+    static const ShardPtr emptyShard = std::make_shared<const Shard>();
+
+    for (size_t i = 0; i < SHARD_NUM; i++)
+    {
+        _shards[i] = emptyShard;
+    }
+}
+
+size_t ObjectsSnapshot::shardIndex(const string &id)
+{
+    return std::hash<string>()(id) % SHARD_NUM;
+}
+
+const ObjectItem *ObjectsSnapshot::find(const string &id) const
+{
+    const Shard &shard = *_shards[shardIndex(id)];
+    Shard::const_iterator it = shard.find(id);
+    if (it == shard.end())
+    {
+        return NULL;
+    }
+
+    return it->second.get();
+}
+
+ObjectsSnapshotPtr ObjectsSnapshot::create(const ObjectsCache &objCache)
+{
+    vector<std::shared_ptr<Shard> > shards(SHARD_NUM);
+
+    for (ObjectsCache::const_iterator it = objCache.begin(); it != objCache.end(); ++it)
+    {
+        std::shared_ptr<Shard> &shard = shards[shardIndex(it->first)];
+        if (!shard)
+        {
+            shard = std::make_shared<Shard>();
+        }
+        shard->insert(shard->end(), make_pair(it->first, std::make_shared<const ObjectItem>(it->second)));
+    }
+
+    std::shared_ptr<ObjectsSnapshot> snapshot = std::make_shared<ObjectsSnapshot>();
+    for (size_t i = 0; i < SHARD_NUM; i++)
+    {
+        if (shards[i])
+        {
+            snapshot->_shards[i] = shards[i];
+        }
+    }
+    snapshot->_size = objCache.size();
+
+    return snapshot;
+}
+
+ObjectsSnapshotPtr ObjectsSnapshot::update(const ObjectsCache &changed) const
+{
+    std::shared_ptr<ObjectsSnapshot> snapshot = std::make_shared<ObjectsSnapshot>(*this);
+
+    //本次更新中已经复制过的分片
+    vector<std::shared_ptr<Shard> > copied(SHARD_NUM);
+
+    for (ObjectsCache::const_iterator it = changed.begin(); it != changed.end(); ++it)
+    {
+        size_t index = shardIndex(it->first);
+        std::shared_ptr<Shard> &shard = copied[index];
+        if (!shard)
+        {
+            shard = std::make_shared<Shard>(*_shards[index]);
+            snapshot->_shards[index] = shard;
+        }
+
+        size_t before = shard->size();
+
+        //增量的时候加载的是服务的所有节点，因此这里直接替换
+        (*shard)[it->first] = std::make_shared<const ObjectItem>(it->second);
+
+        snapshot->_size += shard->size() - before;
+    }
+
+    return snapshot;
+}
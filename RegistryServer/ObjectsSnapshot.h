@@ -0,0 +1,100 @@
+/**
+ * Tencent is pleased to support the open source community by making Tars available.
+ *
+ * Copyright (C) 2016THL A29 Limited, a Tencent company. All rights reserved.
+ *
+ * Licensed under the BSD 3-Clause License (the "License"); you may not use this file except
+ * in compliance with the License. You may obtain a copy of the License at
+ *
+ * https://opensource.org/licenses/BSD-3-Clause
+ *
+ * Unless required by applicable law or agreed to in writing, software distributed
+ * under the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+ * CONDITIONS OF ANY KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations under the License.
+ */
+
+#ifndef __OBJECTS_SNAPSHOT_H__
+#define __OBJECTS_SNAPSHOT_H__
+
+#include <map>
+#include <memory>
+#include "Registry.h"
+
+using namespace tars;
+
+//<servant, ObjectItem>
+typedef map<string, ObjectItem> ObjectsCache;
+
+class ObjectsSnapshot;
+
+typedef std::shared_ptr<const ObjectsSnapshot> ObjectsSnapshotPtr;
+
+//////////////////////////////////////////////////////
+/**
+ * 对象列表的只读快照
+ * 对象按名字hash到固定数量的分片中, 每个分片是一个不可修改的map
+ * 增量更新时只复制有变化的分片, 其余分片在新旧快照之间共享,
+ * 分片中的对象也通过shared_ptr共享, 复制分片只复制指针, 不复制ObjectItem中的endpoint列表,
+ * 因此更新的开销只与变化的对象所在分片有关, 而与对象总数无关
+ * 读者通过shared_ptr持有快照, 快照在最后一个读者释放后才销毁
+ */
+class ObjectsSnapshot
+{
+public:
+    enum { SHARD_NUM = 256 };
+
+    typedef std::shared_ptr<const ObjectItem>  ObjectItemPtr;
+    typedef map<string, ObjectItemPtr>         Shard;
+    typedef std::shared_ptr<const Shard>       ShardPtr;
+
+    /**
+     * 构造空快照
+     */
+    ObjectsSnapshot();
+
+    /**
+     * 查找对象
+     * @return 不存在返回NULL, 返回的指针在快照存活期间有效
+     */
+    const ObjectItem *find(const string &id) const;
+
+    /**
+     * 对象个数
+     */
+    size_t size() const { return _size; }
+
+    /**
+     * 遍历所有对象
+     */
+    template<typename F>
+    void forEach(F f) const
+    {
+        for (size_t i = 0; i < SHARD_NUM; i++)
+        {
+            for (auto it = _shards[i]->begin(); it != _shards[i]->end(); ++it)
+            {
+                f(it->first, *it->second);
+            }
+        }
+    }
+
+    /**
+     * 用全量数据构造快照
+     */
+    static ObjectsSnapshotPtr create(const ObjectsCache &objCache);
+
+    /**
+     * 以当前快照为基础, 用变化的对象覆盖后生成新快照, 未变化的分片直接共享
+     */
+    ObjectsSnapshotPtr update(const ObjectsCache &changed) const;
+
+protected:
+    static size_t shardIndex(const string &id);
+
+    ShardPtr _shards[SHARD_NUM];
+
+    size_t   _size;
+};
+
+#endif
@@ -16,6 +16,7 @@
 
 #include "QueryImp.h"
 #include "util/tc_clientsocket.h"
+#include "QueryLogThread.h"
 
 extern TC_Config * g_pconf;
 
@@ -25,60 +26,60 @@ void QueryImp::initialize()
 
     //初始化配置db连接
     _db.init(g_pconf);
-
-	_openDayLog = g_pconf->get("/tars/reap<openDayLog>", "N") == "Y";
 }
 
 vector<EndpointF> QueryImp::findObjectById(const string & id, CurrentPtr current)
 {
+    QueryTrace trace = beginDaylog();
+
     vector<EndpointF> eps = _db.findObjectById(id);
 
-    ostringstream os;
-    doDaylog(FUNID_findObjectById,id,eps,vector<EndpointF>(),current,os);
+    doDaylog(FUNID_findObjectById,id,eps,vector<EndpointF>(),current,trace);
 
     return eps;
 }
 
 int QueryImp::findObjectById4Any(const std::string & id,vector<EndpointF> &activeEp,vector<EndpointF> &inactiveEp,CurrentPtr current)
 {
+    QueryTrace trace = beginDaylog();
+
     int iRet = _db.findObjectById4All(id, activeEp, inactiveEp);
 
-    ostringstream os;
-    doDaylog(FUNID_findObjectById4Any,id,activeEp,inactiveEp,current,os);
+    doDaylog(FUNID_findObjectById4Any,id,activeEp,inactiveEp,current,trace);
 
     return iRet;
 }
 
 int QueryImp::findObjectById4All(const std::string & id, vector<EndpointF> &activeEp,vector<EndpointF> &inactiveEp,CurrentPtr current)
 {
-    ostringstream os;
+    QueryTrace trace = beginDaylog();
 
-    int iRet = _db.findObjectByIdInGroupPriority(id,current->getHostName() ,activeEp, inactiveEp,os);
+    int iRet = _db.findObjectByIdInGroupPriority(id,current->getHostName() ,activeEp, inactiveEp,trace.get());
 
-    doDaylog(FUNID_findObjectById4All,id,activeEp,inactiveEp,current,os);
+    doDaylog(FUNID_findObjectById4All,id,activeEp,inactiveEp,current,trace);
 
     return iRet;
 }
 
 int QueryImp::findObjectByIdInSameGroup(const std::string & id, vector<EndpointF> &activeEp,vector<EndpointF> &inactiveEp, CurrentPtr current)
 {
-    ostringstream os;
+    QueryTrace trace = beginDaylog();
     TLOGINFO(__FUNCTION__ << ":" << __LINE__ << "|" << id << "|" << current->getHostName()  << endl);
 
-    int iRet = _db.findObjectByIdInGroupPriority(id, current->getHostName() , activeEp, inactiveEp, os);
+    int iRet = _db.findObjectByIdInGroupPriority(id, current->getHostName() , activeEp, inactiveEp, trace.get());
 
-    doDaylog(FUNID_findObjectByIdInSameGroup,id,activeEp,inactiveEp,current,os);
+    doDaylog(FUNID_findObjectByIdInSameGroup,id,activeEp,inactiveEp,current,trace);
 
     return iRet;
 }
 
 int QueryImp::findObjectByIdInSameStation(const std::string & id, const std::string & sStation, vector<EndpointF> &activeEp, vector<EndpointF> &inactiveEp, CurrentPtr current)
 {
-    ostringstream os;
+    QueryTrace trace = beginDaylog();
 
-    int iRet = _db.findObjectByIdInSameStation(id, sStation, activeEp, inactiveEp, os);
+    int iRet = _db.findObjectByIdInSameStation(id, sStation, activeEp, inactiveEp, trace.get());
 
-    doDaylog(FUNID_findObjectByIdInSameStation,id,activeEp,inactiveEp,current,os);
+    doDaylog(FUNID_findObjectByIdInSameStation,id,activeEp,inactiveEp,current,trace);
 
     return iRet;
 }
@@ -93,8 +94,8 @@ Int32 QueryImp::findObjectByIdInSameSet(const std::string & id,const std::string
         return -1;
     }
 
-    ostringstream os;
-    int iRet = _db.findObjectByIdInSameSet(id, vtSetInfo, activeEp, inactiveEp, os);
+    QueryTrace trace = beginDaylog();
+    int iRet = _db.findObjectByIdInSameSet(id, vtSetInfo, activeEp, inactiveEp, trace.get());
     if (-1 == iRet)
     {
         //未启动set，启动ip分组策略
@@ -113,96 +114,38 @@ Int32 QueryImp::findObjectByIdInSameSet(const std::string & id,const std::string
         return -1;
     }
 
-    doDaylog(FUNID_findObjectByIdInSameSet,id,activeEp,inactiveEp,current,os,setId);
+    doDaylog(FUNID_findObjectByIdInSameSet,id,activeEp,inactiveEp,current,trace,setId);
 
     return iRet;
 }
 
-void QueryImp::doDaylog(const FUNID eFnId,const string& id,const vector<EndpointF> &activeEp, const vector<EndpointF> &inactiveEp, const CurrentPtr& current,const ostringstream& os,const string& sSetid)
+QueryImp::QueryTrace QueryImp::beginDaylog()
 {
-	if(_openDayLog) {
-		string sEpList;
-		for (size_t i = 0; i < activeEp.size(); i++) {
-			if (0 != i) {
-				sEpList += ";";
-			}
-        sEpList += activeEp[i].host + ":" + TC_Common::tostr(activeEp[i].port) + ", " + TC_Common::tostr(activeEp[i].weight)
-                + ", " + TC_Common::tostr(activeEp[i].weightType);
-		}
-
-		sEpList += "|";
-
-		for (size_t i = 0; i < inactiveEp.size(); i++) {
-			if (0 != i) {
-				sEpList += ";";
-			}
-        sEpList += inactiveEp[i].host + ":" + TC_Common::tostr(inactiveEp[i].port) + ", " + TC_Common::tostr(inactiveEp[i].weight)
-                + ", " + TC_Common::tostr(inactiveEp[i].weightType);
-		}
-
-		switch (eFnId) {
-			case FUNID_findObjectById4All:
-			case FUNID_findObjectByIdInSameGroup: {
-				FDLOG("query_idc") << eFunTostr(eFnId) << "|" << current->getHostName() << "|" << current->getPort()
-				                   << "|" << id << "|" << sSetid << "|" << sEpList << os.str() << endl;
-			}
-				break;
-			case FUNID_findObjectByIdInSameSet: {
-				FDLOG("query_set") << eFunTostr(eFnId) << "|" << current->getHostName() << "|" << current->getPort()
-				                   << "|" << id << "|" << sSetid << "|" << sEpList << os.str() << endl;
-			}
-				break;
-			case FUNID_findObjectById4Any:
-			case FUNID_findObjectById:
-			case FUNID_findObjectByIdInSameStation:
-			default: {
-				FDLOG("query") << eFunTostr(eFnId) << "|" << current->getHostName() << "|" << current->getPort() << "|"
-				               << id << "|" << sSetid << "|" << sEpList << os.str() << endl;
-			}
-				break;
-		}
-	}
+    //只有抽样命中的请求才记录查询过程
+    return QueryTrace(QUERY_LOG_INS->sample() ? new ostringstream() : NULL);
 }
 
-string QueryImp::eFunTostr(const FUNID eFnId)
+void QueryImp::doDaylog(const FUNID eFnId,const string& id,const vector<EndpointF> &activeEp, const vector<EndpointF> &inactiveEp, const CurrentPtr& current,const QueryTrace& trace,const string& sSetid)
 {
-    string sFun = "";
-    switch(eFnId)
+    //抽样命中, 或者没有可用节点时一定记录
+    if (!QUERY_LOG_INS->isOpen() || (!trace && !activeEp.empty()))
     {
-        case FUNID_findObjectByIdInSameGroup:
-        {
-            sFun = "findObjectByIdInSameGroup";
-        }
-        break;
-        case FUNID_findObjectByIdInSameSet:
-        {
-            sFun = "findObjectByIdInSameSet";
-        }
-        break;
-        case FUNID_findObjectById4Any:
-        {
-            sFun = "findObjectById4All";
-        }
-        break;
-        case FUNID_findObjectById:
-        {
-            sFun = "findObjectById";
-        }
-        break;
-        case FUNID_findObjectById4All:
-        {
-            sFun = "findObjectById4All";
-        }
-        break;
-        case FUNID_findObjectByIdInSameStation:
-        {
-            sFun = "findObjectByIdInSameStation";
-        }
-        break;
-        default:
-            sFun = "UNKNOWN";
-        break;
+        return;
     }
-    return sFun;
-}
 
+    QueryLogRecordPtr record = std::make_shared<QueryLogRecord>();
+    record->eFnId     = eFnId;
+    record->sHost     = current->getHostName();
+    record->iPort     = current->getPort();
+    record->sId       = id;
+    record->sSetId    = sSetid;
+    record->vActive   = activeEp;
+    record->vInactive = inactiveEp;
+    if (trace)
+    {
+        record->sDetail = trace->str();
+    }
+
+    //格式化和写日志在日志线程中进行
+    QUERY_LOG_INS->push(record);
+}
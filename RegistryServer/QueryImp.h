@@ -19,21 +19,11 @@
 
 #include "QueryF.h"
 #include "DbHandle.h"
+#include "QueryLogThread.h"
+#include <memory>
 
 using namespace tars;
 
-//////////////////////////////////////////////////////
-
-enum FUNID
-{
-    FUNID_findObjectById              = 0,
-    FUNID_findObjectById4Any          = 1,
-    FUNID_findObjectById4All          = 2,
-    FUNID_findObjectByIdInSameGroup   = 3,
-    FUNID_findObjectByIdInSameStation = 4,
-    FUNID_findObjectByIdInSameSet     = 5
-};
-
 //////////////////////////////////////////////////////
 /**
  * 对象查询接口类
@@ -87,23 +77,24 @@ public:
     Int32 findObjectByIdInSameSet(const std::string & id,const std::string & setId,vector<EndpointF> &activeEp,vector<EndpointF> &inactiveEp, CurrentPtr current);
 
 private:
+    //记录查询过程, 未命中抽样时为空, 查询路径上不会为日志分配内存
+    typedef std::unique_ptr<std::ostringstream> QueryTrace;
+
     /**
-     * 打印按天日志
+     * 按抽样决定本次查询是否记录查询过程
      */
-    void doDaylog(const FUNID eFnId,const string& id,const vector<EndpointF> &activeEp, const vector<EndpointF> &inactiveEp, const CurrentPtr& current,const std::ostringstream& os,const string& sSetid="");
+    QueryTrace beginDaylog();
 
     /**
-     * 转化成字符串
+     * 打印按天日志, 抽样命中或者没有可用节点时才记录, 格式化由日志线程完成
      */
-    string eFunTostr(const FUNID eFnId);
+    void doDaylog(const FUNID eFnId,const string& id,const vector<EndpointF> &activeEp, const vector<EndpointF> &inactiveEp, const CurrentPtr& current,const QueryTrace& trace,const string& sSetid="");
 
 protected:
 
     //数据库操作
     CDbHandle      _db;
 
-    bool           _openDayLog = false;
-
 };
 
 #endif
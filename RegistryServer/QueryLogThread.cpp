@@ -0,0 +1,167 @@
+/**
+ * Tencent is pleased to support the open source community by making Tars available.
+ *
+ * Copyright (C) 2016THL A29 Limited, a Tencent company. All rights reserved.
+ *
+ * Licensed under the BSD 3-Clause License (the "License"); you may not use this file except
+ * in compliance with the License. You may obtain a copy of the License at
+ *
+ * https://opensource.org/licenses/BSD-3-Clause
+ *
+ * Unless required by applicable law or agreed to in writing, software distributed
+ * under the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+ * CONDITIONS OF ANY KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations under the License.
+ */
+
+#include "QueryLogThread.h"
+#include "servant/RemoteLogger.h"
+#include "util/tc_config.h"
+
+using namespace tars;
+
+extern TC_Config * g_pconf;
+
+void QueryLogThread::init()
+{
+    _openDayLog = g_pconf->get("/tars/reap<openDayLog>", "N") == "Y";
+
+    int sampleRate = TC_Common::strto<int>(g_pconf->get("/tars/reap<queryLogSampleRate>", "100"));
+    _sampleRate = sampleRate < 1 ? 1 : static_cast<uint32_t>(sampleRate);
+
+    int maxQueueSize = TC_Common::strto<int>(g_pconf->get("/tars/reap<queryLogQueueSize>", "100000"));
+    _maxQueueSize = maxQueueSize < 1000 ? 1000 : static_cast<size_t>(maxQueueSize);
+
+    TLOG_DEBUG("QueryLogThread init _openDayLog: " << _openDayLog << "|"
+               << "_sampleRate: " << _sampleRate << "|"
+               << "_maxQueueSize: " << _maxQueueSize << endl);
+}
+
+void QueryLogThread::terminate()
+{
+    _terminate = true;
+    _queue.notifyT();
+}
+
+bool QueryLogThread::sample()
+{
+    if (!_openDayLog)
+    {
+        return false;
+    }
+
+    //每个线程独立计数, 避免多个查询线程竞争同一个计数器
+    static thread_local uint32_t counter = 0;
+
+    return (++counter % _sampleRate) == 0;
+}
+
+void QueryLogThread::push(const QueryLogRecordPtr &record)
+{
+    if (_queue.size() >= _maxQueueSize)
+    {
+        ++_dropped;
+        return;
+    }
+
+    _queue.push_back(record);
+}
+
+void QueryLogThread::run()
+{
+    time_t tLastReport = TNOW;
+    while (!_terminate)
+    {
+        try
+        {
+            QueryLogRecordPtr record;
+            if (_queue.pop_front(record, 1000) && record)
+            {
+                write(*record);
+            }
+
+            //定期报告丢弃的记录数
+            if (TNOW - tLastReport >= 60)
+            {
+                tLastReport = TNOW;
+                uint64_t dropped = _dropped.exchange(0);
+                if (dropped > 0)
+                {
+                    TLOG_ERROR("QueryLogThread queue full, dropped: " << dropped << endl);
+                }
+            }
+        }
+        catch (exception &e)
+        {
+            TLOG_ERROR("QueryLogThread::run catch exception:" << e.what() << endl);
+        }
+        catch (...)
+        {
+            TLOG_ERROR("QueryLogThread::run catch unkown exception." << endl);
+        }
+    }
+}
+
+void QueryLogThread::write(const QueryLogRecord &record)
+{
+    string sEpList;
+    for (size_t i = 0; i < record.vActive.size(); i++)
+    {
+        if (0 != i)
+        {
+            sEpList += ";";
+        }
+        sEpList += record.vActive[i].host + ":" + TC_Common::tostr(record.vActive[i].port) + ", " + TC_Common::tostr(record.vActive[i].weight)
+                + ", " + TC_Common::tostr(record.vActive[i].weightType);
+    }
+
+    sEpList += "|";
+
+    for (size_t i = 0; i < record.vInactive.size(); i++)
+    {
+        if (0 != i)
+        {
+            sEpList += ";";
+        }
+        sEpList += record.vInactive[i].host + ":" + TC_Common::tostr(record.vInactive[i].port) + ", " + TC_Common::tostr(record.vInactive[i].weight)
+                + ", " + TC_Common::tostr(record.vInactive[i].weightType);
+    }
+
+    const char *sLogName = "query";
+    switch (record.eFnId)
+    {
+        case FUNID_findObjectById4All:
+        case FUNID_findObjectByIdInSameGroup:
+            sLogName = "query_idc";
+            break;
+        case FUNID_findObjectByIdInSameSet:
+            sLogName = "query_set";
+            break;
+        default:
+            break;
+    }
+
+    FDLOG(sLogName) << eFunTostr(record.eFnId) << "|" << record.sHost << "|" << record.iPort << "|"
+                    << record.sId << "|" << record.sSetId << "|" << sEpList << record.sDetail << endl;
+}
+
+const char *QueryLogThread::eFunTostr(FUNID eFnId)
+{
+    switch (eFnId)
+    {
+        case FUNID_findObjectByIdInSameGroup:
+            return "findObjectByIdInSameGroup";
+        case FUNID_findObjectByIdInSameSet:
+            return "findObjectByIdInSameSet";
+        case FUNID_findObjectById4Any:
+            return "findObjectById4All";
+        case FUNID_findObjectById:
+            return "findObjectById";
+        case FUNID_findObjectById4All:
+            return "findObjectById4All";
+        case FUNID_findObjectByIdInSameStation:
+            return "findObjectByIdInSameStation";
+        default:
+            return "UNKNOWN";
+    }
+}
@@ -0,0 +1,143 @@
+/**
+ * Tencent is pleased to support the open source community by making Tars available.
+ *
+ * Copyright (C) 2016THL A29 Limited, a Tencent company. All rights reserved.
+ *
+ * Licensed under the BSD 3-Clause License (the "License"); you may not use this file except
+ * in compliance with the License. You may obtain a copy of the License at
+ *
+ * https://opensource.org/licenses/BSD-3-Clause
+ *
+ * Unless required by applicable law or agreed to in writing, software distributed
+ * under the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+ * CONDITIONS OF ANY KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations under the License.
+ */
+
+#ifndef __QUERY_LOG_THREAD_H__
+#define __QUERY_LOG_THREAD_H__
+
+#include <atomic>
+#include <memory>
+#include "util/tc_thread.h"
+#include "util/tc_thread_queue.h"
+#include "util/tc_singleton.h"
+#include "QueryF.h"
+
+using namespace tars;
+
+//////////////////////////////////////////////////////
+
+enum FUNID
+{
+    FUNID_findObjectById              = 0,
+    FUNID_findObjectById4Any          = 1,
+    FUNID_findObjectById4All          = 2,
+    FUNID_findObjectByIdInSameGroup   = 3,
+    FUNID_findObjectByIdInSameStation = 4,
+    FUNID_findObjectByIdInSameSet     = 5
+};
+
+/**
+ * 一条查询日志, 只保存原始数据, 由日志线程格式化
+ */
+struct QueryLogRecord
+{
+    FUNID               eFnId;
+    string              sHost;
+    int                 iPort;
+    string              sId;
+    string              sSetId;
+    vector<EndpointF>   vActive;
+    vector<EndpointF>   vInactive;
+    string              sDetail;     //查询过程, 只有抽样命中时才有
+};
+
+typedef std::shared_ptr<QueryLogRecord> QueryLogRecordPtr;
+
+//////////////////////////////////////////////////////
+/**
+ * 查询日志线程
+ * 查询线程只做抽样判断, 命中抽样或者查询结果为空的请求才生成记录放入队列,
+ * 格式化和写按天日志都在本线程中进行
+ */
+class QueryLogThread : public TC_Thread, public TC_Singleton<QueryLogThread>
+{
+public:
+    QueryLogThread() = default;
+
+    virtual ~QueryLogThread()
+    {
+        terminate();
+    }
+
+    void init();
+
+    /*
+     * 线程执行函数
+     */
+    virtual void run();
+
+    /*
+     * 停止运行
+     */
+    void terminate();
+
+    /**
+     * 是否开启了按天日志
+     */
+    bool isOpen() const { return _openDayLog; }
+
+    /**
+     * 抽样判断, 每_sampleRate次查询命中一次
+     */
+    bool sample();
+
+    /**
+     * 放入日志记录, 队列满时丢弃
+     */
+    void push(const QueryLogRecordPtr &record);
+
+    /**
+     * 转化成字符串
+     */
+    static const char *eFunTostr(FUNID eFnId);
+
+protected:
+    /**
+     * 格式化并写按天日志
+     */
+    void write(const QueryLogRecord &record);
+
+protected:
+    /*
+     * 线程结束标志
+     */
+    bool                              _terminate{false};
+
+    /*
+     * 是否开启按天日志
+     */
+    bool                              _openDayLog{false};
+
+    /*
+     * 抽样比例, 每N次查询记录一次, 1表示全部记录
+     */
+    uint32_t                          _sampleRate{100};
+
+    /*
+     * 队列最大长度, 超过后丢弃
+     */
+    size_t                            _maxQueueSize{100000};
+
+    /*
+     * 因队列满丢弃的记录数
+     */
+    std::atomic<uint64_t>             _dropped{0};
+
+    TC_ThreadQueue<QueryLogRecordPtr> _queue;
+};
+
+#define QUERY_LOG_INS QueryLogThread::getInstance()
+
+#endif
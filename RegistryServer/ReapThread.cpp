@@ -29,6 +29,9 @@ ReapThread::ReapThread()
 , _recoverProtect(true)
 , _recoverProtectRate(30)
 , _heartBeatOff(false)
+, _changeLogKeepTime(3600)
+, _cacheSnapshotMaxAge(86400)
+, _needReconcile(false)
 {
 }
 
@@ -68,9 +71,20 @@ int ReapThread::init()
     //是否关闭更新主控心跳时间,一般需要迁移主控服务是，设置此项为Y
     _heartBeatOff = (*g_pconf).get("/tars/reap<heartbeatoff>", "N") == "Y"?true:false;
 
+    //服务变更日志保留时间, 必须远大于全量加载间隔
+    _changeLogKeepTime = TC_Common::strto<int>((*g_pconf).get("/tars/reap<changeLogKeepTime>", "3600"));
+    _changeLogKeepTime = _changeLogKeepTime < _loadObjectsInterval2 * 2 ? _loadObjectsInterval2 * 2 : _changeLogKeepTime;
+
+    //路由缓存快照文件, 启动时先从快照恢复, 再在后台从db加载
+    _cacheSnapshotFile   = (*g_pconf).get("/tars/reap<cacheSnapshotFile>", ServerConfig::DataPath + "/registry_cache.snapshot");
+    _cacheSnapshotMaxAge = TC_Common::strto<int>((*g_pconf).get("/tars/reap<cacheSnapshotMaxAge>", "86400"));
+
     //最小值保护
     _loadObjectsInterval1  = _loadObjectsInterval1 < 5 ? 5 : _loadObjectsInterval1;
 
+    //增量加载重读上个周期以来的变更日志, 多留5秒给晚提交的事务
+    _db.setChangeLogWindow(_loadObjectsInterval1 + 5);
+
     _registryTimeout       = _registryTimeout      < 5 ? 5 : _registryTimeout;
 
     _recoverProtectRate    = _recoverProtectRate   < 1 ? 30: _recoverProtectRate;
@@ -78,10 +92,20 @@ int ReapThread::init()
     //更新主控心跳时间,设置主控状态为active
     _db.updateRegistryInfo2Db(_heartBeatOff);
 	
-    //加载对象列表
-    _db.loadObjectIdCache(_recoverProtect, _recoverProtectRate,0,true, true);
+    if (!_cacheSnapshotFile.empty() && _db.loadCacheSnapshot(_cacheSnapshotFile, _cacheSnapshotMaxAge) == 0)
+    {
+        //已从快照恢复, db加载放到线程中进行, db异常时也能启动并提供查询服务
+        _needReconcile = true;
+    }
+    else
+    {
+        //加载对象列表
+        _db.loadObjectIdCache(_recoverProtect, _recoverProtectRate,0,true, true);
+
+        saveCacheSnapshot();
+    }
 
-    TLOG_DEBUG("ReapThread init ok."<<endl);
+    TLOG_DEBUG("ReapThread init ok, reconcile:" << _needReconcile << endl);
 
     return 0;
 }
@@ -93,11 +117,19 @@ void ReapThread::terminate()
 }
 
 
+void ReapThread::saveCacheSnapshot()
+{
+    if (!_cacheSnapshotFile.empty())
+    {
+        _db.saveCacheSnapshot(_cacheSnapshotFile);
+    }
+}
+
 void ReapThread::run()
 {
     //增量加载服务分两个阶段
-    //第一阶段加载时间
-    time_t tLastLoadObjectsStep1 = TC_TimeProvider::getInstance()->getNow();
+    //第一阶段加载时间, 从快照启动时立即开始从db加载
+    time_t tLastLoadObjectsStep1 = _needReconcile ? 0 : TC_TimeProvider::getInstance()->getNow();
 
     //全量加载时间
     time_t tLastLoadObjectsStep2 = TC_TimeProvider::getInstance()->getNow();
@@ -117,11 +149,20 @@ void ReapThread::run()
 
 				_db.updateRegistryInfo2Db(_heartBeatOff);
 
-				if (tNow - tLastLoadObjectsStep2 >= _loadObjectsInterval2)
+				if (_needReconcile || tNow - tLastLoadObjectsStep2 >= _loadObjectsInterval2)
 				{
 					tLastLoadObjectsStep2 = tNow;
 					//全量加载,_leastChangedTime2参数没有意义
-					_db.loadObjectIdCache(_recoverProtect, _recoverProtectRate, _leastChangedTime2, true, false);
+					if (_db.loadObjectIdCache(_recoverProtect, _recoverProtectRate, _leastChangedTime2, true, false) == 0)
+					{
+						//从快照启动时, 在db加载成功之前每个周期都重试全量加载
+						_needReconcile = false;
+
+						saveCacheSnapshot();
+					}
+
+					//清理过期的服务变更日志
+					_db.purgeServerChangeLog(_changeLogKeepTime);
 				}
 				else
 				{
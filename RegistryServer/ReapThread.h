@@ -55,6 +55,12 @@ public:
      */
     virtual void run();
 
+protected:
+    /**
+     * 把当前路由缓存写入快照文件
+     */
+    void saveCacheSnapshot();
+
 protected:
     /*
      * 线程结束标志
@@ -99,6 +105,26 @@ protected:
      */
     bool       _heartBeatOff;
 
+    /*
+     * 服务变更日志保留时间,单位是秒
+     */
+    int        _changeLogKeepTime;
+
+    /*
+     * 路由缓存快照文件, 为空表示不启用
+     */
+    string     _cacheSnapshotFile;
+
+    /*
+     * 快照最大有效时间,单位是秒
+     */
+    int        _cacheSnapshotMaxAge;
+
+    /*
+     * 启动时从快照恢复了缓存, 需要尽快从db全量加载校正
+     */
+    bool       _needReconcile;
+
 };
 
 #endif
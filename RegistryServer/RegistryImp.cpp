@@ -45,6 +45,7 @@ int RegistryImp::doClose(CurrentPtr current)
 int RegistryImp::reportNode(const ReportNode &rn, CurrentPtr current)
 {
 	NodeManager::getInstance()->createNodeCurrent(rn.nodeName, current);
+	g_app.getCheckNodeThread()->keepAlive(rn.nodeName);
 	return 0;
 }
 
@@ -55,15 +56,14 @@ int RegistryImp::registerNode(const string & name, const NodeInfo & ni, const Lo
 
 int RegistryImp::keepAlive(const string & name, const LoadInfo & ni, CurrentPtr current)
 {
-    RegistryProcInfo procInfo;
-    procInfo.nodeName = name;
-    procInfo.loadinfo = ni;
-    procInfo.cmd      = EM_NODE_KEEPALIVE;
+    //只记录到内存, 由心跳写入线程合并后批量写db
+    g_app.getHeartbeatFlushThread()->keepAlive(name, ni);
 
-    //放入异步处理线程中
-    g_app.getRegProcThread()->put(procInfo);
+    //刷新时间轮中的超时时间
+    g_app.getCheckNodeThread()->keepAlive(name);
 
-    return 0;
+    //上次写db时发现没有这个node的记录, 返回非0让node重新注册
+    return g_app.getHeartbeatFlushThread()->needRegister(name) ? 1 : 0;
 }
 
 vector<ServerDescriptor> RegistryImp::getServers(const std::string & app,const std::string & serverName,const std::string & nodeName,CurrentPtr current)
@@ -83,6 +83,8 @@ int RegistryImp::updateServerBatch(const std::vector<ServerStateInfo> & vecState
 
 int RegistryImp::destroyNode(const string & name, CurrentPtr current)
 {
+    g_app.getCheckNodeThread()->removeNode(name);
+
     return _db.destroyNode(name);
 }
 
@@ -42,6 +42,10 @@ void RegistryServer::initialize()
         _reapThread.init();
         _reapThread.start();
 
+        //node心跳合并写入db的线程
+        _heartbeatFlushThread.init();
+        _heartbeatFlushThread.start();
+
         //检查node超时的线程
         _checkNodeThread.init();
         _checkNodeThread.start();
@@ -66,6 +70,10 @@ void RegistryServer::initialize()
         //供node访问的对象
         addServant<RegistryImp>((*g_pconf)["/tars/objname<RegistryObjName>"]);
 
+        //查询按天日志的写日志线程
+        QUERY_LOG_INS->init();
+        QUERY_LOG_INS->start();
+
         //供tars的服务获取路由的对象
         addServant<QueryImp>((*g_pconf)["/tars/objname<QueryObjName>"]);
 
@@ -19,6 +19,7 @@
 #include "QueryImp.h"
 #include "ReapThread.h"
 #include "CheckNodeThread.h"
+#include "HeartbeatFlushThread.h"
 //#include "CheckSettingState.h"
 #include "RegistryProcThread.h"
 #include "DockerThread.h"
@@ -57,6 +58,16 @@ public:
      */
     RegistryProcThread * getRegProcThread();
 
+    /**
+     * 获取node心跳合并写入线程
+     */
+    HeartbeatFlushThread * getHeartbeatFlushThread() { return &_heartbeatFlushThread; }
+
+    /**
+     * 获取node超时检查线程
+     */
+    CheckNodeThread * getCheckNodeThread() { return &_checkNodeThread; }
+
     /**
      * 获取对应的ip、端口等信息
      */
@@ -77,6 +88,8 @@ protected:
 
     CheckNodeThread        _checkNodeThread;        //监控tarsnode超时的线程
 
+    HeartbeatFlushThread   _heartbeatFlushThread;   //node心跳合并写入db的线程
+
 	DockerThread           _dockerThread;        //拉取docker镜像的线程
 
 //	CheckSettingState      _checksetingThread;      //监控所有服务状态的线程
@@ -0,0 +1,156 @@
+/**
+ * Tencent is pleased to support the open source community by making Tars available.
+ *
+ * Copyright (C) 2016THL A29 Limited, a Tencent company. All rights reserved.
+ *
+ * Licensed under the BSD 3-Clause License (the "License"); you may not use this file except
+ * in compliance with the License. You may obtain a copy of the License at
+ *
+ * https://opensource.org/licenses/BSD-3-Clause
+ *
+ * Unless required by applicable law or agreed to in writing, software distributed
+ * under the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+ * CONDITIONS OF ANY KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations under the License.
+ */
+
+#include "TimerWheel.h"
+
+TimerWheel::TimerWheel(int64_t tickMs, int64_t nowMs)
+: _tickMs(tickMs > 0 ? tickMs : 1)
+, _baseMs(nowMs)
+, _curTick(0)
+, _gen(0)
+{
+    _wheel[0].resize(ROOT_SIZE);
+    for (int i = 1; i < LEVEL_NUM; i++)
+    {
+        _wheel[i].resize(LEVEL_SIZE);
+    }
+}
+
+uint64_t TimerWheel::toTick(int64_t ms) const
+{
+    return ms <= _baseMs ? 0 : static_cast<uint64_t>((ms - _baseMs) / _tickMs);
+}
+
+void TimerWheel::refresh(const string &name, int64_t nowMs, int64_t timeoutMs)
+{
+    uint64_t expireTick = toTick(nowMs + timeoutMs);
+
+    unordered_map<string, Timer>::iterator it = _timers.find(name);
+    if (it != _timers.end() && it->second.expireTick <= expireTick)
+    {
+        //超时时间延后, 槽位记录到期时再重新放入
+        it->second.expireTick = expireTick;
+        return;
+    }
+
+    //新增或超时时间提前, 旧的槽位记录因gen不一致而失效
+    Timer &timer     = _timers[name];
+    timer.expireTick = expireTick;
+    timer.gen        = ++_gen;
+
+    schedule(name, timer.gen, expireTick);
+}
+
+void TimerWheel::remove(const string &name)
+{
+    _timers.erase(name);
+}
+
+void TimerWheel::schedule(const string &name, uint64_t gen, uint64_t expireTick)
+{
+    //至少放到下一个刻度, 当前刻度的槽位可能已经处理过
+    uint64_t delta = expireTick > _curTick ? expireTick - _curTick : 1;
+
+    const uint64_t maxDelta = 1ULL << (ROOT_BITS + (LEVEL_NUM - 1) * LEVEL_BITS);
+    if (delta >= maxDelta)
+    {
+        //超出时间轮范围, 先放到最远的槽位, 到时再根据真实的到期刻度重新放入
+        delta = maxDelta - 1;
+    }
+
+    uint64_t tick = _curTick + delta;
+
+    SlotEntry entry;
+    entry.name = name;
+    entry.gen  = gen;
+
+    if (delta < ROOT_SIZE)
+    {
+        _wheel[0][tick & (ROOT_SIZE - 1)].push_back(entry);
+        return;
+    }
+
+    for (int level = 1; level < LEVEL_NUM; level++)
+    {
+        int shift = ROOT_BITS + level * LEVEL_BITS;
+        if (level == LEVEL_NUM - 1 || delta < (1ULL << shift))
+        {
+            _wheel[level][(tick >> (shift - LEVEL_BITS)) & (LEVEL_SIZE - 1)].push_back(entry);
+            return;
+        }
+    }
+}
+
+void TimerWheel::cascade(int level)
+{
+    int shift  = ROOT_BITS + (level - 1) * LEVEL_BITS;
+    size_t idx = (_curTick >> shift) & (LEVEL_SIZE - 1);
+
+    Slot slot;
+    slot.swap(_wheel[level][idx]);
+
+    for (size_t i = 0; i < slot.size(); i++)
+    {
+        unordered_map<string, Timer>::const_iterator it = _timers.find(slot[i].name);
+        if (it != _timers.end() && it->second.gen == slot[i].gen)
+        {
+            schedule(slot[i].name, slot[i].gen, it->second.expireTick);
+        }
+    }
+
+    //本层转完一圈, 继续把上一层的槽位分散下来
+    if (idx == 0 && level + 1 < LEVEL_NUM)
+    {
+        cascade(level + 1);
+    }
+}
+
+void TimerWheel::advance(int64_t nowMs, vector<string> &expired)
+{
+    uint64_t target = toTick(nowMs);
+
+    while (_curTick < target)
+    {
+        ++_curTick;
+
+        if ((_curTick & (ROOT_SIZE - 1)) == 0)
+        {
+            cascade(1);
+        }
+
+        Slot slot;
+        slot.swap(_wheel[0][_curTick & (ROOT_SIZE - 1)]);
+
+        for (size_t i = 0; i < slot.size(); i++)
+        {
+            unordered_map<string, Timer>::iterator it = _timers.find(slot[i].name);
+            if (it == _timers.end() || it->second.gen != slot[i].gen)
+            {
+                continue;
+            }
+
+            if (it->second.expireTick > _curTick)
+            {
+                schedule(slot[i].name, slot[i].gen, it->second.expireTick);
+            }
+            else
+            {
+                expired.push_back(slot[i].name);
+                _timers.erase(it);
+            }
+        }
+    }
+}
@@ -0,0 +1,111 @@
+/**
+ * Tencent is pleased to support the open source community by making Tars available.
+ *
+ * Copyright (C) 2016THL A29 Limited, a Tencent company. All rights reserved.
+ *
+ * Licensed under the BSD 3-Clause License (the "License"); you may not use this file except
+ * in compliance with the License. You may obtain a copy of the License at
+ *
+ * https://opensource.org/licenses/BSD-3-Clause
+ *
+ * Unless required by applicable law or agreed to in writing, software distributed
+ * under the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+ * CONDITIONS OF ANY KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations under the License.
+ */
+
+#ifndef __TIMER_WHEEL_H__
+#define __TIMER_WHEEL_H__
+
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <stdint.h>
+
+using namespace std;
+
+//////////////////////////////////////////////////////
+/**
+ * 分层时间轮, 按名称管理超时时间, 非线程安全
+ * 第0层256个槽, 之后每层64个槽, 共4层, 刻度为tickMs时可覆盖 256*64^3 个刻度
+ * 每个名称在轮中只有一个槽位记录, 刷新超时时间只修改记录中的到期刻度,
+ * 槽位到期时再检查, 未到期则重新放入对应的槽位
+ */
+class TimerWheel
+{
+public:
+    /**
+     * @param tickMs 刻度, 单位毫秒
+     * @param nowMs  当前时间, 单位毫秒
+     */
+    TimerWheel(int64_t tickMs, int64_t nowMs);
+
+    /**
+     * 设置或刷新超时时间
+     * @param name      名称
+     * @param nowMs     当前时间, 单位毫秒
+     * @param timeoutMs 超时时长, 单位毫秒
+     */
+    void refresh(const string &name, int64_t nowMs, int64_t timeoutMs);
+
+    /**
+     * 删除
+     */
+    void remove(const string &name);
+
+    /**
+     * 推进时间轮到nowMs, 到期的名称被移除并追加到expired中
+     */
+    void advance(int64_t nowMs, vector<string> &expired);
+
+    /**
+     * 未到期的记录数
+     */
+    size_t size() const { return _timers.size(); }
+
+protected:
+    enum
+    {
+        ROOT_BITS  = 8,
+        LEVEL_BITS = 6,
+        ROOT_SIZE  = 1 << ROOT_BITS,
+        LEVEL_SIZE = 1 << LEVEL_BITS,
+        LEVEL_NUM  = 4,
+    };
+
+    struct Timer
+    {
+        uint64_t expireTick;
+        uint64_t gen;
+    };
+
+    struct SlotEntry
+    {
+        string   name;
+        uint64_t gen;
+    };
+
+    typedef vector<SlotEntry> Slot;
+
+    void schedule(const string &name, uint64_t gen, uint64_t expireTick);
+
+    void cascade(int level);
+
+    uint64_t toTick(int64_t ms) const;
+
+protected:
+    int64_t                         _tickMs;
+
+    int64_t                         _baseMs;
+
+    uint64_t                        _curTick;
+
+    uint64_t                        _gen;
+
+    unordered_map<string, Timer>    _timers;
+
+    //_wheel[0]有ROOT_SIZE个槽, 其他层有LEVEL_SIZE个槽
+    vector<Slot>                    _wheel[LEVEL_NUM];
+};
+
+#endif
@@ -0,0 +1,424 @@
+/**
+ * Tencent is pleased to support the open source community by making Tars available.
+ *
+ * Copyright (C) 2016THL A29 Limited, a Tencent company. All rights reserved.
+ *
+ * Licensed under the BSD 3-Clause License (the "License"); you may not use this file except
+ * in compliance with the License. You may obtain a copy of the License at
+ *
+ * https://opensource.org/licenses/BSD-3-Clause
+ *
+ * Unless required by applicable law or agreed to in writing, software distributed
+ * under the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+ * CONDITIONS OF ANY KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations under the License.
+ */
+
+#include "RegistryBench.h"
+#include <chrono>
+#include <cstdio>
+#include <iostream>
+#include <thread>
+#include "util.h"
+
+using namespace tars;
+
+//调用方的set信息为bench.sh.N
+#define BENCH_SET_NAME      "bench"
+#define BENCH_SET_AREA      "sh"
+
+/**
+ * 查询线程使用的随机数, 避免rand()内部加锁
+ */
+static inline uint64_t xorshift(uint64_t &state)
+{
+    state ^= state << 13;
+    state ^= state >> 7;
+    state ^= state << 17;
+    return state;
+}
+
+RegistryBench::RegistryBench(const BenchOption &option)
+: _option(option)
+{
+}
+
+string RegistryBench::objName(int index) const
+{
+    return "Bench" + TC_Common::tostr(index % 100) + ".Server" + TC_Common::tostr(index) + ".BenchObj";
+}
+
+string RegistryBench::nodeIp(int group, int index) const
+{
+    return "10." + TC_Common::tostr(group) + "." + TC_Common::tostr((index >> 8) & 0xff) + "." + TC_Common::tostr(index & 0xff);
+}
+
+ObjectItem RegistryBench::makeObject(int index, int round) const
+{
+    ObjectItem item;
+    for (int k = 0; k < _option.endpoints; k++)
+    {
+        int group = (index + k) % _option.groups;
+
+        EndpointF ep;
+        ep.host        = nodeIp(group, index * _option.endpoints + k);
+        ep.port        = 10000 + k;
+        ep.timeout     = 3000;
+        ep.istcp       = 1;
+        ep.groupworkid = group + 1;
+        ep.grouprealid = group + 1;
+        ep.setId       = string(BENCH_SET_NAME) + "." + BENCH_SET_AREA + "." + TC_Common::tostr(k % _option.sets);
+        ep.weight      = DEFAULT_WEIGHT;
+        ep.weightType  = (k % 2 == 0) ? LOAD_BALANCE_DYNAMIC_WEIGHT : LOAD_BALANCE_LOOP;
+
+        //每轮更新有不同的节点不可用
+        if ((k + round) % 10 == 0)
+        {
+            item.vInactiveEndpoints.push_back(ep);
+        }
+        else
+        {
+            item.vActiveEndpoints.push_back(ep);
+        }
+    }
+
+    return item;
+}
+
+void RegistryBench::loadObjects()
+{
+    ObjectsCache objCache;
+    for (int i = 0; i < _option.objects; i++)
+    {
+        objCache[_objNames[i]] = makeObject(i, 0);
+    }
+
+    _db.updateObjectsCache(objCache, true);
+
+    _weightEps.resize(_option.objects);
+    for (int i = 0; i < _option.objects; i++)
+    {
+        _weightEps[i] = objCache[_objNames[i]].vActiveEndpoints;
+    }
+}
+
+void RegistryBench::loadGroupRule()
+{
+    vector<map<string, string> > serverGroupRule;
+    for (int g = 0; g < _option.groups; g++)
+    {
+        map<string, string> rule;
+        rule["group_id"]      = TC_Common::tostr(g + 1);
+        rule["allow_ip_rule"] = "10." + TC_Common::tostr(g) + ".*.*";
+        rule["group_name"]    = "bench_group_" + TC_Common::tostr(g);
+        serverGroupRule.push_back(rule);
+    }
+
+    _db.load2GroupMap(serverGroupRule);
+}
+
+void RegistryBench::loadSetDivision()
+{
+    CDbHandle::SetDivisionCache setDivisionCache;
+    for (int i = 0; i < _option.objects; i++)
+    {
+        ObjectItem item = makeObject(i, 0);
+
+        vector<CDbHandle::SetServerInfo> &vSetServerInfo = setDivisionCache[_objNames[i]][BENCH_SET_NAME];
+        for (int active = 0; active < 2; active++)
+        {
+            const vector<EndpointF> &vEps = active ? item.vActiveEndpoints : item.vInactiveEndpoints;
+            for (size_t k = 0; k < vEps.size(); k++)
+            {
+                CDbHandle::SetServerInfo setServerInfo;
+                setServerInfo.sSetId   = vEps[k].setId;
+                setServerInfo.sSetArea = string(BENCH_SET_NAME) + "." + BENCH_SET_AREA;
+                setServerInfo.bActive  = active != 0;
+                setServerInfo.epf      = vEps[k];
+                vSetServerInfo.push_back(setServerInfo);
+            }
+        }
+    }
+
+    _db.updateDivisionCache(setDivisionCache, true);
+}
+
+void RegistryBench::loadWeight()
+{
+    LoadBalanceThread::LoadCache loadCache;
+    for (int i = 0; i < _option.objects; i++)
+    {
+        const vector<EndpointF> &vEps = _weightEps[i];
+
+        LoadBalanceInfo &info = loadCache[_objNames[i]];
+        for (size_t k = 0; k < vEps.size(); k++)
+        {
+            LoadBalanceItem loadItem;
+            loadItem.slaveName  = _objNames[i];
+            loadItem.slaveIp    = vEps[k].host;
+            loadItem.port       = vEps[k].port;
+            loadItem.weight     = MIN_WEIGHT + static_cast<int>(k * 7) % DEFAULT_WEIGHT;
+            loadItem.weightType = LOAD_BALANCE_DYNAMIC_WEIGHT;
+            info.vtBalanceItem.push_back(loadItem);
+        }
+    }
+
+    LOAD_BALANCE_INS->_dynamicSwitch = 1;
+    LOAD_BALANCE_INS->updateWeightCache(loadCache);
+}
+
+void RegistryBench::prepare()
+{
+    int64_t begin = TC_Common::now2ms();
+
+    _objNames.resize(_option.objects);
+    for (int i = 0; i < _option.objects; i++)
+    {
+        _objNames[i] = objName(i);
+    }
+
+    loadObjects();
+    loadGroupRule();
+    loadSetDivision();
+    loadWeight();
+
+    cout << "prepare objects:" << _option.objects << ", endpoints per object:" << _option.endpoints
+         << ", groups:" << _option.groups << ", sets:" << _option.sets
+         << ", cost:" << TC_Common::now2ms() - begin << "ms" << endl;
+}
+
+void RegistryBench::queryWorker(int threadIndex, vector<QueryStat> &stats)
+{
+    stats.resize(QUERY_TYPE_NUM);
+    for (size_t i = 0; i < stats.size(); i++)
+    {
+        stats[i].histogram.assign(LATENCY_BUCKET_NUM, 0);
+    }
+
+    //调用方参数预先生成, 只统计主控查询路径本身
+    vector<string> vCallerIp(_option.groups);
+    for (int g = 0; g < _option.groups; g++)
+    {
+        vCallerIp[g] = nodeIp(g, threadIndex + 1);
+    }
+
+    vector<vector<string> > vSetInfo(_option.sets);
+    for (int s = 0; s < _option.sets; s++)
+    {
+        vSetInfo[s].push_back(BENCH_SET_NAME);
+        vSetInfo[s].push_back(BENCH_SET_AREA);
+        vSetInfo[s].push_back(TC_Common::tostr(s));
+    }
+
+    vector<EndpointF> vWeightEps;
+    vWeightEps.reserve(_option.endpoints);
+
+    uint64_t rnd = 0x9E3779B97F4A7C15ULL * (threadIndex + 1);
+    uint64_t seq = 0;
+
+    while (!_stop.load(std::memory_order_relaxed))
+    {
+        int type      = static_cast<int>(seq++ % QUERY_TYPE_NUM);
+        int index     = static_cast<int>(xorshift(rnd) % _option.objects);
+        const string &id = _objNames[index];
+
+        if (type == QUERY_DYNAMIC_WEIGHT)
+        {
+            //getDynamicWeight会修改入参, 每次从原始节点列表复制
+            vWeightEps = _weightEps[index];
+        }
+
+        uint64_t allocs = threadAllocs();
+        std::chrono::steady_clock::time_point begin = std::chrono::steady_clock::now();
+
+        switch (type)
+        {
+            case QUERY_BY_ID:
+            {
+                vector<EndpointF> vEps = _db.findObjectById(id);
+                break;
+            }
+            case QUERY_IN_SAME_GROUP:
+            {
+                vector<EndpointF> activeEp;
+                vector<EndpointF> inactiveEp;
+                _db.findObjectByIdInSameGroup(id, vCallerIp[xorshift(rnd) % vCallerIp.size()], activeEp, inactiveEp, NULL);
+                break;
+            }
+            case QUERY_IN_SAME_SET:
+            {
+                vector<EndpointF> activeEp;
+                vector<EndpointF> inactiveEp;
+                _db.findObjectByIdInSameSet(id, vSetInfo[xorshift(rnd) % vSetInfo.size()], activeEp, inactiveEp, NULL);
+                break;
+            }
+            default:
+            {
+                LOAD_BALANCE_INS->getDynamicWeight(id, vWeightEps);
+                break;
+            }
+        }
+
+        uint64_t ns = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - begin).count();
+
+        QueryStat &stat = stats[type];
+        stat.count++;
+        stat.allocs += threadAllocs() - allocs;
+
+        uint64_t bucket = ns / LATENCY_BUCKET_NS;
+        stat.histogram[bucket < LATENCY_BUCKET_NUM ? bucket : LATENCY_BUCKET_NUM - 1]++;
+    }
+}
+
+void RegistryBench::swapWorker()
+{
+    int round = 0;
+    int changeNum = _option.objects * _option.swapPercent / 100;
+    changeNum = changeNum < 1 ? 1 : changeNum;
+
+    uint64_t rnd = 0x2545F4914F6CDD1DULL;
+
+    while (!_stop.load(std::memory_order_relaxed))
+    {
+        std::this_thread::sleep_for(std::chrono::milliseconds(_option.swapInterval));
+        if (_stop.load(std::memory_order_relaxed))
+        {
+            break;
+        }
+
+        ++round;
+
+        ObjectsCache objCache;
+        if (_option.fullSwapEvery > 0 && round % _option.fullSwapEvery == 0)
+        {
+            for (int i = 0; i < _option.objects; i++)
+            {
+                objCache[_objNames[i]] = makeObject(i, round);
+            }
+            _db.updateObjectsCache(objCache, true);
+        }
+        else
+        {
+            int start = static_cast<int>(xorshift(rnd) % _option.objects);
+            for (int i = 0; i < changeNum; i++)
+            {
+                int index = (start + i) % _option.objects;
+                objCache[_objNames[index]] = makeObject(index, round);
+            }
+            _db.updateObjectsCache(objCache, false);
+        }
+
+        _swaps++;
+    }
+}
+
+void RegistryBench::run()
+{
+    vector<vector<QueryStat> > stats(_option.threads);
+    vector<std::thread> workers;
+
+    int64_t begin = TC_Common::now2ms();
+
+    for (int i = 0; i < _option.threads; i++)
+    {
+        workers.push_back(std::thread(&RegistryBench::queryWorker, this, i, std::ref(stats[i])));
+    }
+
+    std::thread swapper;
+    if (_option.swapInterval > 0)
+    {
+        swapper = std::thread(&RegistryBench::swapWorker, this);
+    }
+
+    std::this_thread::sleep_for(std::chrono::seconds(_option.seconds));
+    _stop = true;
+
+    for (size_t i = 0; i < workers.size(); i++)
+    {
+        workers[i].join();
+    }
+
+    double elapsedSec = (TC_Common::now2ms() - begin) / 1000.0;
+
+    if (swapper.joinable())
+    {
+        swapper.join();
+    }
+
+    report(stats, elapsedSec, _swaps);
+}
+
+const char *RegistryBench::queryName(int type)
+{
+    switch (type)
+    {
+        case QUERY_BY_ID:
+            return "findObjectById";
+        case QUERY_IN_SAME_GROUP:
+            return "findObjectByIdInSameGroup";
+        case QUERY_IN_SAME_SET:
+            return "findObjectByIdInSameSet";
+        case QUERY_DYNAMIC_WEIGHT:
+            return "getDynamicWeight";
+        default:
+            return "UNKNOWN";
+    }
+}
+
+/**
+ * 从延时分布中取百分位, 返回微秒
+ */
+static double percentile(const vector<uint64_t> &histogram, uint64_t total, double pct, uint32_t bucketNs)
+{
+    if (total == 0)
+    {
+        return 0;
+    }
+
+    uint64_t target = static_cast<uint64_t>(total * pct);
+    uint64_t sum    = 0;
+    for (size_t i = 0; i < histogram.size(); i++)
+    {
+        sum += histogram[i];
+        if (sum > target)
+        {
+            return (i + 1) * bucketNs / 1000.0;
+        }
+    }
+
+    return histogram.size() * bucketNs / 1000.0;
+}
+
+void RegistryBench::report(const vector<vector<QueryStat> > &stats, double elapsedSec, uint64_t swaps) const
+{
+    printf("threads:%d, duration:%.2fs, cache updates:%lu\n", _option.threads, elapsedSec, (unsigned long)swaps);
+    printf("%-28s %12s %12s %10s %10s %10s %14s\n", "query", "count", "qps", "p50(us)", "p99(us)", "p999(us)", "allocs/query");
+
+    uint64_t totalCount = 0;
+    for (int type = 0; type < QUERY_TYPE_NUM; type++)
+    {
+        QueryStat merged;
+        merged.histogram.assign(LATENCY_BUCKET_NUM, 0);
+        for (size_t t = 0; t < stats.size(); t++)
+        {
+            const QueryStat &stat = stats[t][type];
+            merged.count  += stat.count;
+            merged.allocs += stat.allocs;
+            for (size_t i = 0; i < stat.histogram.size(); i++)
+            {
+                merged.histogram[i] += stat.histogram[i];
+            }
+        }
+
+        totalCount += merged.count;
+
+        printf("%-28s %12lu %12.0f %10.1f %10.1f %10.1f %14.2f\n", queryName(type), (unsigned long)merged.count,
+               elapsedSec > 0 ? merged.count / elapsedSec : 0,
+               percentile(merged.histogram, merged.count, 0.50, LATENCY_BUCKET_NS),
+               percentile(merged.histogram, merged.count, 0.99, LATENCY_BUCKET_NS),
+               percentile(merged.histogram, merged.count, 0.999, LATENCY_BUCKET_NS),
+               merged.count > 0 ? (double)merged.allocs / merged.count : 0);
+    }
+
+    printf("%-28s %12lu %12.0f\n", "total", (unsigned long)totalCount, elapsedSec > 0 ? totalCount / elapsedSec : 0);
+}
@@ -0,0 +1,140 @@
+/**
+ * Tencent is pleased to support the open source community by making Tars available.
+ *
+ * Copyright (C) 2016THL A29 Limited, a Tencent company. All rights reserved.
+ *
+ * Licensed under the BSD 3-Clause License (the "License"); you may not use this file except
+ * in compliance with the License. You may obtain a copy of the License at
+ *
+ * https://opensource.org/licenses/BSD-3-Clause
+ *
+ * Unless required by applicable law or agreed to in writing, software distributed
+ * under the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+ * CONDITIONS OF ANY KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations under the License.
+ */
+
+#ifndef __REGISTRY_BENCH_H__
+#define __REGISTRY_BENCH_H__
+
+#include <atomic>
+#include <string>
+#include <vector>
+#include "DbHandle.h"
+#include "LoadBalanceThread.h"
+
+using namespace tars;
+
+/**
+ * 主控查询路径压测参数
+ */
+struct BenchOption
+{
+    int     objects{10000};           //对象数
+    int     endpoints{20};            //每个对象的节点数
+    int     groups{16};               //ip分组数, 节点按分组均匀分布
+    int     sets{4};                  //每个对象的set分组数
+    int     threads{8};               //查询线程数
+    int     seconds{10};              //压测时长
+    int     swapInterval{100};        //对象缓存增量更新间隔(ms), 0表示不更新
+    int     swapPercent{1};           //每次增量更新的对象比例(%)
+    int     fullSwapEvery{50};        //每N次增量更新做一次全量更新
+};
+
+/**
+ * 主控查询路径压测
+ * 不连接数据库, 直接把合成的对象/分组/set/动态权重装入CDbHandle和LoadBalanceThread,
+ * 多线程调用findObjectById/findObjectByIdInSameGroup/findObjectByIdInSameSet/getDynamicWeight,
+ * 同时由一个线程周期性更新对象缓存, 统计各接口的QPS, 延时分布和每次查询的内存分配次数
+ */
+class RegistryBench
+{
+public:
+    enum QueryType
+    {
+        QUERY_BY_ID = 0,
+        QUERY_IN_SAME_GROUP,
+        QUERY_IN_SAME_SET,
+        QUERY_DYNAMIC_WEIGHT,
+        QUERY_TYPE_NUM
+    };
+
+    /**
+     * 单个查询线程的统计
+     */
+    struct QueryStat
+    {
+        uint64_t            count{0};
+        uint64_t            allocs{0};
+        vector<uint64_t>    histogram;      //延时分布, 每个桶LATENCY_BUCKET_NS, 超出范围的计入最后一个桶
+    };
+
+    //延时统计的桶宽度(ns)和桶数, 覆盖0~10ms
+    static const uint32_t LATENCY_BUCKET_NS  = 100;
+    static const uint32_t LATENCY_BUCKET_NUM = 100000;
+
+    explicit RegistryBench(const BenchOption &option);
+
+    /**
+     * 生成合成数据并装载到缓存
+     */
+    void prepare();
+
+    /**
+     * 执行压测并输出结果
+     */
+    void run();
+
+    /**
+     * 当前线程累计的内存分配次数, 由main.cpp中替换的operator new维护
+     */
+    static uint64_t threadAllocs();
+
+protected:
+    /**
+     * 生成单个对象的节点列表, round用于增量更新时改变节点状态
+     */
+    ObjectItem makeObject(int index, int round) const;
+
+    string objName(int index) const;
+
+    string nodeIp(int group, int index) const;
+
+    void loadObjects();
+
+    void loadGroupRule();
+
+    void loadSetDivision();
+
+    void loadWeight();
+
+    /**
+     * 查询线程
+     */
+    void queryWorker(int threadIndex, vector<QueryStat> &stats);
+
+    /**
+     * 缓存更新线程
+     */
+    void swapWorker();
+
+    void report(const vector<vector<QueryStat> > &stats, double elapsedSec, uint64_t swaps) const;
+
+    static const char *queryName(int type);
+
+protected:
+    BenchOption         _option;
+
+    CDbHandle           _db;
+
+    vector<string>      _objNames;
+
+    //每个对象的节点列表, 作为getDynamicWeight的输入
+    vector<vector<EndpointF> > _weightEps;
+
+    std::atomic<bool>   _stop{false};
+
+    std::atomic<uint64_t> _swaps{0};
+};
+
+#endif
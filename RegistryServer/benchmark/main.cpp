@@ -0,0 +1,137 @@
+/**
+ * Tencent is pleased to support the open source community by making Tars available.
+ *
+ * Copyright (C) 2016THL A29 Limited, a Tencent company. All rights reserved.
+ *
+ * Licensed under the BSD 3-Clause License (the "License"); you may not use this file except
+ * in compliance with the License. You may obtain a copy of the License at
+ *
+ * https://opensource.org/licenses/BSD-3-Clause
+ *
+ * Unless required by applicable law or agreed to in writing, software distributed
+ * under the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+ * CONDITIONS OF ANY KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations under the License.
+ */
+
+#include <cstdlib>
+#include <new>
+#include <iostream>
+#include "util/tc_option.h"
+#include "util/tc_config.h"
+#include "RegistryServer.h"
+#include "RegistryBench.h"
+
+using namespace tars;
+
+//复用主控的源文件, 需要提供主控的全局对象
+RegistryServer g_app;
+TC_Config * g_pconf;
+
+//每个线程独立计数, 统计查询路径上的内存分配次数
+static thread_local uint64_t g_threadAllocs = 0;
+
+uint64_t RegistryBench::threadAllocs()
+{
+    return g_threadAllocs;
+}
+
+void *operator new(size_t size)
+{
+    ++g_threadAllocs;
+    void *p = malloc(size == 0 ? 1 : size);
+    if (p == NULL)
+    {
+        throw std::bad_alloc();
+    }
+    return p;
+}
+
+void *operator new[](size_t size)
+{
+    return operator new(size);
+}
+
+void operator delete(void *p) noexcept
+{
+    free(p);
+}
+
+void operator delete[](void *p) noexcept
+{
+    free(p);
+}
+
+void operator delete(void *p, size_t) noexcept
+{
+    free(p);
+}
+
+void operator delete[](void *p, size_t) noexcept
+{
+    free(p);
+}
+
+static void usage(const char *argv0)
+{
+    cout << "Usage: " << argv0 << " [options]" << endl
+         << "  --objects=N          objects in cache, default 10000" << endl
+         << "  --endpoints=N        endpoints per object, default 20" << endl
+         << "  --groups=N           ip groups, default 16" << endl
+         << "  --sets=N             set groups per object, default 4" << endl
+         << "  --threads=N          query threads, default 8" << endl
+         << "  --seconds=N          duration, default 10" << endl
+         << "  --swap-interval=MS   objects cache update interval, 0 disables, default 100" << endl
+         << "  --swap-percent=N     percent of objects changed per update, default 1" << endl
+         << "  --full-swap-every=N  full reload every N updates, default 50" << endl;
+}
+
+int main(int argc, char *argv[])
+{
+    try
+    {
+        TC_Option op;
+        op.decode(argc, argv);
+
+        if (op.hasParam("help"))
+        {
+            usage(argv[0]);
+            return 0;
+        }
+
+        TC_Config conf;
+        g_pconf = &conf;
+
+        //压测时只输出错误日志, 避免日志影响结果
+        LocalRollLogger::getInstance()->logger()->setLogLevel("ERROR");
+
+        BenchOption option;
+        option.objects       = TC_Common::strto<int>(op.getValue("objects", "10000"));
+        option.endpoints     = TC_Common::strto<int>(op.getValue("endpoints", "20"));
+        option.groups        = TC_Common::strto<int>(op.getValue("groups", "16"));
+        option.sets          = TC_Common::strto<int>(op.getValue("sets", "4"));
+        option.threads       = TC_Common::strto<int>(op.getValue("threads", "8"));
+        option.seconds       = TC_Common::strto<int>(op.getValue("seconds", "10"));
+        option.swapInterval  = TC_Common::strto<int>(op.getValue("swap-interval", "100"));
+        option.swapPercent   = TC_Common::strto<int>(op.getValue("swap-percent", "1"));
+        option.fullSwapEvery = TC_Common::strto<int>(op.getValue("full-swap-every", "50"));
+
+        if (option.objects <= 0 || option.endpoints <= 0 || option.groups <= 0 || option.groups > 255
+            || option.sets <= 0 || option.threads <= 0 || option.seconds <= 0)
+        {
+            usage(argv[0]);
+            return -1;
+        }
+
+        RegistryBench bench(option);
+        bench.prepare();
+        bench.run();
+    }
+    catch (exception &ex)
+    {
+        cerr << "registry bench error:" << ex.what() << endl;
+        return -1;
+    }
+
+    return 0;
+}
@@ -275,6 +275,35 @@ CREATE TABLE `t_server_conf` (
 /*!40101 SET character_set_client = @saved_cs_client */;
 
 
+--
+-- Table structure for table `t_server_change_log`
+--
+
+DROP TABLE IF EXISTS `t_server_change_log`;
+/*!40101 SET @saved_cs_client     = @@character_set_client */;
+/*!40101 SET character_set_client = utf8 */;
+CREATE TABLE `t_server_change_log` (
+  `id` bigint(20) NOT NULL AUTO_INCREMENT,
+  `application` varchar(128) NOT NULL DEFAULT '',
+  `server_name` varchar(128) NOT NULL DEFAULT '',
+  `change_time` timestamp NOT NULL DEFAULT CURRENT_TIMESTAMP,
+  PRIMARY KEY (`id`),
+  KEY `index_change_time` (`change_time`)
+) ENGINE=InnoDB DEFAULT CHARSET=utf8;
+/*!40101 SET character_set_client = @saved_cs_client */;
+
+CREATE TRIGGER `tr_server_conf_insert` AFTER INSERT ON `t_server_conf` FOR EACH ROW INSERT INTO `t_server_change_log` (`application`, `server_name`) VALUES (NEW.application, NEW.server_name);
+
+CREATE TRIGGER `tr_server_conf_update` AFTER UPDATE ON `t_server_conf` FOR EACH ROW INSERT INTO `t_server_change_log` (`application`, `server_name`) SELECT NEW.application, NEW.server_name FROM DUAL WHERE NOT (NEW.setting_state <=> OLD.setting_state AND NEW.present_state <=> OLD.present_state AND NEW.flow_state <=> OLD.flow_state AND NEW.enable_group <=> OLD.enable_group AND NEW.ip_group_name <=> OLD.ip_group_name AND NEW.bak_flag <=> OLD.bak_flag AND NEW.enable_set <=> OLD.enable_set AND NEW.set_name <=> OLD.set_name AND NEW.set_area <=> OLD.set_area AND NEW.set_group <=> OLD.set_group AND NEW.node_name <=> OLD.node_name);
+
+CREATE TRIGGER `tr_server_conf_delete` AFTER DELETE ON `t_server_conf` FOR EACH ROW INSERT INTO `t_server_change_log` (`application`, `server_name`) VALUES (OLD.application, OLD.server_name);
+
+CREATE TRIGGER `tr_adapter_conf_insert` AFTER INSERT ON `t_adapter_conf` FOR EACH ROW INSERT INTO `t_server_change_log` (`application`, `server_name`) VALUES (NEW.application, NEW.server_name);
+
+CREATE TRIGGER `tr_adapter_conf_update` AFTER UPDATE ON `t_adapter_conf` FOR EACH ROW INSERT INTO `t_server_change_log` (`application`, `server_name`) SELECT NEW.application, NEW.server_name FROM DUAL WHERE NOT (NEW.servant <=> OLD.servant AND NEW.endpoint <=> OLD.endpoint AND NEW.node_name <=> OLD.node_name);
+
+CREATE TRIGGER `tr_adapter_conf_delete` AFTER DELETE ON `t_adapter_conf` FOR EACH ROW INSERT INTO `t_server_change_log` (`application`, `server_name`) VALUES (OLD.application, OLD.server_name);
+
 --
 -- Table structure for table `t_base_image`
 --
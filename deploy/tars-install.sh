@@ -171,7 +171,7 @@ done
 function check_ports()
 {
     LOG_DEBUG "check port if conflict"
-    PORTS="18993 18997 18793 18797 18693 18697 18193 18197 18593 18597 18493 18497 18393 18397 18293 18297 12000 19385 19387 17897 17890 17891 3000 3001"
+    PORTS="18993 18997 18793 18797 18693 18697 18193 18197 18593 18597 18493 18497 18393 18397 18293 18297 12000 19385 19387 19388 17897 17890 17891 3000 3001"
     for P in $PORTS;
     do
         NETINFO=$(netstat_port)
@@ -0,0 +1,597 @@
+/**
+ * Tencent is pleased to support the open source community by making Tars available.
+ *
+ * Copyright (C) 2016THL A29 Limited, a Tencent company. All rights reserved.
+ *
+ * Licensed under the BSD 3-Clause License (the "License"); you may not use this file except 
+ * in compliance with the License. You may obtain a copy of the License at
+ *
+ * https://opensource.org/licenses/BSD-3-Clause
+ *
+ * Unless required by applicable law or agreed to in writing, software distributed 
+ * under the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR 
+ * CONDITIONS OF ANY KIND, either express or implied. See the License for the 
+ * specific language governing permissions and limitations under the License.
+ */
+
+
+#include "tars_delta.h"
+#include "util/tc_file.h"
+#include "util/tc_common.h"
+#include "util/tc_md5.h"
+
+#if !TARGET_PLATFORM_WINDOWS
+
+#include <zlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <stdint.h>
+#include <vector>
+#include <unordered_map>
+
+namespace tars
+{
+
+#define DELTA_MAGIC         "TARSDELTA3"
+
+//按块匹配, 最小块和tar的块一样大
+#define DELTA_MIN_BLOCK     512
+
+//旧内容最多分成这么多块, 内容更大时块也更大
+#define DELTA_MAX_BLOCKS    (4 * 1024 * 1024)
+
+//块的弱校验预过滤表的位数
+#define DELTA_FILTER_BITS   24
+
+/**
+ * rsync的滚动弱校验, 窗口右移一个字节时O(1)更新
+ */
+struct RollingSum
+{
+    uint32_t a;
+    uint32_t b;
+    uint32_t len;
+
+    void init(const unsigned char *p, uint32_t n)
+    {
+        a   = 0;
+        b   = 0;
+        len = n;
+        for (uint32_t i = 0; i < n; i++)
+        {
+            a += p[i];
+            b += (n - i) * p[i];
+        }
+    }
+
+    void roll(unsigned char out, unsigned char in)
+    {
+        a += in - out;
+        b += a - len * out;
+    }
+
+    uint32_t digest() const
+    {
+        return (a & 0xffff) | (b << 16);
+    }
+};
+
+static inline uint32_t filterIndex(uint32_t weak)
+{
+    return (weak * 2654435761U) >> (32 - DELTA_FILTER_BITS);
+}
+
+static void putUint64(string &out, uint64_t v)
+{
+    for (int i = 0; i < 8; i++)
+    {
+        out += (char)((v >> (i * 8)) & 0xff);
+    }
+}
+
+static uint64_t getUint64(const char *p)
+{
+    uint64_t v = 0;
+    for (int i = 7; i >= 0; i--)
+    {
+        v = (v << 8) | (unsigned char)p[i];
+    }
+    return v;
+}
+
+/**
+ * 差量的输出, 攒够一定数据后压缩写入文件
+ */
+class DeltaWriter
+{
+public:
+    DeltaWriter(gzFile gz) : _gz(gz), _ok(true) {}
+
+    void copy(uint64_t offset, uint64_t len)
+    {
+        _buf += 'C';
+        putUint64(_buf, offset);
+        putUint64(_buf, len);
+        flush(false);
+    }
+
+    void literal(const char *data, uint64_t len)
+    {
+        if (len == 0)
+        {
+            return;
+        }
+
+        _buf += 'L';
+        putUint64(_buf, len);
+        _buf.append(data, len);
+        flush(false);
+    }
+
+    void append(const string &data)
+    {
+        _buf += data;
+    }
+
+    bool flush(bool force)
+    {
+        if ((force || _buf.size() >= 1024 * 1024) && !_buf.empty() && _ok)
+        {
+            _ok = (gzwrite(_gz, _buf.c_str(), (unsigned)_buf.size()) == (int)_buf.size());
+            _buf.clear();
+        }
+        return _ok;
+    }
+
+protected:
+    gzFile  _gz;
+    string  _buf;
+    bool    _ok;
+};
+
+int TarsDelta::loadContent(const string &file, size_t maxSize, string &content, string &sResult)
+{
+    gzFile gz = gzopen(file.c_str(), "rb");
+    if (gz == NULL)
+    {
+        sResult = "open " + file + " error:" + strerror(errno);
+        return -1;
+    }
+
+    gzbuffer(gz, 256 * 1024);
+
+    content.clear();
+
+    vector<char> buffer(1024 * 1024);
+    int ret = 0;
+    int n;
+
+    //不是gzip格式时gzread直接读取原始内容
+    while ((n = gzread(gz, &buffer[0], (unsigned)buffer.size())) > 0)
+    {
+        if (maxSize > 0 && content.size() + n > maxSize)
+        {
+            sResult = file + " content is larger than " + TC_Common::tostr(maxSize);
+            ret = -2;
+            break;
+        }
+
+        content.append(&buffer[0], n);
+    }
+
+    if (n < 0)
+    {
+        int err = 0;
+        const char *msg = gzerror(gz, &err);
+        sResult = "read " + file + " error:" + (msg ? msg : "");
+        ret = -3;
+    }
+
+    gzclose(gz);
+
+    if (ret != 0)
+    {
+        content.clear();
+    }
+
+    return ret;
+}
+
+int TarsDelta::makeDelta(const string &oldContent, const string &newContent, const string &newMd5, const string &deltaFile, string &sResult)
+{
+    size_t blockSize = DELTA_MIN_BLOCK;
+    while (oldContent.size() / blockSize > DELTA_MAX_BLOCKS)
+    {
+        blockSize *= 2;
+    }
+
+    const unsigned char *oldData = (const unsigned char *)oldContent.data();
+    const unsigned char *newData = (const unsigned char *)newContent.data();
+    const size_t oldSize = oldContent.size();
+    const size_t newSize = newContent.size();
+
+    //旧内容按块建索引, 弱校验相同的块只保留第一个, 匹配后会向后扩展
+    size_t blocks = oldSize / blockSize;
+
+    unordered_map<uint32_t, uint32_t> index;
+    index.reserve(blocks);
+
+    vector<uint8_t> filter((1 << DELTA_FILTER_BITS) / 8, 0);
+
+    RollingSum sum;
+    for (size_t i = 0; i < blocks; i++)
+    {
+        sum.init(oldData + i * blockSize, blockSize);
+        uint32_t weak = sum.digest();
+
+        if (index.insert(make_pair(weak, (uint32_t)i)).second)
+        {
+            uint32_t f = filterIndex(weak);
+            filter[f >> 3] |= (1 << (f & 7));
+        }
+    }
+
+    string tmpFile = deltaFile + ".tmp";
+
+    gzFile gz = gzopen(tmpFile.c_str(), "wb6");
+    if (gz == NULL)
+    {
+        sResult = "open " + tmpFile + " error:" + strerror(errno);
+        return -1;
+    }
+
+    DeltaWriter writer(gz);
+    writer.append(string(DELTA_MAGIC) + " " + TC_Common::lower(newMd5) + " " + TC_MD5::md5str(newContent) + " " + TC_Common::tostr(newSize) + "\n");
+
+    size_t pos      = 0;
+    size_t litStart = 0;
+
+    if (blocks > 0 && newSize >= blockSize)
+    {
+        sum.init(newData, blockSize);
+    }
+
+    while (blocks > 0 && pos + blockSize <= newSize)
+    {
+        uint32_t weak = sum.digest();
+        uint32_t f    = filterIndex(weak);
+
+        if (filter[f >> 3] & (1 << (f & 7)))
+        {
+            unordered_map<uint32_t, uint32_t>::const_iterator it = index.find(weak);
+            if (it != index.end() && memcmp(oldData + (size_t)it->second * blockSize, newData + pos, blockSize) == 0)
+            {
+                size_t oldStart = (size_t)it->second * blockSize;
+                size_t newStart = pos;
+
+                //向前扩展到未输出的新增数据中
+                while (newStart > litStart && oldStart > 0 && oldData[oldStart - 1] == newData[newStart - 1])
+                {
+                    --oldStart;
+                    --newStart;
+                }
+
+                //向后扩展到不相同为止
+                size_t len = pos + blockSize - newStart;
+                while (newStart + len < newSize && oldStart + len < oldSize && oldData[oldStart + len] == newData[newStart + len])
+                {
+                    ++len;
+                }
+
+                writer.literal(newContent.data() + litStart, newStart - litStart);
+                writer.copy(oldStart, len);
+
+                pos      = newStart + len;
+                litStart = pos;
+
+                if (pos + blockSize <= newSize)
+                {
+                    sum.init(newData + pos, blockSize);
+                }
+                continue;
+            }
+        }
+
+        if (pos + blockSize < newSize)
+        {
+            sum.roll(newData[pos], newData[pos + blockSize]);
+        }
+        ++pos;
+    }
+
+    writer.literal(newContent.data() + litStart, newSize - litStart);
+    writer.append("E");
+
+    bool ok = writer.flush(true);
+
+    if (gzclose(gz) != Z_OK || !ok)
+    {
+        sResult = "write " + tmpFile + " error";
+        TC_File::removeFile(tmpFile, false);
+        return -2;
+    }
+
+    if (::rename(tmpFile.c_str(), deltaFile.c_str()) != 0)
+    {
+        sResult = "rename " + tmpFile + " error:" + strerror(errno);
+        TC_File::removeFile(tmpFile, false);
+        return -3;
+    }
+
+    return 0;
+}
+
+/**
+ * 从差量中读取n个字节
+ */
+static bool readDelta(gzFile gz, void *buf, size_t n)
+{
+    return gzread(gz, buf, (unsigned)n) == (int)n;
+}
+
+static bool writeAll(int fd, const char *data, size_t n)
+{
+    while (n > 0)
+    {
+        ssize_t ret = ::write(fd, data, n);
+        if (ret < 0 && errno == EINTR)
+        {
+            continue;
+        }
+        if (ret <= 0)
+        {
+            return false;
+        }
+        data += ret;
+        n    -= ret;
+    }
+    return true;
+}
+
+/**
+ * 把旧包解压到baseFile, 不是gzip格式时原样拷贝
+ */
+static int unpackFile(const string &file, const string &baseFile, string &sResult)
+{
+    gzFile gz = gzopen(file.c_str(), "rb");
+    if (gz == NULL)
+    {
+        sResult = "open " + file + " error:" + strerror(errno);
+        return -1;
+    }
+
+    gzbuffer(gz, 256 * 1024);
+
+    int fd = ::open(baseFile.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (fd < 0)
+    {
+        sResult = "open " + baseFile + " error:" + strerror(errno);
+        gzclose(gz);
+        return -1;
+    }
+
+    vector<char> buffer(1024 * 1024);
+    bool ok = true;
+    int n = 0;
+    while (ok && (n = gzread(gz, &buffer[0], (unsigned)buffer.size())) > 0)
+    {
+        ok = writeAll(fd, &buffer[0], n);
+    }
+
+    if (!ok)
+    {
+        sResult = "write " + baseFile + " error:" + strerror(errno);
+    }
+    else if (n < 0)
+    {
+        int err = 0;
+        const char *msg = gzerror(gz, &err);
+        sResult = "read " + file + " error:" + (msg ? msg : "");
+        ok = false;
+    }
+
+    gzclose(gz);
+
+    if (::close(fd) != 0 && ok)
+    {
+        sResult = "write " + baseFile + " error:" + strerror(errno);
+        ok = false;
+    }
+
+    if (!ok)
+    {
+        TC_File::removeFile(baseFile, false);
+        return -1;
+    }
+
+    return 0;
+}
+
+int TarsDelta::applyDelta(const string &oldFile, const string &deltaFile, const string &newFile, const string &newMd5, string &contentMd5, string &sResult)
+{
+    gzFile gz = gzopen(deltaFile.c_str(), "rb");
+    if (gz == NULL)
+    {
+        sResult = "open " + deltaFile + " error:" + strerror(errno);
+        return -1;
+    }
+
+    gzbuffer(gz, 256 * 1024);
+
+    char line[256] = {0};
+    vector<string> vHeader;
+    if (gzgets(gz, line, sizeof(line)) != NULL)
+    {
+        vHeader = TC_Common::sepstr<string>(TC_Common::trim(line), " ");
+    }
+
+    //先比较差量头中新包的md5, 不是要的版本时不用还原
+    if (vHeader.size() != 4 || vHeader[0] != DELTA_MAGIC || TC_Common::lower(vHeader[1]) != TC_Common::lower(newMd5))
+    {
+        sResult = deltaFile + " header error";
+        gzclose(gz);
+        return -4;
+    }
+
+    string   newContentMd5 = TC_Common::lower(vHeader[2]);
+    uint64_t newSize       = TC_Common::strto<uint64_t>(vHeader[3]);
+
+    //差量是基于旧包解压后的内容计算的, 先解压到文件, 打开后就删掉, 异常退出也不会残留
+    string baseFile = newFile + ".base";
+    if (unpackFile(oldFile, baseFile, sResult) != 0)
+    {
+        gzclose(gz);
+        return -2;
+    }
+
+    int oldFd = ::open(baseFile.c_str(), O_RDONLY | O_CLOEXEC);
+    TC_File::removeFile(baseFile, false);
+
+    struct stat st;
+    if (oldFd < 0 || ::fstat(oldFd, &st) != 0)
+    {
+        sResult = "open " + baseFile + " error:" + strerror(errno);
+        if (oldFd >= 0)
+        {
+            ::close(oldFd);
+        }
+        gzclose(gz);
+        return -2;
+    }
+
+    int newFd = ::open(newFile.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (newFd < 0)
+    {
+        sResult = "open " + newFile + " error:" + strerror(errno);
+        ::close(oldFd);
+        gzclose(gz);
+        return -3;
+    }
+
+    const uint64_t oldSize = st.st_size;
+    uint64_t written = 0;
+
+    vector<char> buffer(1024 * 1024);
+    char num[16];
+
+    bool end = false;
+    bool ok  = true;
+    while (ok && !end)
+    {
+        char op;
+        if (!readDelta(gz, &op, 1))
+        {
+            break;
+        }
+
+        if (op == 'E')
+        {
+            end = true;
+        }
+        else if (op == 'C' && readDelta(gz, num, 16))
+        {
+            uint64_t offset = getUint64(num);
+            uint64_t len    = getUint64(num + 8);
+
+            if (offset > oldSize || len > oldSize - offset || len > newSize - written)
+            {
+                break;
+            }
+
+            while (ok && len > 0)
+            {
+                ssize_t n = ::pread(oldFd, &buffer[0], (size_t)min<uint64_t>(len, buffer.size()), (off_t)offset);
+                ok = (n > 0 && writeAll(newFd, &buffer[0], n));
+                if (ok)
+                {
+                    offset  += n;
+                    len     -= n;
+                    written += n;
+                }
+            }
+        }
+        else if (op == 'L' && readDelta(gz, num, 8))
+        {
+            uint64_t len = getUint64(num);
+
+            if (len > newSize - written)
+            {
+                break;
+            }
+
+            while (ok && len > 0)
+            {
+                size_t n = (size_t)min<uint64_t>(len, buffer.size());
+                ok = (readDelta(gz, &buffer[0], n) && writeAll(newFd, &buffer[0], n));
+                if (ok)
+                {
+                    len     -= n;
+                    written += n;
+                }
+            }
+        }
+        else
+        {
+            break;
+        }
+    }
+
+    gzclose(gz);
+    ::close(oldFd);
+
+    if (::close(newFd) != 0)
+    {
+        ok = false;
+    }
+
+    if (!ok || !end || written != newSize)
+    {
+        sResult = deltaFile + " data error";
+        TC_File::removeFile(newFile, false);
+        return -5;
+    }
+
+    //还原出的是新包解压后的内容, 用patch根据新包计算的内容md5校验
+    if (TC_MD5::md5file(newFile) != newContentMd5)
+    {
+        sResult = newFile + " md5 is not equal:" + newContentMd5;
+        TC_File::removeFile(newFile, false);
+        return -6;
+    }
+
+    contentMd5 = newContentMd5;
+
+    return 0;
+}
+
+}
+
+#else
+
+namespace tars
+{
+
+int TarsDelta::loadContent(const string &file, size_t maxSize, string &content, string &sResult)
+{
+    sResult = "delta is not supported on windows";
+    return -1;
+}
+
+int TarsDelta::makeDelta(const string &oldContent, const string &newContent, const string &newMd5, const string &deltaFile, string &sResult)
+{
+    sResult = "delta is not supported on windows";
+    return -1;
+}
+
+int TarsDelta::applyDelta(const string &oldFile, const string &deltaFile, const string &newFile, const string &newMd5, string &contentMd5, string &sResult)
+{
+    sResult = "delta is not supported on windows";
+    return -1;
+}
+
+}
+
+#endif
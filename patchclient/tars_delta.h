@@ -0,0 +1,73 @@
+/**
+ * Tencent is pleased to support the open source community by making Tars available.
+ *
+ * Copyright (C) 2016THL A29 Limited, a Tencent company. All rights reserved.
+ *
+ * Licensed under the BSD 3-Clause License (the "License"); you may not use this file except 
+ * in compliance with the License. You may obtain a copy of the License at
+ *
+ * https://opensource.org/licenses/BSD-3-Clause
+ *
+ * Unless required by applicable law or agreed to in writing, software distributed 
+ * under the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR 
+ * CONDITIONS OF ANY KIND, either express or implied. See the License for the 
+ * specific language governing permissions and limitations under the License.
+ */
+
+
+#ifndef __TARS_DELTA_H_
+#define __TARS_DELTA_H_
+
+#include <string>
+#include "util/tc_platform.h"
+
+using namespace std;
+
+namespace tars
+{
+/////////////////////////////////////////////////////////////////////////////////////
+/**
+ * 发布包的二进制差量
+ * tgz中一个文件变化后后面的压缩数据都不同, 差量基于解压后的tar计算, 不是gzip格式的包(war/jar等)直接按原始内容计算.
+ * gzip的输出不能逐字节复现, 还原出来的是解压后的内容, 用差量头中内容的md5校验
+ *
+ * 差量文件整体gzip压缩, 解压后的格式:
+ * "TARSDELTA3 <新包md5> <新包内容md5> <新包内容长度>\n"
+ * 'C' + 8字节偏移 + 8字节长度: 从旧包内容中拷贝
+ * 'L' + 8字节长度 + 数据: 新增的数据
+ * 'E': 结束
+ * 数字都是小端
+ *
+ * 只在非windows平台实现(依赖zlib)
+ */
+class TarsDelta
+{
+public:
+    /**
+     * 读取发布包解压后的内容, 不是gzip格式时读取原始内容
+     * @param maxSize, 内容超过该长度时失败, 0表示不限制
+     * @return 0成功, <0失败
+     */
+    static int loadContent(const string &file, size_t maxSize, string &content, string &sResult);
+
+    /**
+     * 生成从oldContent到newContent的差量文件
+     * @param newMd5, 新包的md5, 写入差量头, 节点用它确认差量对应的版本
+     * @return 0成功, <0失败
+     */
+    static int makeDelta(const string &oldContent, const string &newContent, const string &newMd5, const string &deltaFile, string &sResult);
+
+    /**
+     * 在旧包上应用差量, 边解压差量边写出新包的内容
+     * 旧包先解压到newFile.base再按偏移读取, 内存占用与包大小无关
+     * @param newFile, 还原出的新包内容, 失败时删除
+     * @param newMd5, 新包的md5, 必须与差量头一致
+     * @param contentMd5, 返回新包内容的md5(已校验), 与newMd5相同说明新包不是gzip格式, 还原出来的就是新包本身
+     * @return 0成功, <0失败
+     */
+    static int applyDelta(const string &oldFile, const string &deltaFile, const string &newFile, const string &newMd5, string &contentMd5, string &sResult);
+};
+
+}
+
+#endif
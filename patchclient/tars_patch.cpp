@@ -19,6 +19,7 @@
 #include "util/tc_md5.h"
 #include "servant/RemoteLogger.h"
 #include "tars_patch.h"
+#include "tars_range.h"
 
 #include <iostream>
 
@@ -26,6 +27,7 @@ namespace tars
 {
 TarsPatch::TarsPatch()
 : _remove(false)
+, _rangeSize(8*1024*1024)
 {
 }
 
@@ -54,6 +56,11 @@ void TarsPatch::setRemove(bool bRemove)
     _remove = bRemove;
 }
 
+void TarsPatch::setRangeSize(size_t rangeSize)
+{
+    _rangeSize = rangeSize;
+}
+
 void TarsPatch::download(const TarsPatchNotifyInterfacePtr &pPtr)
 {
     //记录下载本次服务的总的时间开始
@@ -183,12 +190,17 @@ void TarsPatch::download(bool bDir, const FileInfo &fi, const TarsPatchNotifyInt
     {
         //循环下载文件到本地
         vector<char> v;
-        int pos = 0;
+        size_t pos = 0;
         while (true)
         {
             v.clear();
             int ret;
 
+            //按范围请求, 第一个请求要求带上文件大小和md5
+            map<string, string> context;
+            map<string, string> rspContext;
+            TarsRange::setRequest(context, pos, _rangeSize, pos == 0);
+
             int nRetryTime = 0;
 
         RETRY:
@@ -196,11 +208,11 @@ void TarsPatch::download(bool bDir, const FileInfo &fi, const TarsPatchNotifyInt
             {
                 if (bDir)
                 {
-                    ret = _patchPrx->download(tars::TC_File::simplifyDirectory(_remoteDir + "/" + fi.path), pos, v);
+                    ret = _patchPrx->download(tars::TC_File::simplifyDirectory(_remoteDir + "/" + fi.path), (int)pos, v, context, &rspContext);
                 }
                 else
                 {
-                    ret = _patchPrx->download(tars::TC_File::simplifyDirectory(_remoteDir), pos, v);
+                    ret = _patchPrx->download(tars::TC_File::simplifyDirectory(_remoteDir), (int)pos, v, context, &rspContext);
                 }
             }
             catch(TarsException& ex)
@@ -219,6 +231,13 @@ void TarsPatch::download(bool bDir, const FileInfo &fi, const TarsPatchNotifyInt
             {
                 throw TarsPatchException("download file '" + file + "' error!");
             }
+
+            size_t fileSize = 0;
+            string fileMd5;
+            if (pos == 0 && TarsRange::getFileInfo(rspContext, fileSize, fileMd5) && (fileSize != (size_t)fi.size || fileMd5 != fi.md5))
+            {
+                throw TarsPatchException("file '" + fi.path + "' changed while downloading");
+            }
             else if (ret == 0)
             {
                 size_t r = fwrite((void*)&v[0], 1, v.size(), fp);
@@ -145,6 +145,12 @@ public:
      */
     void setRemove(bool bRemove);
 
+    /**
+     * 设置每次范围下载请求的大小, patch按自己的rangeMax截断, 不支持范围下载的patch按它的size返回
+     * @param rangeSize
+     */
+    void setRangeSize(size_t rangeSize);
+
     /**
      * 下载, 失败抛出异常
      *
@@ -181,6 +187,11 @@ protected:
      */
     bool            _remove;
 
+    /**
+     * 每次范围下载请求的大小
+     */
+    size_t          _rangeSize;
+
     /**
      * patch服务器
      */
@@ -0,0 +1,86 @@
+/**
+ * Tencent is pleased to support the open source community by making Tars available.
+ *
+ * Copyright (C) 2016THL A29 Limited, a Tencent company. All rights reserved.
+ *
+ * Licensed under the BSD 3-Clause License (the "License"); you may not use this file except 
+ * in compliance with the License. You may obtain a copy of the License at
+ *
+ * https://opensource.org/licenses/BSD-3-Clause
+ *
+ * Unless required by applicable law or agreed to in writing, software distributed 
+ * under the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR 
+ * CONDITIONS OF ANY KIND, either express or implied. See the License for the 
+ * specific language governing permissions and limitations under the License.
+ */
+
+
+#include "util/tc_common.h"
+#include "tars_range.h"
+
+namespace tars
+{
+
+#define RANGE_POS   "TARS_PATCH_RANGE_POS"
+#define RANGE_LEN   "TARS_PATCH_RANGE_LEN"
+#define RANGE_INFO  "TARS_PATCH_RANGE_INFO"
+#define FILE_SIZE   "TARS_PATCH_FILE_SIZE"
+#define FILE_MD5    "TARS_PATCH_FILE_MD5"
+
+void TarsRange::setRequest(map<string, string> &context, size_t pos, size_t len, bool withInfo)
+{
+    context[RANGE_POS] = TC_Common::tostr(pos);
+    context[RANGE_LEN] = TC_Common::tostr(len);
+
+    if (withInfo)
+    {
+        context[RANGE_INFO] = "Y";
+    }
+    else
+    {
+        context.erase(RANGE_INFO);
+    }
+}
+
+bool TarsRange::getRequest(const map<string, string> &context, size_t &pos, size_t &len, bool &withInfo)
+{
+    map<string, string>::const_iterator itPos = context.find(RANGE_POS);
+    map<string, string>::const_iterator itLen = context.find(RANGE_LEN);
+
+    if (itPos == context.end() || itLen == context.end() || !TC_Common::isdigit(itPos->second) || !TC_Common::isdigit(itLen->second))
+    {
+        return false;
+    }
+
+    pos = TC_Common::strto<size_t>(itPos->second);
+    len = TC_Common::strto<size_t>(itLen->second);
+
+    map<string, string>::const_iterator itInfo = context.find(RANGE_INFO);
+    withInfo = (itInfo != context.end() && itInfo->second == "Y");
+
+    return true;
+}
+
+void TarsRange::setFileInfo(map<string, string> &context, size_t size, const string &md5)
+{
+    context[FILE_SIZE] = TC_Common::tostr(size);
+    context[FILE_MD5]  = md5;
+}
+
+bool TarsRange::getFileInfo(const map<string, string> &context, size_t &size, string &md5)
+{
+    map<string, string>::const_iterator itSize = context.find(FILE_SIZE);
+    map<string, string>::const_iterator itMd5  = context.find(FILE_MD5);
+
+    if (itSize == context.end() || itMd5 == context.end() || !TC_Common::isdigit(itSize->second))
+    {
+        return false;
+    }
+
+    size = TC_Common::strto<size_t>(itSize->second);
+    md5  = itMd5->second;
+
+    return true;
+}
+
+}
@@ -0,0 +1,71 @@
+/**
+ * Tencent is pleased to support the open source community by making Tars available.
+ *
+ * Copyright (C) 2016THL A29 Limited, a Tencent company. All rights reserved.
+ *
+ * Licensed under the BSD 3-Clause License (the "License"); you may not use this file except 
+ * in compliance with the License. You may obtain a copy of the License at
+ *
+ * https://opensource.org/licenses/BSD-3-Clause
+ *
+ * Unless required by applicable law or agreed to in writing, software distributed 
+ * under the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR 
+ * CONDITIONS OF ANY KIND, either express or implied. See the License for the 
+ * specific language governing permissions and limitations under the License.
+ */
+
+
+#ifndef __TARS_RANGE_H_
+#define __TARS_RANGE_H_
+
+#include <map>
+#include <string>
+
+using namespace std;
+
+namespace tars
+{
+/////////////////////////////////////////////////////////////////////////////////////
+/**
+ * 大窗口的范围下载
+ * Patch::download每次只返回patch配置的size, 单个连接的吞吐被RTT限制.
+ * Patch协议不在本仓库中定义, 范围参数放在download请求的context中,
+ * 不认识这些key的patch/节点忽略它们, 仍然按size返回, 调用者需要能处理返回长度比请求短的情况
+ *
+ * 请求context:
+ * TARS_PATCH_RANGE_POS: 下载的起始位置, 64位, 有它时忽略int类型的pos参数
+ * TARS_PATCH_RANGE_LEN: 希望返回的长度, 服务端按自己的rangeMax截断
+ * TARS_PATCH_RANGE_INFO: Y表示应答context中带上文件大小和md5, 一般只在第一个请求中带
+ *
+ * 应答context:
+ * TARS_PATCH_FILE_SIZE / TARS_PATCH_FILE_MD5
+ */
+class TarsRange
+{
+public:
+    /**
+     * 设置范围请求
+     */
+    static void setRequest(map<string, string> &context, size_t pos, size_t len, bool withInfo);
+
+    /**
+     * 解析范围请求
+     * @return 不是范围请求时返回false
+     */
+    static bool getRequest(const map<string, string> &context, size_t &pos, size_t &len, bool &withInfo);
+
+    /**
+     * 在应答中带上文件信息
+     */
+    static void setFileInfo(map<string, string> &context, size_t size, const string &md5);
+
+    /**
+     * 获取应答中的文件信息
+     * @return 服务端不支持范围下载或者没有带文件信息时返回false
+     */
+    static bool getFileInfo(const map<string, string> &context, size_t &size, string &md5);
+};
+
+}
+
+#endif